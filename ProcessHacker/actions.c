@@ -974,6 +974,45 @@ static BOOLEAN PhpShowErrorProcess(
     }
 }
 
+static BOOLEAN PhpUiControlProcessesWithPhSvc(
+    _In_ HWND hWnd,
+    _In_ PWSTR Verb,
+    _In_ PPH_PROCESS_ITEM *Processes,
+    _In_ ULONG NumberOfProcesses,
+    _In_ PHSVC_API_CONTROLPROCESS_COMMAND Command,
+    _In_ ULONG Argument
+    )
+{
+    BOOLEAN success = TRUE;
+    PHANDLE processIds;
+    PNTSTATUS statuses;
+    ULONG i;
+
+    processIds = PhAllocate(NumberOfProcesses * sizeof(HANDLE));
+    statuses = PhAllocate(NumberOfProcesses * sizeof(NTSTATUS));
+
+    for (i = 0; i < NumberOfProcesses; i++)
+        processIds[i] = Processes[i]->ProcessId;
+
+    PhSvcCallControlProcesses(processIds, NumberOfProcesses, Command, Argument, statuses);
+
+    for (i = 0; i < NumberOfProcesses; i++)
+    {
+        if (!NT_SUCCESS(statuses[i]))
+        {
+            success = FALSE;
+
+            if (!PhpShowErrorProcess(hWnd, Verb, Processes[i], statuses[i], 0))
+                break;
+        }
+    }
+
+    PhFree(statuses);
+    PhFree(processIds);
+
+    return success;
+}
+
 BOOLEAN PhUiTerminateProcesses(
     _In_ HWND hWnd,
     _In_ PPH_PROCESS_ITEM *Processes,
@@ -1028,12 +1067,12 @@ BOOLEAN PhUiTerminateProcesses(
             {
                 if (connected)
                 {
-                    if (NT_SUCCESS(status = PhSvcCallControlProcess(Processes[i]->ProcessId, PhSvcControlProcessTerminate, 0)))
+                    // Send this process and all remaining ones to phsvc in one batch.
+                    if (PhpUiControlProcessesWithPhSvc(hWnd, L"terminate", &Processes[i], NumberOfProcesses - i, PhSvcControlProcessTerminate, 0))
                         success = TRUE;
-                    else
-                        PhpShowErrorProcess(hWnd, L"terminate", Processes[i], status, 0);
 
                     PhUiDisconnectFromPhSvc();
+                    break;
                 }
                 else
                 {
@@ -1207,12 +1246,12 @@ BOOLEAN PhUiSuspendProcesses(
             {
                 if (connected)
                 {
-                    if (NT_SUCCESS(status = PhSvcCallControlProcess(Processes[i]->ProcessId, PhSvcControlProcessSuspend, 0)))
+                    // Send this process and all remaining ones to phsvc in one batch.
+                    if (PhpUiControlProcessesWithPhSvc(hWnd, L"suspend", &Processes[i], NumberOfProcesses - i, PhSvcControlProcessSuspend, 0))
                         success = TRUE;
-                    else
-                        PhpShowErrorProcess(hWnd, L"suspend", Processes[i], status, 0);
 
                     PhUiDisconnectFromPhSvc();
+                    break;
                 }
                 else
                 {
@@ -1280,12 +1319,12 @@ BOOLEAN PhUiResumeProcesses(
             {
                 if (connected)
                 {
-                    if (NT_SUCCESS(status = PhSvcCallControlProcess(Processes[i]->ProcessId, PhSvcControlProcessResume, 0)))
+                    // Send this process and all remaining ones to phsvc in one batch.
+                    if (PhpUiControlProcessesWithPhSvc(hWnd, L"resume", &Processes[i], NumberOfProcesses - i, PhSvcControlProcessResume, 0))
                         success = TRUE;
-                    else
-                        PhpShowErrorProcess(hWnd, L"resume", Processes[i], status, 0);
 
                     PhUiDisconnectFromPhSvc();
+                    break;
                 }
                 else
                 {
@@ -1770,12 +1809,12 @@ BOOLEAN PhUiSetIoPriorityProcesses(
             {
                 if (connected)
                 {
-                    if (NT_SUCCESS(status = PhSvcCallControlProcess(Processes[i]->ProcessId, PhSvcControlProcessIoPriority, IoPriority)))
+                    // Send this process and all remaining ones to phsvc in one batch.
+                    if (PhpUiControlProcessesWithPhSvc(hWnd, L"set the I/O priority of", &Processes[i], NumberOfProcesses - i, PhSvcControlProcessIoPriority, IoPriority))
                         success = TRUE;
-                    else
-                        PhpShowErrorProcess(hWnd, L"set the I/O priority of", Processes[i], status, 0);
 
                     PhUiDisconnectFromPhSvc();
+                    break;
                 }
                 else
                 {
@@ -1890,12 +1929,12 @@ BOOLEAN PhUiSetPriorityProcesses(
             {
                 if (connected)
                 {
-                    if (NT_SUCCESS(status = PhSvcCallControlProcess(Processes[i]->ProcessId, PhSvcControlProcessPriority, PriorityClass)))
+                    // Send this process and all remaining ones to phsvc in one batch.
+                    if (PhpUiControlProcessesWithPhSvc(hWnd, L"set the priority of", &Processes[i], NumberOfProcesses - i, PhSvcControlProcessPriority, PriorityClass))
                         success = TRUE;
-                    else
-                        PhpShowErrorProcess(hWnd, L"set the priority of", Processes[i], status, 0);
 
                     PhUiDisconnectFromPhSvc();
+                    break;
                 }
                 else
                 {
@@ -2356,6 +2395,45 @@ static BOOLEAN PhpShowErrorThread(
         );
 }
 
+static BOOLEAN PhpUiControlThreadsWithPhSvc(
+    _In_ HWND hWnd,
+    _In_ PWSTR Verb,
+    _In_ PPH_THREAD_ITEM *Threads,
+    _In_ ULONG NumberOfThreads,
+    _In_ PHSVC_API_CONTROLTHREAD_COMMAND Command,
+    _In_ ULONG Argument
+    )
+{
+    BOOLEAN success = TRUE;
+    PHANDLE threadIds;
+    PNTSTATUS statuses;
+    ULONG i;
+
+    threadIds = PhAllocate(NumberOfThreads * sizeof(HANDLE));
+    statuses = PhAllocate(NumberOfThreads * sizeof(NTSTATUS));
+
+    for (i = 0; i < NumberOfThreads; i++)
+        threadIds[i] = Threads[i]->ThreadId;
+
+    PhSvcCallControlThreads(threadIds, NumberOfThreads, Command, Argument, statuses);
+
+    for (i = 0; i < NumberOfThreads; i++)
+    {
+        if (!NT_SUCCESS(statuses[i]))
+        {
+            success = FALSE;
+
+            if (!PhpShowErrorThread(hWnd, Verb, Threads[i], statuses[i], 0))
+                break;
+        }
+    }
+
+    PhFree(statuses);
+    PhFree(threadIds);
+
+    return success;
+}
+
 BOOLEAN PhUiTerminateThreads(
     _In_ HWND hWnd,
     _In_ PPH_THREAD_ITEM *Threads,
@@ -2406,12 +2484,12 @@ BOOLEAN PhUiTerminateThreads(
             {
                 if (connected)
                 {
-                    if (NT_SUCCESS(status = PhSvcCallControlThread(Threads[i]->ThreadId, PhSvcControlThreadTerminate, 0)))
+                    // Send this thread and all remaining ones to phsvc in one batch.
+                    if (PhpUiControlThreadsWithPhSvc(hWnd, L"terminate", &Threads[i], NumberOfThreads - i, PhSvcControlThreadTerminate, 0))
                         success = TRUE;
-                    else
-                        PhpShowErrorThread(hWnd, L"terminate", Threads[i], status, 0);
 
                     PhUiDisconnectFromPhSvc();
+                    break;
                 }
                 else
                 {
@@ -2469,12 +2547,12 @@ BOOLEAN PhUiSuspendThreads(
             {
                 if (connected)
                 {
-                    if (NT_SUCCESS(status = PhSvcCallControlThread(Threads[i]->ThreadId, PhSvcControlThreadSuspend, 0)))
+                    // Send this thread and all remaining ones to phsvc in one batch.
+                    if (PhpUiControlThreadsWithPhSvc(hWnd, L"suspend", &Threads[i], NumberOfThreads - i, PhSvcControlThreadSuspend, 0))
                         success = TRUE;
-                    else
-                        PhpShowErrorThread(hWnd, L"suspend", Threads[i], status, 0);
 
                     PhUiDisconnectFromPhSvc();
+                    break;
                 }
                 else
                 {
@@ -2532,12 +2610,12 @@ BOOLEAN PhUiResumeThreads(
             {
                 if (connected)
                 {
-                    if (NT_SUCCESS(status = PhSvcCallControlThread(Threads[i]->ThreadId, PhSvcControlThreadResume, 0)))
+                    // Send this thread and all remaining ones to phsvc in one batch.
+                    if (PhpUiControlThreadsWithPhSvc(hWnd, L"resume", &Threads[i], NumberOfThreads - i, PhSvcControlThreadResume, 0))
                         success = TRUE;
-                    else
-                        PhpShowErrorThread(hWnd, L"resume", Threads[i], status, 0);
 
                     PhUiDisconnectFromPhSvc();
+                    break;
                 }
                 else
                 {
@@ -0,0 +1,479 @@
+/*
+ * Process Hacker -
+ *   thread stack profiler
+ *
+ * This file is part of Process Hacker.
+ *
+ * Process Hacker is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Process Hacker is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Process Hacker.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * The profiler periodically walks the stacks of all threads in a process and merges the stacks
+ * into a stack profile. Thread handles and the frame buffer are reused between samples, and the
+ * thread list is only refreshed every PROFILE_THREAD_REFRESH_INTERVAL. Frames are stored as
+ * addresses and are only resolved to symbols after sampling has stopped, so each sample costs
+ * little more than the stack walk itself.
+ */
+
+#include <phapp.h>
+
+#include <kphuser.h>
+#include <stkprof.h>
+#include <symprv.h>
+
+#include <procprv.h>
+#include <settings.h>
+#include <thrdprv.h>
+
+#define WM_PH_COMPLETED (WM_APP + 301)
+
+#define PROFILE_MAXIMUM_FRAMES 256
+#define PROFILE_THREAD_REFRESH_INTERVAL (1000 * PH_TICKS_PER_MS)
+#define PROFILE_STATUS_TIMER 1
+
+typedef struct _PROFILE_THREAD
+{
+    CLIENT_ID ClientId;
+    HANDLE ThreadHandle;
+    BOOLEAN Found;
+} PROFILE_THREAD, *PPROFILE_THREAD;
+
+typedef struct _PROFILE_STACKS_CONTEXT
+{
+    HANDLE ProcessId;
+    PPH_THREAD_PROVIDER ThreadProvider;
+    PPH_SYMBOL_PROVIDER SymbolProvider;
+    ULONG Interval;
+
+    HWND ProgressWindowHandle;
+    BOOLEAN Stop;
+    BOOLEAN Resolving;
+    NTSTATUS Status;
+
+    PPH_LIST Threads;
+    ULONG64 Frames[PROFILE_MAXIMUM_FRAMES];
+    ULONG NumberOfFrames;
+
+    PH_STACK_PROFILE Profile;
+    PPH_STRING Folded;
+} PROFILE_STACKS_CONTEXT, *PPROFILE_STACKS_CONTEXT;
+
+static INT_PTR CALLBACK PhpProfileStacksProgressDlgProc(
+    _In_ HWND hwndDlg,
+    _In_ UINT uMsg,
+    _In_ WPARAM wParam,
+    _In_ LPARAM lParam
+    );
+
+static VOID PhpSaveStackProfile(
+    _In_ HWND hWnd,
+    _In_ PPROFILE_STACKS_CONTEXT Context
+    );
+
+VOID PhUiProfileThreadStacks(
+    _In_ HWND hWnd,
+    _In_ PPH_THREAD_PROVIDER ThreadProvider
+    )
+{
+    PROFILE_STACKS_CONTEXT context;
+    ULONG i;
+
+    if (ThreadProvider->ProcessId == SYSTEM_PROCESS_ID && !KphIsConnected())
+    {
+        PhShowError(hWnd, PH_KPH_ERROR_MESSAGE);
+        return;
+    }
+
+    memset(&context, 0, sizeof(PROFILE_STACKS_CONTEXT));
+    context.ProcessId = ThreadProvider->ProcessId;
+    context.ThreadProvider = ThreadProvider;
+    context.SymbolProvider = ThreadProvider->SymbolProvider;
+    context.Interval = PhGetIntegerSetting(L"ThreadStackProfileInterval");
+    context.Threads = PhCreateList(32);
+    PhInitializeStackProfile(&context.Profile);
+
+    if (context.Interval == 0)
+        context.Interval = 1;
+
+    DialogBoxParam(
+        PhInstanceHandle,
+        MAKEINTRESOURCE(IDD_PROGRESS),
+        hWnd,
+        PhpProfileStacksProgressDlgProc,
+        (LPARAM)&context
+        );
+
+    if (context.Folded)
+    {
+        PhpSaveStackProfile(hWnd, &context);
+        PhDereferenceObject(context.Folded);
+    }
+    else if (!NT_SUCCESS(context.Status))
+    {
+        PhShowStatus(hWnd, L"Unable to profile the process", context.Status, 0);
+    }
+    else
+    {
+        PhShowError(hWnd, L"No stacks were sampled.");
+    }
+
+    for (i = 0; i < context.Threads->Count; i++)
+    {
+        PPROFILE_THREAD thread = context.Threads->Items[i];
+
+        if (thread->ThreadHandle)
+            NtClose(thread->ThreadHandle);
+
+        PhFree(thread);
+    }
+
+    PhDereferenceObject(context.Threads);
+    PhDeleteStackProfile(&context.Profile);
+}
+
+static VOID PhpRefreshProfileThreads(
+    _Inout_ PPROFILE_STACKS_CONTEXT Context
+    )
+{
+    PVOID processes;
+    PSYSTEM_PROCESS_INFORMATION process;
+    ULONG i;
+    ULONG j;
+
+    if (!NT_SUCCESS(PhEnumProcesses(&processes)))
+        return;
+
+    process = PhFindProcessInformation(processes, Context->ProcessId);
+
+    if (!process)
+    {
+        PhFree(processes);
+        return;
+    }
+
+    for (i = 0; i < Context->Threads->Count; i++)
+        ((PPROFILE_THREAD)Context->Threads->Items[i])->Found = FALSE;
+
+    for (i = 0; i < process->NumberOfThreads; i++)
+    {
+        PSYSTEM_THREAD_INFORMATION threadInfo = &process->Threads[i];
+        PPROFILE_THREAD thread = NULL;
+
+        // Don't try to sample ourselves.
+        if (threadInfo->ClientId.UniqueThread == NtCurrentTeb()->ClientId.UniqueThread)
+            continue;
+
+        for (j = 0; j < Context->Threads->Count; j++)
+        {
+            if (((PPROFILE_THREAD)Context->Threads->Items[j])->ClientId.UniqueThread == threadInfo->ClientId.UniqueThread)
+            {
+                thread = Context->Threads->Items[j];
+                break;
+            }
+        }
+
+        if (!thread)
+        {
+            thread = PhAllocate(sizeof(PROFILE_THREAD));
+            thread->ClientId = threadInfo->ClientId;
+            thread->ThreadHandle = NULL;
+
+            // Threads that can't be opened are kept in the list so that we don't try to open
+            // them again on every refresh.
+            if (!NT_SUCCESS(PhOpenThread(
+                &thread->ThreadHandle,
+                THREAD_QUERY_INFORMATION | THREAD_GET_CONTEXT | THREAD_SUSPEND_RESUME,
+                thread->ClientId.UniqueThread
+                )) && KphIsConnected())
+            {
+                PhOpenThread(&thread->ThreadHandle, ThreadQueryAccess, thread->ClientId.UniqueThread);
+            }
+
+            PhAddItemList(Context->Threads, thread);
+        }
+
+        thread->Found = TRUE;
+    }
+
+    // Remove threads that have terminated.
+    for (i = Context->Threads->Count; i != 0; i--)
+    {
+        PPROFILE_THREAD thread = Context->Threads->Items[i - 1];
+
+        if (!thread->Found)
+        {
+            if (thread->ThreadHandle)
+                NtClose(thread->ThreadHandle);
+
+            PhFree(thread);
+            PhRemoveItemList(Context->Threads, i - 1);
+        }
+    }
+
+    PhFree(processes);
+}
+
+static BOOLEAN NTAPI PhpProfileWalkThreadStackCallback(
+    _In_ PPH_THREAD_STACK_FRAME StackFrame,
+    _In_opt_ PVOID Context
+    )
+{
+    PPROFILE_STACKS_CONTEXT context = Context;
+
+    context->Frames[context->NumberOfFrames++] = (ULONG64)(ULONG_PTR)StackFrame->PcAddress;
+
+    return context->NumberOfFrames < PROFILE_MAXIMUM_FRAMES;
+}
+
+static PPH_STRING NTAPI PhpProfileResolveAddress(
+    _In_ ULONG64 Address,
+    _In_opt_ PVOID Context
+    )
+{
+    PPROFILE_STACKS_CONTEXT context = Context;
+
+    return PhGetSymbolFromAddress(context->SymbolProvider, Address, NULL, NULL, NULL, NULL);
+}
+
+static NTSTATUS PhpProfileStacksThreadStart(
+    _In_ PVOID Parameter
+    )
+{
+    PH_AUTO_POOL autoPool;
+    PPROFILE_STACKS_CONTEXT context = Parameter;
+    LARGE_INTEGER lastRefreshTime;
+    LARGE_INTEGER startTime;
+    LARGE_INTEGER endTime;
+    LARGE_INTEGER interval;
+    ULONG i;
+
+    PhInitializeAutoPool(&autoPool);
+
+    // Module information is needed to unwind stacks on AMD64, so load symbols before we start.
+    PhLoadSymbolsThreadProvider(context->ThreadProvider);
+
+    lastRefreshTime.QuadPart = 0;
+    context->Status = STATUS_SUCCESS;
+
+    while (!context->Stop)
+    {
+        PhQuerySystemTime(&startTime);
+
+        if (startTime.QuadPart - lastRefreshTime.QuadPart >= PROFILE_THREAD_REFRESH_INTERVAL)
+        {
+            PhpRefreshProfileThreads(context);
+            lastRefreshTime = startTime;
+        }
+
+        for (i = 0; i < context->Threads->Count && !context->Stop; i++)
+        {
+            PPROFILE_THREAD thread = context->Threads->Items[i];
+            NTSTATUS status;
+
+            if (!thread->ThreadHandle)
+                continue;
+
+            context->NumberOfFrames = 0;
+            status = PhWalkThreadStack(
+                thread->ThreadHandle,
+                context->SymbolProvider->ProcessHandle,
+                &thread->ClientId,
+                context->SymbolProvider,
+                PH_WALK_I386_STACK | PH_WALK_AMD64_STACK | PH_WALK_KERNEL_STACK,
+                PhpProfileWalkThreadStackCallback,
+                context
+                );
+
+            if (context->NumberOfFrames != 0)
+                PhAddStackProfileSample(&context->Profile, context->Frames, context->NumberOfFrames);
+            else if (!NT_SUCCESS(status))
+                context->Status = status;
+        }
+
+        // Sleep for the rest of the interval. If walking the stacks took longer than the
+        // interval, start the next pass immediately.
+
+        PhQuerySystemTime(&endTime);
+        interval.QuadPart = (LONGLONG)context->Interval * PH_TICKS_PER_MS - (endTime.QuadPart - startTime.QuadPart);
+
+        if (interval.QuadPart > 0 && !context->Stop)
+        {
+            interval.QuadPart = -interval.QuadPart;
+            NtDelayExecution(FALSE, &interval);
+        }
+    }
+
+    if (context->Profile.NumberOfSamples != 0)
+    {
+        context->Resolving = TRUE;
+        context->Folded = PhFormatStackProfileFolded(&context->Profile, PhpProfileResolveAddress, context);
+    }
+
+    PostMessage(context->ProgressWindowHandle, WM_PH_COMPLETED, 0, 0);
+
+    PhDeleteAutoPool(&autoPool);
+
+    return STATUS_SUCCESS;
+}
+
+static INT_PTR CALLBACK PhpProfileStacksProgressDlgProc(
+    _In_ HWND hwndDlg,
+    _In_ UINT uMsg,
+    _In_ WPARAM wParam,
+    _In_ LPARAM lParam
+    )
+{
+    switch (uMsg)
+    {
+    case WM_INITDIALOG:
+        {
+            PPROFILE_STACKS_CONTEXT context = (PPROFILE_STACKS_CONTEXT)lParam;
+            HANDLE threadHandle;
+
+            SetProp(hwndDlg, PhMakeContextAtom(), (HANDLE)context);
+            context->ProgressWindowHandle = hwndDlg;
+
+            if (threadHandle = PhCreateThread(0, PhpProfileStacksThreadStart, context))
+            {
+                NtClose(threadHandle);
+            }
+            else
+            {
+                context->Status = STATUS_UNSUCCESSFUL;
+                EndDialog(hwndDlg, IDOK);
+                break;
+            }
+
+            PhCenterWindow(hwndDlg, GetParent(hwndDlg));
+
+            PhSetWindowStyle(GetDlgItem(hwndDlg, IDC_PROGRESS), PBS_MARQUEE, PBS_MARQUEE);
+            SendMessage(GetDlgItem(hwndDlg, IDC_PROGRESS), PBM_SETMARQUEE, TRUE, 75);
+            SetWindowText(hwndDlg, L"Profiling stacks...");
+            SetDlgItemText(hwndDlg, IDCANCEL, L"Stop");
+            SetDlgItemText(hwndDlg, IDC_PROGRESSTEXT, L"Starting...");
+
+            SetTimer(hwndDlg, PROFILE_STATUS_TIMER, 500, NULL);
+        }
+        break;
+    case WM_DESTROY:
+        {
+            KillTimer(hwndDlg, PROFILE_STATUS_TIMER);
+            RemoveProp(hwndDlg, PhMakeContextAtom());
+        }
+        break;
+    case WM_COMMAND:
+        {
+            switch (LOWORD(wParam))
+            {
+            case IDCANCEL:
+                {
+                    PPROFILE_STACKS_CONTEXT context = (PPROFILE_STACKS_CONTEXT)GetProp(hwndDlg, PhMakeContextAtom());
+
+                    EnableWindow(GetDlgItem(hwndDlg, IDCANCEL), FALSE);
+                    context->Stop = TRUE;
+                }
+                break;
+            }
+        }
+        break;
+    case WM_TIMER:
+        {
+            PPROFILE_STACKS_CONTEXT context = (PPROFILE_STACKS_CONTEXT)GetProp(hwndDlg, PhMakeContextAtom());
+
+            if (context->Resolving)
+            {
+                SetDlgItemText(hwndDlg, IDC_PROGRESSTEXT, L"Resolving symbols...");
+            }
+            else
+            {
+                PPH_STRING message;
+
+                // These values are only read for display, so we don't need to synchronize with
+                // the profiler thread.
+                message = PhFormatString(
+                    L"Collected %u samples (%u unique frames) from %u threads.",
+                    context->Profile.NumberOfSamples,
+                    context->Profile.NumberOfNodes - 1,
+                    context->Threads->Count
+                    );
+                SetDlgItemText(hwndDlg, IDC_PROGRESSTEXT, message->Buffer);
+                PhDereferenceObject(message);
+            }
+        }
+        break;
+    case WM_PH_COMPLETED:
+        {
+            EndDialog(hwndDlg, IDOK);
+        }
+        break;
+    }
+
+    return 0;
+}
+
+static VOID PhpSaveStackProfile(
+    _In_ HWND hWnd,
+    _In_ PPROFILE_STACKS_CONTEXT Context
+    )
+{
+    static PH_FILETYPE_FILTER filters[] =
+    {
+        { L"Folded stacks (*.txt)", L"*.txt" },
+        { L"All files (*.*)", L"*.*" }
+    };
+    PVOID fileDialog;
+    PPH_PROCESS_ITEM processItem;
+    PPH_STRING suggestedFileName = NULL;
+
+    fileDialog = PhCreateSaveFileDialog();
+
+    PhSetFileDialogFilter(fileDialog, filters, sizeof(filters) / sizeof(PH_FILETYPE_FILTER));
+
+    if (processItem = PhReferenceProcessItem(Context->ProcessId))
+    {
+        suggestedFileName = PhConcatStrings2(processItem->ProcessName->Buffer, L".folded.txt");
+        PhDereferenceObject(processItem);
+    }
+
+    PhSetFileDialogFileName(fileDialog, PhGetStringOrDefault(suggestedFileName, L"Stacks.folded.txt"));
+    PhClearReference(&suggestedFileName);
+
+    if (PhShowFileDialog(hWnd, fileDialog))
+    {
+        NTSTATUS status;
+        PPH_STRING fileName;
+        PPH_FILE_STREAM fileStream;
+
+        fileName = PH_AUTO(PhGetFileDialogFileName(fileDialog));
+
+        // Flame graph tools don't expect a byte order mark, so don't write one.
+        if (NT_SUCCESS(status = PhCreateFileStream(
+            &fileStream,
+            fileName->Buffer,
+            FILE_GENERIC_WRITE,
+            FILE_SHARE_READ,
+            FILE_OVERWRITE_IF,
+            0
+            )))
+        {
+            status = PhWriteStringAsUtf8FileStream(fileStream, &Context->Folded->sr);
+            PhDereferenceObject(fileStream);
+        }
+
+        if (!NT_SUCCESS(status))
+            PhShowStatus(hWnd, L"Unable to create the file", status, 0);
+    }
+
+    PhFreeFileDialog(fileDialog);
+}
@@ -338,6 +338,52 @@ static VOID PhpPrintHashtableStatistics(
     wprintf(L"\nExpected lookup misses: %lu\n", expectedLookupMisses);
 }
 
+static int __cdecl PhpQueuedLockSiteCompareByWaitTime(
+    _In_ const void *elem1,
+    _In_ const void *elem2
+    )
+{
+    PPH_QUEUED_LOCK_SITE site1 = (PPH_QUEUED_LOCK_SITE)elem1;
+    PPH_QUEUED_LOCK_SITE site2 = (PPH_QUEUED_LOCK_SITE)elem2;
+
+    return uint64cmp(site2->WaitTime, site1->WaitTime);
+}
+
+static VOID PhpPrintQueuedLockProfile(
+    VOID
+    )
+{
+    PPH_QUEUED_LOCK_SITE sites;
+    ULONG numberOfSites;
+    ULONG i;
+
+    if (!PhGetQueuedLockProfiling())
+    {
+        wprintf(L"Lock profiling is disabled. Type \"lockprof on\" to enable it.\n");
+        return;
+    }
+
+    sites = PhAllocate(sizeof(PH_QUEUED_LOCK_SITE) * (PH_QUEUED_LOCK_PROFILE_SIZE + 1));
+    numberOfSites = PhGetQueuedLockProfile(sites, PH_QUEUED_LOCK_PROFILE_SIZE + 1);
+    qsort(sites, numberOfSites, sizeof(PH_QUEUED_LOCK_SITE), PhpQueuedLockSiteCompareByWaitTime);
+
+    wprintf(L"Lock contention:\n");
+    wprintf(L"%10s %8s %14s  %s\n", L"Blocks", L"Waiters", L"Wait time (us)", L"Site");
+
+    for (i = 0; i < numberOfSites; i++)
+    {
+        wprintf(
+            L"%10u %8u %14I64u  %s\n",
+            sites[i].Blocks,
+            sites[i].MaximumWaiters,
+            sites[i].WaitTime / PH_TICKS_PER_NS,
+            sites[i].Address ? PhpGetSymbolForAddress(sites[i].Address) : L"(other)"
+            );
+    }
+
+    PhFree(sites);
+}
+
 #ifdef DEBUG
 static VOID PhpDebugCreateObjectHook(
     _In_ PVOID Object,
@@ -492,6 +538,14 @@ static ULONG PhGetMillisecondsStopwatch(
         countsPerMs.QuadPart);
 }
 
+static VOID NTAPI PhpTestCallbackFunction(
+    _In_opt_ PVOID Parameter,
+    _In_opt_ PVOID Context
+    )
+{
+    NOTHING;
+}
+
 typedef VOID (FASTCALL *PPHF_RW_LOCK_FUNCTION)(
     _In_ PVOID Parameter
     );
@@ -735,6 +789,7 @@ NTSTATUS PhpDebugConsoleThreadStart(
                 L"testperf\n"
                 L"testlocks\n"
                 L"stats\n"
+                L"lockprof [on|off|reset]\n"
                 L"objects [type-name-filter]\n"
                 L"objtrace object-address\n"
                 L"objmksnap\n"
@@ -768,6 +823,11 @@ NTSTATUS PhpDebugConsoleThreadStart(
             RTL_CRITICAL_SECTION testCriticalSection;
             PH_FAST_LOCK testFastLock;
             PH_QUEUED_LOCK testQueuedLock;
+            PH_CALLBACK testCallback;
+            PH_CALLBACK_REGISTRATION testRegistrations[4];
+            PH_FORMAT testFormat[64];
+            WCHAR testBuffer[RTL_NUMBER_OF(testFormat)][32];
+            ULONG j;
 
             // Control (string reference counting)
 
@@ -839,6 +899,81 @@ NTSTATUS PhpDebugConsoleThreadStart(
             PhStopStopwatch(&stopwatch);
 
             wprintf(L"Queued lock: %ums\n", PhGetMillisecondsStopwatch(&stopwatch));
+
+            // Callback
+
+            PhInitializeCallback(&testCallback);
+
+            for (i = 0; i < RTL_NUMBER_OF(testRegistrations); i++)
+                PhRegisterCallback(&testCallback, PhpTestCallbackFunction, NULL, &testRegistrations[i]);
+
+            PhInvokeCallback(&testCallback, NULL);
+            PhStartStopwatch(&stopwatch);
+
+            for (i = 0; i < 10000000; i++)
+            {
+                PhInvokeCallback(&testCallback, NULL);
+            }
+
+            PhStopStopwatch(&stopwatch);
+
+            for (i = 0; i < RTL_NUMBER_OF(testRegistrations); i++)
+                PhUnregisterCallback(&testCallback, &testRegistrations[i]);
+
+            PhDeleteCallback(&testCallback);
+
+            wprintf(L"Callback (4 functions): %ums\n", PhGetMillisecondsStopwatch(&stopwatch));
+
+            // Formatting (1000000 doubles each)
+
+            PhStartStopwatch(&stopwatch);
+
+            for (i = 0; i < 1000000; i++)
+            {
+                _snwprintf(testBuffer[0], RTL_NUMBER_OF(testBuffer[0]), L"%.2f", (DOUBLE)i / 100);
+            }
+
+            PhStopStopwatch(&stopwatch);
+
+            wprintf(L"_snwprintf (%%.2f): %ums\n", PhGetMillisecondsStopwatch(&stopwatch));
+
+            PhStartStopwatch(&stopwatch);
+
+            for (i = 0; i < 1000000; i++)
+            {
+                PhInitFormatF(&testFormat[0], (DOUBLE)i / 100, 2);
+                PhFormatToBuffer(testFormat, 1, testBuffer[0], sizeof(testBuffer[0]), NULL);
+            }
+
+            PhStopStopwatch(&stopwatch);
+
+            wprintf(L"PhFormatToBuffer (fixed): %ums\n", PhGetMillisecondsStopwatch(&stopwatch));
+
+            PhStartStopwatch(&stopwatch);
+
+            for (i = 0; i < 1000000; i++)
+            {
+                PhInitFormatR(&testFormat[0], (DOUBLE)i / 100);
+                PhFormatToBuffer(testFormat, 1, testBuffer[0], sizeof(testBuffer[0]), NULL);
+            }
+
+            PhStopStopwatch(&stopwatch);
+
+            wprintf(L"PhFormatToBuffer (shortest): %ums\n", PhGetMillisecondsStopwatch(&stopwatch));
+
+            PhStartStopwatch(&stopwatch);
+
+            for (i = 0; i < 1000000; i += RTL_NUMBER_OF(testFormat))
+            {
+                for (j = 0; j < RTL_NUMBER_OF(testFormat); j++)
+                    PhInitFormatF(&testFormat[j], (DOUBLE)(i + j) / 100, 2);
+
+                PhFormatToBufferBatch(testFormat, RTL_NUMBER_OF(testFormat), testBuffer[0], sizeof(testBuffer[0]), NULL);
+            }
+
+            PhStopStopwatch(&stopwatch);
+
+            wprintf(L"PhFormatToBufferBatch (fixed, 64 cells): %ums\n", PhGetMillisecondsStopwatch(&stopwatch));
         }
         else if (PhEqualStringZ(command, L"testlocks", TRUE))
         {
@@ -916,10 +1051,25 @@ NTSTATUS PhpDebugConsoleThreadStart(
             PRINT_STATISTIC(WqWorkQueueThreadsCreated);
             PRINT_STATISTIC(WqWorkQueueThreadsCreateFailed);
             PRINT_STATISTIC(WqWorkItemsQueued);
-
-#else
-            wprintf(commandDebugOnly);
+            wprintf(L"\n");
 #endif
+
+            PhpPrintQueuedLockProfile();
+        }
+        else if (PhEqualStringZ(command, L"lockprof", TRUE))
+        {
+            PWSTR option = wcstok_s(NULL, delims, &context);
+
+            if (!option)
+                wprintf(L"Lock profiling is %s.\n", PhGetQueuedLockProfiling() ? L"enabled" : L"disabled");
+            else if (PhEqualStringZ(option, L"on", TRUE))
+                PhSetQueuedLockProfiling(TRUE);
+            else if (PhEqualStringZ(option, L"off", TRUE))
+                PhSetQueuedLockProfiling(FALSE);
+            else if (PhEqualStringZ(option, L"reset", TRUE))
+                PhResetQueuedLockProfile();
+            else
+                wprintf(L"Invalid option.\n");
         }
         else if (PhEqualStringZ(command, L"objects", TRUE))
         {
@@ -1287,12 +1437,22 @@ NTSTATUS PhpDebugConsoleThreadStart(
                     while (providerEntry != &providerThread->ListHead)
                     {
                         PPH_PROVIDER_REGISTRATION registration;
+                        ULONG64 lastRunTime;
+                        ULONG64 totalRunTime;
 
                         registration = CONTAINING_RECORD(providerEntry, PH_PROVIDER_REGISTRATION, ListEntry);
+                        PhGetRunTimeProvider(registration, &lastRunTime, &totalRunTime);
 
                         wprintf(L"\tProvider registration at %Ix\n", (ULONG_PTR)registration);
                         wprintf(L"\t\tEnabled: %s\n", registration->Enabled ? L"Yes" : L"No");
                         wprintf(L"\t\tFunction: %s\n", PhpGetSymbolForAddress(registration->Function));
+                        wprintf(L"\t\tInterval: %u ms (phase %u ms)\n", registration->Interval, registration->Phase);
+                        wprintf(L"\t\tRuns: %u\n", registration->RunId);
+                        wprintf(
+                            L"\t\tRun time: %I64u us last, %I64u us total\n",
+                            lastRunTime / PH_TICKS_PER_NS,
+                            totalRunTime / PH_TICKS_PER_NS
+                            );
 
                         if (registration->Object)
                         {
@@ -749,6 +749,7 @@ typedef struct _SEARCH_HANDLE_CONTEXT
     BOOLEAN NeedToFree;
     PSYSTEM_HANDLE_TABLE_ENTRY_INFO_EX HandleInfo;
     HANDLE ProcessHandle;
+    ULONG Generation;
 } SEARCH_HANDLE_CONTEXT, *PSEARCH_HANDLE_CONTEXT;
 
 static NTSTATUS NTAPI SearchHandleFunction(
@@ -756,14 +757,15 @@ static NTSTATUS NTAPI SearchHandleFunction(
     )
 {
     PSEARCH_HANDLE_CONTEXT context = Parameter;
+    NTSTATUS subStatus;
     PPH_STRING typeName;
     PPH_STRING bestObjectName;
 
-    if (!SearchStop && NT_SUCCESS(PhGetHandleInformation(
+    if (!SearchStop && NT_SUCCESS(PhGetHandleInformationCached(
         context->ProcessHandle,
-        (HANDLE)context->HandleInfo->HandleValue,
-        context->HandleInfo->ObjectTypeIndex,
-        NULL,
+        context->HandleInfo,
+        context->Generation,
+        &subStatus,
         &typeName,
         NULL,
         &bestObjectName
@@ -771,6 +773,13 @@ static NTSTATUS NTAPI SearchHandleFunction(
     {
         PPH_STRING upperBestObjectName;
 
+        // Skip objects whose names couldn't be queried.
+        if (!NT_SUCCESS(subStatus))
+        {
+            PhDereferenceObject(typeName);
+            goto CleanupExit;
+        }
+
         upperBestObjectName = PhDuplicateString(bestObjectName);
         _wcsupr(upperBestObjectName->Buffer);
 
@@ -807,6 +816,7 @@ static NTSTATUS NTAPI SearchHandleFunction(
         PhDereferenceObject(upperBestObjectName);
     }
 
+CleanupExit:
     if (context->NeedToFree)
         PhFree(context);
 
@@ -894,7 +904,9 @@ static NTSTATUS PhpFindObjectsThreadStart(
 
         BOOLEAN useWorkQueue = FALSE;
         PH_WORK_QUEUE workQueue;
+        ULONG generation;
         processHandleHashtable = PhCreateSimpleHashtable(8);
+        generation = PhUpdateHandleNameCache(handles, NULL);
 
         if (!KphIsConnected() && WindowsVersion >= WINDOWS_VISTA)
         {
@@ -959,6 +971,7 @@ static NTSTATUS PhpFindObjectsThreadStart(
                 searchHandleContext->NeedToFree = TRUE;
                 searchHandleContext->HandleInfo = handleInfo;
                 searchHandleContext->ProcessHandle = processHandle;
+                searchHandleContext->Generation = generation;
                 PhQueueItemWorkQueue(&workQueue, SearchHandleFunction, searchHandleContext);
             }
             else
@@ -968,6 +981,7 @@ static NTSTATUS PhpFindObjectsThreadStart(
                 searchHandleContext.NeedToFree = FALSE;
                 searchHandleContext.HandleInfo = handleInfo;
                 searchHandleContext.ProcessHandle = processHandle;
+                searchHandleContext.Generation = generation;
                 SearchHandleFunction(&searchHandleContext);
             }
         }
@@ -33,6 +33,7 @@ typedef struct _PHP_CREATE_HANDLE_ITEM_CONTEXT
 {
     PPH_HANDLE_PROVIDER Provider;
     PSYSTEM_HANDLE_TABLE_ENTRY_INFO_EX Handle;
+    ULONG Generation;
 } PHP_CREATE_HANDLE_ITEM_CONTEXT, *PPHP_CREATE_HANDLE_ITEM_CONTEXT;
 
 VOID NTAPI PhpHandleProviderDeleteProcedure(
@@ -425,17 +426,14 @@ NTSTATUS PhpCreateHandleItemFunction(
 
     handleItem = PhCreateHandleItem(context->Handle);
 
-    PhGetHandleInformationEx(
+    PhGetHandleInformationCached(
         context->Provider->ProcessHandle,
-        handleItem->Handle,
-        context->Handle->ObjectTypeIndex,
-        0,
-        NULL,
+        context->Handle,
+        context->Generation,
         NULL,
         &handleItem->TypeName,
         &handleItem->ObjectName,
-        &handleItem->BestObjectName,
-        NULL
+        &handleItem->BestObjectName
         );
 
     if (handleItem->TypeName)
@@ -468,6 +466,7 @@ VOID PhHandleProviderUpdate(
     PPH_HANDLE_PROVIDER handleProvider = (PPH_HANDLE_PROVIDER)Object;
     PSYSTEM_HANDLE_INFORMATION_EX handleInfo;
     BOOLEAN filterNeeded;
+    ULONG generation;
     PSYSTEM_HANDLE_TABLE_ENTRY_INFO_EX handles;
     ULONG numberOfHandles;
     ULONG i;
@@ -487,6 +486,10 @@ VOID PhHandleProviderUpdate(
         )))
         goto UpdateExit;
 
+    // Names are cached by object, so handles to objects which are open elsewhere (or which were
+    // seen by Find Handles) don't need to be queried again.
+    generation = PhUpdateHandleNameCache(handleInfo, filterNeeded ? NULL : handleProvider->ProcessId);
+
     if (!KphIsConnected() && WindowsVersion >= WINDOWS_VISTA)
     {
         useWorkQueue = TRUE;
@@ -622,23 +625,21 @@ VOID PhHandleProviderUpdate(
                 context = PhAllocate(sizeof(PHP_CREATE_HANDLE_ITEM_CONTEXT));
                 context->Provider = handleProvider;
                 context->Handle = handle;
+                context->Generation = generation;
                 PhQueueItemWorkQueue(&workQueue, PhpCreateHandleItemFunction, context);
                 continue;
             }
 
             handleItem = PhCreateHandleItem(handle);
 
-            PhGetHandleInformationEx(
+            PhGetHandleInformationCached(
                 handleProvider->ProcessHandle,
-                handleItem->Handle,
-                handle->ObjectTypeIndex,
-                0,
-                NULL,
+                handle,
+                generation,
                 NULL,
                 &handleItem->TypeName,
                 &handleItem->ObjectName,
-                &handleItem->BestObjectName,
-                NULL
+                &handleItem->BestObjectName
                 );
 
             // We need at least a type name to continue.
@@ -5,6 +5,9 @@
 #define PH_FLUSH_PROCESS_QUERY_DATA_INTERVAL_2 750
 #define PH_FLUSH_PROCESS_QUERY_DATA_INTERVAL_LONG_TERM 1000
 
+// The service and network providers run every this many update intervals.
+#define PH_SLOW_PROVIDER_INTERVAL_MULTIPLIER 2
+
 #define TIMER_FLUSH_PROCESS_QUERY_DATA 1
 #define TIMER_ICON_CLICK_ACTIVATE 2
 #define TIMER_ICON_RESTORE_HOVER 3
@@ -41,6 +44,10 @@ VOID PhMwpInitializeProviders(
     VOID
     );
 
+VOID PhMwpSetProviderIntervals(
+    _In_ ULONG Interval
+    );
+
 VOID PhMwpApplyUpdateInterval(
     _In_ ULONG Interval
     );
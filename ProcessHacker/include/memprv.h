@@ -26,7 +26,7 @@ typedef enum _PH_MEMORY_REGION_TYPE
 typedef struct _PH_MEMORY_ITEM
 {
     LIST_ENTRY ListEntry;
-    PH_AVL_LINKS Links;
+    PH_AVL_LINKS Links; // Not used
 
     union
     {
@@ -89,8 +89,14 @@ typedef struct _PH_MEMORY_ITEM
 typedef struct _PH_MEMORY_ITEM_LIST
 {
     HANDLE ProcessId;
-    PH_AVL_TREE Set;
+    PH_AVL_TREE Set; // Not used; use PhLookupMemoryItemList instead
     LIST_ENTRY ListHead;
+
+    // New fields
+    /** The memory items, sorted by base address. */
+    PPH_MEMORY_ITEM *Items;
+    ULONG Count;
+    ULONG AllocatedCount;
 } PH_MEMORY_ITEM_LIST, *PPH_MEMORY_ITEM_LIST;
 // end_phapppub
 
@@ -145,4 +151,11 @@ PhQueryMemoryItemList(
     );
 // end_phapppub
 
+NTSTATUS PhQueryMemoryItemListEx(
+    _In_ HANDLE ProcessId,
+    _In_ ULONG Flags,
+    _In_opt_ PPH_MEMORY_ITEM_LIST PreviousList,
+    _Out_ PPH_MEMORY_ITEM_LIST List
+    );
+
 #endif
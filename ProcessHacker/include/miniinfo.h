@@ -211,6 +211,7 @@ typedef struct _PH_MINIINFO_LIST_SECTION
     PH_LAYOUT_MANAGER LayoutManager;
     ULONG RunCount;
     LONG SuspendUpdate;
+    PH_PROCESS_GROUP_CACHE ProcessGroupCache;
     PPH_LIST ProcessGroupList;
     PPH_LIST NodeList;
     HANDLE SelectedRepresentativeProcessId;
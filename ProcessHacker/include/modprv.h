@@ -49,6 +49,7 @@ typedef struct _PH_MODULE_PROVIDER
     PPH_STRING PackageFullName;
     SLIST_HEADER QueryListHead;
     NTSTATUS RunStatus;
+    PPH_LIST SortedModuleList; // Module items sorted by base address (no extra references added)
 } PH_MODULE_PROVIDER, *PPH_MODULE_PROVIDER;
 // end_phapppub
 
@@ -17,6 +17,7 @@
 #include <treenew.h>
 #include <graph.h>
 #include <circbuf.h>
+#include <histfile.h>
 #include <dltmgr.h>
 #include <phnet.h>
 
@@ -285,6 +286,13 @@ VOID PhUiAnalyzeWaitThread(
     _In_ PPH_SYMBOL_PROVIDER SymbolProvider
     );
 
+// anaprof
+
+VOID PhUiProfileThreadStacks(
+    _In_ HWND hWnd,
+    _In_ PPH_THREAD_PROVIDER ThreadProvider
+    );
+
 // mdump
 
 BOOLEAN PhUiCreateDumpFileProcess(
@@ -25,6 +25,7 @@ typedef enum _PHSVC_API_NUMBER
     PhSvcSetServiceSecurityApiNumber = 17,
     PhSvcLoadDbgHelpApiNumber = 18, // WOW64 compatible
     PhSvcWriteMiniDumpProcessApiNumber = 19, // WOW64 compatible
+    PhSvcBatchApiNumber = 20,
     PhSvcMaximumApiNumber
 } PHSVC_API_NUMBER, *PPHSVC_API_NUMBER;
 
@@ -260,6 +261,33 @@ typedef union _PHSVC_API_WRITEMINIDUMPPROCESS
     } i;
 } PHSVC_API_WRITEMINIDUMPPROCESS, *PPHSVC_API_WRITEMINIDUMPPROCESS;
 
+typedef struct _PHSVC_API_BATCH_ITEM
+{
+    PHSVC_API_NUMBER ApiNumber;
+    NTSTATUS ReturnStatus;
+
+    // Only APIs which do not return data can be batched.
+    union
+    {
+        PHSVC_API_CONTROLPROCESS ControlProcess;
+        PHSVC_API_CONTROLSERVICE ControlService;
+        PHSVC_API_CONTROLTHREAD ControlThread;
+    } u;
+} PHSVC_API_BATCH_ITEM, *PPHSVC_API_BATCH_ITEM;
+
+typedef union _PHSVC_API_BATCH
+{
+    struct
+    {
+        PH_RELATIVE_STRINGREF Items; // array of PHSVC_API_BATCH_ITEM
+        BOOLEAN StopOnError;
+    } i;
+    struct
+    {
+        ULONG NumberOfItemsProcessed;
+    } o;
+} PHSVC_API_BATCH, *PPHSVC_API_BATCH;
+
 typedef union _PHSVC_API_PAYLOAD
 {
     PHSVC_API_CONNECTINFO ConnectInfo;
@@ -287,6 +315,7 @@ typedef union _PHSVC_API_PAYLOAD
             PHSVC_API_SETSERVICESECURITY SetServiceSecurity;
             PHSVC_API_LOADDBGHELP LoadDbgHelp;
             PHSVC_API_WRITEMINIDUMPPROCESS WriteMiniDumpProcess;
+            PHSVC_API_BATCH Batch;
         } u;
     };
 } PHSVC_API_PAYLOAD, *PPHSVC_API_PAYLOAD;
@@ -3,6 +3,8 @@
 
 #include <phsvcapi.h>
 
+#define PHSVC_BATCH_CHUNK_SIZE 1024
+
 extern HANDLE PhSvcClServerProcessId;
 
 NTSTATUS PhSvcConnectToServer(
@@ -152,4 +154,27 @@ NTSTATUS PhSvcCallWriteMiniDumpProcess(
     _In_ ULONG DumpType
     );
 
+NTSTATUS PhSvcCallBatch(
+    _Inout_updates_(NumberOfItems) PPHSVC_API_BATCH_ITEM Items,
+    _In_ ULONG NumberOfItems,
+    _In_ BOOLEAN StopOnError,
+    _Out_opt_ PULONG NumberOfItemsProcessed
+    );
+
+NTSTATUS PhSvcCallControlProcesses(
+    _In_reads_(NumberOfProcesses) PHANDLE ProcessIds,
+    _In_ ULONG NumberOfProcesses,
+    _In_ PHSVC_API_CONTROLPROCESS_COMMAND Command,
+    _In_ ULONG Argument,
+    _Out_writes_(NumberOfProcesses) PNTSTATUS Statuses
+    );
+
+NTSTATUS PhSvcCallControlThreads(
+    _In_reads_(NumberOfThreads) PHANDLE ThreadIds,
+    _In_ ULONG NumberOfThreads,
+    _In_ PHSVC_API_CONTROLTHREAD_COMMAND Command,
+    _In_ ULONG Argument,
+    _Out_writes_(NumberOfThreads) PNTSTATUS Statuses
+    );
+
 #endif
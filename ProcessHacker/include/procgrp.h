@@ -18,7 +18,26 @@ typedef VOID (NTAPI *PPH_SORT_LIST_FUNCTION)(
 #define PH_GROUP_PROCESSES_DONT_GROUP 0x1
 #define PH_GROUP_PROCESSES_FILE_PATH 0x2
 
+typedef struct _PH_PROCESS_GROUP_CACHE
+{
+    PPH_HASHTABLE ProcessDataHashtable; // Process ID to process data
+    PPH_HASHTABLE WindowHashtable; // Set of windows chosen for processes
+    ULONG Flags;
+    ULONG RunId;
+    BOOLEAN WindowsValid;
+    BOOLEAN GroupsValid;
+} PH_PROCESS_GROUP_CACHE, *PPH_PROCESS_GROUP_CACHE;
+
+VOID PhInitializeProcessGroupCache(
+    _Out_ PPH_PROCESS_GROUP_CACHE Cache
+    );
+
+VOID PhDeleteProcessGroupCache(
+    _Inout_ PPH_PROCESS_GROUP_CACHE Cache
+    );
+
 PPH_LIST PhCreateProcessGroupList(
+    _Inout_ PPH_PROCESS_GROUP_CACHE Cache,
     _In_opt_ PPH_SORT_LIST_FUNCTION SortListFunction, // Sort a list of PPH_PROCESS_NODE
     _In_opt_ PVOID Context,
     _In_ ULONG MaximumGroups,
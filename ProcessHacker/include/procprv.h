@@ -18,12 +18,31 @@ extern ULONG PhStatisticsSampleCount;
 extern BOOLEAN PhEnableProcessQueryStage2;
 extern BOOLEAN PhEnablePurgeProcessRecords;
 extern BOOLEAN PhEnableCycleCpuUsage;
+extern BOOLEAN PhEnableHistoryFile;
+
+// Series recorded in the history file
+#define PH_HISTORY_FILE_CPU_KERNEL 0
+#define PH_HISTORY_FILE_CPU_USER 1
+#define PH_HISTORY_FILE_IO_READ 2
+#define PH_HISTORY_FILE_IO_WRITE 3
+#define PH_HISTORY_FILE_IO_OTHER 4
+#define PH_HISTORY_FILE_COMMIT 5
+#define PH_HISTORY_FILE_PHYSICAL 6
+#define PH_HISTORY_FILE_NUMBER_OF_SERIES 7
+
+// Levels of the history file
+#define PH_HISTORY_FILE_LEVEL_SECOND 0
+#define PH_HISTORY_FILE_LEVEL_MINUTE 1
+#define PH_HISTORY_FILE_LEVEL_HOUR 2
+#define PH_HISTORY_FILE_NUMBER_OF_LEVELS 3
 
 extern PVOID PhProcessInformation; // only can be used if running on same thread as process provider
 extern ULONG PhProcessInformationSequenceNumber;
 extern SYSTEM_PERFORMANCE_INFORMATION PhPerfInformation;
+extern PH_PROCESSOR_TOPOLOGY PhCpuTopology;
 extern PSYSTEM_PROCESSOR_PERFORMANCE_INFORMATION PhCpuInformation;
 extern SYSTEM_PROCESSOR_PERFORMANCE_INFORMATION PhCpuTotals;
+extern PSYSTEM_PROCESSOR_PERFORMANCE_INFORMATION PhCpuNodeTotals;
 extern ULONG PhTotalProcesses;
 extern ULONG PhTotalThreads;
 extern ULONG PhTotalHandles;
@@ -38,6 +57,8 @@ extern FLOAT PhCpuKernelUsage;
 extern FLOAT PhCpuUserUsage;
 extern PFLOAT PhCpusKernelUsage;
 extern PFLOAT PhCpusUserUsage;
+extern PFLOAT PhCpuNodesKernelUsage;
+extern PFLOAT PhCpuNodesUserUsage;
 
 extern PH_UINT64_DELTA PhCpuKernelDelta;
 extern PH_UINT64_DELTA PhCpuUserDelta;
@@ -47,6 +68,10 @@ extern PPH_UINT64_DELTA PhCpusKernelDelta;
 extern PPH_UINT64_DELTA PhCpusUserDelta;
 extern PPH_UINT64_DELTA PhCpusIdleDelta;
 
+extern PPH_UINT64_DELTA PhCpuNodesKernelDelta;
+extern PPH_UINT64_DELTA PhCpuNodesUserDelta;
+extern PPH_UINT64_DELTA PhCpuNodesIdleDelta;
+
 extern PH_UINT64_DELTA PhIoReadDelta;
 extern PH_UINT64_DELTA PhIoWriteDelta;
 extern PH_UINT64_DELTA PhIoOtherDelta;
@@ -59,6 +84,9 @@ extern PPH_CIRCULAR_BUFFER_FLOAT PhCpusKernelHistory;
 extern PPH_CIRCULAR_BUFFER_FLOAT PhCpusUserHistory;
 //extern PPH_CIRCULAR_BUFFER_FLOAT PhCpusOtherHistory;
 
+extern PPH_CIRCULAR_BUFFER_FLOAT PhCpuNodesKernelHistory;
+extern PPH_CIRCULAR_BUFFER_FLOAT PhCpuNodesUserHistory;
+
 extern PH_CIRCULAR_BUFFER_ULONG64 PhIoReadHistory;
 extern PH_CIRCULAR_BUFFER_ULONG64 PhIoWriteHistory;
 extern PH_CIRCULAR_BUFFER_ULONG64 PhIoOtherHistory;
@@ -87,6 +115,15 @@ extern PH_CIRCULAR_BUFFER_ULONG64 PhMaxIoWriteHistory;
 
 // The process item has been removed.
 #define PH_PROCESS_ITEM_REMOVED 0x1
+
+// Process history series
+#define PH_PROCESS_HISTORY_CPU_KERNEL 0
+#define PH_PROCESS_HISTORY_CPU_USER 1
+#define PH_PROCESS_HISTORY_IO_READ 2
+#define PH_PROCESS_HISTORY_IO_WRITE 3
+#define PH_PROCESS_HISTORY_IO_OTHER 4
+#define PH_PROCESS_HISTORY_PRIVATE_BYTES 5
+#define PH_PROCESS_HISTORY_COUNT 6
 // end_phapppub
 
 #define PH_INTEGRITY_STR_LEN 10
@@ -214,6 +251,7 @@ typedef struct _PH_PROCESS_ITEM
     ULONG HardFaultCount; // since WIN7
 
     ULONG SequenceNumber;
+    // These buffers are no longer filled and are always empty. Use History instead.
     PH_CIRCULAR_BUFFER_FLOAT CpuKernelHistory;
     PH_CIRCULAR_BUFFER_FLOAT CpuUserHistory;
     PH_CIRCULAR_BUFFER_ULONG64 IoReadHistory;
@@ -227,6 +265,8 @@ typedef struct _PH_PROCESS_ITEM
     PPH_STRING PackageFullName;
 
     PH_QUEUED_LOCK RemoveLock;
+
+    PH_HISTORY_BUFFER History; // PH_PROCESS_HISTORY_*
 } PH_PROCESS_ITEM, *PPH_PROCESS_ITEM;
 // end_phapppub
 
@@ -338,6 +378,30 @@ PhGetStatisticsTimeString(
     );
 // end_phapppub
 
+ULONG PhGetCountSystemHistoryFile(
+    _In_ ULONG Level
+    );
+
+ULONG PhCopySystemHistoryFile(
+    _In_ ULONG Level,
+    _In_ ULONG Series,
+    _Out_writes_to_(Count, return) PFLOAT Buffer,
+    _In_ ULONG Count
+    );
+
+BOOLEAN PhGetSampleSystemHistoryFile(
+    _In_ ULONG Level,
+    _In_ ULONG Index,
+    _In_ ULONG Series,
+    _Out_opt_ PLARGE_INTEGER Time,
+    _Out_opt_ PFLOAT Average,
+    _Out_opt_ PFLOAT Maximum
+    );
+
+VOID PhCloseSystemHistoryFile(
+    VOID
+    );
+
 VOID PhFlushProcessQueryData(
     _In_ BOOLEAN SendModifiedEvent
     );
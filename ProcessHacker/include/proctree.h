@@ -334,10 +334,10 @@ VOID PhSelectAndEnsureVisibleProcessNodes(
     _In_ ULONG NumberOfProcessNodes
     );
 
-PPH_LIST PhGetProcessTreeListLines(
+NTSTATUS PhWriteProcessTreeNodes(
     _In_ HWND TreeListHandle,
-    _In_ ULONG NumberOfNodes,
     _In_ PPH_LIST RootNodes,
+    _Inout_ PPH_FILE_STREAM FileStream,
     _In_ ULONG Mode
     );
 
@@ -134,6 +134,13 @@ NTSTATUS PhLoadSettings(
     _In_ PWSTR FileName
     );
 
+#define PH_LOAD_SETTINGS_USE_CACHE 0x1
+
+NTSTATUS PhLoadSettingsEx(
+    _In_ PWSTR FileName,
+    _In_ ULONG Flags
+    );
+
 NTSTATUS PhSaveSettings(
     _In_ PWSTR FileName
     );
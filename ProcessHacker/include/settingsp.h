@@ -3,6 +3,28 @@
 
 #include <shlobj.h>
 
+#define PH_SETTINGS_CACHE_MAGIC ('cshp')
+#define PH_SETTINGS_CACHE_VERSION 1
+#define PH_SETTINGS_CACHE_MAXIMUM_SIZE (16 * 1024 * 1024)
+
+typedef struct _PH_SETTINGS_CACHE_HEADER
+{
+    ULONG Magic;
+    ULONG Version;
+    LARGE_INTEGER LastWriteTime; // of the settings file
+    LARGE_INTEGER EndOfFile; // of the settings file
+    ULONG NumberOfEntries;
+    ULONG Checksum; // CRC32 of everything after the header
+} PH_SETTINGS_CACHE_HEADER, *PPH_SETTINGS_CACHE_HEADER;
+
+typedef struct _PH_SETTINGS_CACHE_ENTRY
+{
+    ULONG NameLength;
+    ULONG ValueLength;
+    // WCHAR Name[NameLength / sizeof(WCHAR)];
+    // WCHAR Value[ValueLength / sizeof(WCHAR)];
+} PH_SETTINGS_CACHE_ENTRY, *PPH_SETTINGS_CACHE_ENTRY;
+
 BOOLEAN NTAPI PhpSettingsHashtableEqualFunction(
     _In_ PVOID Entry1,
     _In_ PVOID Entry2
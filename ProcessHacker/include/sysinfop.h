@@ -285,10 +285,20 @@ VOID PhSipNotifyCpuGraph(
     _In_ NMHDR *Header
     );
 
+VOID PhSipNotifyCpuNodeGraph(
+    _In_ ULONG Index,
+    _In_ NMHDR *Header
+    );
+
 VOID PhSipUpdateCpuGraphs(
     VOID
     );
 
+VOID PhSipShowCpuHistoryMenu(
+    _In_ HWND GraphHandle,
+    _In_ POINT Point
+    );
+
 VOID PhSipUpdateCpuPanel(
     VOID
     );
@@ -656,7 +656,7 @@ VOID PhpInitializeSettings(
 
         if (PhSettingsFileName)
         {
-            status = PhLoadSettings(PhSettingsFileName->Buffer);
+            status = PhLoadSettingsEx(PhSettingsFileName->Buffer, PH_LOAD_SETTINGS_USE_CACHE);
 
             // If we didn't find the file, it will be created. Otherwise,
             // there was probably a parsing error and we don't want to
@@ -376,6 +376,18 @@ VOID PhMwpInitializeProviders(
     PhRegisterProvider(&PhPrimaryProviderThread, PhServiceProviderUpdate, NULL, &PhMwpServiceProviderRegistration);
     PhSetEnabledProvider(&PhMwpServiceProviderRegistration, TRUE);
     PhRegisterProvider(&PhPrimaryProviderThread, PhNetworkProviderUpdate, NULL, &PhMwpNetworkProviderRegistration);
+    PhMwpSetProviderIntervals(interval);
+}
+
+VOID PhMwpSetProviderIntervals(
+    _In_ ULONG Interval
+    )
+{
+    // Enumerating services and connections is slower than enumerating processes, and they change
+    // less often, so don't delay the process provider with them on every run. Boosting (e.g.
+    // refreshing) still runs them immediately. The phases put them on different runs.
+    PhSetIntervalProvider(&PhMwpServiceProviderRegistration, Interval * PH_SLOW_PROVIDER_INTERVAL_MULTIPLIER, 0);
+    PhSetIntervalProvider(&PhMwpNetworkProviderRegistration, Interval * PH_SLOW_PROVIDER_INTERVAL_MULTIPLIER, Interval);
 }
 
 VOID PhMwpApplyUpdateInterval(
@@ -384,6 +396,7 @@ VOID PhMwpApplyUpdateInterval(
 {
     PhSetIntervalProviderThread(&PhPrimaryProviderThread, Interval);
     PhSetIntervalProviderThread(&PhSecondaryProviderThread, Interval);
+    PhMwpSetProviderIntervals(Interval);
 
     if (Interval > PH_FLUSH_PROCESS_QUERY_DATA_INTERVAL_LONG_TERM)
         SetTimer(PhMainWndHandle, TIMER_FLUSH_PROCESS_QUERY_DATA, PH_FLUSH_PROCESS_QUERY_DATA_INTERVAL_LONG_TERM, NULL);
@@ -552,6 +565,7 @@ VOID PhMwpOnDestroy(
         ProcessHacker_SaveAllSettings(PhMainWndHandle);
 
     PhNfUninitialization();
+    PhCloseSystemHistoryFile();
 
     PostQuitMessage(0);
 }
@@ -668,6 +682,7 @@ VOID PhMwpOnCommand(
             {
                 { L"Text files (*.txt;*.log)", L"*.txt;*.log" },
                 { L"Comma-separated values (*.csv)", L"*.csv" },
+                { L"JSON Lines (*.jsonl)", L"*.jsonl" },
                 { L"All files (*.*)", L"*.*" }
             };
             PVOID fileDialog = PhCreateSaveFileDialog();
@@ -704,11 +719,17 @@ VOID PhMwpOnCommand(
 
                     if (filterIndex == 2)
                         mode = PH_EXPORT_MODE_CSV;
+                    else if (filterIndex == 3)
+                        mode = PH_EXPORT_MODE_JSON_LINES;
                     else
                         mode = PH_EXPORT_MODE_TABS;
 
-                    PhWriteStringAsUtf8FileStream(fileStream, &PhUnicodeByteOrderMark);
-                    PhWritePhTextHeader(fileStream);
+                    // JSON Lines files must contain nothing but one object per line.
+                    if (mode != PH_EXPORT_MODE_JSON_LINES)
+                    {
+                        PhWriteStringAsUtf8FileStream(fileStream, &PhUnicodeByteOrderMark);
+                        PhWritePhTextHeader(fileStream);
+                    }
 
                     exportContent.FileStream = fileStream;
                     exportContent.Mode = mode;
@@ -2267,6 +2288,7 @@ VOID PhMwpLoadSettings(
     PhEnableProcessQueryStage2 = !!PhGetIntegerSetting(L"EnableStage2");
     PhEnablePurgeProcessRecords = !PhGetIntegerSetting(L"NoPurgeProcessRecords");
     PhEnableCycleCpuUsage = !!PhGetIntegerSetting(L"EnableCycleCpuUsage");
+    PhEnableHistoryFile = !!PhGetIntegerSetting(L"EnableHistoryFile");
     PhEnableServiceNonPoll = !!PhGetIntegerSetting(L"EnableServiceNonPoll");
     PhEnableNetworkProviderResolve = !!PhGetIntegerSetting(L"EnableNetworkResolve");
 
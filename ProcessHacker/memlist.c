@@ -30,6 +30,12 @@
 #include <phplug.h>
 #include <settings.h>
 
+typedef struct _PHP_MEMORY_NODE_ENTRY
+{
+    PPH_MEMORY_ITEM MemoryItem;
+    PPH_MEMORY_NODE MemoryNode;
+} PHP_MEMORY_NODE_ENTRY, *PPHP_MEMORY_NODE_ENTRY;
+
 VOID PhpClearMemoryList(
     _Inout_ PPH_MEMORY_LIST_CONTEXT Context
     );
@@ -300,31 +306,167 @@ VOID PhpCopyMemoryRegionTypeInfo(
         PhReferenceObject(Destination->u.MappedFile.FileName);
 }
 
+static BOOLEAN NTAPI PhpMemoryNodeEntryEqualFunction(
+    _In_ PVOID Entry1,
+    _In_ PVOID Entry2
+    )
+{
+    return ((PPHP_MEMORY_NODE_ENTRY)Entry1)->MemoryItem == ((PPHP_MEMORY_NODE_ENTRY)Entry2)->MemoryItem;
+}
+
+static ULONG NTAPI PhpMemoryNodeEntryHashFunction(
+    _In_ PVOID Entry
+    )
+{
+    return PhHashIntPtr((ULONG_PTR)((PPHP_MEMORY_NODE_ENTRY)Entry)->MemoryItem);
+}
+
+static VOID PhpInvalidateMemoryNode(
+    _Inout_ PPH_MEMORY_NODE MemoryNode
+    )
+{
+    MemoryNode->Node.Visible = TRUE;
+    memset(MemoryNode->TextCache, 0, sizeof(PH_STRINGREF) * PHMMTLC_MAXIMUM);
+    PhClearReference(&MemoryNode->UseText);
+}
+
+static VOID PhpResetAllocationBaseNode(
+    _Inout_ PPH_MEMORY_NODE MemoryNode
+    )
+{
+    PPH_MEMORY_ITEM memoryItem = MemoryNode->MemoryItem;
+
+    // The statistics are aggregated again from the regions.
+
+    if (memoryItem->RegionType == CustomRegion)
+        PhClearReference(&memoryItem->u.Custom.Text);
+    else if (memoryItem->RegionType == MappedFileRegion)
+        PhClearReference(&memoryItem->u.MappedFile.FileName);
+
+    memoryItem->RegionType = UnknownRegion;
+    memset(&memoryItem->u, 0, sizeof(memoryItem->u));
+
+    memoryItem->AllocationProtect = 0;
+    memoryItem->RegionSize = 0;
+    memoryItem->State = 0;
+    memoryItem->Protect = 0;
+    memoryItem->Type = 0;
+    memoryItem->CommittedSize = 0;
+    memoryItem->PrivateSize = 0;
+    memoryItem->TotalWorkingSetPages = 0;
+    memoryItem->PrivateWorkingSetPages = 0;
+    memoryItem->SharedWorkingSetPages = 0;
+    memoryItem->ShareableWorkingSetPages = 0;
+    memoryItem->LockedWorkingSetPages = 0;
+
+    PhClearList(MemoryNode->Children);
+    PhpInvalidateMemoryNode(MemoryNode);
+}
+
+/**
+ * Replaces the nodes in a memory list.
+ *
+ * \param Context The memory list context.
+ * \param List The new memory item list, or NULL to clear the memory list.
+ *
+ * \remarks Memory items that were carried over from the previous list by PhQueryMemoryItemListEx()
+ * keep their nodes, and so do allocation bases that still exist. This preserves the selection and
+ * expansion state of unchanged regions, and only changed regions need new nodes.
+ */
 VOID PhReplaceMemoryList(
     _Inout_ PPH_MEMORY_LIST_CONTEXT Context,
     _In_opt_ PPH_MEMORY_ITEM_LIST List
     )
 {
-    PLIST_ENTRY listEntry;
+    ULONG i;
     PPH_MEMORY_NODE allocationBaseNode = NULL;
-
-    PhpClearMemoryList(Context);
+    PPH_LIST oldAllocationBaseNodeList;
+    PPH_LIST oldRegionNodeList;
+    ULONG oldAllocationBaseIndex;
+    PPH_FLAT_HASHTABLE oldRegionNodeHashtable;
 
     if (!List)
     {
+        PhpClearMemoryList(Context);
         TreeNew_NodesStructured(Context->TreeNewHandle);
         return;
     }
 
-    for (listEntry = List->ListHead.Flink; listEntry != &List->ListHead; listEntry = listEntry->Flink)
+    oldAllocationBaseNodeList = Context->AllocationBaseNodeList;
+    oldRegionNodeList = Context->RegionNodeList;
+    Context->AllocationBaseNodeList = PhCreateList(max(oldAllocationBaseNodeList->Count, 100));
+    Context->RegionNodeList = PhCreateList(max(oldRegionNodeList->Count, 400));
+
+    // The region node list may have been sorted, so old region nodes are found by their memory
+    // item. The allocation base node list is always sorted by base address, like the new list.
+
+    oldRegionNodeHashtable = PhCreateFlatHashtable(
+        sizeof(PHP_MEMORY_NODE_ENTRY),
+        PhpMemoryNodeEntryEqualFunction,
+        PhpMemoryNodeEntryHashFunction,
+        oldRegionNodeList->Count
+        );
+
+    for (i = 0; i < oldRegionNodeList->Count; i++)
     {
-        PPH_MEMORY_ITEM memoryItem = CONTAINING_RECORD(listEntry, PH_MEMORY_ITEM, ListEntry);
+        PHP_MEMORY_NODE_ENTRY entry;
+
+        entry.MemoryNode = oldRegionNodeList->Items[i];
+        entry.MemoryItem = entry.MemoryNode->MemoryItem;
+        PhAddEntryFlatHashtable(oldRegionNodeHashtable, &entry);
+    }
+
+    oldAllocationBaseIndex = 0;
+
+    for (i = 0; i < List->Count; i++)
+    {
+        PPH_MEMORY_ITEM memoryItem = List->Items[i];
         PPH_MEMORY_NODE memoryNode;
+        PHP_MEMORY_NODE_ENTRY lookupEntry;
+        PPHP_MEMORY_NODE_ENTRY entry;
 
         if (memoryItem->AllocationBaseItem == memoryItem)
-            allocationBaseNode = PhpAddAllocationBaseNode(Context, memoryItem->AllocationBase);
+        {
+            allocationBaseNode = NULL;
+
+            while (oldAllocationBaseIndex < oldAllocationBaseNodeList->Count)
+            {
+                PPH_MEMORY_NODE oldNode = oldAllocationBaseNodeList->Items[oldAllocationBaseIndex];
+
+                if ((ULONG_PTR)oldNode->MemoryItem->BaseAddress > (ULONG_PTR)memoryItem->AllocationBase)
+                    break;
+
+                oldAllocationBaseIndex++;
+
+                if (oldNode->MemoryItem->BaseAddress == memoryItem->AllocationBase)
+                {
+                    allocationBaseNode = oldNode;
+                    PhpResetAllocationBaseNode(allocationBaseNode);
+                    PhAddItemList(Context->AllocationBaseNodeList, allocationBaseNode);
+                    break;
+                }
+
+                PhpDestroyMemoryNode(oldNode);
+            }
+
+            if (!allocationBaseNode)
+                allocationBaseNode = PhpAddAllocationBaseNode(Context, memoryItem->AllocationBase);
+        }
 
-        memoryNode = PhpAddRegionNode(Context, memoryItem);
+        lookupEntry.MemoryItem = memoryItem;
+
+        if (entry = PhFindEntryFlatHashtable(oldRegionNodeHashtable, &lookupEntry))
+        {
+            memoryNode = entry->MemoryNode;
+            entry->MemoryNode = NULL;
+            memoryNode->Parent = NULL;
+            PhpInvalidateMemoryNode(memoryNode);
+            PhAddItemList(Context->RegionNodeList, memoryNode);
+        }
+        else
+        {
+            memoryNode = PhpAddRegionNode(Context, memoryItem);
+        }
 
         if (Context->HideFreeRegions && (memoryItem->State & MEM_FREE))
             memoryNode->Node.Visible = FALSE;
@@ -372,6 +514,28 @@ VOID PhReplaceMemoryList(
         PhGetMemoryProtectionString(memoryItem->Protect, memoryNode->ProtectionText);
     }
 
+    // Destroy the nodes of regions and allocation bases that no longer exist.
+
+    for (i = oldAllocationBaseIndex; i < oldAllocationBaseNodeList->Count; i++)
+        PhpDestroyMemoryNode(oldAllocationBaseNodeList->Items[i]);
+
+    {
+        PPHP_MEMORY_NODE_ENTRY entry;
+        PH_FLAT_HASHTABLE_ENUM_CONTEXT enumContext;
+
+        PhBeginEnumFlatHashtable(oldRegionNodeHashtable, &enumContext);
+
+        while (entry = PhNextEnumFlatHashtable(&enumContext))
+        {
+            if (entry->MemoryNode)
+                PhpDestroyMemoryNode(entry->MemoryNode);
+        }
+    }
+
+    PhDereferenceObject(oldRegionNodeHashtable);
+    PhDereferenceObject(oldAllocationBaseNodeList);
+    PhDereferenceObject(oldRegionNodeList);
+
     TreeNew_NodesStructured(Context->TreeNewHandle);
 }
 
@@ -176,18 +176,62 @@ VOID PhDeleteMemoryItemList(
     _In_ PPH_MEMORY_ITEM_LIST List
     )
 {
-    PLIST_ENTRY listEntry;
-    PPH_MEMORY_ITEM memoryItem;
+    ULONG i;
+
+    for (i = 0; i < List->Count; i++)
+        PhDereferenceObject(List->Items[i]);
+
+    PhFree(List->Items);
+}
+
+static VOID PhpAddMemoryItemList(
+    _Inout_ PPH_MEMORY_ITEM_LIST List,
+    _In_ PPH_MEMORY_ITEM MemoryItem
+    )
+{
+    // Items are always added in ascending address order.
+
+    if (List->Count == List->AllocatedCount)
+    {
+        List->AllocatedCount *= 2;
+        List->Items = PhReAllocate(List->Items, List->AllocatedCount * sizeof(PPH_MEMORY_ITEM));
+    }
+
+    List->Items[List->Count++] = MemoryItem;
+
+    // Keep ListHead valid for plugins. A reused item is simply re-linked; the previous list only
+    // uses its array from now on.
+    InsertTailList(&List->ListHead, &MemoryItem->ListEntry);
+}
+
+/**
+ * Finds the index of the memory item with the largest base address that is less than or equal to
+ * the given address.
+ *
+ * \return The index of the memory item, or -1 if all memory items are above \a Address.
+ */
+static ULONG PhpFindMemoryItemIndexList(
+    _In_ PPH_MEMORY_ITEM_LIST List,
+    _In_ PVOID Address
+    )
+{
+    ULONG low;
+    ULONG high;
 
-    listEntry = List->ListHead.Flink;
+    low = 0;
+    high = List->Count;
 
-    while (listEntry != &List->ListHead)
+    while (low < high)
     {
-        memoryItem = CONTAINING_RECORD(listEntry, PH_MEMORY_ITEM, ListEntry);
-        listEntry = listEntry->Flink;
+        ULONG mid = low + (high - low) / 2;
 
-        PhDereferenceObject(memoryItem);
+        if ((ULONG_PTR)List->Items[mid]->BaseAddress <= (ULONG_PTR)Address)
+            low = mid + 1;
+        else
+            high = mid;
     }
+
+    return low - 1;
 }
 
 PPH_MEMORY_ITEM PhLookupMemoryItemList(
@@ -195,18 +239,14 @@ PPH_MEMORY_ITEM PhLookupMemoryItemList(
     _In_ PVOID Address
     )
 {
-    PH_MEMORY_ITEM lookupMemoryItem;
-    PPH_AVL_LINKS links;
+    ULONG index;
     PPH_MEMORY_ITEM memoryItem;
 
-    // Do an approximate search on the set to locate the memory item with the largest
-    // base address that is still smaller than the given address.
-    lookupMemoryItem.BaseAddress = Address;
-    links = PhUpperDualBoundElementAvlTree(&List->Set, &lookupMemoryItem.Links);
+    index = PhpFindMemoryItemIndexList(List, Address);
 
-    if (links)
+    if (index != -1)
     {
-        memoryItem = CONTAINING_RECORD(links, PH_MEMORY_ITEM, Links);
+        memoryItem = List->Items[index];
 
         if ((ULONG_PTR)Address < (ULONG_PTR)memoryItem->BaseAddress + memoryItem->RegionSize)
             return memoryItem;
@@ -242,18 +282,20 @@ PPH_MEMORY_ITEM PhpSetMemoryRegionType(
 
 NTSTATUS PhpUpdateMemoryRegionTypes(
     _In_ PPH_MEMORY_ITEM_LIST List,
-    _In_ HANDLE ProcessHandle
+    _In_ HANDLE ProcessHandle,
+    _In_opt_ PPH_LIST NewItems
     )
 {
     NTSTATUS status;
     PVOID processes;
     PSYSTEM_PROCESS_INFORMATION process;
     ULONG i;
+    PPH_MEMORY_ITEM *items;
+    ULONG count;
 #ifdef _WIN64
     BOOLEAN isWow64 = FALSE;
 #endif
     PPH_MEMORY_ITEM memoryItem;
-    PLIST_ENTRY listEntry;
 
     if (!NT_SUCCESS(status = PhEnumProcessesEx(&processes, SystemExtendedProcessInformation)))
         return status;
@@ -403,9 +445,22 @@ NTSTATUS PhpUpdateMemoryRegionTypes(
     }
 
     // Mapped file, heap segment, unusable
-    for (listEntry = List->ListHead.Flink; listEntry != &List->ListHead; listEntry = listEntry->Flink)
+    // This reads every region, so only new regions are examined when a previous list was reused.
+
+    if (NewItems)
+    {
+        items = (PPH_MEMORY_ITEM *)NewItems->Items;
+        count = NewItems->Count;
+    }
+    else
     {
-        memoryItem = CONTAINING_RECORD(listEntry, PH_MEMORY_ITEM, ListEntry);
+        items = List->Items;
+        count = List->Count;
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        memoryItem = items[i];
 
         if (memoryItem->RegionType != UnknownRegion)
             continue;
@@ -497,7 +552,7 @@ NTSTATUS PhpUpdateMemoryWsCounters(
     _In_ HANDLE ProcessHandle
     )
 {
-    PLIST_ENTRY listEntry;
+    ULONG index;
     PMEMORY_WORKING_SET_EX_INFORMATION info;
 
     info = PhAllocatePage(WS_REQUEST_COUNT * sizeof(MEMORY_WORKING_SET_EX_INFORMATION), NULL);
@@ -505,9 +560,9 @@ NTSTATUS PhpUpdateMemoryWsCounters(
     if (!info)
         return STATUS_NO_MEMORY;
 
-    for (listEntry = List->ListHead.Flink; listEntry != &List->ListHead; listEntry = listEntry->Flink)
+    for (index = 0; index < List->Count; index++)
     {
-        PPH_MEMORY_ITEM memoryItem = CONTAINING_RECORD(listEntry, PH_MEMORY_ITEM, ListEntry);
+        PPH_MEMORY_ITEM memoryItem = List->Items[index];
         ULONG_PTR virtualAddress;
         SIZE_T remainingPages;
         SIZE_T requestPages;
@@ -609,19 +664,144 @@ NTSTATUS PhpUpdateMemoryWsCountersOld(
     return STATUS_SUCCESS;
 }
 
+static VOID PhpResetMemoryRegionType(
+    _Inout_ PPH_MEMORY_ITEM MemoryItem
+    )
+{
+    switch (MemoryItem->RegionType)
+    {
+    case CustomRegion:
+        PhClearReference(&MemoryItem->u.Custom.Text);
+        break;
+    case MappedFileRegion:
+        PhClearReference(&MemoryItem->u.MappedFile.FileName);
+        break;
+    }
+
+    MemoryItem->RegionType = UnknownRegion;
+    memset(&MemoryItem->u, 0, sizeof(MemoryItem->u));
+}
+
+static VOID PhpReuseMemoryItem(
+    _Inout_ PPH_MEMORY_ITEM MemoryItem,
+    _Inout_ PPH_LIST NewItems
+    )
+{
+    // The basic information is unchanged, so the sizes and an unknown or unusable region type are
+    // kept. Other region types are derived from threads, heaps or the allocation base (the memory
+    // list copies the allocation base type into regions), which can change without this region
+    // changing, so they are determined again. Mapped file names are also queried again because a
+    // different file can be mapped at the same address with the same size and protection.
+    switch (MemoryItem->RegionType)
+    {
+    case UnknownRegion:
+    case UnusableRegion:
+        break;
+    case MappedFileRegion:
+        if (MemoryItem->AllocationBaseItem == MemoryItem)
+            PhAddItemList(NewItems, MemoryItem);
+        PhpResetMemoryRegionType(MemoryItem);
+        break;
+    default:
+        PhAddItemList(NewItems, MemoryItem);
+        PhpResetMemoryRegionType(MemoryItem);
+        break;
+    }
+
+    MemoryItem->AllocationBaseItem = NULL;
+    MemoryItem->TotalWorkingSetPages = 0;
+    MemoryItem->PrivateWorkingSetPages = 0;
+    MemoryItem->SharedWorkingSetPages = 0;
+    MemoryItem->ShareableWorkingSetPages = 0;
+    MemoryItem->LockedWorkingSetPages = 0;
+}
+
+static PPH_MEMORY_ITEM PhpCreateMemoryItemFromBasicInfo(
+    _In_opt_ PPH_MEMORY_ITEM_LIST PreviousList,
+    _Inout_ PULONG PreviousIndex,
+    _In_opt_ PPH_LIST NewItems,
+    _In_ PMEMORY_BASIC_INFORMATION BasicInfo
+    )
+{
+    PPH_MEMORY_ITEM memoryItem;
+
+    if (PreviousList)
+    {
+        // Both lists are sorted by base address, so we only need to move forward through the
+        // previous list.
+        while (*PreviousIndex < PreviousList->Count &&
+            (ULONG_PTR)PreviousList->Items[*PreviousIndex]->BaseAddress < (ULONG_PTR)BasicInfo->BaseAddress)
+        {
+            (*PreviousIndex)++;
+        }
+
+        if (*PreviousIndex < PreviousList->Count)
+        {
+            memoryItem = PreviousList->Items[*PreviousIndex];
+
+            if (memcmp(&memoryItem->BasicInfo, BasicInfo, sizeof(MEMORY_BASIC_INFORMATION)) == 0)
+            {
+                (*PreviousIndex)++;
+                PhReferenceObject(memoryItem);
+                PhpReuseMemoryItem(memoryItem, NewItems);
+
+                return memoryItem;
+            }
+        }
+    }
+
+    memoryItem = PhCreateMemoryItem();
+    memoryItem->BasicInfo = *BasicInfo;
+
+    if (NewItems)
+        PhAddItemList(NewItems, memoryItem);
+
+    return memoryItem;
+}
+
 NTSTATUS PhQueryMemoryItemList(
     _In_ HANDLE ProcessId,
     _In_ ULONG Flags,
     _Out_ PPH_MEMORY_ITEM_LIST List
     )
+{
+    return PhQueryMemoryItemListEx(ProcessId, Flags, NULL, List);
+}
+
+/**
+ * Queries the memory regions of a process.
+ *
+ * \param ProcessId The ID of the process.
+ * \param Flags A combination of PH_QUERY_MEMORY_* flags.
+ * \param PreviousList An optional list returned by a previous query for the same process. Memory
+ * items whose basic information has not changed are moved to the new list and updated in place
+ * instead of being created again. The previous list is always deleted by this function, so the new
+ * list is the only list that owns the items. Memory nodes that display the previous list see the
+ * updated items until they are replaced with PhReplaceMemoryList().
+ * \param List A variable which receives the list of memory items. Call PhDeleteMemoryItemList()
+ * when you no longer need the list.
+ */
+NTSTATUS PhQueryMemoryItemListEx(
+    _In_ HANDLE ProcessId,
+    _In_ ULONG Flags,
+    _In_opt_ PPH_MEMORY_ITEM_LIST PreviousList,
+    _Out_ PPH_MEMORY_ITEM_LIST List
+    )
 {
     NTSTATUS status;
+    PPH_LIST newItems = NULL;
     HANDLE processHandle;
     ULONG_PTR allocationGranularity;
     PVOID baseAddress = (PVOID)0;
     MEMORY_BASIC_INFORMATION basicInfo;
     PPH_MEMORY_ITEM allocationBaseItem = NULL;
-    PPH_MEMORY_ITEM previousMemoryItem = NULL;
+    ULONG previousIndex = 0;
+
+    if (PreviousList && PreviousList->ProcessId != ProcessId)
+    {
+        PhDeleteMemoryItemList(PreviousList);
+        PreviousList = NULL;
+    }
 
     if (!NT_SUCCESS(status = PhOpenProcess(
         &processHandle,
@@ -635,14 +815,23 @@ NTSTATUS PhQueryMemoryItemList(
             ProcessId
             )))
         {
+            if (PreviousList)
+                PhDeleteMemoryItemList(PreviousList);
+
             return status;
         }
     }
 
     List->ProcessId = ProcessId;
+    List->Count = 0;
+    List->AllocatedCount = PreviousList && PreviousList->Count > 64 ? PreviousList->Count : 64;
+    List->Items = PhAllocate(List->AllocatedCount * sizeof(PPH_MEMORY_ITEM));
     PhInitializeAvlTree(&List->Set, PhpMemoryItemCompareFunction);
     InitializeListHead(&List->ListHead);
 
+    if (PreviousList)
+        newItems = PhCreateList(64);
+
     allocationGranularity = PhSystemBasicInformation.AllocationGranularity;
 
     while (NT_SUCCESS(NtQueryVirtualMemory(
@@ -662,29 +851,7 @@ NTSTATUS PhQueryMemoryItemList(
                 goto ContinueLoop;
 
             basicInfo.AllocationBase = basicInfo.BaseAddress;
-        }
-
-        memoryItem = PhCreateMemoryItem();
-        memoryItem->BasicInfo = basicInfo;
-
-        if (basicInfo.AllocationBase == basicInfo.BaseAddress)
-            allocationBaseItem = memoryItem;
-        if (allocationBaseItem && basicInfo.AllocationBase == allocationBaseItem->BaseAddress)
-            memoryItem->AllocationBaseItem = allocationBaseItem;
-
-        if (basicInfo.State & MEM_COMMIT)
-        {
-            memoryItem->CommittedSize = memoryItem->RegionSize;
-
-            if (basicInfo.Type & MEM_PRIVATE)
-                memoryItem->PrivateSize = memoryItem->RegionSize;
-        }
-
-        PhAddElementAvlTree(&List->Set, &memoryItem->Links);
-        InsertTailList(&List->ListHead, &memoryItem->ListEntry);
 
-        if (basicInfo.State & MEM_FREE)
-        {
             if ((ULONG_PTR)basicInfo.BaseAddress & (allocationGranularity - 1))
             {
                 ULONG_PTR nextAllocationBase;
@@ -695,42 +862,65 @@ NTSTATUS PhQueryMemoryItemList(
                 nextAllocationBase = ALIGN_UP_BY(basicInfo.BaseAddress, allocationGranularity);
                 potentialUnusableSize = nextAllocationBase - (ULONG_PTR)basicInfo.BaseAddress;
 
-                memoryItem->RegionType = UnusableRegion;
-
                 // VMMap does this, but is it correct?
                 //if (previousMemoryItem && (previousMemoryItem->State & MEM_COMMIT))
                 //    memoryItem->CommittedSize = min(potentialUnusableSize, basicInfo.RegionSize);
 
                 if (nextAllocationBase < (ULONG_PTR)basicInfo.BaseAddress + basicInfo.RegionSize)
                 {
-                    PPH_MEMORY_ITEM otherMemoryItem;
+                    MEMORY_BASIC_INFORMATION splitBasicInfo;
 
-                    memoryItem->RegionSize = potentialUnusableSize;
+                    splitBasicInfo = basicInfo;
+                    splitBasicInfo.RegionSize = potentialUnusableSize;
 
-                    otherMemoryItem = PhCreateMemoryItem();
-                    otherMemoryItem->BasicInfo = basicInfo;
-                    otherMemoryItem->BaseAddress = (PVOID)nextAllocationBase;
-                    otherMemoryItem->AllocationBase = otherMemoryItem->BaseAddress;
-                    otherMemoryItem->RegionSize = basicInfo.RegionSize - potentialUnusableSize;
-                    otherMemoryItem->AllocationBaseItem = otherMemoryItem;
+                    memoryItem = PhpCreateMemoryItemFromBasicInfo(PreviousList, &previousIndex, newItems, &splitBasicInfo);
+                    memoryItem->AllocationBaseItem = memoryItem;
+                    memoryItem->RegionType = UnusableRegion;
+                    PhpAddMemoryItemList(List, memoryItem);
+                    allocationBaseItem = memoryItem;
 
-                    PhAddElementAvlTree(&List->Set, &otherMemoryItem->Links);
-                    InsertTailList(&List->ListHead, &otherMemoryItem->ListEntry);
+                    splitBasicInfo = basicInfo;
+                    splitBasicInfo.BaseAddress = (PVOID)nextAllocationBase;
+                    splitBasicInfo.AllocationBase = splitBasicInfo.BaseAddress;
+                    splitBasicInfo.RegionSize = basicInfo.RegionSize - potentialUnusableSize;
+
+                    memoryItem = PhpCreateMemoryItemFromBasicInfo(PreviousList, &previousIndex, newItems, &splitBasicInfo);
+                    memoryItem->AllocationBaseItem = memoryItem;
+                    PhpAddMemoryItemList(List, memoryItem);
 
-                    previousMemoryItem = otherMemoryItem;
                     goto ContinueLoop;
                 }
+
+                memoryItem = PhpCreateMemoryItemFromBasicInfo(PreviousList, &previousIndex, newItems, &basicInfo);
+                memoryItem->RegionType = UnusableRegion;
+                goto AddItem;
             }
         }
 
-        previousMemoryItem = memoryItem;
+        memoryItem = PhpCreateMemoryItemFromBasicInfo(PreviousList, &previousIndex, newItems, &basicInfo);
+
+AddItem:
+        if (basicInfo.AllocationBase == basicInfo.BaseAddress)
+            allocationBaseItem = memoryItem;
+        if (allocationBaseItem && basicInfo.AllocationBase == allocationBaseItem->BaseAddress)
+            memoryItem->AllocationBaseItem = allocationBaseItem;
+
+        if (basicInfo.State & MEM_COMMIT)
+        {
+            memoryItem->CommittedSize = memoryItem->RegionSize;
+
+            if (basicInfo.Type & MEM_PRIVATE)
+                memoryItem->PrivateSize = memoryItem->RegionSize;
+        }
+
+        PhpAddMemoryItemList(List, memoryItem);
 
 ContinueLoop:
         baseAddress = PTR_ADD_OFFSET(baseAddress, basicInfo.RegionSize);
     }
 
     if (Flags & PH_QUERY_MEMORY_REGION_TYPE)
-        PhpUpdateMemoryRegionTypes(List, processHandle);
+        PhpUpdateMemoryRegionTypes(List, processHandle, newItems);
 
     if (Flags & PH_QUERY_MEMORY_WS_COUNTERS)
     {
@@ -742,5 +932,11 @@ ContinueLoop:
 
     NtClose(processHandle);
 
+    if (PreviousList)
+    {
+        PhDeleteMemoryItemList(PreviousList);
+        PhDereferenceObject(newItems);
+    }
+
     return STATUS_SUCCESS;
 }
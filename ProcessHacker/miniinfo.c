@@ -1213,6 +1213,7 @@ BOOLEAN PhMipListSectionCallback(
     case MiniInfoCreate:
         {
             listSection->NodeList = PhCreateList(2);
+            PhInitializeProcessGroupCache(&listSection->ProcessGroupCache);
             listSection->Callback(listSection, MiListSectionCreate, NULL, NULL);
         }
         break;
@@ -1221,6 +1222,7 @@ BOOLEAN PhMipListSectionCallback(
             listSection->Callback(listSection, MiListSectionDestroy, NULL, NULL);
 
             PhMipClearListSection(listSection);
+            PhDeleteProcessGroupCache(&listSection->ProcessGroupCache);
             PhDereferenceObject(listSection->NodeList);
             PhFree(listSection);
         }
@@ -1336,6 +1338,7 @@ VOID PhMipTickListSection(
     PhMipClearListSection(ListSection);
 
     ListSection->ProcessGroupList = PhCreateProcessGroupList(
+        &ListSection->ProcessGroupCache,
         PhMipListSectionSortFunction,
         ListSection,
         MIP_MAX_PROCESS_GROUPS,
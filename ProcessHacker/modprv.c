@@ -91,6 +91,7 @@ PPH_MODULE_PROVIDER PhCreateModuleProvider(
         20
         );
     PhInitializeFastLock(&moduleProvider->ModuleHashtableLock);
+    moduleProvider->SortedModuleList = PhCreateList(20);
 
     PhInitializeCallback(&moduleProvider->ModuleAddedEvent);
     PhInitializeCallback(&moduleProvider->ModuleModifiedEvent);
@@ -149,6 +150,7 @@ VOID PhpModuleProviderDeleteProcedure(
 
     PhDereferenceObject(moduleProvider->ModuleHashtable);
     PhDeleteFastLock(&moduleProvider->ModuleHashtableLock);
+    PhDereferenceObject(moduleProvider->SortedModuleList);
     PhDeleteCallback(&moduleProvider->ModuleAddedEvent);
     PhDeleteCallback(&moduleProvider->ModuleModifiedEvent);
     PhDeleteCallback(&moduleProvider->ModuleRemovedEvent);
@@ -333,6 +335,28 @@ VOID PhpQueueModuleQuery(
     PhQueueItemWorkQueueEx(PhGetGlobalWorkQueue(), PhpModuleQueryWorker, data, NULL, &environment);
 }
 
+static int __cdecl PhpModuleInfoBaseAddressCompareFunction(
+    _In_ const void *elem1,
+    _In_ const void *elem2
+    )
+{
+    PPH_MODULE_INFO module1 = *(PPH_MODULE_INFO *)elem1;
+    PPH_MODULE_INFO module2 = *(PPH_MODULE_INFO *)elem2;
+
+    return uintptrcmp((ULONG_PTR)module1->BaseAddress, (ULONG_PTR)module2->BaseAddress);
+}
+
+static int __cdecl PhpModuleItemBaseAddressCompareFunction(
+    _In_ const void *elem1,
+    _In_ const void *elem2
+    )
+{
+    PPH_MODULE_ITEM moduleItem1 = *(PPH_MODULE_ITEM *)elem1;
+    PPH_MODULE_ITEM moduleItem2 = *(PPH_MODULE_ITEM *)elem2;
+
+    return uintptrcmp((ULONG_PTR)moduleItem1->BaseAddress, (ULONG_PTR)moduleItem2->BaseAddress);
+}
+
 static BOOLEAN NTAPI EnumModulesCallback(
     _In_ PPH_MODULE_INFO Module,
     _In_opt_ PVOID Context
@@ -355,6 +379,8 @@ VOID PhModuleProviderUpdate(
 {
     PPH_MODULE_PROVIDER moduleProvider = (PPH_MODULE_PROVIDER)Object;
     PPH_LIST modules;
+    PPH_MODULE_INFO *sortedModules;
+    PPH_LIST newModuleItems = NULL;
     ULONG i;
 
     // If we didn't get a handle when we created the provider,
@@ -373,41 +399,67 @@ VOID PhModuleProviderUpdate(
         modules
         );
 
+    // Sort a copy of the modules by base address so we can merge them with the module items. We
+    // keep the original list because new modules are added in enumeration order.
+
+    sortedModules = NULL;
+
+    if (modules->Count != 0)
+    {
+        sortedModules = PhAllocateCopy(modules->Items, modules->Count * sizeof(PPH_MODULE_INFO));
+        qsort(sortedModules, modules->Count, sizeof(PPH_MODULE_INFO), PhpModuleInfoBaseAddressCompareFunction);
+    }
+
     // Look for removed modules.
     {
+        PPH_LIST sortedModuleList = moduleProvider->SortedModuleList;
         PPH_LIST modulesToRemove = NULL;
-        ULONG enumerationKey = 0;
-        PPH_MODULE_ITEM *moduleItem;
+        ULONG j;
+        ULONG k;
+        ULONG count;
 
-        while (PhEnumHashtable(moduleProvider->ModuleHashtable, (PVOID *)&moduleItem, &enumerationKey))
+        j = 0;
+        count = 0;
+
+        for (i = 0; i < sortedModuleList->Count; i++)
         {
+            PPH_MODULE_ITEM moduleItem = sortedModuleList->Items[i];
             BOOLEAN found = FALSE;
 
-            // Check if the module still exists.
-            for (i = 0; i < modules->Count; i++)
-            {
-                PPH_MODULE_INFO module = modules->Items[i];
+            // Skip over modules before this one. Module items have unique base addresses, so
+            // these are either new or replacing a removed module item.
+            while (j < modules->Count && (ULONG_PTR)sortedModules[j]->BaseAddress < (ULONG_PTR)moduleItem->BaseAddress)
+                j++;
 
-                if ((*moduleItem)->BaseAddress == module->BaseAddress &&
-                    PhEqualString((*moduleItem)->FileName, module->FileName, TRUE))
+            // Check if the module still exists. We only need to compare file names when the base
+            // addresses are the same.
+            for (k = j; k < modules->Count && sortedModules[k]->BaseAddress == moduleItem->BaseAddress; k++)
+            {
+                if (PhEqualString(moduleItem->FileName, sortedModules[k]->FileName, TRUE))
                 {
                     found = TRUE;
                     break;
                 }
             }
 
-            if (!found)
+            if (found)
+            {
+                sortedModuleList->Items[count++] = moduleItem;
+            }
+            else
             {
                 // Raise the module removed event.
-                PhInvokeCallback(&moduleProvider->ModuleRemovedEvent, *moduleItem);
+                PhInvokeCallback(&moduleProvider->ModuleRemovedEvent, moduleItem);
 
                 if (!modulesToRemove)
                     modulesToRemove = PhCreateList(2);
 
-                PhAddItemList(modulesToRemove, *moduleItem);
+                PhAddItemList(modulesToRemove, moduleItem);
             }
         }
 
+        sortedModuleList->Count = count;
+
         if (modulesToRemove)
         {
             PhAcquireFastLockExclusive(&moduleProvider->ModuleHashtableLock);
@@ -552,6 +604,11 @@ VOID PhModuleProviderUpdate(
             PhAddEntryHashtable(moduleProvider->ModuleHashtable, &moduleItem);
             PhReleaseFastLockExclusive(&moduleProvider->ModuleHashtableLock);
 
+            if (!newModuleItems)
+                newModuleItems = PhCreateList(modules->Count - i);
+
+            PhAddItemList(newModuleItems, moduleItem);
+
             // Raise the module added event.
             PhInvokeCallback(&moduleProvider->ModuleAddedEvent, moduleItem);
         }
@@ -571,8 +628,42 @@ VOID PhModuleProviderUpdate(
         }
     }
 
+    // Merge the new module items into the sorted list.
+    if (newModuleItems)
+    {
+        PPH_LIST sortedModuleList = moduleProvider->SortedModuleList;
+        PPH_LIST newSortedModuleList;
+        ULONG j;
+
+        qsort(newModuleItems->Items, newModuleItems->Count, sizeof(PPH_MODULE_ITEM), PhpModuleItemBaseAddressCompareFunction);
+
+        newSortedModuleList = PhCreateList(sortedModuleList->Count + newModuleItems->Count);
+        i = 0;
+        j = 0;
+
+        while (i < sortedModuleList->Count || j < newModuleItems->Count)
+        {
+            if (j == newModuleItems->Count || (i < sortedModuleList->Count &&
+                (ULONG_PTR)((PPH_MODULE_ITEM)sortedModuleList->Items[i])->BaseAddress <
+                (ULONG_PTR)((PPH_MODULE_ITEM)newModuleItems->Items[j])->BaseAddress))
+            {
+                PhAddItemList(newSortedModuleList, sortedModuleList->Items[i++]);
+            }
+            else
+            {
+                PhAddItemList(newSortedModuleList, newModuleItems->Items[j++]);
+            }
+        }
+
+        PhMoveReference(&moduleProvider->SortedModuleList, newSortedModuleList);
+        PhDereferenceObject(newModuleItems);
+    }
+
     // Free the modules list.
 
+    if (sortedModules)
+        PhFree(sortedModules);
+
     for (i = 0; i < modules->Count; i++)
     {
         PPH_MODULE_INFO module = modules->Items[i];
@@ -1215,3 +1215,157 @@ CleanupExit:
 
     return status;
 }
+
+/**
+ * Executes multiple operations in the server using as few round trips as possible.
+ *
+ * \param Items An array of operations. The ReturnStatus field of each processed item
+ * receives the status of the operation.
+ * \param NumberOfItems The number of items in \a Items.
+ * \param StopOnError TRUE to stop at the first operation that fails, otherwise FALSE.
+ * \param NumberOfItemsProcessed A variable which receives the number of items that
+ * were processed.
+ *
+ * \remarks Strings referenced by items (e.g. service names) must have been allocated
+ * using PhSvcpCreateString.
+ */
+NTSTATUS PhSvcCallBatch(
+    _Inout_updates_(NumberOfItems) PPHSVC_API_BATCH_ITEM Items,
+    _In_ ULONG NumberOfItems,
+    _In_ BOOLEAN StopOnError,
+    _Out_opt_ PULONG NumberOfItemsProcessed
+    )
+{
+    NTSTATUS status = STATUS_SUCCESS;
+    PHSVC_API_MSG m;
+    PPHSVC_API_BATCH_ITEM items;
+    ULONG offset;
+    ULONG numberOfItemsProcessed = 0;
+    ULONG chunkCount;
+    ULONG chunkProcessed;
+
+    if (!PhSvcClPortHandle)
+        return STATUS_PORT_DISCONNECTED;
+
+    // The items are copied into the shared section so the server can write
+    // the statuses back in place. Large batches are split into chunks so we
+    // don't exhaust the port heap.
+
+    chunkCount = min(NumberOfItems, PHSVC_BATCH_CHUNK_SIZE);
+
+    if (chunkCount == 0)
+        goto CleanupExit;
+
+    if (!(items = PhSvcpAllocateHeap(chunkCount * sizeof(PHSVC_API_BATCH_ITEM), &offset)))
+        return STATUS_NO_MEMORY;
+
+    while (numberOfItemsProcessed < NumberOfItems)
+    {
+        chunkCount = min(NumberOfItems - numberOfItemsProcessed, PHSVC_BATCH_CHUNK_SIZE);
+        memcpy(items, &Items[numberOfItemsProcessed], chunkCount * sizeof(PHSVC_API_BATCH_ITEM));
+
+        memset(&m, 0, sizeof(PHSVC_API_MSG));
+        m.p.ApiNumber = PhSvcBatchApiNumber;
+        m.p.u.Batch.i.Items.Offset = offset;
+        m.p.u.Batch.i.Items.Length = chunkCount * sizeof(PHSVC_API_BATCH_ITEM);
+        m.p.u.Batch.i.StopOnError = StopOnError;
+
+        status = PhSvcpCallServer(&m);
+
+        if (!NT_SUCCESS(status))
+            break;
+
+        chunkProcessed = min(m.p.u.Batch.o.NumberOfItemsProcessed, chunkCount);
+        memcpy(&Items[numberOfItemsProcessed], items, chunkProcessed * sizeof(PHSVC_API_BATCH_ITEM));
+        numberOfItemsProcessed += chunkProcessed;
+
+        if (chunkProcessed != chunkCount)
+            break;
+    }
+
+    PhSvcpFreeHeap(items);
+
+CleanupExit:
+    if (NumberOfItemsProcessed)
+        *NumberOfItemsProcessed = numberOfItemsProcessed;
+
+    return status;
+}
+
+NTSTATUS PhSvcCallControlProcesses(
+    _In_reads_(NumberOfProcesses) PHANDLE ProcessIds,
+    _In_ ULONG NumberOfProcesses,
+    _In_ PHSVC_API_CONTROLPROCESS_COMMAND Command,
+    _In_ ULONG Argument,
+    _Out_writes_(NumberOfProcesses) PNTSTATUS Statuses
+    )
+{
+    NTSTATUS status;
+    PPHSVC_API_BATCH_ITEM items;
+    ULONG numberOfItemsProcessed;
+    ULONG i;
+
+    items = PhAllocate(NumberOfProcesses * sizeof(PHSVC_API_BATCH_ITEM));
+    memset(items, 0, NumberOfProcesses * sizeof(PHSVC_API_BATCH_ITEM));
+
+    for (i = 0; i < NumberOfProcesses; i++)
+    {
+        items[i].ApiNumber = PhSvcControlProcessApiNumber;
+        items[i].u.ControlProcess.i.ProcessId = ProcessIds[i];
+        items[i].u.ControlProcess.i.Command = Command;
+        items[i].u.ControlProcess.i.Argument = Argument;
+    }
+
+    status = PhSvcCallBatch(items, NumberOfProcesses, FALSE, &numberOfItemsProcessed);
+
+    for (i = 0; i < NumberOfProcesses; i++)
+    {
+        if (i < numberOfItemsProcessed)
+            Statuses[i] = items[i].ReturnStatus;
+        else
+            Statuses[i] = NT_SUCCESS(status) ? STATUS_UNSUCCESSFUL : status;
+    }
+
+    PhFree(items);
+
+    return status;
+}
+
+NTSTATUS PhSvcCallControlThreads(
+    _In_reads_(NumberOfThreads) PHANDLE ThreadIds,
+    _In_ ULONG NumberOfThreads,
+    _In_ PHSVC_API_CONTROLTHREAD_COMMAND Command,
+    _In_ ULONG Argument,
+    _Out_writes_(NumberOfThreads) PNTSTATUS Statuses
+    )
+{
+    NTSTATUS status;
+    PPHSVC_API_BATCH_ITEM items;
+    ULONG numberOfItemsProcessed;
+    ULONG i;
+
+    items = PhAllocate(NumberOfThreads * sizeof(PHSVC_API_BATCH_ITEM));
+    memset(items, 0, NumberOfThreads * sizeof(PHSVC_API_BATCH_ITEM));
+
+    for (i = 0; i < NumberOfThreads; i++)
+    {
+        items[i].ApiNumber = PhSvcControlThreadApiNumber;
+        items[i].u.ControlThread.i.ThreadId = ThreadIds[i];
+        items[i].u.ControlThread.i.Command = Command;
+        items[i].u.ControlThread.i.Argument = Argument;
+    }
+
+    status = PhSvcCallBatch(items, NumberOfThreads, FALSE, &numberOfItemsProcessed);
+
+    for (i = 0; i < NumberOfThreads; i++)
+    {
+        if (i < numberOfItemsProcessed)
+            Statuses[i] = items[i].ReturnStatus;
+        else
+            Statuses[i] = NT_SUCCESS(status) ? STATUS_UNSUCCESSFUL : status;
+    }
+
+    PhFree(items);
+
+    return status;
+}
@@ -65,7 +65,8 @@ PPHSVC_API_PROCEDURE PhSvcApiCallTable[] =
     PhSvcApiCreateProcessIgnoreIfeoDebugger,
     PhSvcApiSetServiceSecurity,
     PhSvcApiLoadDbgHelp,
-    PhSvcApiWriteMiniDumpProcess
+    PhSvcApiWriteMiniDumpProcess,
+    PhSvcApiBatch
 };
 C_ASSERT(sizeof(PhSvcApiCallTable) / sizeof(PPHSVC_API_PROCEDURE) == PhSvcMaximumApiNumber - 1);
 
@@ -1444,3 +1445,65 @@ NTSTATUS PhSvcApiWriteMiniDumpProcess(
             return STATUS_UNSUCCESSFUL;
     }
 }
+
+NTSTATUS PhSvcApiBatch(
+    _In_ PPHSVC_CLIENT Client,
+    _Inout_ PPHSVC_API_PAYLOAD Payload
+    )
+{
+    NTSTATUS status;
+    PPHSVC_API_BATCH_ITEM items;
+    ULONG numberOfItems;
+    BOOLEAN stopOnError;
+    ULONG i;
+
+    if (Payload->u.Batch.i.Items.Length % sizeof(PHSVC_API_BATCH_ITEM) != 0)
+        return STATUS_INVALID_BUFFER_SIZE;
+    if (!NT_SUCCESS(status = PhSvcProbeBuffer(&Payload->u.Batch.i.Items, sizeof(ULONG), FALSE, &items)))
+        return status;
+
+    numberOfItems = Payload->u.Batch.i.Items.Length / sizeof(PHSVC_API_BATCH_ITEM);
+    stopOnError = Payload->u.Batch.i.StopOnError;
+
+    for (i = 0; i < numberOfItems; i++)
+    {
+        PHSVC_API_PAYLOAD payload;
+
+        // Capture each item before dispatching it. The items live in the client's view,
+        // so the client could modify them while we are using them.
+
+        memset(&payload, 0, sizeof(PHSVC_API_PAYLOAD));
+        payload.ApiNumber = items[i].ApiNumber;
+
+        switch (payload.ApiNumber)
+        {
+        case PhSvcControlProcessApiNumber:
+            payload.u.ControlProcess = items[i].u.ControlProcess;
+            status = PhSvcApiControlProcess(Client, &payload);
+            break;
+        case PhSvcControlServiceApiNumber:
+            payload.u.ControlService = items[i].u.ControlService;
+            status = PhSvcApiControlService(Client, &payload);
+            break;
+        case PhSvcControlThreadApiNumber:
+            payload.u.ControlThread = items[i].u.ControlThread;
+            status = PhSvcApiControlThread(Client, &payload);
+            break;
+        default:
+            status = STATUS_INVALID_SYSTEM_SERVICE;
+            break;
+        }
+
+        items[i].ReturnStatus = status;
+
+        if (!NT_SUCCESS(status) && stopOnError)
+        {
+            i++;
+            break;
+        }
+    }
+
+    Payload->u.Batch.o.NumberOfItemsProcessed = i;
+
+    return STATUS_SUCCESS;
+}
@@ -29,84 +29,223 @@
 typedef struct _PHP_PROCESS_DATA
 {
     PPH_PROCESS_NODE Process;
-    LIST_ENTRY ListEntry;
+    LARGE_INTEGER CreateTime;
+    PPH_PROCESS_NODE Parent;
     HWND WindowHandle;
+    HWND PreviousWindowHandle;
+    struct _PHP_PROCESS_DATA *Root;
+    PPH_LIST Members; // Group members, if this is the root of a group (PPHP_PROCESS_DATA)
+    ULONG RunId;
 } PHP_PROCESS_DATA, *PPHP_PROCESS_DATA;
 
-PPH_LIST PhpCreateProcessDataList(
-    _In_ PPH_LIST Processes
+// The window event hooks and the list of caches are only used by the GUI thread. Out-of-context
+// events are delivered to the message loop of the thread which installed the hooks.
+static HWINEVENTHOOK PhpWindowEventHooks[2];
+static BOOLEAN PhpWindowEventsHooked = FALSE;
+static PPH_LIST PhpProcessGroupCacheList = NULL;
+
+VOID CALLBACK PhpProcessGroupWinEventProc(
+    _In_ HWINEVENTHOOK WinEventHook,
+    _In_ DWORD Event,
+    _In_ HWND hwnd,
+    _In_ LONG ObjectId,
+    _In_ LONG ChildId,
+    _In_ DWORD EventThread,
+    _In_ DWORD EventTime
     )
 {
-    PPH_LIST processDataList;
     ULONG i;
 
-    processDataList = PhCreateList(Processes->Count);
+    if (ObjectId != OBJID_WINDOW || ChildId != CHILDID_SELF || !hwnd)
+        return;
 
-    for (i = 0; i < Processes->Count; i++)
+    if (Event == EVENT_OBJECT_DESTROY)
     {
-        PPH_PROCESS_NODE process = Processes->Items[i];
-        PPHP_PROCESS_DATA processData;
+        // Destroyed windows can't be checked anymore. Only the windows chosen for processes affect
+        // grouping, so look the window up in each cache.
+        for (i = 0; i < PhpProcessGroupCacheList->Count; i++)
+        {
+            PPH_PROCESS_GROUP_CACHE cache = PhpProcessGroupCacheList->Items[i];
 
-        if (PH_IS_FAKE_PROCESS_ID(process->ProcessId) || process->ProcessId == SYSTEM_IDLE_PROCESS_ID)
-            continue;
+            if (PhFindItemSimpleHashtable(cache->WindowHashtable, hwnd))
+                cache->WindowsValid = FALSE;
+        }
+    }
+    else if (GetAncestor(hwnd, GA_PARENT) == GetDesktopWindow()) // Only top-level windows affect grouping
+    {
+        for (i = 0; i < PhpProcessGroupCacheList->Count; i++)
+        {
+            PPH_PROCESS_GROUP_CACHE cache = PhpProcessGroupCacheList->Items[i];
 
-        processData = PhAllocate(sizeof(PHP_PROCESS_DATA));
-        memset(processData, 0, sizeof(PHP_PROCESS_DATA));
-        processData->Process = process;
-        PhAddItemList(processDataList, processData);
+            cache->WindowsValid = FALSE;
+        }
     }
+}
 
-    return processDataList;
+VOID PhpReferenceWindowEventHooks(
+    _In_ PPH_PROCESS_GROUP_CACHE Cache
+    )
+{
+    if (!PhpProcessGroupCacheList)
+        PhpProcessGroupCacheList = PhCreateList(2);
+
+    PhAddItemList(PhpProcessGroupCacheList, Cache);
+
+    if (PhpProcessGroupCacheList->Count != 1)
+        return;
+
+    PhpWindowEventHooks[0] = SetWinEventHook(EVENT_OBJECT_CREATE, EVENT_OBJECT_HIDE, NULL,
+        PhpProcessGroupWinEventProc, 0, 0, WINEVENT_OUTOFCONTEXT);
+    PhpWindowEventHooks[1] = SetWinEventHook(EVENT_OBJECT_NAMECHANGE, EVENT_OBJECT_NAMECHANGE, NULL,
+        PhpProcessGroupWinEventProc, 0, 0, WINEVENT_OUTOFCONTEXT);
+
+    if (PhpWindowEventHooks[0] && PhpWindowEventHooks[1])
+    {
+        PhpWindowEventsHooked = TRUE;
+    }
+    else
+    {
+        // Without both hooks we can't tell when windows change, so we enumerate them every time.
+        if (PhpWindowEventHooks[0]) UnhookWinEvent(PhpWindowEventHooks[0]);
+        if (PhpWindowEventHooks[1]) UnhookWinEvent(PhpWindowEventHooks[1]);
+        PhpWindowEventHooks[0] = NULL;
+        PhpWindowEventHooks[1] = NULL;
+    }
 }
 
-VOID PhpDestroyProcessDataList(
-    _In_ PPH_LIST List
+VOID PhpDereferenceWindowEventHooks(
+    _In_ PPH_PROCESS_GROUP_CACHE Cache
     )
 {
-    ULONG i;
+    ULONG index;
 
-    for (i = 0; i < List->Count; i++)
+    index = PhFindItemList(PhpProcessGroupCacheList, Cache);
+    assert(index != -1);
+    PhRemoveItemList(PhpProcessGroupCacheList, index);
+
+    if (PhpProcessGroupCacheList->Count != 0)
+        return;
+
+    if (PhpWindowEventsHooked)
     {
-        PPHP_PROCESS_DATA processData = List->Items[i];
-        PhFree(processData);
+        UnhookWinEvent(PhpWindowEventHooks[0]);
+        UnhookWinEvent(PhpWindowEventHooks[1]);
+        PhpWindowEventHooks[0] = NULL;
+        PhpWindowEventHooks[1] = NULL;
+        PhpWindowEventsHooked = FALSE;
     }
+}
 
-    PhDereferenceObject(List);
+/**
+ * Initializes a process group cache.
+ *
+ * \param Cache The cache. It must stay at the same address until PhDeleteProcessGroupCache() is
+ * called, and both functions must be called from the GUI thread.
+ */
+VOID PhInitializeProcessGroupCache(
+    _Out_ PPH_PROCESS_GROUP_CACHE Cache
+    )
+{
+    memset(Cache, 0, sizeof(PH_PROCESS_GROUP_CACHE));
+    Cache->ProcessDataHashtable = PhCreateSimpleHashtable(64);
+    Cache->WindowHashtable = PhCreateSimpleHashtable(16);
+
+    PhpReferenceWindowEventHooks(Cache);
 }
 
-VOID PhpProcessDataListToLinkedList(
-    _In_ PPH_LIST List,
-    _Out_ PLIST_ENTRY ListHead
+VOID PhpClearProcessGroupCache(
+    _Inout_ PPH_PROCESS_GROUP_CACHE Cache
     )
 {
-    ULONG i;
+    PH_HASHTABLE_ENUM_CONTEXT enumContext;
+    PPH_KEY_VALUE_PAIR entry;
 
-    InitializeListHead(ListHead);
+    // Don't touch the process nodes here. They may have been freed since the cache was updated.
 
-    for (i = 0; i < List->Count; i++)
+    PhBeginEnumHashtable(Cache->ProcessDataHashtable, &enumContext);
+
+    while (entry = PhNextEnumHashtable(&enumContext))
     {
-        PPHP_PROCESS_DATA processData = List->Items[i];
-        InsertTailList(ListHead, &processData->ListEntry);
+        PPHP_PROCESS_DATA processData = entry->Value;
+
+        if (processData->Members)
+            PhDereferenceObject(processData->Members);
+
+        PhFree(processData);
     }
+
+    PhClearHashtable(Cache->ProcessDataHashtable);
+    PhClearHashtable(Cache->WindowHashtable);
+    Cache->WindowsValid = FALSE;
+    Cache->GroupsValid = FALSE;
 }
 
-VOID PhpProcessDataListToHashtable(
-    _In_ PPH_LIST List,
-    _Out_ PPH_HASHTABLE *Hashtable
+VOID PhDeleteProcessGroupCache(
+    _Inout_ PPH_PROCESS_GROUP_CACHE Cache
     )
 {
-    PPH_HASHTABLE hashtable;
+    PhpDereferenceWindowEventHooks(Cache);
+
+    PhpClearProcessGroupCache(Cache);
+    PhDereferenceObject(Cache->ProcessDataHashtable);
+    PhDereferenceObject(Cache->WindowHashtable);
+}
+
+VOID PhpUpdateProcessData(
+    _Inout_ PPH_PROCESS_GROUP_CACHE Cache,
+    _In_ PPH_LIST Processes
+    )
+{
+    ULONG count;
     ULONG i;
 
-    hashtable = PhCreateSimpleHashtable(List->Count);
+    // The groups only depend on the set of processes, their parents and their windows. File
+    // names and user names are fixed for the lifetime of a process item, so as long as every
+    // process node is the same as last time there's nothing to do here.
 
-    for (i = 0; i < List->Count; i++)
+    count = 0;
+
+    for (i = 0; i < Processes->Count; i++)
     {
-        PPHP_PROCESS_DATA processData = List->Items[i];
-        PhAddItemSimpleHashtable(hashtable, processData->Process->ProcessId, processData);
+        PPH_PROCESS_NODE process = Processes->Items[i];
+        PPHP_PROCESS_DATA processData;
+
+        if (PH_IS_FAKE_PROCESS_ID(process->ProcessId) || process->ProcessId == SYSTEM_IDLE_PROCESS_ID)
+            continue;
+
+        processData = PhFindItemSimpleHashtable2(Cache->ProcessDataHashtable, process->ProcessId);
+
+        if (!processData ||
+            processData->Process != process ||
+            processData->CreateTime.QuadPart != process->ProcessItem->CreateTime.QuadPart ||
+            processData->Parent != process->Parent)
+        {
+            break;
+        }
+
+        count++;
     }
 
-    *Hashtable = hashtable;
+    if (i == Processes->Count && count == Cache->ProcessDataHashtable->Count)
+        return;
+
+    PhpClearProcessGroupCache(Cache);
+
+    for (i = 0; i < Processes->Count; i++)
+    {
+        PPH_PROCESS_NODE process = Processes->Items[i];
+        PPHP_PROCESS_DATA processData;
+
+        if (PH_IS_FAKE_PROCESS_ID(process->ProcessId) || process->ProcessId == SYSTEM_IDLE_PROCESS_ID)
+            continue;
+
+        processData = PhAllocate(sizeof(PHP_PROCESS_DATA));
+        memset(processData, 0, sizeof(PHP_PROCESS_DATA));
+        processData->Process = process;
+        processData->CreateTime = process->ProcessItem->CreateTime;
+        processData->Parent = process->Parent;
+        PhAddItemSimpleHashtable(Cache->ProcessDataHashtable, process->ProcessId, processData);
+    }
 }
 
 typedef struct _QUERY_WINDOWS_CONTEXT
@@ -142,6 +281,47 @@ BOOL CALLBACK PhpQueryWindowsEnumWindowsProc(
     return TRUE;
 }
 
+VOID PhpUpdateProcessWindows(
+    _Inout_ PPH_PROCESS_GROUP_CACHE Cache
+    )
+{
+    PH_HASHTABLE_ENUM_CONTEXT enumContext;
+    PPH_KEY_VALUE_PAIR entry;
+    QUERY_WINDOWS_CONTEXT queryWindowsContext;
+
+    if (Cache->WindowsValid && PhpWindowEventsHooked)
+        return;
+
+    PhBeginEnumHashtable(Cache->ProcessDataHashtable, &enumContext);
+
+    while (entry = PhNextEnumHashtable(&enumContext))
+    {
+        PPHP_PROCESS_DATA processData = entry->Value;
+
+        processData->PreviousWindowHandle = processData->WindowHandle;
+        processData->WindowHandle = NULL;
+    }
+
+    queryWindowsContext.ProcessDataHashtable = Cache->ProcessDataHashtable;
+    PhEnumChildWindows(NULL, 0x800, PhpQueryWindowsEnumWindowsProc, (LPARAM)&queryWindowsContext);
+
+    PhClearHashtable(Cache->WindowHashtable);
+    PhBeginEnumHashtable(Cache->ProcessDataHashtable, &enumContext);
+
+    while (entry = PhNextEnumHashtable(&enumContext))
+    {
+        PPHP_PROCESS_DATA processData = entry->Value;
+
+        if (processData->WindowHandle != processData->PreviousWindowHandle)
+            Cache->GroupsValid = FALSE;
+
+        if (processData->WindowHandle)
+            PhAddItemSimpleHashtable(Cache->WindowHashtable, processData->WindowHandle, NULL);
+    }
+
+    Cache->WindowsValid = TRUE;
+}
+
 PPH_STRING PhpGetRelevantFileName(
     _In_ PPH_PROCESS_ITEM ProcessItem,
     _In_ ULONG Flags
@@ -214,17 +394,16 @@ PPHP_PROCESS_DATA PhpFindGroupRoot(
 
 VOID PhpAddGroupMember(
     _In_ PPHP_PROCESS_DATA ProcessData,
-    _Inout_ PPH_LIST List
+    _Inout_ PPHP_PROCESS_DATA RootProcessData
     )
 {
-    PhReferenceObject(ProcessData->Process->ProcessItem);
-    PhAddItemList(List, ProcessData->Process->ProcessItem);
-    RemoveEntryList(&ProcessData->ListEntry);
+    ProcessData->Root = RootProcessData;
+    PhAddItemList(RootProcessData->Members, ProcessData);
 }
 
 VOID PhpAddGroupMembersFromRoot(
     _In_ PPHP_PROCESS_DATA ProcessData,
-    _Inout_ PPH_LIST List,
+    _Inout_ PPHP_PROCESS_DATA RootProcessData,
     _In_ PPH_HASHTABLE ProcessDataHashtable,
     _In_ ULONG Flags
     )
@@ -233,7 +412,7 @@ VOID PhpAddGroupMembersFromRoot(
     PPH_STRING userName;
     ULONG i;
 
-    PhpAddGroupMember(ProcessData, List);
+    PhpAddGroupMember(ProcessData, RootProcessData);
     fileName = PhpGetRelevantFileName(ProcessData->Process->ProcessItem, Flags);
     userName = ProcessData->Process->ProcessItem->UserName;
 
@@ -243,16 +422,68 @@ VOID PhpAddGroupMembersFromRoot(
         PPHP_PROCESS_DATA processData;
 
         if ((processData = PhFindItemSimpleHashtable2(ProcessDataHashtable, node->ProcessId)) &&
+            !processData->Root &&
             PhpEqualFileNameAndUserName(fileName, userName, node->ProcessItem, Flags) &&
             node->ProcessItem->UserName && PhEqualString(node->ProcessItem->UserName, userName, TRUE) &&
             !processData->WindowHandle)
         {
-            PhpAddGroupMembersFromRoot(processData, List, ProcessDataHashtable, Flags);
+            PhpAddGroupMembersFromRoot(processData, RootProcessData, ProcessDataHashtable, Flags);
         }
     }
 }
 
+VOID PhpUpdateProcessGroups(
+    _Inout_ PPH_PROCESS_GROUP_CACHE Cache
+    )
+{
+    PH_HASHTABLE_ENUM_CONTEXT enumContext;
+    PPH_KEY_VALUE_PAIR entry;
+
+    PhBeginEnumHashtable(Cache->ProcessDataHashtable, &enumContext);
+
+    while (entry = PhNextEnumHashtable(&enumContext))
+    {
+        PPHP_PROCESS_DATA processData = entry->Value;
+
+        processData->Root = NULL;
+        PhClearReference(&processData->Members);
+    }
+
+    // Every process belongs to the group of the root found by walking up from it, so the groups
+    // don't depend on the order in which we visit the processes.
+
+    PhBeginEnumHashtable(Cache->ProcessDataHashtable, &enumContext);
+
+    while (entry = PhNextEnumHashtable(&enumContext))
+    {
+        PPHP_PROCESS_DATA processData = entry->Value;
+        PPH_STRING fileName;
+        PPH_STRING userName;
+
+        if (processData->Root)
+            continue;
+
+        fileName = PhpGetRelevantFileName(processData->Process->ProcessItem, Cache->Flags);
+        userName = processData->Process->ProcessItem->UserName;
+
+        if (!fileName || !userName || (Cache->Flags & PH_GROUP_PROCESSES_DONT_GROUP))
+        {
+            processData->Members = PhCreateList(1);
+            PhpAddGroupMember(processData, processData);
+        }
+        else
+        {
+            processData = PhpFindGroupRoot(processData, Cache->ProcessDataHashtable, Cache->Flags);
+            processData->Members = PhCreateList(4);
+            PhpAddGroupMembersFromRoot(processData, processData, Cache->ProcessDataHashtable, Cache->Flags);
+        }
+    }
+
+    Cache->GroupsValid = TRUE;
+}
+
 PPH_LIST PhCreateProcessGroupList(
+    _Inout_ PPH_PROCESS_GROUP_CACHE Cache,
     _In_opt_ PPH_SORT_LIST_FUNCTION SortListFunction,
     _In_opt_ PVOID Context,
     _In_ ULONG MaximumGroups,
@@ -260,66 +491,73 @@ PPH_LIST PhCreateProcessGroupList(
     )
 {
     PPH_LIST processList;
-    PPH_LIST processDataList;
-    LIST_ENTRY processDataListHead; // We will be removing things from this list as we group processes together
-    PPH_HASHTABLE processDataHashtable; // Process ID to process data hashtable
-    QUERY_WINDOWS_CONTEXT queryWindowsContext;
     PPH_LIST processGroupList;
+    ULONG i;
+    ULONG j;
 
     // We group together processes that share a common ancestor and have the same file name, where
     // the ancestor must have a visible window and all other processes in the group do not have a
     // visible window. All processes in the group must have the same user name. All ancestors up to
     // the lowest common ancestor must have the same file name and user name.
     //
-    // The current algorithm is greedy and may not detect groups that have many processes, each with
-    // a small usage amount.
+    // The groups are kept in the cache and only recomputed when processes are created or
+    // terminated or when top-level windows change; otherwise we only need to sort the processes
+    // and pick the groups of the first few. This is greedy and may not detect groups that have
+    // many processes, each with a small usage amount.
 
     processList = PhDuplicateProcessNodeList();
 
     if (SortListFunction)
         SortListFunction(processList, Context);
 
-    processDataList = PhpCreateProcessDataList(processList);
-    PhDereferenceObject(processList);
-    PhpProcessDataListToLinkedList(processDataList, &processDataListHead);
-    PhpProcessDataListToHashtable(processDataList, &processDataHashtable);
+    if (Cache->Flags != Flags)
+    {
+        Cache->Flags = Flags;
+        Cache->GroupsValid = FALSE;
+    }
 
-    queryWindowsContext.ProcessDataHashtable = processDataHashtable;
-    PhEnumChildWindows(NULL, 0x800, PhpQueryWindowsEnumWindowsProc, (LPARAM)&queryWindowsContext);
+    PhpUpdateProcessData(Cache, processList);
+    PhpUpdateProcessWindows(Cache);
+
+    if (!Cache->GroupsValid)
+        PhpUpdateProcessGroups(Cache);
 
+    Cache->RunId++;
     processGroupList = PhCreateList(10);
 
-    while (processDataListHead.Flink != &processDataListHead && processGroupList->Count < MaximumGroups)
+    for (i = 0; i < processList->Count && processGroupList->Count < MaximumGroups; i++)
     {
-        PPHP_PROCESS_DATA processData = CONTAINING_RECORD(processDataListHead.Flink, PHP_PROCESS_DATA, ListEntry);
+        PPH_PROCESS_NODE process = processList->Items[i];
+        PPHP_PROCESS_DATA processData;
         PPH_PROCESS_GROUP processGroup;
-        PPH_STRING fileName;
-        PPH_STRING userName;
+
+        if (!(processData = PhFindItemSimpleHashtable2(Cache->ProcessDataHashtable, process->ProcessId)))
+            continue;
+
+        processData = processData->Root;
+
+        if (processData->RunId == Cache->RunId)
+            continue; // Already added as part of an earlier process's group
+
+        processData->RunId = Cache->RunId;
 
         processGroup = PhAllocate(sizeof(PH_PROCESS_GROUP));
-        processGroup->Processes = PhCreateList(4);
-        fileName = PhpGetRelevantFileName(processData->Process->ProcessItem, Flags);
-        userName = processData->Process->ProcessItem->UserName;
+        processGroup->Representative = processData->Process->ProcessItem;
+        processGroup->Processes = PhCreateList(processData->Members->Count);
+        processGroup->WindowHandle = processData->WindowHandle;
 
-        if (!fileName || !userName || (Flags & PH_GROUP_PROCESSES_DONT_GROUP))
-        {
-            processGroup->Representative = processData->Process->ProcessItem;
-            PhpAddGroupMember(processData, processGroup->Processes);
-        }
-        else
+        for (j = 0; j < processData->Members->Count; j++)
         {
-            processData = PhpFindGroupRoot(processData, processDataHashtable, Flags);
-            processGroup->Representative = processData->Process->ProcessItem;
-            PhpAddGroupMembersFromRoot(processData, processGroup->Processes, processDataHashtable, Flags);
-        }
+            PPHP_PROCESS_DATA member = processData->Members->Items[j];
 
-        processGroup->WindowHandle = processData->WindowHandle;
+            PhReferenceObject(member->Process->ProcessItem);
+            PhAddItemList(processGroup->Processes, member->Process->ProcessItem);
+        }
 
         PhAddItemList(processGroupList, processGroup);
     }
 
-    PhDereferenceObject(processDataHashtable);
-    PhpDestroyProcessDataList(processDataList);
+    PhDereferenceObject(processList);
 
     return processGroupList;
 }
@@ -180,11 +180,16 @@ ULONG PhStatisticsSampleCount = 512;
 BOOLEAN PhEnableProcessQueryStage2 = FALSE;
 BOOLEAN PhEnablePurgeProcessRecords = TRUE;
 BOOLEAN PhEnableCycleCpuUsage = TRUE;
+BOOLEAN PhEnableHistoryFile = FALSE;
+PPH_HISTORY_FILE PhHistoryFile = NULL;
+PH_QUEUED_LOCK PhHistoryFileLock = PH_QUEUED_LOCK_INIT;
 
 PVOID PhProcessInformation; // only can be used if running on same thread as process provider
 SYSTEM_PERFORMANCE_INFORMATION PhPerfInformation;
+PH_PROCESSOR_TOPOLOGY PhCpuTopology;
 PSYSTEM_PROCESSOR_PERFORMANCE_INFORMATION PhCpuInformation;
 SYSTEM_PROCESSOR_PERFORMANCE_INFORMATION PhCpuTotals;
+PSYSTEM_PROCESSOR_PERFORMANCE_INFORMATION PhCpuNodeTotals;
 ULONG PhTotalProcesses;
 ULONG PhTotalThreads;
 ULONG PhTotalHandles;
@@ -203,6 +208,8 @@ FLOAT PhCpuKernelUsage;
 FLOAT PhCpuUserUsage;
 PFLOAT PhCpusKernelUsage;
 PFLOAT PhCpusUserUsage;
+PFLOAT PhCpuNodesKernelUsage;
+PFLOAT PhCpuNodesUserUsage;
 
 PH_UINT64_DELTA PhCpuKernelDelta;
 PH_UINT64_DELTA PhCpuUserDelta;
@@ -212,6 +219,10 @@ PPH_UINT64_DELTA PhCpusKernelDelta;
 PPH_UINT64_DELTA PhCpusUserDelta;
 PPH_UINT64_DELTA PhCpusIdleDelta;
 
+PPH_UINT64_DELTA PhCpuNodesKernelDelta;
+PPH_UINT64_DELTA PhCpuNodesUserDelta;
+PPH_UINT64_DELTA PhCpuNodesIdleDelta;
+
 PH_UINT64_DELTA PhIoReadDelta;
 PH_UINT64_DELTA PhIoWriteDelta;
 PH_UINT64_DELTA PhIoOtherDelta;
@@ -228,6 +239,9 @@ PPH_CIRCULAR_BUFFER_FLOAT PhCpusKernelHistory;
 PPH_CIRCULAR_BUFFER_FLOAT PhCpusUserHistory;
 //PPH_CIRCULAR_BUFFER_FLOAT PhCpusOtherHistory;
 
+PPH_CIRCULAR_BUFFER_FLOAT PhCpuNodesKernelHistory;
+PPH_CIRCULAR_BUFFER_FLOAT PhCpuNodesUserHistory;
+
 PH_CIRCULAR_BUFFER_ULONG64 PhIoReadHistory;
 PH_CIRCULAR_BUFFER_ULONG64 PhIoWriteHistory;
 PH_CIRCULAR_BUFFER_ULONG64 PhIoOtherHistory;
@@ -281,48 +295,75 @@ BOOLEAN PhProcessProviderInitialization(
     PhInterruptsProcessInformation.UniqueProcessId = INTERRUPTS_PROCESS_ID;
     PhInterruptsProcessInformation.InheritedFromUniqueProcessId = SYSTEM_IDLE_PROCESS_ID;
 
+    // The basic information only counts the processors in our own processor group, so use the
+    // topology for everything that is stored per processor.
+    PhQueryProcessorTopology(&PhCpuTopology);
+
     PhCpuInformation = PhAllocate(
         sizeof(SYSTEM_PROCESSOR_PERFORMANCE_INFORMATION) *
-        (ULONG)PhSystemBasicInformation.NumberOfProcessors
+        PhCpuTopology.NumberOfProcessors
         );
 
     PhCpuIdleCycleTime = PhAllocate(
         sizeof(LARGE_INTEGER) *
-        (ULONG)PhSystemBasicInformation.NumberOfProcessors
+        PhCpuTopology.NumberOfProcessors
         );
     PhCpuSystemCycleTime = PhAllocate(
         sizeof(LARGE_INTEGER) *
-        (ULONG)PhSystemBasicInformation.NumberOfProcessors
+        PhCpuTopology.NumberOfProcessors
         );
 
     usageBuffer = PhAllocate(
         sizeof(FLOAT) *
-        (ULONG)PhSystemBasicInformation.NumberOfProcessors *
+        PhCpuTopology.NumberOfProcessors *
         2
         );
     deltaBuffer = PhAllocate(
         sizeof(PH_UINT64_DELTA) *
-        (ULONG)PhSystemBasicInformation.NumberOfProcessors *
+        PhCpuTopology.NumberOfProcessors *
         3 // 4 for PhCpusIdleCycleDelta
         );
     historyBuffer = PhAllocate(
         sizeof(PH_CIRCULAR_BUFFER_FLOAT) *
-        (ULONG)PhSystemBasicInformation.NumberOfProcessors *
+        PhCpuTopology.NumberOfProcessors *
         2
         );
 
     PhCpusKernelUsage = usageBuffer;
-    PhCpusUserUsage = PhCpusKernelUsage + (ULONG)PhSystemBasicInformation.NumberOfProcessors;
+    PhCpusUserUsage = PhCpusKernelUsage + PhCpuTopology.NumberOfProcessors;
 
     PhCpusKernelDelta = deltaBuffer;
-    PhCpusUserDelta = PhCpusKernelDelta + (ULONG)PhSystemBasicInformation.NumberOfProcessors;
-    PhCpusIdleDelta = PhCpusUserDelta + (ULONG)PhSystemBasicInformation.NumberOfProcessors;
-    //PhCpusIdleCycleDelta = PhCpusIdleDelta + (ULONG)PhSystemBasicInformation.NumberOfProcessors;
+    PhCpusUserDelta = PhCpusKernelDelta + PhCpuTopology.NumberOfProcessors;
+    PhCpusIdleDelta = PhCpusUserDelta + PhCpuTopology.NumberOfProcessors;
+    //PhCpusIdleCycleDelta = PhCpusIdleDelta + PhCpuTopology.NumberOfProcessors;
 
     PhCpusKernelHistory = historyBuffer;
-    PhCpusUserHistory = PhCpusKernelHistory + (ULONG)PhSystemBasicInformation.NumberOfProcessors;
+    PhCpusUserHistory = PhCpusKernelHistory + PhCpuTopology.NumberOfProcessors;
+
+    memset(deltaBuffer, 0, sizeof(PH_UINT64_DELTA) * PhCpuTopology.NumberOfProcessors);
+
+    // Totals for each NUMA node.
+
+    PhCpuNodeTotals = PhAllocate(
+        sizeof(SYSTEM_PROCESSOR_PERFORMANCE_INFORMATION) *
+        PhCpuTopology.NumberOfNodes
+        );
+
+    usageBuffer = PhAllocate(sizeof(FLOAT) * PhCpuTopology.NumberOfNodes * 2);
+    deltaBuffer = PhAllocate(sizeof(PH_UINT64_DELTA) * PhCpuTopology.NumberOfNodes * 3);
+    historyBuffer = PhAllocate(sizeof(PH_CIRCULAR_BUFFER_FLOAT) * PhCpuTopology.NumberOfNodes * 2);
+
+    PhCpuNodesKernelUsage = usageBuffer;
+    PhCpuNodesUserUsage = PhCpuNodesKernelUsage + PhCpuTopology.NumberOfNodes;
+
+    PhCpuNodesKernelDelta = deltaBuffer;
+    PhCpuNodesUserDelta = PhCpuNodesKernelDelta + PhCpuTopology.NumberOfNodes;
+    PhCpuNodesIdleDelta = PhCpuNodesUserDelta + PhCpuTopology.NumberOfNodes;
 
-    memset(deltaBuffer, 0, sizeof(PH_UINT64_DELTA) * (ULONG)PhSystemBasicInformation.NumberOfProcessors);
+    PhCpuNodesKernelHistory = historyBuffer;
+    PhCpuNodesUserHistory = PhCpuNodesKernelHistory + PhCpuTopology.NumberOfNodes;
+
+    memset(deltaBuffer, 0, sizeof(PH_UINT64_DELTA) * PhCpuTopology.NumberOfNodes * 3);
 
     return TRUE;
 }
@@ -449,13 +490,7 @@ PPH_PROCESS_ITEM PhCreateProcessItem(
         PhPrintUInt32(processItem->ProcessIdString, HandleToUlong(ProcessId));
 
     // Create the statistics buffers.
-    PhInitializeCircularBuffer_FLOAT(&processItem->CpuKernelHistory, PhStatisticsSampleCount);
-    PhInitializeCircularBuffer_FLOAT(&processItem->CpuUserHistory, PhStatisticsSampleCount);
-    PhInitializeCircularBuffer_ULONG64(&processItem->IoReadHistory, PhStatisticsSampleCount);
-    PhInitializeCircularBuffer_ULONG64(&processItem->IoWriteHistory, PhStatisticsSampleCount);
-    PhInitializeCircularBuffer_ULONG64(&processItem->IoOtherHistory, PhStatisticsSampleCount);
-    PhInitializeCircularBuffer_SIZE_T(&processItem->PrivateBytesHistory, PhStatisticsSampleCount);
-    //PhInitializeCircularBuffer_SIZE_T(&processItem->WorkingSetHistory, PhStatisticsSampleCount);
+    PhInitializeHistoryBuffer(&processItem->History, PH_PROCESS_HISTORY_COUNT, PhStatisticsSampleCount);
 
     PhEmCallObjectOperation(EmProcessItemType, processItem, EmObjectCreate);
 
@@ -472,13 +507,7 @@ VOID PhpProcessItemDeleteProcedure(
 
     PhEmCallObjectOperation(EmProcessItemType, processItem, EmObjectDelete);
 
-    PhDeleteCircularBuffer_FLOAT(&processItem->CpuKernelHistory);
-    PhDeleteCircularBuffer_FLOAT(&processItem->CpuUserHistory);
-    PhDeleteCircularBuffer_ULONG64(&processItem->IoReadHistory);
-    PhDeleteCircularBuffer_ULONG64(&processItem->IoWriteHistory);
-    PhDeleteCircularBuffer_ULONG64(&processItem->IoOtherHistory);
-    PhDeleteCircularBuffer_SIZE_T(&processItem->PrivateBytesHistory);
-    //PhDeleteCircularBuffer_SIZE_T(&processItem->WorkingSetHistory);
+    PhDeleteHistoryBuffer(&processItem->History);
 
     if (processItem->ServiceList)
     {
@@ -1520,31 +1549,20 @@ VOID PhpUpdateCpuInformation(
     ULONG i;
     ULONG64 totalTime;
 
-    NtQuerySystemInformation(
+    PhQueryProcessorInformation(
+        &PhCpuTopology,
         SystemProcessorPerformanceInformation,
-        PhCpuInformation,
-        sizeof(SYSTEM_PROCESSOR_PERFORMANCE_INFORMATION) * (ULONG)PhSystemBasicInformation.NumberOfProcessors,
-        NULL
+        sizeof(SYSTEM_PROCESSOR_PERFORMANCE_INFORMATION),
+        PhCpuInformation
         );
 
-    // Zero the CPU totals.
-    memset(&PhCpuTotals, 0, sizeof(SYSTEM_PROCESSOR_PERFORMANCE_INFORMATION));
+    PhSumProcessorPerformanceInformation(&PhCpuTopology, PhCpuInformation, &PhCpuTotals, PhCpuNodeTotals);
 
-    for (i = 0; i < (ULONG)PhSystemBasicInformation.NumberOfProcessors; i++)
+    for (i = 0; i < PhCpuTopology.NumberOfProcessors; i++)
     {
         PSYSTEM_PROCESSOR_PERFORMANCE_INFORMATION cpuInfo =
             &PhCpuInformation[i];
 
-        // KernelTime includes IdleTime.
-        cpuInfo->KernelTime.QuadPart -= cpuInfo->IdleTime.QuadPart;
-
-        PhCpuTotals.DpcTime.QuadPart += cpuInfo->DpcTime.QuadPart;
-        PhCpuTotals.IdleTime.QuadPart += cpuInfo->IdleTime.QuadPart;
-        PhCpuTotals.InterruptCount += cpuInfo->InterruptCount;
-        PhCpuTotals.InterruptTime.QuadPart += cpuInfo->InterruptTime.QuadPart;
-        PhCpuTotals.KernelTime.QuadPart += cpuInfo->KernelTime.QuadPart;
-        PhCpuTotals.UserTime.QuadPart += cpuInfo->UserTime.QuadPart;
-
         PhUpdateDelta(&PhCpusKernelDelta[i], cpuInfo->KernelTime.QuadPart);
         PhUpdateDelta(&PhCpusUserDelta[i], cpuInfo->UserTime.QuadPart);
         PhUpdateDelta(&PhCpusIdleDelta[i], cpuInfo->IdleTime.QuadPart);
@@ -1566,6 +1584,27 @@ VOID PhpUpdateCpuInformation(
         }
     }
 
+    // The node usage is always based on times, like the usage of each processor.
+    for (i = 0; i < PhCpuTopology.NumberOfNodes; i++)
+    {
+        PhUpdateDelta(&PhCpuNodesKernelDelta[i], PhCpuNodeTotals[i].KernelTime.QuadPart);
+        PhUpdateDelta(&PhCpuNodesUserDelta[i], PhCpuNodeTotals[i].UserTime.QuadPart);
+        PhUpdateDelta(&PhCpuNodesIdleDelta[i], PhCpuNodeTotals[i].IdleTime.QuadPart);
+
+        totalTime = PhCpuNodesKernelDelta[i].Delta + PhCpuNodesUserDelta[i].Delta + PhCpuNodesIdleDelta[i].Delta;
+
+        if (totalTime != 0)
+        {
+            PhCpuNodesKernelUsage[i] = (FLOAT)PhCpuNodesKernelDelta[i].Delta / totalTime;
+            PhCpuNodesUserUsage[i] = (FLOAT)PhCpuNodesUserDelta[i].Delta / totalTime;
+        }
+        else
+        {
+            PhCpuNodesKernelUsage[i] = 0;
+            PhCpuNodesUserUsage[i] = 0;
+        }
+    }
+
     PhUpdateDelta(&PhCpuKernelDelta, PhCpuTotals.KernelTime.QuadPart);
     PhUpdateDelta(&PhCpuUserDelta, PhCpuTotals.UserTime.QuadPart);
     PhUpdateDelta(&PhCpuIdleDelta, PhCpuTotals.IdleTime.QuadPart);
@@ -1601,16 +1640,16 @@ VOID PhpUpdateCpuCycleInformation(
     // We need to query this separately because the idle cycle time in SYSTEM_PROCESS_INFORMATION
     // doesn't give us data for individual processors.
 
-    NtQuerySystemInformation(
+    PhQueryProcessorInformation(
+        &PhCpuTopology,
         SystemProcessorIdleCycleTimeInformation,
-        PhCpuIdleCycleTime,
-        sizeof(LARGE_INTEGER) * (ULONG)PhSystemBasicInformation.NumberOfProcessors,
-        NULL
+        sizeof(LARGE_INTEGER),
+        PhCpuIdleCycleTime
         );
 
     total = 0;
 
-    for (i = 0; i < (ULONG)PhSystemBasicInformation.NumberOfProcessors; i++)
+    for (i = 0; i < PhCpuTopology.NumberOfProcessors; i++)
     {
         //PhUpdateDelta(&PhCpusIdleCycleDelta[i], PhCpuIdleCycleTime[i].QuadPart);
         total += PhCpuIdleCycleTime[i].QuadPart;
@@ -1621,16 +1660,16 @@ VOID PhpUpdateCpuCycleInformation(
 
     // System
 
-    NtQuerySystemInformation(
+    PhQueryProcessorInformation(
+        &PhCpuTopology,
         SystemProcessorCycleTimeInformation,
-        PhCpuSystemCycleTime,
-        sizeof(LARGE_INTEGER) * (ULONG)PhSystemBasicInformation.NumberOfProcessors,
-        NULL
+        sizeof(LARGE_INTEGER),
+        PhCpuSystemCycleTime
         );
 
     total = 0;
 
-    for (i = 0; i < (ULONG)PhSystemBasicInformation.NumberOfProcessors; i++)
+    for (i = 0; i < PhCpuTopology.NumberOfProcessors; i++)
     {
         total += PhCpuSystemCycleTime[i].QuadPart;
     }
@@ -1692,7 +1731,7 @@ VOID PhpUpdateCpuCycleUsageInformation(
         PhCpuUserUsage = baseCpuUsage / 2;
     }
 
-    for (i = 0; i < (ULONG)PhSystemBasicInformation.NumberOfProcessors; i++)
+    for (i = 0; i < PhCpuTopology.NumberOfProcessors; i++)
     {
         totalTime = PhCpusKernelDelta[i].Delta + PhCpusUserDelta[i].Delta + PhCpusIdleDelta[i].Delta;
 
@@ -1731,11 +1770,60 @@ VOID PhpInitializeProcessStatistics(
     PhInitializeCircularBuffer_ULONG64(&PhMaxIoWriteHistory, PhStatisticsSampleCount);
 #endif
 
-    for (i = 0; i < (ULONG)PhSystemBasicInformation.NumberOfProcessors; i++)
+    for (i = 0; i < PhCpuTopology.NumberOfProcessors; i++)
     {
         PhInitializeCircularBuffer_FLOAT(&PhCpusKernelHistory[i], PhStatisticsSampleCount);
         PhInitializeCircularBuffer_FLOAT(&PhCpusUserHistory[i], PhStatisticsSampleCount);
     }
+
+    for (i = 0; i < PhCpuTopology.NumberOfNodes; i++)
+    {
+        PhInitializeCircularBuffer_FLOAT(&PhCpuNodesKernelHistory[i], PhStatisticsSampleCount);
+        PhInitializeCircularBuffer_FLOAT(&PhCpuNodesUserHistory[i], PhStatisticsSampleCount);
+    }
+
+    if (PhEnableHistoryFile && PhSettingsFileName)
+    {
+        static PH_HISTORY_FILE_LEVEL levels[PH_HISTORY_FILE_NUMBER_OF_LEVELS] =
+        {
+            { 1, 6 * 60 * 60 }, // PH_HISTORY_FILE_LEVEL_SECOND: 6 hours
+            { 60, 7 * 24 * 60 }, // PH_HISTORY_FILE_LEVEL_MINUTE: 1 week
+            { 60 * 60, 365 * 24 } // PH_HISTORY_FILE_LEVEL_HOUR: 1 year
+        };
+        ULONG_PTR indexOfBackslash;
+        PH_STRINGREF directory;
+        PH_STRINGREF fileName;
+        PPH_STRING historyFileName;
+
+        // Keep the history file next to the settings file.
+
+        indexOfBackslash = PhFindLastCharInString(PhSettingsFileName, 0, '\\');
+
+        if (indexOfBackslash != -1)
+        {
+            directory.Buffer = PhSettingsFileName->Buffer;
+            directory.Length = (indexOfBackslash + 1) * sizeof(WCHAR);
+            PhInitializeStringRef(&fileName, L"history.db");
+            historyFileName = PhConcatStringRef2(&directory, &fileName);
+
+            PhAcquireQueuedLockExclusive(&PhHistoryFileLock);
+
+            if (!NT_SUCCESS(PhCreateHistoryFile(
+                &PhHistoryFile,
+                historyFileName->Buffer,
+                PH_HISTORY_FILE_NUMBER_OF_SERIES,
+                RTL_NUMBER_OF(levels),
+                levels
+                )))
+            {
+                PhHistoryFile = NULL;
+            }
+
+            PhReleaseQueuedLockExclusive(&PhHistoryFileLock);
+
+            PhDereferenceObject(historyFileName);
+        }
+    }
 }
 
 VOID PhpUpdateSystemHistory(
@@ -1751,12 +1839,19 @@ VOID PhpUpdateSystemHistory(
     PhAddItemCircularBuffer_FLOAT(&PhCpuUserHistory, PhCpuUserUsage);
 
     // CPUs
-    for (i = 0; i < (ULONG)PhSystemBasicInformation.NumberOfProcessors; i++)
+    for (i = 0; i < PhCpuTopology.NumberOfProcessors; i++)
     {
         PhAddItemCircularBuffer_FLOAT(&PhCpusKernelHistory[i], PhCpusKernelUsage[i]);
         PhAddItemCircularBuffer_FLOAT(&PhCpusUserHistory[i], PhCpusUserUsage[i]);
     }
 
+    // NUMA nodes
+    for (i = 0; i < PhCpuTopology.NumberOfNodes; i++)
+    {
+        PhAddItemCircularBuffer_FLOAT(&PhCpuNodesKernelHistory[i], PhCpuNodesKernelUsage[i]);
+        PhAddItemCircularBuffer_FLOAT(&PhCpuNodesUserHistory[i], PhCpuNodesUserUsage[i]);
+    }
+
     // I/O
     PhAddItemCircularBuffer_ULONG64(&PhIoReadHistory, PhIoReadDelta.Delta);
     PhAddItemCircularBuffer_ULONG64(&PhIoWriteHistory, PhIoWriteDelta.Delta);
@@ -1772,6 +1867,26 @@ VOID PhpUpdateSystemHistory(
     PhQuerySystemTime(&systemTime);
     RtlTimeToSecondsSince1980(&systemTime, &secondsSince1980);
     PhAddItemCircularBuffer_ULONG(&PhTimeHistory, secondsSince1980);
+
+    // The lock only prevents the file from being closed; the history file has its own lock.
+    PhAcquireQueuedLockShared(&PhHistoryFileLock);
+
+    if (PhHistoryFile)
+    {
+        FLOAT values[PH_HISTORY_FILE_NUMBER_OF_SERIES];
+
+        values[PH_HISTORY_FILE_CPU_KERNEL] = PhCpuKernelUsage;
+        values[PH_HISTORY_FILE_CPU_USER] = PhCpuUserUsage;
+        values[PH_HISTORY_FILE_IO_READ] = (FLOAT)PhIoReadDelta.Delta;
+        values[PH_HISTORY_FILE_IO_WRITE] = (FLOAT)PhIoWriteDelta.Delta;
+        values[PH_HISTORY_FILE_IO_OTHER] = (FLOAT)PhIoOtherDelta.Delta;
+        values[PH_HISTORY_FILE_COMMIT] = (FLOAT)PhPerfInformation.CommittedPages;
+        values[PH_HISTORY_FILE_PHYSICAL] = (FLOAT)(PhSystemBasicInformation.NumberOfPhysicalPages - PhPerfInformation.AvailablePages);
+
+        PhAddSampleHistoryFile(PhHistoryFile, secondsSince1980, values);
+    }
+
+    PhReleaseQueuedLockShared(&PhHistoryFileLock);
 }
 
 /**
@@ -1841,6 +1956,112 @@ PPH_STRING PhGetStatisticsTimeString(
     }
 }
 
+/**
+ * Gets the number of rows in a level of the system history file.
+ *
+ * \param Level One of the PH_HISTORY_FILE_LEVEL_* values.
+ *
+ * \return The number of rows, or 0 if the history file is not open.
+ */
+ULONG PhGetCountSystemHistoryFile(
+    _In_ ULONG Level
+    )
+{
+    ULONG count = 0;
+
+    PhAcquireQueuedLockShared(&PhHistoryFileLock);
+
+    if (PhHistoryFile)
+        count = PhGetCountHistoryFile(PhHistoryFile, Level);
+
+    PhReleaseQueuedLockShared(&PhHistoryFileLock);
+
+    return count;
+}
+
+/**
+ * Copies the average values of a series from the system history file.
+ *
+ * \param Level One of the PH_HISTORY_FILE_LEVEL_* values.
+ * \param Series One of the PH_HISTORY_FILE_* series.
+ * \param Buffer A buffer which receives the values, starting with the most recent row.
+ * \param Count The number of elements in \a Buffer.
+ *
+ * \return The number of values copied.
+ */
+ULONG PhCopySystemHistoryFile(
+    _In_ ULONG Level,
+    _In_ ULONG Series,
+    _Out_writes_to_(Count, return) PFLOAT Buffer,
+    _In_ ULONG Count
+    )
+{
+    ULONG copied = 0;
+
+    PhAcquireQueuedLockShared(&PhHistoryFileLock);
+
+    if (PhHistoryFile)
+        copied = PhCopyHistoryFile(PhHistoryFile, Level, Series, FALSE, Buffer, Count);
+
+    PhReleaseQueuedLockShared(&PhHistoryFileLock);
+
+    return copied;
+}
+
+/**
+ * Retrieves a row from the system history file.
+ *
+ * \param Level One of the PH_HISTORY_FILE_LEVEL_* values.
+ * \param Index The index of the row, where 0 is the most recent row.
+ * \param Series One of the PH_HISTORY_FILE_* series.
+ * \param Time A variable which receives the time of the row. For levels other than
+ * PH_HISTORY_FILE_LEVEL_SECOND, this is the start of the period covered by the row.
+ * \param Average A variable which receives the average value of the series.
+ * \param Maximum A variable which receives the maximum value of the series.
+ */
+BOOLEAN PhGetSampleSystemHistoryFile(
+    _In_ ULONG Level,
+    _In_ ULONG Index,
+    _In_ ULONG Series,
+    _Out_opt_ PLARGE_INTEGER Time,
+    _Out_opt_ PFLOAT Average,
+    _Out_opt_ PFLOAT Maximum
+    )
+{
+    BOOLEAN result = FALSE;
+    ULONG secondsSince1980;
+
+    PhAcquireQueuedLockShared(&PhHistoryFileLock);
+
+    if (PhHistoryFile)
+        result = PhGetSampleHistoryFile(PhHistoryFile, Level, Index, Series, &secondsSince1980, Average, Maximum);
+
+    PhReleaseQueuedLockShared(&PhHistoryFileLock);
+
+    if (result && Time)
+        RtlSecondsSince1980ToTime(secondsSince1980, Time);
+
+    return result;
+}
+
+/**
+ * Closes the system history file. Nothing is recorded after this function returns.
+ */
+VOID PhCloseSystemHistoryFile(
+    VOID
+    )
+{
+    PhAcquireQueuedLockExclusive(&PhHistoryFileLock);
+
+    if (PhHistoryFile)
+    {
+        PhDestroyHistoryFile(PhHistoryFile);
+        PhHistoryFile = NULL;
+    }
+
+    PhReleaseQueuedLockExclusive(&PhHistoryFileLock);
+}
+
 VOID PhFlushProcessQueryData(
     _In_ BOOLEAN SendModifiedEvent
     )
@@ -2296,6 +2517,7 @@ VOID PhProcessProviderUpdate(
             FLOAT newCpuUsage;
             FLOAT kernelCpuUsage;
             FLOAT userCpuUsage;
+            FLOAT samples[PH_PROCESS_HISTORY_COUNT];
 
             PhpGetProcessThreadInformation(process, &isSuspended, &isPartiallySuspended, &contextSwitches);
             PhpUpdateDynamicInfoProcessItem(processItem, process);
@@ -2315,12 +2537,6 @@ VOID PhProcessProviderUpdate(
             PhUpdateDelta(&processItem->PrivateBytesDelta, process->PagefileUsage);
 
             processItem->SequenceNumber++;
-            PhAddItemCircularBuffer_ULONG64(&processItem->IoReadHistory, processItem->IoReadDelta.Delta);
-            PhAddItemCircularBuffer_ULONG64(&processItem->IoWriteHistory, processItem->IoWriteDelta.Delta);
-            PhAddItemCircularBuffer_ULONG64(&processItem->IoOtherHistory, processItem->IoOtherDelta.Delta);
-
-            PhAddItemCircularBuffer_SIZE_T(&processItem->PrivateBytesHistory, processItem->VmCounters.PagefileUsage);
-            //PhAddItemCircularBuffer_SIZE_T(&processItem->WorkingSetHistory, processItem->VmCounters.WorkingSetSize);
 
             if (InterlockedExchange(&processItem->JustProcessed, 0) != 0)
                 modified = TRUE;
@@ -2368,8 +2584,13 @@ VOID PhProcessProviderUpdate(
             processItem->CpuKernelUsage = kernelCpuUsage;
             processItem->CpuUserUsage = userCpuUsage;
 
-            PhAddItemCircularBuffer_FLOAT(&processItem->CpuKernelHistory, kernelCpuUsage);
-            PhAddItemCircularBuffer_FLOAT(&processItem->CpuUserHistory, userCpuUsage);
+            samples[PH_PROCESS_HISTORY_CPU_KERNEL] = kernelCpuUsage;
+            samples[PH_PROCESS_HISTORY_CPU_USER] = userCpuUsage;
+            samples[PH_PROCESS_HISTORY_IO_READ] = (FLOAT)processItem->IoReadDelta.Delta;
+            samples[PH_PROCESS_HISTORY_IO_WRITE] = (FLOAT)processItem->IoWriteDelta.Delta;
+            samples[PH_PROCESS_HISTORY_IO_OTHER] = (FLOAT)processItem->IoOtherDelta.Delta;
+            samples[PH_PROCESS_HISTORY_PRIVATE_BYTES] = (FLOAT)processItem->VmCounters.PagefileUsage;
+            PhAddSamplesHistoryBuffer(&processItem->History, samples);
 
             // Max. values
 
@@ -68,6 +68,10 @@ VOID PhpUpdateProcessNodeCycles(
     _Inout_ PPH_PROCESS_NODE ProcessNode
     );
 
+BOOLEAN PhpResortProcessNodeList(
+    VOID
+    );
+
 LONG PhpProcessTreeNewPostSortFunction(
     _In_ LONG Result,
     _In_ PVOID Node1,
@@ -434,7 +438,12 @@ PPH_PROCESS_NODE PhAddProcessNode(
 
     PhEmCallObjectOperation(EmProcessNodeType, processNode, EmObjectCreate);
 
-    TreeNew_NodesStructured(ProcessTreeListHandle);
+    // A new leaf under an existing parent only changes the rows of that parent, so the rest of the
+    // list doesn't need to be rebuilt.
+    if (ProcessTreeListSortOrder == NoSortOrder && processNode->Parent && processNode->Children->Count == 0)
+        TreeNew_NodeChildrenStructured(ProcessTreeListHandle, &processNode->Parent->Node);
+    else
+        TreeNew_NodesStructured(ProcessTreeListHandle);
 
     return processNode;
 }
@@ -495,15 +504,26 @@ VOID PhpRemoveProcessNode(
 {
     ULONG index;
     ULONG i;
+    BOOLEAN structured;
 
     PhEmCallObjectOperation(EmProcessNodeType, ProcessNode, EmObjectDelete);
 
+    structured = FALSE;
+
     if (ProcessNode->Parent)
     {
         // Remove the node from its parent.
 
         if ((index = PhFindItemList(ProcessNode->Parent->Children, ProcessNode)) != -1)
             PhRemoveItemList(ProcessNode->Parent->Children, index);
+
+        // If the node has no children, only the rows of its parent are affected. This must be done
+        // while the node is still valid because the tree list reads it when removing its row.
+        if (ProcessTreeListSortOrder == NoSortOrder && ProcessNode->Children->Count == 0)
+        {
+            TreeNew_NodeChildrenStructured(ProcessTreeListHandle, &ProcessNode->Parent->Node);
+            structured = TRUE;
+        }
     }
     else
     {
@@ -581,7 +601,8 @@ VOID PhpRemoveProcessNode(
 
     PhFree(ProcessNode);
 
-    TreeNew_NodesStructured(ProcessTreeListHandle);
+    if (!structured)
+        TreeNew_NodesStructured(ProcessTreeListHandle);
 }
 
 VOID PhUpdateProcessNode(
@@ -631,9 +652,9 @@ VOID PhTickProcessNodes(
 
     fullyInvalidated = FALSE;
 
-    if (ProcessTreeListSortOrder != NoSortOrder)
+    if (ProcessTreeListSortOrder != NoSortOrder && PhpResortProcessNodeList())
     {
-        // Force a rebuild to sort the items.
+        // The order of the items has changed, so force a rebuild.
         TreeNew_NodesStructured(ProcessTreeListHandle);
         fullyInvalidated = TRUE;
     }
@@ -1235,19 +1256,19 @@ static VOID PhpUpdateProcessNodeCycles(
         // System Idle Process requires special treatment.
 
         idleThreadCycleTimes = PhAllocate(
-            sizeof(ULARGE_INTEGER) * (ULONG)PhSystemBasicInformation.NumberOfProcessors
+            sizeof(ULARGE_INTEGER) * PhCpuTopology.NumberOfProcessors
             );
 
-        if (NT_SUCCESS(NtQuerySystemInformation(
+        if (NT_SUCCESS(PhQueryProcessorInformation(
+            &PhCpuTopology,
             SystemProcessorIdleCycleTimeInformation,
-            idleThreadCycleTimes,
-            sizeof(ULARGE_INTEGER) * (ULONG)PhSystemBasicInformation.NumberOfProcessors,
-            NULL
+            sizeof(ULARGE_INTEGER),
+            idleThreadCycleTimes
             )))
         {
             cycleTime = 0;
 
-            for (i = 0; i < (ULONG)PhSystemBasicInformation.NumberOfProcessors; i++)
+            for (i = 0; i < PhCpuTopology.NumberOfProcessors; i++)
                 cycleTime += idleThreadCycleTimes[i].QuadPart;
 
             PhUpdateDelta(&ProcessNode->CyclesDelta, cycleTime);
@@ -1900,6 +1921,157 @@ BEGIN_SORT_FUNCTION(FileSize)
 }
 END_SORT_FUNCTION
 
+VOID PhpSortProcessNodeList(
+    VOID
+    )
+{
+    static PVOID sortFunctions[] =
+    {
+        SORT_FUNCTION(Name),
+        SORT_FUNCTION(Pid),
+        SORT_FUNCTION(Cpu),
+        SORT_FUNCTION(IoTotalRate),
+        SORT_FUNCTION(PrivateBytes),
+        SORT_FUNCTION(UserName),
+        SORT_FUNCTION(Description),
+        SORT_FUNCTION(CompanyName),
+        SORT_FUNCTION(Version),
+        SORT_FUNCTION(FileName),
+        SORT_FUNCTION(CommandLine),
+        SORT_FUNCTION(PeakPrivateBytes),
+        SORT_FUNCTION(WorkingSet),
+        SORT_FUNCTION(PeakWorkingSet),
+        SORT_FUNCTION(PrivateWs),
+        SORT_FUNCTION(SharedWs),
+        SORT_FUNCTION(ShareableWs),
+        SORT_FUNCTION(VirtualSize),
+        SORT_FUNCTION(PeakVirtualSize),
+        SORT_FUNCTION(PageFaults),
+        SORT_FUNCTION(SessionId),
+        SORT_FUNCTION(BasePriority), // Priority Class
+        SORT_FUNCTION(BasePriority),
+        SORT_FUNCTION(Threads),
+        SORT_FUNCTION(Handles),
+        SORT_FUNCTION(GdiHandles),
+        SORT_FUNCTION(UserHandles),
+        SORT_FUNCTION(IoRoRate),
+        SORT_FUNCTION(IoWRate),
+        SORT_FUNCTION(Integrity),
+        SORT_FUNCTION(IoPriority),
+        SORT_FUNCTION(PagePriority),
+        SORT_FUNCTION(StartTime),
+        SORT_FUNCTION(TotalCpuTime),
+        SORT_FUNCTION(KernelCpuTime),
+        SORT_FUNCTION(UserCpuTime),
+        SORT_FUNCTION(VerificationStatus),
+        SORT_FUNCTION(VerifiedSigner),
+        SORT_FUNCTION(Aslr),
+        SORT_FUNCTION(RelativeStartTime),
+        SORT_FUNCTION(Bits),
+        SORT_FUNCTION(Elevation),
+        SORT_FUNCTION(WindowTitle),
+        SORT_FUNCTION(WindowStatus),
+        SORT_FUNCTION(Cycles),
+        SORT_FUNCTION(CyclesDelta),
+        SORT_FUNCTION(Cpu), // CPU History
+        SORT_FUNCTION(PrivateBytes), // Private Bytes History
+        SORT_FUNCTION(IoTotalRate), // I/O History
+        SORT_FUNCTION(Dep),
+        SORT_FUNCTION(Virtualized),
+        SORT_FUNCTION(ContextSwitches),
+        SORT_FUNCTION(ContextSwitchesDelta),
+        SORT_FUNCTION(PageFaultsDelta),
+        SORT_FUNCTION(IoReads),
+        SORT_FUNCTION(IoWrites),
+        SORT_FUNCTION(IoOther),
+        SORT_FUNCTION(IoReadBytes),
+        SORT_FUNCTION(IoWriteBytes),
+        SORT_FUNCTION(IoOtherBytes),
+        SORT_FUNCTION(IoReadsDelta),
+        SORT_FUNCTION(IoWritesDelta),
+        SORT_FUNCTION(IoOtherDelta),
+        SORT_FUNCTION(OsContext),
+        SORT_FUNCTION(PagedPool),
+        SORT_FUNCTION(PeakPagedPool),
+        SORT_FUNCTION(NonPagedPool),
+        SORT_FUNCTION(PeakNonPagedPool),
+        SORT_FUNCTION(MinimumWorkingSet),
+        SORT_FUNCTION(MaximumWorkingSet),
+        SORT_FUNCTION(PrivateBytesDelta),
+        SORT_FUNCTION(Subsystem),
+        SORT_FUNCTION(PackageName),
+        SORT_FUNCTION(AppId),
+        SORT_FUNCTION(DpiAwareness),
+        SORT_FUNCTION(CfGuard),
+        SORT_FUNCTION(TimeStamp),
+        SORT_FUNCTION(FileModifiedTime),
+        SORT_FUNCTION(FileSize)
+    };
+    static PH_INITONCE initOnce = PH_INITONCE_INIT;
+    int (__cdecl *sortFunction)(const void *, const void *);
+
+    if (PhBeginInitOnce(&initOnce))
+    {
+        if (WindowsVersion >= WINDOWS_7)
+        {
+            sortFunctions[PHPRTLC_PRIVATEWS] = SORT_FUNCTION(PrivateWsWin7);
+            sortFunctions[PHPRTLC_CYCLES] = SORT_FUNCTION(CyclesWin7);
+            sortFunctions[PHPRTLC_CYCLESDELTA] = SORT_FUNCTION(CyclesDeltaWin7);
+        }
+
+        PhEndInitOnce(&initOnce);
+    }
+
+    if (!PhCmForwardSort(
+        (PPH_TREENEW_NODE *)ProcessNodeList->Items,
+        ProcessNodeList->Count,
+        ProcessTreeListSortColumn,
+        ProcessTreeListSortOrder,
+        &ProcessTreeListCm
+        ))
+    {
+        if (ProcessTreeListSortColumn < PHPRTLC_MAXIMUM)
+            sortFunction = sortFunctions[ProcessTreeListSortColumn];
+        else
+            sortFunction = NULL;
+
+        if (sortFunction)
+        {
+            qsort(ProcessNodeList->Items, ProcessNodeList->Count, sizeof(PVOID), sortFunction);
+        }
+    }
+}
+
+/**
+ * Sorts the list of process nodes and determines whether the order of the nodes has changed.
+ *
+ * \return TRUE if the nodes were reordered, otherwise FALSE.
+ */
+BOOLEAN PhpResortProcessNodeList(
+    VOID
+    )
+{
+    static PVOID *previousItems = NULL;
+    static ULONG previousAllocatedCount = 0;
+
+    if (ProcessNodeList->Count == 0)
+        return FALSE;
+
+    if (previousAllocatedCount < ProcessNodeList->Count)
+    {
+        if (previousItems)
+            PhFree(previousItems);
+
+        previousAllocatedCount = ProcessNodeList->AllocatedCount;
+        previousItems = PhAllocate(previousAllocatedCount * sizeof(PVOID));
+    }
+
+    memcpy(previousItems, ProcessNodeList->Items, ProcessNodeList->Count * sizeof(PVOID));
+    PhpSortProcessNodeList();
+
+    return memcmp(previousItems, ProcessNodeList->Items, ProcessNodeList->Count * sizeof(PVOID)) != 0;
+}
+
 BOOLEAN NTAPI PhpProcessTreeNewCallback(
     _In_ HWND hwnd,
     _In_ PH_TREENEW_MESSAGE Message,
@@ -1938,121 +2110,7 @@ BOOLEAN NTAPI PhpProcessTreeNewCallback(
             {
                 if (!node)
                 {
-                    static PVOID sortFunctions[] =
-                    {
-                        SORT_FUNCTION(Name),
-                        SORT_FUNCTION(Pid),
-                        SORT_FUNCTION(Cpu),
-                        SORT_FUNCTION(IoTotalRate),
-                        SORT_FUNCTION(PrivateBytes),
-                        SORT_FUNCTION(UserName),
-                        SORT_FUNCTION(Description),
-                        SORT_FUNCTION(CompanyName),
-                        SORT_FUNCTION(Version),
-                        SORT_FUNCTION(FileName),
-                        SORT_FUNCTION(CommandLine),
-                        SORT_FUNCTION(PeakPrivateBytes),
-                        SORT_FUNCTION(WorkingSet),
-                        SORT_FUNCTION(PeakWorkingSet),
-                        SORT_FUNCTION(PrivateWs),
-                        SORT_FUNCTION(SharedWs),
-                        SORT_FUNCTION(ShareableWs),
-                        SORT_FUNCTION(VirtualSize),
-                        SORT_FUNCTION(PeakVirtualSize),
-                        SORT_FUNCTION(PageFaults),
-                        SORT_FUNCTION(SessionId),
-                        SORT_FUNCTION(BasePriority), // Priority Class
-                        SORT_FUNCTION(BasePriority),
-                        SORT_FUNCTION(Threads),
-                        SORT_FUNCTION(Handles),
-                        SORT_FUNCTION(GdiHandles),
-                        SORT_FUNCTION(UserHandles),
-                        SORT_FUNCTION(IoRoRate),
-                        SORT_FUNCTION(IoWRate),
-                        SORT_FUNCTION(Integrity),
-                        SORT_FUNCTION(IoPriority),
-                        SORT_FUNCTION(PagePriority),
-                        SORT_FUNCTION(StartTime),
-                        SORT_FUNCTION(TotalCpuTime),
-                        SORT_FUNCTION(KernelCpuTime),
-                        SORT_FUNCTION(UserCpuTime),
-                        SORT_FUNCTION(VerificationStatus),
-                        SORT_FUNCTION(VerifiedSigner),
-                        SORT_FUNCTION(Aslr),
-                        SORT_FUNCTION(RelativeStartTime),
-                        SORT_FUNCTION(Bits),
-                        SORT_FUNCTION(Elevation),
-                        SORT_FUNCTION(WindowTitle),
-                        SORT_FUNCTION(WindowStatus),
-                        SORT_FUNCTION(Cycles),
-                        SORT_FUNCTION(CyclesDelta),
-                        SORT_FUNCTION(Cpu), // CPU History
-                        SORT_FUNCTION(PrivateBytes), // Private Bytes History
-                        SORT_FUNCTION(IoTotalRate), // I/O History
-                        SORT_FUNCTION(Dep),
-                        SORT_FUNCTION(Virtualized),
-                        SORT_FUNCTION(ContextSwitches),
-                        SORT_FUNCTION(ContextSwitchesDelta),
-                        SORT_FUNCTION(PageFaultsDelta),
-                        SORT_FUNCTION(IoReads),
-                        SORT_FUNCTION(IoWrites),
-                        SORT_FUNCTION(IoOther),
-                        SORT_FUNCTION(IoReadBytes),
-                        SORT_FUNCTION(IoWriteBytes),
-                        SORT_FUNCTION(IoOtherBytes),
-                        SORT_FUNCTION(IoReadsDelta),
-                        SORT_FUNCTION(IoWritesDelta),
-                        SORT_FUNCTION(IoOtherDelta),
-                        SORT_FUNCTION(OsContext),
-                        SORT_FUNCTION(PagedPool),
-                        SORT_FUNCTION(PeakPagedPool),
-                        SORT_FUNCTION(NonPagedPool),
-                        SORT_FUNCTION(PeakNonPagedPool),
-                        SORT_FUNCTION(MinimumWorkingSet),
-                        SORT_FUNCTION(MaximumWorkingSet),
-                        SORT_FUNCTION(PrivateBytesDelta),
-                        SORT_FUNCTION(Subsystem),
-                        SORT_FUNCTION(PackageName),
-                        SORT_FUNCTION(AppId),
-                        SORT_FUNCTION(DpiAwareness),
-                        SORT_FUNCTION(CfGuard),
-                        SORT_FUNCTION(TimeStamp),
-                        SORT_FUNCTION(FileModifiedTime),
-                        SORT_FUNCTION(FileSize)
-                    };
-                    static PH_INITONCE initOnce = PH_INITONCE_INIT;
-                    int (__cdecl *sortFunction)(const void *, const void *);
-
-                    if (PhBeginInitOnce(&initOnce))
-                    {
-                        if (WindowsVersion >= WINDOWS_7)
-                        {
-                            sortFunctions[PHPRTLC_PRIVATEWS] = SORT_FUNCTION(PrivateWsWin7);
-                            sortFunctions[PHPRTLC_CYCLES] = SORT_FUNCTION(CyclesWin7);
-                            sortFunctions[PHPRTLC_CYCLESDELTA] = SORT_FUNCTION(CyclesDeltaWin7);
-                        }
-
-                        PhEndInitOnce(&initOnce);
-                    }
-
-                    if (!PhCmForwardSort(
-                        (PPH_TREENEW_NODE *)ProcessNodeList->Items,
-                        ProcessNodeList->Count,
-                        ProcessTreeListSortColumn,
-                        ProcessTreeListSortOrder,
-                        &ProcessTreeListCm
-                        ))
-                    {
-                        if (ProcessTreeListSortColumn < PHPRTLC_MAXIMUM)
-                            sortFunction = sortFunctions[ProcessTreeListSortColumn];
-                        else
-                            sortFunction = NULL;
-
-                        if (sortFunction)
-                        {
-                            qsort(ProcessNodeList->Items, ProcessNodeList->Count, sizeof(PVOID), sortFunction);
-                        }
-                    }
+                    PhpSortProcessNodeList();
 
                     getChildren->Children = (PPH_TREENEW_NODE *)ProcessNodeList->Items;
                     getChildren->NumberOfChildren = ProcessNodeList->Count;
@@ -2923,14 +2981,14 @@ BOOLEAN NTAPI PhpProcessTreeNewCallback(
                     PhGetDrawInfoGraphBuffers(
                         &node->CpuGraphBuffers,
                         &drawInfo,
-                        processItem->CpuKernelHistory.Count
+                        processItem->History.Count
                         );
 
                     if (!node->CpuGraphBuffers.Valid)
                     {
-                        PhCopyCircularBuffer_FLOAT(&processItem->CpuKernelHistory,
+                        PhCopyHistoryBuffer(&processItem->History, PH_PROCESS_HISTORY_CPU_KERNEL,
                             node->CpuGraphBuffers.Data1, drawInfo.LineDataCount);
-                        PhCopyCircularBuffer_FLOAT(&processItem->CpuUserHistory,
+                        PhCopyHistoryBuffer(&processItem->History, PH_PROCESS_HISTORY_CPU_USER,
                             node->CpuGraphBuffers.Data2, drawInfo.LineDataCount);
                         node->CpuGraphBuffers.Valid = TRUE;
                     }
@@ -2945,20 +3003,16 @@ BOOLEAN NTAPI PhpProcessTreeNewCallback(
                     PhGetDrawInfoGraphBuffers(
                         &node->PrivateGraphBuffers,
                         &drawInfo,
-                        processItem->PrivateBytesHistory.Count
+                        processItem->History.Count
                         );
 
                     if (!node->PrivateGraphBuffers.Valid)
                     {
-                        ULONG i;
                         FLOAT total;
                         FLOAT max;
 
-                        for (i = 0; i < drawInfo.LineDataCount; i++)
-                        {
-                            node->PrivateGraphBuffers.Data1[i] =
-                                (FLOAT)PhGetItemCircularBuffer_SIZE_T(&processItem->PrivateBytesHistory, i);
-                        }
+                        PhCopyHistoryBuffer(&processItem->History, PH_PROCESS_HISTORY_PRIVATE_BYTES,
+                            node->PrivateGraphBuffers.Data1, drawInfo.LineDataCount);
 
                         // This makes it easier for the user to see what processes are hogging memory.
                         // Scaling is still *not* consistent across all graphs.
@@ -2993,29 +3047,25 @@ BOOLEAN NTAPI PhpProcessTreeNewCallback(
                     PhGetDrawInfoGraphBuffers(
                         &node->IoGraphBuffers,
                         &drawInfo,
-                        processItem->IoReadHistory.Count
+                        processItem->History.Count
                         );
 
                     if (!node->IoGraphBuffers.Valid)
                     {
-                        ULONG i;
                         FLOAT total;
-                        FLOAT max = 0;
-
-                        for (i = 0; i < drawInfo.LineDataCount; i++)
-                        {
-                            FLOAT data1;
-                            FLOAT data2;
+                        FLOAT max;
 
-                            node->IoGraphBuffers.Data1[i] = data1 =
-                                (FLOAT)PhGetItemCircularBuffer_ULONG64(&processItem->IoReadHistory, i) +
-                                (FLOAT)PhGetItemCircularBuffer_ULONG64(&processItem->IoOtherHistory, i);
-                            node->IoGraphBuffers.Data2[i] = data2 =
-                                (FLOAT)PhGetItemCircularBuffer_ULONG64(&processItem->IoWriteHistory, i);
+                        // Data1 is read + other. Data2 is used as scratch space for the other series
+                        // before it receives the write series.
+                        PhCopyHistoryBuffer(&processItem->History, PH_PROCESS_HISTORY_IO_READ,
+                            node->IoGraphBuffers.Data1, drawInfo.LineDataCount);
+                        PhCopyHistoryBuffer(&processItem->History, PH_PROCESS_HISTORY_IO_OTHER,
+                            node->IoGraphBuffers.Data2, drawInfo.LineDataCount);
+                        PhAddSingles(node->IoGraphBuffers.Data1, node->IoGraphBuffers.Data2, drawInfo.LineDataCount);
+                        PhCopyHistoryBuffer(&processItem->History, PH_PROCESS_HISTORY_IO_WRITE,
+                            node->IoGraphBuffers.Data2, drawInfo.LineDataCount);
 
-                            if (max < data1 + data2)
-                                max = data1 + data2;
-                        }
+                        max = PhMaximumSumSingles(node->IoGraphBuffers.Data1, node->IoGraphBuffers.Data2, drawInfo.LineDataCount);
 
                         // Make the scaling a bit more consistent across the processes.
                         // It does *not* scale all graphs using the same maximum.
@@ -3332,126 +3382,125 @@ VOID PhSelectAndEnsureVisibleProcessNodes(
     TreeNew_InvalidateNode(ProcessTreeListHandle, &leader->Node);
 }
 
-VOID PhpPopulateTableWithProcessNodes(
-    _In_ HWND TreeListHandle,
+typedef struct _PH_PROCESS_TREE_WRITE_CONTEXT
+{
+    HWND TreeListHandle;
+    PPH_TEXT_TABLE_WRITER Writer;
+    PULONG DisplayToId;
+    ULONG Columns;
+    BOOLEAN Measure;
+    PH_STRING_BUILDER IndentedText;
+} PH_PROCESS_TREE_WRITE_CONTEXT, *PPH_PROCESS_TREE_WRITE_CONTEXT;
+
+NTSTATUS PhpWriteProcessNodes(
+    _Inout_ PPH_PROCESS_TREE_WRITE_CONTEXT Context,
     _In_ PPH_PROCESS_NODE Node,
-    _In_ ULONG Level,
-    _In_ PPH_STRING **Table,
-    _Inout_ PULONG Index,
-    _In_ PULONG DisplayToId,
-    _In_ ULONG Columns
+    _In_ ULONG Level
     )
 {
+    NTSTATUS status = STATUS_SUCCESS;
     ULONG i;
 
-    for (i = 0; i < Columns; i++)
+    for (i = 0; i < Context->Columns && NT_SUCCESS(status); i++)
     {
         PH_TREENEW_GET_CELL_TEXT getCellText;
-        PPH_STRING text;
+        PPH_STRINGREF text;
 
         getCellText.Node = &Node->Node;
-        getCellText.Id = DisplayToId[i];
+        getCellText.Id = Context->DisplayToId[i];
         PhInitializeEmptyStringRef(&getCellText.Text);
-        TreeNew_GetCellText(TreeListHandle, &getCellText);
+        TreeNew_GetCellText(Context->TreeListHandle, &getCellText);
 
         if (i != 0)
         {
-            text = PhaCreateStringEx(getCellText.Text.Buffer, getCellText.Text.Length);
+            text = &getCellText.Text;
         }
         else
         {
             // If this is the first column in the row, add some indentation.
-            text = PhaCreateStringEx(
-                NULL,
-                getCellText.Text.Length + Level * 2 * sizeof(WCHAR)
-                );
-            wmemset(text->Buffer, ' ', Level * 2);
-            memcpy(&text->Buffer[Level * 2], getCellText.Text.Buffer, getCellText.Text.Length);
+            PhRemoveEndStringBuilder(&Context->IndentedText, Context->IndentedText.String->Length / sizeof(WCHAR));
+            PhAppendCharStringBuilder2(&Context->IndentedText, ' ', Level * 2);
+            PhAppendStringBuilder(&Context->IndentedText, &getCellText.Text);
+            text = &Context->IndentedText.String->sr;
         }
 
-        Table[*Index][i] = text;
+        if (Context->Measure)
+            PhMeasureTextTableCell(Context->Writer, i, text);
+        else
+            status = PhWriteTextTableCell(Context->Writer, text);
     }
 
-    (*Index)++;
-
     // Process the children.
-    for (i = 0; i < Node->Children->Count; i++)
+    for (i = 0; i < Node->Children->Count && NT_SUCCESS(status); i++)
     {
-        PhpPopulateTableWithProcessNodes(
-            TreeListHandle,
-            Node->Children->Items[i],
-            Level + 1,
-            Table,
-            Index,
-            DisplayToId,
-            Columns
-            );
+        status = PhpWriteProcessNodes(Context, Node->Children->Items[i], Level + 1);
     }
+
+    return status;
 }
 
-PPH_LIST PhGetProcessTreeListLines(
+NTSTATUS PhWriteProcessTreeNodes(
     _In_ HWND TreeListHandle,
-    _In_ ULONG NumberOfNodes,
     _In_ PPH_LIST RootNodes,
+    _Inout_ PPH_FILE_STREAM FileStream,
     _In_ ULONG Mode
     )
 {
-    PH_AUTO_POOL autoPool;
-    PPH_LIST lines;
-    // The number of rows in the table (including +1 for the column headers).
-    ULONG rows;
+    NTSTATUS status = STATUS_SUCCESS;
+    PH_TEXT_TABLE_WRITER writer;
+    PH_PROCESS_TREE_WRITE_CONTEXT context;
     // The number of columns.
     ULONG columns;
     // A column display index to ID map.
     PULONG displayToId;
     // A column display index to text map.
     PWSTR *displayToText;
-    // The actual string table.
-    PPH_STRING **table;
+    ULONG pass;
     ULONG i;
-    ULONG j;
-
-    // Use a local auto-pool to make memory mangement a bit less painful.
-    PhInitializeAutoPool(&autoPool);
-
-    rows = NumberOfNodes + 1;
 
     // Create the display index to ID map.
     PhMapDisplayIndexTreeNew(TreeListHandle, &displayToId, &displayToText, &columns);
 
-    PhaCreateTextTable(&table, rows, columns);
+    PhInitializeTextTableWriter(&writer, FileStream, Mode, columns);
 
-    // Populate the first row with the column headers.
-    for (i = 0; i < columns; i++)
+    context.TreeListHandle = TreeListHandle;
+    context.Writer = &writer;
+    context.DisplayToId = displayToId;
+    context.Columns = columns;
+    PhInitializeStringBuilder(&context.IndentedText, 0x100);
+
+    // Go through the nodes in the process tree twice if the columns need to be aligned: once to
+    // calculate the column widths, and once to write each cell. Nothing else is kept in memory.
+
+    for (pass = PH_EXPORT_MODE_ALIGNED(Mode) ? 0 : 1; pass < 2 && NT_SUCCESS(status); pass++)
     {
-        table[0][i] = PhaCreateString(displayToText[i]);
-    }
+        context.Measure = pass == 0;
 
-    // Go through the nodes in the process tree and populate each cell of the table.
+        // The first row contains the column headers.
+        for (i = 0; i < columns && NT_SUCCESS(status); i++)
+        {
+            PH_STRINGREF text;
 
-    j = 1; // index starts at one because the first row contains the column headers.
+            PhInitializeStringRef(&text, displayToText[i]);
 
-    for (i = 0; i < RootNodes->Count; i++)
-    {
-        PhpPopulateTableWithProcessNodes(
-            TreeListHandle,
-            RootNodes->Items[i],
-            0,
-            table,
-            &j,
-            displayToId,
-            columns
-            );
+            if (context.Measure)
+                PhMeasureTextTableCell(&writer, i, &text);
+            else
+                status = PhWriteTextTableCell(&writer, &text);
+        }
+
+        for (i = 0; i < RootNodes->Count && NT_SUCCESS(status); i++)
+        {
+            status = PhpWriteProcessNodes(&context, RootNodes->Items[i], 0);
+        }
     }
 
+    PhDeleteStringBuilder(&context.IndentedText);
+    PhDeleteTextTableWriter(&writer);
     PhFree(displayToId);
     PhFree(displayToText);
 
-    lines = PhaFormatTextTable(table, rows, columns, Mode);
-
-    PhDeleteAutoPool(&autoPool);
-
-    return lines;
+    return status;
 }
 
 VOID PhCopyProcessTree(
@@ -3470,27 +3519,12 @@ VOID PhWriteProcessTree(
     _In_ ULONG Mode
     )
 {
-    PPH_LIST lines;
-    ULONG i;
-
-    lines = PhGetProcessTreeListLines(
+    PhWriteProcessTreeNodes(
         ProcessTreeListHandle,
-        ProcessNodeList->Count,
         ProcessNodeRootList,
+        FileStream,
         Mode
         );
-
-    for (i = 0; i < lines->Count; i++)
-    {
-        PPH_STRING line;
-
-        line = lines->Items[i];
-        PhWriteStringAsUtf8FileStream(FileStream, &line->sr);
-        PhDereferenceObject(line);
-        PhWriteStringAsUtf8FileStream2(FileStream, L"\r\n");
-    }
-
-    PhDereferenceObject(lines);
 }
 
 PPH_LIST PhDuplicateProcessNodeList(
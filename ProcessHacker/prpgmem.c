@@ -45,16 +45,24 @@ VOID PhpRefreshProcessMemoryList(
     )
 {
     PPH_MEMORY_CONTEXT memoryContext = PropPageContext->Context;
+    PH_MEMORY_ITEM_LIST previousList;
+    BOOLEAN previousListValid;
 
-    if (memoryContext->MemoryItemListValid)
+    // The new list is queried directly into the context because its ListHead can't be copied.
+    // The previous list only needs its item array, so it can be moved out.
+    previousListValid = memoryContext->MemoryItemListValid;
+
+    if (previousListValid)
     {
-        PhDeleteMemoryItemList(&memoryContext->MemoryItemList);
+        previousList = memoryContext->MemoryItemList;
         memoryContext->MemoryItemListValid = FALSE;
     }
 
-    memoryContext->LastRunStatus = PhQueryMemoryItemList(
+    // Unchanged regions are carried over from the previous list, which is deleted by the query.
+    memoryContext->LastRunStatus = PhQueryMemoryItemListEx(
         memoryContext->ProcessId,
         PH_QUERY_MEMORY_REGION_TYPE | PH_QUERY_MEMORY_WS_COUNTERS,
+        previousListValid ? &previousList : NULL,
         &memoryContext->MemoryItemList
         );
 
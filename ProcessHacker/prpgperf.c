@@ -153,14 +153,14 @@ INT_PTR CALLBACK PhpProcessPerformanceDlgProc(
                         PhGraphStateGetDrawInfo(
                             &performanceContext->CpuGraphState,
                             getDrawInfo,
-                            processItem->CpuKernelHistory.Count
+                            processItem->History.Count
                             );
 
                         if (!performanceContext->CpuGraphState.Valid)
                         {
-                            PhCopyCircularBuffer_FLOAT(&processItem->CpuKernelHistory,
+                            PhCopyHistoryBuffer(&processItem->History, PH_PROCESS_HISTORY_CPU_KERNEL,
                                 performanceContext->CpuGraphState.Data1, drawInfo->LineDataCount);
-                            PhCopyCircularBuffer_FLOAT(&processItem->CpuUserHistory,
+                            PhCopyHistoryBuffer(&processItem->History, PH_PROCESS_HISTORY_CPU_USER,
                                 performanceContext->CpuGraphState.Data2, drawInfo->LineDataCount);
                             performanceContext->CpuGraphState.Valid = TRUE;
                         }
@@ -191,18 +191,13 @@ INT_PTR CALLBACK PhpProcessPerformanceDlgProc(
                         PhGraphStateGetDrawInfo(
                             &performanceContext->PrivateGraphState,
                             getDrawInfo,
-                            processItem->PrivateBytesHistory.Count
+                            processItem->History.Count
                             );
 
                         if (!performanceContext->PrivateGraphState.Valid)
                         {
-                            ULONG i;
-
-                            for (i = 0; i < drawInfo->LineDataCount; i++)
-                            {
-                                performanceContext->PrivateGraphState.Data1[i] =
-                                    (FLOAT)PhGetItemCircularBuffer_SIZE_T(&processItem->PrivateBytesHistory, i);
-                            }
+                            PhCopyHistoryBuffer(&processItem->History, PH_PROCESS_HISTORY_PRIVATE_BYTES,
+                                performanceContext->PrivateGraphState.Data1, drawInfo->LineDataCount);
 
                             if (processItem->VmCounters.PeakPagefileUsage != 0)
                             {
@@ -244,28 +239,26 @@ INT_PTR CALLBACK PhpProcessPerformanceDlgProc(
                         PhGraphStateGetDrawInfo(
                             &performanceContext->IoGraphState,
                             getDrawInfo,
-                            processItem->IoReadHistory.Count
+                            processItem->History.Count
                             );
 
                         if (!performanceContext->IoGraphState.Valid)
                         {
-                            ULONG i;
-                            FLOAT max = 0;
-
-                            for (i = 0; i < drawInfo->LineDataCount; i++)
-                            {
-                                FLOAT data1;
-                                FLOAT data2;
-
-                                performanceContext->IoGraphState.Data1[i] = data1 =
-                                    (FLOAT)PhGetItemCircularBuffer_ULONG64(&processItem->IoReadHistory, i) +
-                                    (FLOAT)PhGetItemCircularBuffer_ULONG64(&processItem->IoOtherHistory, i);
-                                performanceContext->IoGraphState.Data2[i] = data2 =
-                                    (FLOAT)PhGetItemCircularBuffer_ULONG64(&processItem->IoWriteHistory, i);
-
-                                if (max < data1 + data2)
-                                    max = data1 + data2;
-                            }
+                            FLOAT max;
+
+                            // Data1 is read + other. Data2 is used as scratch space for the other series
+                            // before it receives the write series.
+                            PhCopyHistoryBuffer(&processItem->History, PH_PROCESS_HISTORY_IO_READ,
+                                performanceContext->IoGraphState.Data1, drawInfo->LineDataCount);
+                            PhCopyHistoryBuffer(&processItem->History, PH_PROCESS_HISTORY_IO_OTHER,
+                                performanceContext->IoGraphState.Data2, drawInfo->LineDataCount);
+                            PhAddSingles(performanceContext->IoGraphState.Data1, performanceContext->IoGraphState.Data2,
+                                drawInfo->LineDataCount);
+                            PhCopyHistoryBuffer(&processItem->History, PH_PROCESS_HISTORY_IO_WRITE,
+                                performanceContext->IoGraphState.Data2, drawInfo->LineDataCount);
+
+                            max = PhMaximumSumSingles(performanceContext->IoGraphState.Data1,
+                                performanceContext->IoGraphState.Data2, drawInfo->LineDataCount);
 
                             if (max != 0)
                             {
@@ -325,8 +318,8 @@ INT_PTR CALLBACK PhpProcessPerformanceDlgProc(
                             FLOAT cpuKernel;
                             FLOAT cpuUser;
 
-                            cpuKernel = PhGetItemCircularBuffer_FLOAT(&processItem->CpuKernelHistory, getTooltipText->Index);
-                            cpuUser = PhGetItemCircularBuffer_FLOAT(&processItem->CpuUserHistory, getTooltipText->Index);
+                            cpuKernel = PhGetSampleHistoryBuffer(&processItem->History, PH_PROCESS_HISTORY_CPU_KERNEL, getTooltipText->Index);
+                            cpuUser = PhGetSampleHistoryBuffer(&processItem->History, PH_PROCESS_HISTORY_CPU_USER, getTooltipText->Index);
 
                             PhMoveReference(&performanceContext->CpuGraphState.TooltipText, PhFormatString(
                                 L"%.2f%%\n%s",
@@ -346,7 +339,7 @@ INT_PTR CALLBACK PhpProcessPerformanceDlgProc(
                         {
                             SIZE_T privateBytes;
 
-                            privateBytes = PhGetItemCircularBuffer_SIZE_T(&processItem->PrivateBytesHistory, getTooltipText->Index);
+                            privateBytes = (SIZE_T)PhGetSampleHistoryBuffer(&processItem->History, PH_PROCESS_HISTORY_PRIVATE_BYTES, getTooltipText->Index);
 
                             PhMoveReference(&performanceContext->PrivateGraphState.TooltipText, PhFormatString(
                                 L"Private bytes: %s\n%s",
@@ -368,9 +361,9 @@ INT_PTR CALLBACK PhpProcessPerformanceDlgProc(
                             ULONG64 ioWrite;
                             ULONG64 ioOther;
 
-                            ioRead = PhGetItemCircularBuffer_ULONG64(&processItem->IoReadHistory, getTooltipText->Index);
-                            ioWrite = PhGetItemCircularBuffer_ULONG64(&processItem->IoWriteHistory, getTooltipText->Index);
-                            ioOther = PhGetItemCircularBuffer_ULONG64(&processItem->IoOtherHistory, getTooltipText->Index);
+                            ioRead = (ULONG64)PhGetSampleHistoryBuffer(&processItem->History, PH_PROCESS_HISTORY_IO_READ, getTooltipText->Index);
+                            ioWrite = (ULONG64)PhGetSampleHistoryBuffer(&processItem->History, PH_PROCESS_HISTORY_IO_WRITE, getTooltipText->Index);
+                            ioOther = (ULONG64)PhGetSampleHistoryBuffer(&processItem->History, PH_PROCESS_HISTORY_IO_OTHER, getTooltipText->Index);
 
                             PhMoveReference(&performanceContext->IoGraphState.TooltipText, PhFormatString(
                                 L"R: %s\nW: %s\nO: %s\n%s",
@@ -891,6 +891,13 @@ INT_PTR CALLBACK PhpProcessThreadsDlgProc(
                     }
                 }
                 break;
+            case ID_ANALYZE_STACKPROFILE:
+                {
+                    PhReferenceObject(threadsContext->Provider);
+                    PhUiProfileThreadStacks(hwndDlg, threadsContext->Provider);
+                    PhDereferenceObject(threadsContext->Provider);
+                }
+                break;
             case ID_PRIORITY_TIMECRITICAL:
             case ID_PRIORITY_HIGHEST:
             case ID_PRIORITY_ABOVENORMAL:
@@ -528,6 +528,7 @@
 #define IDC_DELETE                      1382
 #define IDC_EDIT                        1383
 #define IDC_NEW                         1384
+#define IDC_ONEGRAPHPERNODE             1385
 #define ID_MAINWND_PROCESSTL            2001
 #define ID_MAINWND_SERVICETL            2002
 #define ID_MAINWND_NETWORKTL            2003
@@ -730,6 +731,7 @@
 #define ID_ENVIRONMENT_EDIT             40290
 #define ID_ENVIRONMENT_COPY             40291
 #define ID_ENVIRONMENT_DELETE           40292
+#define ID_ANALYZE_STACKPROFILE         40293
 #define IDDYNAMIC                       50000
 #define IDPLUGINS                       55000
 
@@ -738,8 +740,8 @@
 #ifdef APSTUDIO_INVOKED
 #ifndef APSTUDIO_READONLY_SYMBOLS
 #define _APS_NEXT_RESOURCE_VALUE        223
-#define _APS_NEXT_COMMAND_VALUE         40293
-#define _APS_NEXT_CONTROL_VALUE         1385
+#define _APS_NEXT_COMMAND_VALUE         40294
+#define _APS_NEXT_CONTROL_VALUE         1386
 #define _APS_NEXT_SYMED_VALUE           169
 #endif
 #endif
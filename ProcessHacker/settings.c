@@ -41,11 +41,20 @@
 
 #include "mxml/mxml.h"
 
-PPH_HASHTABLE PhSettingsHashtable;
+PPH_FLAT_HASHTABLE PhSettingsHashtable;
 PH_QUEUED_LOCK PhSettingsLock = PH_QUEUED_LOCK_INIT;
 
 PPH_LIST PhIgnoredSettings;
 
+// Incremented whenever a setting value changes. Protected by PhSettingsLock.
+static ULONG PhpSettingsGeneration = 0;
+// State of the settings file after the last load or save.
+static PPH_STRING PhpSettingsFileName = NULL;
+static LARGE_INTEGER PhpSettingsFileLastWriteTime;
+static LARGE_INTEGER PhpSettingsFileEndOfFile;
+static ULONG PhpSettingsSavedGeneration = 0;
+static BOOLEAN PhpSettingsUseCache = FALSE;
+
 // These macros make sure the C strings can be seamlessly converted into
 // PH_STRINGREFs at compile time, for a small speed boost.
 
@@ -65,7 +74,7 @@ VOID PhSettingsInitialization(
     VOID
     )
 {
-    PhSettingsHashtable = PhCreateHashtable(
+    PhSettingsHashtable = PhCreateFlatHashtable(
         sizeof(PH_SETTING),
         PhpSettingsHashtableEqualFunction,
         PhpSettingsHashtableHashFunction,
@@ -82,6 +91,7 @@ VOID PhSettingsInitialization(
     PhpAddStringSetting(L"DisabledPlugins", L"");
     PhpAddIntegerSetting(L"ElevationLevel", L"1"); // PromptElevateAction
     PhpAddIntegerSetting(L"EnableCycleCpuUsage", L"1");
+    PhpAddIntegerSetting(L"EnableHistoryFile", L"0");
     PhpAddIntegerSetting(L"EnableInstantTooltips", L"0");
     PhpAddIntegerSetting(L"EnableKph", L"1");
     PhpAddIntegerSetting(L"EnableNetworkResolve", L"1");
@@ -172,6 +182,7 @@ VOID PhSettingsInitialization(
     PhpAddIntegerSetting(L"StartHidden", L"0");
     PhpAddIntegerSetting(L"SysInfoWindowAlwaysOnTop", L"0");
     PhpAddIntegerSetting(L"SysInfoWindowOneGraphPerCpu", L"0");
+    PhpAddIntegerSetting(L"SysInfoWindowOneGraphPerNode", L"0");
     PhpAddIntegerPairSetting(L"SysInfoWindowPosition", L"200,200");
     PhpAddStringSetting(L"SysInfoWindowSection", L"");
     PhpAddScalableIntegerPairSetting(L"SysInfoWindowSize", L"@96|620,590");
@@ -180,6 +191,7 @@ VOID PhSettingsInitialization(
     PhpAddStringSetting(L"ThreadTreeListColumns", L"");
     PhpAddStringSetting(L"ThreadTreeListSort", L"1,2"); // 1, DescendingSortOrder
     PhpAddStringSetting(L"ThreadStackListViewColumns", L"");
+    PhpAddIntegerSetting(L"ThreadStackProfileInterval", L"a"); // 10ms
     PhpAddScalableIntegerPairSetting(L"ThreadStackWindowSize", L"@96|420,380");
     PhpAddIntegerSetting(L"UpdateInterval", L"3e8"); // 1000ms
 
@@ -321,7 +333,7 @@ static VOID PhpAddSetting(
 
     PhpSettingFromString(Type, &setting.DefaultValue, NULL, &setting);
 
-    PhAddEntryHashtable(PhSettingsHashtable, &setting);
+    PhAddEntryFlatHashtable(PhSettingsHashtable, &setting);
 }
 
 static ULONG PhpGetCurrentScale(
@@ -517,7 +529,7 @@ static PVOID PhpLookupSetting(
     PPH_SETTING setting;
 
     lookupSetting.Name = *Name;
-    setting = (PPH_SETTING)PhFindEntryHashtable(
+    setting = (PPH_SETTING)PhFindEntryFlatHashtable(
         PhSettingsHashtable,
         &lookupSetting
         );
@@ -525,6 +537,17 @@ static PVOID PhpLookupSetting(
     return setting;
 }
 
+static BOOLEAN PhpEqualStringSettingValue(
+    _In_ PPH_SETTING Setting,
+    _In_ PPH_STRINGREF Value
+    )
+{
+    if (Setting->u.Pointer)
+        return PhEqualStringRef(&((PPH_STRING)Setting->u.Pointer)->sr, Value, FALSE);
+    else
+        return Value->Length == 0;
+}
+
 _May_raise_ ULONG PhGetIntegerSetting(
     _In_ PWSTR Name
     )
@@ -692,7 +715,11 @@ _May_raise_ VOID PhSetIntegerSetting(
 
     if (setting && setting->Type == IntegerSettingType)
     {
-        setting->u.Integer = Value;
+        if (setting->u.Integer != Value)
+        {
+            setting->u.Integer = Value;
+            PhpSettingsGeneration++;
+        }
     }
 
     PhReleaseQueuedLockExclusive(&PhSettingsLock);
@@ -717,7 +744,11 @@ _May_raise_ VOID PhSetIntegerPairSetting(
 
     if (setting && setting->Type == IntegerPairSettingType)
     {
-        setting->u.IntegerPair = Value;
+        if (setting->u.IntegerPair.X != Value.X || setting->u.IntegerPair.Y != Value.Y)
+        {
+            setting->u.IntegerPair = Value;
+            PhpSettingsGeneration++;
+        }
     }
 
     PhReleaseQueuedLockExclusive(&PhSettingsLock);
@@ -742,8 +773,12 @@ _May_raise_ VOID PhSetScalableIntegerPairSetting(
 
     if (setting && setting->Type == ScalableIntegerPairSettingType)
     {
-        PhpFreeSettingValue(ScalableIntegerPairSettingType, setting);
-        setting->u.Pointer = PhAllocateCopy(&Value, sizeof(PH_SCALABLE_INTEGER_PAIR));
+        if (!setting->u.Pointer || memcmp(setting->u.Pointer, &Value, sizeof(PH_SCALABLE_INTEGER_PAIR)) != 0)
+        {
+            PhpFreeSettingValue(ScalableIntegerPairSettingType, setting);
+            setting->u.Pointer = PhAllocateCopy(&Value, sizeof(PH_SCALABLE_INTEGER_PAIR));
+            PhpSettingsGeneration++;
+        }
     }
 
     PhReleaseQueuedLockExclusive(&PhSettingsLock);
@@ -780,8 +815,16 @@ _May_raise_ VOID PhSetStringSetting(
 
     if (setting && setting->Type == StringSettingType)
     {
-        PhpFreeSettingValue(StringSettingType, setting);
-        setting->u.Pointer = PhCreateString(Value);
+        PH_STRINGREF value;
+
+        PhInitializeStringRefLongHint(&value, Value);
+
+        if (!PhpEqualStringSettingValue(setting, &value))
+        {
+            PhpFreeSettingValue(StringSettingType, setting);
+            setting->u.Pointer = PhCreateString2(&value);
+            PhpSettingsGeneration++;
+        }
     }
 
     PhReleaseQueuedLockExclusive(&PhSettingsLock);
@@ -806,8 +849,12 @@ _May_raise_ VOID PhSetStringSetting2(
 
     if (setting && setting->Type == StringSettingType)
     {
-        PhpFreeSettingValue(StringSettingType, setting);
-        setting->u.Pointer = PhCreateString2(Value);
+        if (!PhpEqualStringSettingValue(setting, Value))
+        {
+            PhpFreeSettingValue(StringSettingType, setting);
+            setting->u.Pointer = PhCreateString2(Value);
+            PhpSettingsGeneration++;
+        }
     }
 
     PhReleaseQueuedLockExclusive(&PhSettingsLock);
@@ -849,6 +896,10 @@ VOID PhClearIgnoredSettings(
     )
 {
     PhpClearIgnoredSettings();
+
+    PhAcquireQueuedLockExclusive(&PhSettingsLock);
+    PhpSettingsGeneration++;
+    PhReleaseQueuedLockExclusive(&PhSettingsLock);
 }
 
 VOID PhConvertIgnoredSettings(
@@ -868,6 +919,8 @@ VOID PhConvertIgnoredSettings(
 
         if (setting)
         {
+            PPH_STRING newValue;
+
             PhpFreeSettingValue(setting->Type, setting);
 
             if (!PhpSettingFromString(
@@ -885,6 +938,15 @@ VOID PhConvertIgnoredSettings(
                     );
             }
 
+            // The settings file already contains the ignored value, so it only needs to be
+            // rewritten if the converted value is written differently.
+            newValue = PhpSettingToString(setting->Type, setting);
+
+            if (!PhEqualString(newValue, ignoredSetting->u.Pointer, FALSE))
+                PhpSettingsGeneration++;
+
+            PhDereferenceObject(newValue);
+
             PhpFreeIgnoredSetting(ignoredSetting);
 
             PhRemoveItemList(PhIgnoredSettings, i);
@@ -895,17 +957,222 @@ VOID PhConvertIgnoredSettings(
     PhReleaseQueuedLockExclusive(&PhSettingsLock);
 }
 
-NTSTATUS PhLoadSettings(
+/**
+ * Applies a setting value which was read from a settings file. The settings lock must be held
+ * exclusively.
+ *
+ * \param Name The name of the setting.
+ * \param Value The value of the setting.
+ * \param ValueString A string object for \a Value, if one is available. This avoids a copy
+ * for string settings.
+ */
+static VOID PhpApplyLoadedSetting(
+    _In_ PPH_STRINGREF Name,
+    _In_ PPH_STRINGREF Value,
+    _In_opt_ PPH_STRING ValueString
+    )
+{
+    PPH_SETTING setting;
+
+    setting = PhpLookupSetting(Name);
+
+    if (setting)
+    {
+        PhpFreeSettingValue(setting->Type, setting);
+
+        if (!PhpSettingFromString(
+            setting->Type,
+            Value,
+            ValueString,
+            setting
+            ))
+        {
+            PhpSettingFromString(
+                setting->Type,
+                &setting->DefaultValue,
+                NULL,
+                setting
+                );
+        }
+    }
+    else
+    {
+        setting = PhAllocate(sizeof(PH_SETTING));
+        setting->Name.Buffer = PhAllocate(Name->Length + sizeof(WCHAR));
+        memcpy(setting->Name.Buffer, Name->Buffer, Name->Length);
+        setting->Name.Buffer[Name->Length / sizeof(WCHAR)] = 0;
+        setting->Name.Length = Name->Length;
+
+        if (ValueString)
+        {
+            PhReferenceObject(ValueString);
+            setting->u.Pointer = ValueString;
+        }
+        else
+        {
+            setting->u.Pointer = PhCreateString2(Value);
+        }
+
+        PhAddItemList(PhIgnoredSettings, setting);
+    }
+}
+
+/**
+ * Converts a UTF-8 string from the settings file, using a caller-supplied buffer when the
+ * result fits.
+ *
+ * \param Utf8String The string to convert.
+ * \param Buffer A buffer which receives the converted string.
+ * \param BufferLength The size of \a Buffer, in bytes.
+ * \param String A variable which receives the converted string.
+ * \param AllocatedString A variable which receives a string object when \a Buffer was too
+ * small, or NULL otherwise. You must free the object using PhDereferenceObject() when you no
+ * longer need it.
+ */
+static VOID PhpConvertSettingsFileString(
+    _In_ PSTR Utf8String,
+    _Out_writes_bytes_(BufferLength) PWCHAR Buffer,
+    _In_ SIZE_T BufferLength,
+    _Out_ PPH_STRINGREF String,
+    _Out_ PPH_STRING *AllocatedString
+    )
+{
+    SIZE_T bytesInUtf16String;
+
+    if (PhConvertUtf8ToUtf16Buffer(Buffer, BufferLength, &bytesInUtf16String, Utf8String, strlen(Utf8String)))
+    {
+        String->Buffer = Buffer;
+        String->Length = bytesInUtf16String;
+        *AllocatedString = NULL;
+    }
+    else
+    {
+        *AllocatedString = PhConvertUtf8ToUtf16(Utf8String);
+        *String = (*AllocatedString)->sr;
+    }
+}
+
+typedef struct _PH_SETTINGS_LOAD_CONTEXT
+{
+    mxml_node_t *TopNode;
+} PH_SETTINGS_LOAD_CONTEXT, *PPH_SETTINGS_LOAD_CONTEXT;
+
+static VOID PhpSettingsLoadSaxCallback(
+    _In_ mxml_node_t *node,
+    _In_ mxml_sax_event_t event,
+    _In_ PVOID data
+    )
+{
+    PPH_SETTINGS_LOAD_CONTEXT context = data;
+
+    switch (event)
+    {
+    case MXML_SAX_ELEMENT_OPEN:
+        {
+            // Keep the top-level element alive so we can tell a complete document apart from a
+            // parse error. Everything else is released as soon as it has been processed, so
+            // memory usage does not depend on the size of the file.
+            if (!node->parent)
+            {
+                context->TopNode = node;
+                mxmlRetain(node);
+            }
+        }
+        break;
+    case MXML_SAX_DATA:
+        {
+            // Keep the value until the setting element is closed.
+            if (node->parent && node->parent != context->TopNode && node->type == MXML_OPAQUE)
+                mxmlRetain(node);
+        }
+        break;
+    case MXML_SAX_ELEMENT_CLOSE:
+        {
+            WCHAR nameBuffer[64];
+            WCHAR valueBuffer[128];
+            PH_STRINGREF settingName;
+            PH_STRINGREF settingValue;
+            PPH_STRING allocatedName;
+            PPH_STRING allocatedValue;
+
+            if (
+                !node->parent ||
+                node->parent != context->TopNode ||
+                node->value.element.num_attrs < 1 ||
+                _stricmp(node->value.element.attrs[0].name, "name") != 0
+                )
+            {
+                break;
+            }
+
+            PhpConvertSettingsFileString(
+                node->value.element.attrs[0].value,
+                nameBuffer,
+                sizeof(nameBuffer),
+                &settingName,
+                &allocatedName
+                );
+
+            if (node->child && node->child->type == MXML_OPAQUE && node->child->value.opaque)
+            {
+                PhpConvertSettingsFileString(
+                    node->child->value.opaque,
+                    valueBuffer,
+                    sizeof(valueBuffer),
+                    &settingValue,
+                    &allocatedValue
+                    );
+            }
+            else
+            {
+                PhInitializeEmptyStringRef(&settingValue);
+                allocatedValue = NULL;
+            }
+
+            PhpApplyLoadedSetting(&settingName, &settingValue, allocatedValue);
+
+            if (allocatedValue)
+                PhDereferenceObject(allocatedValue);
+            if (allocatedName)
+                PhDereferenceObject(allocatedName);
+        }
+        break;
+    }
+}
+
+static PPH_STRING PhpGetSettingsCacheFileName(
     _In_ PWSTR FileName
     )
+{
+    static PH_STRINGREF cacheSuffix = PH_STRINGREF_INIT(L".cache");
+    PH_STRINGREF fileName;
+
+    PhInitializeStringRefLongHint(&fileName, FileName);
+
+    return PhConcatStringRef2(&fileName, &cacheSuffix);
+}
+
+/**
+ * Loads settings from a cache file. The settings lock must be held exclusively.
+ *
+ * \param FileName The file name of the cache.
+ * \param FileInformation Information about the settings file. The cache is only used if it
+ * was created from a settings file with the same last write time and size.
+ */
+static NTSTATUS PhpLoadSettingsCache(
+    _In_ PWSTR FileName,
+    _In_ PFILE_NETWORK_OPEN_INFORMATION FileInformation
+    )
 {
     NTSTATUS status;
     HANDLE fileHandle;
     LARGE_INTEGER fileSize;
-    mxml_node_t *topNode;
-    mxml_node_t *currentNode;
-
-    PhpClearIgnoredSettings();
+    IO_STATUS_BLOCK isb;
+    PVOID buffer;
+    ULONG length;
+    PPH_SETTINGS_CACHE_HEADER header;
+    ULONG offset;
+    ULONG i;
 
     status = PhCreateFileWin32(
         &fileHandle,
@@ -920,95 +1187,356 @@ NTSTATUS PhLoadSettings(
     if (!NT_SUCCESS(status))
         return status;
 
-    if (NT_SUCCESS(PhGetFileSize(fileHandle, &fileSize)) && fileSize.QuadPart == 0)
+    status = PhGetFileSize(fileHandle, &fileSize);
+
+    if (NT_SUCCESS(status) && (fileSize.QuadPart < sizeof(PH_SETTINGS_CACHE_HEADER) || fileSize.QuadPart > PH_SETTINGS_CACHE_MAXIMUM_SIZE))
+        status = STATUS_FILE_CORRUPT_ERROR;
+
+    if (!NT_SUCCESS(status))
     {
-        // A blank file is OK. There are no settings to load.
         NtClose(fileHandle);
         return status;
     }
 
-    topNode = mxmlLoadFd(NULL, fileHandle, MXML_OPAQUE_CALLBACK);
+    length = (ULONG)fileSize.QuadPart;
+    buffer = PhAllocate(length);
+    status = NtReadFile(fileHandle, NULL, NULL, NULL, &isb, buffer, length, NULL, NULL);
     NtClose(fileHandle);
 
-    if (!topNode)
-        return STATUS_FILE_CORRUPT_ERROR;
+    if (NT_SUCCESS(status) && isb.Information != length)
+        status = STATUS_FILE_CORRUPT_ERROR;
+
+    if (!NT_SUCCESS(status))
+        goto CleanupExit;
+
+    header = buffer;
 
-    if (topNode->type != MXML_ELEMENT)
+    if (
+        header->Magic != PH_SETTINGS_CACHE_MAGIC ||
+        header->Version != PH_SETTINGS_CACHE_VERSION ||
+        header->LastWriteTime.QuadPart != FileInformation->LastWriteTime.QuadPart ||
+        header->EndOfFile.QuadPart != FileInformation->EndOfFile.QuadPart ||
+        header->Checksum != PhCrc32(0, PTR_ADD_OFFSET(buffer, sizeof(PH_SETTINGS_CACHE_HEADER)), length - sizeof(PH_SETTINGS_CACHE_HEADER))
+        )
     {
-        mxmlDelete(topNode);
-        return STATUS_FILE_CORRUPT_ERROR;
+        status = STATUS_FILE_CORRUPT_ERROR;
+        goto CleanupExit;
+    }
+
+    // Validate all entries before applying anything, so a damaged cache never leaves us with a
+    // partial set of settings.
+
+    offset = sizeof(PH_SETTINGS_CACHE_HEADER);
+
+    for (i = 0; i < header->NumberOfEntries; i++)
+    {
+        PPH_SETTINGS_CACHE_ENTRY entry;
+
+        offset = ALIGN_UP_BY(offset, sizeof(ULONG));
+
+        if (offset > length || length - offset < sizeof(PH_SETTINGS_CACHE_ENTRY))
+            break;
+
+        entry = PTR_ADD_OFFSET(buffer, offset);
+        offset += sizeof(PH_SETTINGS_CACHE_ENTRY);
+
+        if ((entry->NameLength | entry->ValueLength) & 1)
+            break;
+        if ((ULONG64)entry->NameLength + entry->ValueLength > length - offset)
+            break;
+
+        offset += entry->NameLength + entry->ValueLength;
+    }
+
+    if (i != header->NumberOfEntries)
+    {
+        status = STATUS_FILE_CORRUPT_ERROR;
+        goto CleanupExit;
     }
 
-    currentNode = topNode->child;
+    offset = sizeof(PH_SETTINGS_CACHE_HEADER);
 
-    while (currentNode)
+    for (i = 0; i < header->NumberOfEntries; i++)
     {
-        PPH_STRING settingName = NULL;
+        PPH_SETTINGS_CACHE_ENTRY entry;
+        PH_STRINGREF settingName;
+        PH_STRINGREF settingValue;
 
-        if (
-            currentNode->type == MXML_ELEMENT &&
-            currentNode->value.element.num_attrs >= 1 &&
-            _stricmp(currentNode->value.element.attrs[0].name, "name") == 0
-            )
+        offset = ALIGN_UP_BY(offset, sizeof(ULONG));
+        entry = PTR_ADD_OFFSET(buffer, offset);
+        offset += sizeof(PH_SETTINGS_CACHE_ENTRY);
+
+        settingName.Buffer = PTR_ADD_OFFSET(buffer, offset);
+        settingName.Length = entry->NameLength;
+        settingValue.Buffer = PTR_ADD_OFFSET(settingName.Buffer, settingName.Length);
+        settingValue.Length = entry->ValueLength;
+
+        PhpApplyLoadedSetting(&settingName, &settingValue, NULL);
+
+        offset += entry->NameLength + entry->ValueLength;
+    }
+
+CleanupExit:
+    PhFree(buffer);
+
+    return status;
+}
+
+static VOID PhpAppendSettingsCacheEntry(
+    _Inout_ PPH_BYTES_BUILDER BytesBuilder,
+    _In_ PPH_STRINGREF SettingName,
+    _In_ PPH_STRINGREF SettingValue
+    )
+{
+    PH_SETTINGS_CACHE_ENTRY entry;
+
+    entry.NameLength = (ULONG)SettingName->Length;
+    entry.ValueLength = (ULONG)SettingValue->Length;
+
+    PhAppendBytesBuilderEx(BytesBuilder, &entry, sizeof(PH_SETTINGS_CACHE_ENTRY), sizeof(ULONG), NULL);
+    PhAppendBytesBuilderEx(BytesBuilder, SettingName->Buffer, SettingName->Length, 0, NULL);
+    PhAppendBytesBuilderEx(BytesBuilder, SettingValue->Buffer, SettingValue->Length, 0, NULL);
+}
+
+/**
+ * Writes a settings cache.
+ *
+ * \param FileName The file name of the cache.
+ * \param FileInformation Information about the settings file that the cache corresponds to.
+ * \param BytesBuilder A bytes builder containing a space for the cache header followed by
+ * the cache entries.
+ * \param NumberOfEntries The number of entries in \a BytesBuilder.
+ */
+static NTSTATUS PhpSaveSettingsCache(
+    _In_ PWSTR FileName,
+    _In_ PFILE_NETWORK_OPEN_INFORMATION FileInformation,
+    _Inout_ PPH_BYTES_BUILDER BytesBuilder,
+    _In_ ULONG NumberOfEntries
+    )
+{
+    NTSTATUS status;
+    HANDLE fileHandle;
+    IO_STATUS_BLOCK isb;
+    PPH_SETTINGS_CACHE_HEADER header;
+    ULONG length;
+
+    length = (ULONG)BytesBuilder->Bytes->Length;
+    header = (PPH_SETTINGS_CACHE_HEADER)BytesBuilder->Bytes->Buffer;
+    header->Magic = PH_SETTINGS_CACHE_MAGIC;
+    header->Version = PH_SETTINGS_CACHE_VERSION;
+    header->LastWriteTime = FileInformation->LastWriteTime;
+    header->EndOfFile = FileInformation->EndOfFile;
+    header->NumberOfEntries = NumberOfEntries;
+    header->Checksum = PhCrc32(0, PTR_ADD_OFFSET(header, sizeof(PH_SETTINGS_CACHE_HEADER)), length - sizeof(PH_SETTINGS_CACHE_HEADER));
+
+    // The cache does not need to be written atomically. A torn write fails the checksum and
+    // the settings file is parsed instead.
+
+    status = PhCreateFileWin32(
+        &fileHandle,
+        FileName,
+        FILE_GENERIC_WRITE,
+        0,
+        FILE_SHARE_READ,
+        FILE_OVERWRITE_IF,
+        FILE_NON_DIRECTORY_FILE | FILE_SYNCHRONOUS_IO_NONALERT
+        );
+
+    if (!NT_SUCCESS(status))
+        return status;
+
+    status = NtWriteFile(fileHandle, NULL, NULL, NULL, &isb, header, length, NULL, NULL);
+    NtClose(fileHandle);
+
+    return status;
+}
+
+/**
+ * Writes the cache for the current settings. The settings lock must not be held.
+ */
+static VOID PhpUpdateSettingsCache(
+    _In_ PWSTR FileName,
+    _In_ PFILE_NETWORK_OPEN_INFORMATION FileInformation
+    )
+{
+    PH_BYTES_BUILDER bytesBuilder;
+    PH_FLAT_HASHTABLE_ENUM_CONTEXT enumContext;
+    PPH_SETTING setting;
+    PPH_STRING cacheFileName;
+    ULONG numberOfEntries = 0;
+    ULONG i;
+
+    PhInitializeBytesBuilder(&bytesBuilder, 0x4000);
+    PhAppendBytesBuilderEx(&bytesBuilder, NULL, sizeof(PH_SETTINGS_CACHE_HEADER), 0, NULL);
+
+    PhAcquireQueuedLockShared(&PhSettingsLock);
+
+    PhBeginEnumFlatHashtable(PhSettingsHashtable, &enumContext);
+
+    while (setting = PhNextEnumFlatHashtable(&enumContext))
+    {
+        PPH_STRING settingValue;
+
+        settingValue = PhpSettingToString(setting->Type, setting);
+        PhpAppendSettingsCacheEntry(&bytesBuilder, &setting->Name, &settingValue->sr);
+        PhDereferenceObject(settingValue);
+        numberOfEntries++;
+    }
+
+    for (i = 0; i < PhIgnoredSettings->Count; i++)
+    {
+        setting = PhIgnoredSettings->Items[i];
+        PhpAppendSettingsCacheEntry(&bytesBuilder, &setting->Name, &((PPH_STRING)setting->u.Pointer)->sr);
+        numberOfEntries++;
+    }
+
+    PhReleaseQueuedLockShared(&PhSettingsLock);
+
+    cacheFileName = PhpGetSettingsCacheFileName(FileName);
+    PhpSaveSettingsCache(cacheFileName->Buffer, FileInformation, &bytesBuilder, numberOfEntries);
+    PhDereferenceObject(cacheFileName);
+
+    PhDeleteBytesBuilder(&bytesBuilder);
+}
+
+/**
+ * Remembers the state of the settings file after it has been loaded or saved, so that
+ * PhSaveSettings() can skip writing a file that is already up to date.
+ */
+static VOID PhpSetSettingsFileState(
+    _In_ PWSTR FileName,
+    _In_opt_ PFILE_NETWORK_OPEN_INFORMATION FileInformation,
+    _In_ ULONG Generation
+    )
+{
+    PhMoveReference(&PhpSettingsFileName, PhCreateString(FileName));
+
+    if (FileInformation)
+    {
+        PhpSettingsFileLastWriteTime = FileInformation->LastWriteTime;
+        PhpSettingsFileEndOfFile = FileInformation->EndOfFile;
+    }
+    else
+    {
+        // Unknown state. The next save always writes the file.
+        PhpSettingsFileLastWriteTime.QuadPart = -1;
+        PhpSettingsFileEndOfFile.QuadPart = -1;
+    }
+
+    PhpSettingsSavedGeneration = Generation;
+}
+
+NTSTATUS PhLoadSettings(
+    _In_ PWSTR FileName
+    )
+{
+    return PhLoadSettingsEx(FileName, 0);
+}
+
+/**
+ * Loads settings from a file.
+ *
+ * \param FileName The file name of the settings file.
+ * \param Flags A combination of flags.
+ * \li \c PH_LOAD_SETTINGS_USE_CACHE Use a binary cache of the settings, stored next to the
+ * settings file. The cache is only used while it matches the last write time and size of the
+ * settings file; otherwise the settings file is parsed and the cache is recreated.
+ *
+ * \return STATUS_FILE_CORRUPT_ERROR if the settings file could not be parsed. In this case all
+ * settings have their default values.
+ */
+NTSTATUS PhLoadSettingsEx(
+    _In_ PWSTR FileName,
+    _In_ ULONG Flags
+    )
+{
+    NTSTATUS status;
+    HANDLE fileHandle;
+    FILE_NETWORK_OPEN_INFORMATION fileInformation;
+    PPH_STRING cacheFileName;
+    PH_SETTINGS_LOAD_CONTEXT context;
+    mxml_node_t *topNode;
+    ULONG generation;
+
+    PhpClearIgnoredSettings();
+
+    PhpSettingsUseCache = !!(Flags & PH_LOAD_SETTINGS_USE_CACHE);
+
+    status = PhQueryFullAttributesFileWin32(FileName, &fileInformation);
+
+    if (!NT_SUCCESS(status))
+        return status;
+
+    if (fileInformation.EndOfFile.QuadPart == 0)
+    {
+        // A blank file is OK. There are no settings to load.
+        PhpSetSettingsFileState(FileName, &fileInformation, PhpSettingsGeneration);
+        return status;
+    }
+
+    if (PhpSettingsUseCache)
+    {
+        cacheFileName = PhpGetSettingsCacheFileName(FileName);
+
+        PhAcquireQueuedLockExclusive(&PhSettingsLock);
+        status = PhpLoadSettingsCache(cacheFileName->Buffer, &fileInformation);
+        generation = PhpSettingsGeneration;
+        PhReleaseQueuedLockExclusive(&PhSettingsLock);
+
+        PhDereferenceObject(cacheFileName);
+
+        if (NT_SUCCESS(status))
         {
-            settingName = PhConvertUtf8ToUtf16(currentNode->value.element.attrs[0].value);
+            PhpSetSettingsFileState(FileName, &fileInformation, generation);
+            PhUpdateCachedSettings();
+            return STATUS_SUCCESS;
         }
+    }
 
-        if (settingName)
-        {
-            PPH_STRING settingValue;
+    status = PhCreateFileWin32(
+        &fileHandle,
+        FileName,
+        FILE_GENERIC_READ,
+        0,
+        FILE_SHARE_READ | FILE_SHARE_DELETE,
+        FILE_OPEN,
+        FILE_NON_DIRECTORY_FILE | FILE_SYNCHRONOUS_IO_NONALERT
+        );
 
-            settingValue = PhGetOpaqueXmlNodeText(currentNode);
+    if (!NT_SUCCESS(status))
+        return status;
 
-            PhAcquireQueuedLockExclusive(&PhSettingsLock);
+    // Parse the file straight into the settings hashtable. The lock is only acquired once for
+    // the whole file.
 
-            {
-                PPH_SETTING setting;
-
-                setting = PhpLookupSetting(&settingName->sr);
-
-                if (setting)
-                {
-                    PhpFreeSettingValue(setting->Type, setting);
-
-                    if (!PhpSettingFromString(
-                        setting->Type,
-                        &settingValue->sr,
-                        settingValue,
-                        setting
-                        ))
-                    {
-                        PhpSettingFromString(
-                            setting->Type,
-                            &setting->DefaultValue,
-                            NULL,
-                            setting
-                            );
-                    }
-                }
-                else
-                {
-                    setting = PhAllocate(sizeof(PH_SETTING));
-                    setting->Name.Buffer = PhAllocateCopy(settingName->Buffer, settingName->Length + sizeof(WCHAR));
-                    setting->Name.Length = settingName->Length;
-                    PhReferenceObject(settingValue);
-                    setting->u.Pointer = settingValue;
-
-                    PhAddItemList(PhIgnoredSettings, setting);
-                }
-            }
+    context.TopNode = NULL;
 
-            PhReleaseQueuedLockExclusive(&PhSettingsLock);
+    PhAcquireQueuedLockExclusive(&PhSettingsLock);
+    topNode = mxmlSAXLoadFd(NULL, fileHandle, MXML_OPAQUE_CALLBACK, PhpSettingsLoadSaxCallback, &context);
+    generation = PhpSettingsGeneration;
+    PhReleaseQueuedLockExclusive(&PhSettingsLock);
 
-            PhDereferenceObject(settingValue);
-            PhDereferenceObject(settingName);
-        }
+    NtClose(fileHandle);
 
-        currentNode = currentNode->next;
+    if (!topNode || topNode != context.TopNode || topNode->type != MXML_ELEMENT)
+    {
+        if (topNode)
+            mxmlDelete(topNode);
+
+        // Don't keep the settings which were applied before the error.
+        PhResetSettings();
+        PhpClearIgnoredSettings();
+
+        return STATUS_FILE_CORRUPT_ERROR;
     }
 
     mxmlDelete(topNode);
 
+    PhpSetSettingsFileState(FileName, &fileInformation, generation);
+
+    if (PhpSettingsUseCache)
+        PhpUpdateSettingsCache(FileName, &fileInformation);
+
     PhUpdateCachedSettings();
 
     return STATUS_SUCCESS;
@@ -1063,23 +1591,55 @@ mxml_node_t *PhpCreateSettingElement(
     return settingNode;
 }
 
+/**
+ * Saves settings to a file. Nothing is written if the settings have not changed since they were
+ * last loaded from or saved to the same file, and the file has not been modified since.
+ *
+ * \param FileName The file name of the settings file.
+ */
 NTSTATUS PhSaveSettings(
     _In_ PWSTR FileName
     )
 {
+    static PH_STRINGREF tempSuffix = PH_STRINGREF_INIT(L".tmp");
     NTSTATUS status;
     HANDLE fileHandle;
+    FILE_NETWORK_OPEN_INFORMATION fileInformation;
+    IO_STATUS_BLOCK isb;
+    PH_STRINGREF fileName;
+    PPH_STRING tempFileName;
     mxml_node_t *topNode;
-    PH_HASHTABLE_ENUM_CONTEXT enumContext;
+    PH_FLAT_HASHTABLE_ENUM_CONTEXT enumContext;
     PPH_SETTING setting;
+    ULONG generation;
+
+    PhInitializeStringRefLongHint(&fileName, FileName);
+
+    PhAcquireQueuedLockShared(&PhSettingsLock);
+    generation = PhpSettingsGeneration;
+    PhReleaseQueuedLockShared(&PhSettingsLock);
+
+    if (
+        generation == PhpSettingsSavedGeneration &&
+        PhpSettingsFileName &&
+        PhEqualStringRef(&PhpSettingsFileName->sr, &fileName, TRUE) &&
+        NT_SUCCESS(PhQueryFullAttributesFileWin32(FileName, &fileInformation)) &&
+        fileInformation.LastWriteTime.QuadPart == PhpSettingsFileLastWriteTime.QuadPart &&
+        fileInformation.EndOfFile.QuadPart == PhpSettingsFileEndOfFile.QuadPart
+        )
+    {
+        return STATUS_SUCCESS;
+    }
 
     topNode = mxmlNewElement(MXML_NO_PARENT, "settings");
 
     PhAcquireQueuedLockShared(&PhSettingsLock);
 
-    PhBeginEnumHashtable(PhSettingsHashtable, &enumContext);
+    generation = PhpSettingsGeneration;
+
+    PhBeginEnumFlatHashtable(PhSettingsHashtable, &enumContext);
 
-    while (setting = PhNextEnumHashtable(&enumContext))
+    while (setting = PhNextEnumFlatHashtable(&enumContext))
     {
         PPH_STRING settingValue;
 
@@ -1125,9 +1685,14 @@ NTSTATUS PhSaveSettings(
         }
     }
 
+    // Write to a temporary file and move it over the settings file, so a crash or a full disk
+    // never leaves us with a truncated settings file.
+
+    tempFileName = PhConcatStringRef2(&fileName, &tempSuffix);
+
     status = PhCreateFileWin32(
         &fileHandle,
-        FileName,
+        tempFileName->Buffer,
         FILE_GENERIC_WRITE,
         0,
         FILE_SHARE_READ,
@@ -1135,15 +1700,62 @@ NTSTATUS PhSaveSettings(
         FILE_NON_DIRECTORY_FILE | FILE_SYNCHRONOUS_IO_NONALERT
         );
 
+    if (NT_SUCCESS(status))
+    {
+        if (mxmlSaveFd(topNode, fileHandle, PhpSettingsSaveCallback) == -1)
+            status = STATUS_UNSUCCESSFUL;
+        if (NT_SUCCESS(status))
+            status = NtFlushBuffersFile(fileHandle, &isb);
+
+        NtClose(fileHandle);
+
+        if (NT_SUCCESS(status) && !MoveFileEx(tempFileName->Buffer, FileName, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH))
+            status = PhDosErrorToNtStatus(GetLastError());
+
+        if (!NT_SUCCESS(status))
+            PhDeleteFileWin32(tempFileName->Buffer);
+    }
+
     if (!NT_SUCCESS(status))
     {
-        mxmlDelete(topNode);
-        return status;
+        // We may be allowed to write to the settings file but not to create files next to it,
+        // or the settings file may be open without delete sharing. Overwrite it in place.
+        status = PhCreateFileWin32(
+            &fileHandle,
+            FileName,
+            FILE_GENERIC_WRITE,
+            0,
+            FILE_SHARE_READ,
+            FILE_OVERWRITE_IF,
+            FILE_NON_DIRECTORY_FILE | FILE_SYNCHRONOUS_IO_NONALERT
+            );
+
+        if (NT_SUCCESS(status))
+        {
+            if (mxmlSaveFd(topNode, fileHandle, PhpSettingsSaveCallback) == -1)
+                status = STATUS_UNSUCCESSFUL;
+
+            NtClose(fileHandle);
+        }
     }
 
-    mxmlSaveFd(topNode, fileHandle, PhpSettingsSaveCallback);
+    PhDereferenceObject(tempFileName);
     mxmlDelete(topNode);
-    NtClose(fileHandle);
+
+    if (!NT_SUCCESS(status))
+        return status;
+
+    if (NT_SUCCESS(PhQueryFullAttributesFileWin32(FileName, &fileInformation)))
+    {
+        PhpSetSettingsFileState(FileName, &fileInformation, generation);
+
+        if (PhpSettingsUseCache)
+            PhpUpdateSettingsCache(FileName, &fileInformation);
+    }
+    else
+    {
+        PhpSetSettingsFileState(FileName, NULL, generation);
+    }
 
     return STATUS_SUCCESS;
 }
@@ -1152,19 +1764,21 @@ VOID PhResetSettings(
     VOID
     )
 {
-    PH_HASHTABLE_ENUM_CONTEXT enumContext;
+    PH_FLAT_HASHTABLE_ENUM_CONTEXT enumContext;
     PPH_SETTING setting;
 
     PhAcquireQueuedLockExclusive(&PhSettingsLock);
 
-    PhBeginEnumHashtable(PhSettingsHashtable, &enumContext);
+    PhBeginEnumFlatHashtable(PhSettingsHashtable, &enumContext);
 
-    while (setting = PhNextEnumHashtable(&enumContext))
+    while (setting = PhNextEnumFlatHashtable(&enumContext))
     {
         PhpFreeSettingValue(setting->Type, setting);
         PhpSettingFromString(setting->Type, &setting->DefaultValue, NULL, setting);
     }
 
+    PhpSettingsGeneration++;
+
     PhReleaseQueuedLockExclusive(&PhSettingsLock);
 }
 
@@ -27,21 +27,34 @@
 #include <math.h>
 #include <windowsx.h>
 
+#include <emenu.h>
+
 #include <procprv.h>
 #include <settings.h>
 
+#define CPU_HISTORY_MENU_RECENT 1
+#define CPU_HISTORY_MENU_SECONDS 2
+#define CPU_HISTORY_MENU_MINUTES 3
+#define CPU_HISTORY_MENU_HOURS 4
+
 static PPH_SYSINFO_SECTION CpuSection;
 static HWND CpuDialog;
 static PH_LAYOUT_MANAGER CpuLayoutManager;
 static RECT CpuGraphMargin;
 static HWND CpuGraphHandle;
 static PH_GRAPH_STATE CpuGraphState;
+static ULONG CpuGraphHistoryLevel; // -1 for recent history, otherwise a history file level
 static HWND *CpusGraphHandle;
 static PPH_GRAPH_STATE CpusGraphState;
 static BOOLEAN OneGraphPerCpu;
+static HWND *NodesGraphHandle;
+static PPH_GRAPH_STATE NodesGraphState;
+static BOOLEAN OneGraphPerNode;
 static HWND CpuPanel;
 static ULONG CpuTicked;
 static ULONG NumberOfProcessors;
+static ULONG NumberOfGroupProcessors;
+static ULONG NumberOfNodes; // 0 if there is only one node
 static PSYSTEM_INTERRUPT_INFORMATION InterruptInformation;
 static PPROCESSOR_POWER_INFORMATION PowerInformation;
 static PSYSTEM_PROCESSOR_PERFORMANCE_DISTRIBUTION CurrentPerformanceDistribution;
@@ -149,17 +162,26 @@ VOID PhSipInitializeCpuDialog(
     PhInitializeDelta(&DpcsDelta);
     PhInitializeDelta(&SystemCallsDelta);
 
-    NumberOfProcessors = (ULONG)PhSystemBasicInformation.NumberOfProcessors;
+    NumberOfProcessors = PhCpuTopology.NumberOfProcessors;
+    // Power information and the performance distribution only cover our own processor group.
+    NumberOfGroupProcessors = (ULONG)PhSystemBasicInformation.NumberOfProcessors;
     CpusGraphHandle = PhAllocate(sizeof(HWND) * NumberOfProcessors);
     CpusGraphState = PhAllocate(sizeof(PH_GRAPH_STATE) * NumberOfProcessors);
+    NumberOfNodes = PhCpuTopology.NumberOfNodes > 1 ? PhCpuTopology.NumberOfNodes : 0;
+    NodesGraphHandle = PhAllocate(sizeof(HWND) * NumberOfNodes);
+    NodesGraphState = PhAllocate(sizeof(PH_GRAPH_STATE) * NumberOfNodes);
     InterruptInformation = PhAllocate(sizeof(SYSTEM_INTERRUPT_INFORMATION) * NumberOfProcessors);
-    PowerInformation = PhAllocate(sizeof(PROCESSOR_POWER_INFORMATION) * NumberOfProcessors);
+    PowerInformation = PhAllocate(sizeof(PROCESSOR_POWER_INFORMATION) * NumberOfGroupProcessors);
 
     PhInitializeGraphState(&CpuGraphState);
+    CpuGraphHistoryLevel = -1;
 
     for (i = 0; i < NumberOfProcessors; i++)
         PhInitializeGraphState(&CpusGraphState[i]);
 
+    for (i = 0; i < NumberOfNodes; i++)
+        PhInitializeGraphState(&NodesGraphState[i]);
+
     CpuTicked = 0;
 
     if (!NT_SUCCESS(NtPowerInformation(
@@ -167,10 +189,10 @@ VOID PhSipInitializeCpuDialog(
         NULL,
         0,
         PowerInformation,
-        sizeof(PROCESSOR_POWER_INFORMATION) * NumberOfProcessors
+        sizeof(PROCESSOR_POWER_INFORMATION) * NumberOfGroupProcessors
         )))
     {
-        memset(PowerInformation, 0, sizeof(PROCESSOR_POWER_INFORMATION) * NumberOfProcessors);
+        memset(PowerInformation, 0, sizeof(PROCESSOR_POWER_INFORMATION) * NumberOfGroupProcessors);
     }
 
     CurrentPerformanceDistribution = NULL;
@@ -191,8 +213,13 @@ VOID PhSipUninitializeCpuDialog(
     for (i = 0; i < NumberOfProcessors; i++)
         PhDeleteGraphState(&CpusGraphState[i]);
 
+    for (i = 0; i < NumberOfNodes; i++)
+        PhDeleteGraphState(&NodesGraphState[i]);
+
     PhFree(CpusGraphHandle);
     PhFree(CpusGraphState);
+    PhFree(NodesGraphHandle);
+    PhFree(NodesGraphState);
     PhFree(InterruptInformation);
     PhFree(PowerInformation);
 
@@ -202,6 +229,9 @@ VOID PhSipUninitializeCpuDialog(
         PhFree(PreviousPerformanceDistribution);
 
     PhSetIntegerSetting(L"SysInfoWindowOneGraphPerCpu", OneGraphPerCpu);
+
+    if (NumberOfNodes != 0)
+        PhSetIntegerSetting(L"SysInfoWindowOneGraphPerNode", OneGraphPerNode);
 }
 
 VOID PhSipTickCpuDialog(
@@ -213,11 +243,11 @@ VOID PhSipTickCpuDialog(
 
     dpcCount = 0;
 
-    if (NT_SUCCESS(NtQuerySystemInformation(
+    if (NT_SUCCESS(PhQueryProcessorInformation(
+        &PhCpuTopology,
         SystemInterruptInformation,
-        InterruptInformation,
-        sizeof(SYSTEM_INTERRUPT_INFORMATION) * NumberOfProcessors,
-        NULL
+        sizeof(SYSTEM_INTERRUPT_INFORMATION),
+        InterruptInformation
         )))
     {
         for (i = 0; i < NumberOfProcessors; i++)
@@ -234,10 +264,10 @@ VOID PhSipTickCpuDialog(
         NULL,
         0,
         PowerInformation,
-        sizeof(PROCESSOR_POWER_INFORMATION) * NumberOfProcessors
+        sizeof(PROCESSOR_POWER_INFORMATION) * NumberOfGroupProcessors
         )))
     {
-        memset(PowerInformation, 0, sizeof(PROCESSOR_POWER_INFORMATION) * NumberOfProcessors);
+        memset(PowerInformation, 0, sizeof(PROCESSOR_POWER_INFORMATION) * NumberOfGroupProcessors);
     }
 
     if (WindowsVersion >= WINDOWS_7)
@@ -299,15 +329,26 @@ INT_PTR CALLBACK PhSipCpuDialogProc(
             {
                 OneGraphPerCpu = (BOOLEAN)PhGetIntegerSetting(L"SysInfoWindowOneGraphPerCpu");
                 Button_SetCheck(GetDlgItem(CpuPanel, IDC_ONEGRAPHPERCPU), OneGraphPerCpu ? BST_CHECKED : BST_UNCHECKED);
-                PhSipSetOneGraphPerCpu();
             }
             else
             {
                 OneGraphPerCpu = FALSE;
                 EnableWindow(GetDlgItem(CpuPanel, IDC_ONEGRAPHPERCPU), FALSE);
-                PhSipSetOneGraphPerCpu();
             }
 
+            if (NumberOfNodes != 0)
+            {
+                OneGraphPerNode = !OneGraphPerCpu && PhGetIntegerSetting(L"SysInfoWindowOneGraphPerNode");
+                Button_SetCheck(GetDlgItem(CpuPanel, IDC_ONEGRAPHPERNODE), OneGraphPerNode ? BST_CHECKED : BST_UNCHECKED);
+            }
+            else
+            {
+                OneGraphPerNode = FALSE;
+                ShowWindow(GetDlgItem(CpuPanel, IDC_ONEGRAPHPERNODE), SW_HIDE);
+            }
+
+            PhSipSetOneGraphPerCpu();
+
             PhSipUpdateCpuGraphs();
             PhSipUpdateCpuPanel();
         }
@@ -339,6 +380,15 @@ INT_PTR CALLBACK PhSipCpuDialogProc(
                     if (header->hwndFrom == CpusGraphHandle[i])
                     {
                         PhSipNotifyCpuGraph(i, header);
+                        return FALSE;
+                    }
+                }
+
+                for (i = 0; i < NumberOfNodes; i++)
+                {
+                    if (header->hwndFrom == NodesGraphHandle[i])
+                    {
+                        PhSipNotifyCpuNodeGraph(i, header);
                         break;
                     }
                 }
@@ -372,6 +422,27 @@ INT_PTR CALLBACK PhSipCpuPanelDialogProc(
             case IDC_ONEGRAPHPERCPU:
                 {
                     OneGraphPerCpu = Button_GetCheck(GetDlgItem(hwndDlg, IDC_ONEGRAPHPERCPU)) == BST_CHECKED;
+
+                    if (OneGraphPerCpu && OneGraphPerNode)
+                    {
+                        OneGraphPerNode = FALSE;
+                        Button_SetCheck(GetDlgItem(hwndDlg, IDC_ONEGRAPHPERNODE), BST_UNCHECKED);
+                    }
+
+                    PhSipLayoutCpuGraphs();
+                    PhSipSetOneGraphPerCpu();
+                }
+                break;
+            case IDC_ONEGRAPHPERNODE:
+                {
+                    OneGraphPerNode = Button_GetCheck(GetDlgItem(hwndDlg, IDC_ONEGRAPHPERNODE)) == BST_CHECKED;
+
+                    if (OneGraphPerNode && OneGraphPerCpu)
+                    {
+                        OneGraphPerCpu = FALSE;
+                        Button_SetCheck(GetDlgItem(hwndDlg, IDC_ONEGRAPHPERCPU), BST_UNCHECKED);
+                    }
+
                     PhSipLayoutCpuGraphs();
                     PhSipSetOneGraphPerCpu();
                 }
@@ -422,6 +493,100 @@ VOID PhSipCreateCpuGraphs(
             );
         Graph_SetTooltip(CpusGraphHandle[i], TRUE);
     }
+
+    for (i = 0; i < NumberOfNodes; i++)
+    {
+        NodesGraphHandle[i] = CreateWindow(
+            PH_GRAPH_CLASSNAME,
+            NULL,
+            WS_CHILD | WS_BORDER,
+            0,
+            0,
+            3,
+            3,
+            CpuDialog,
+            NULL,
+            PhInstanceHandle,
+            NULL
+            );
+        Graph_SetTooltip(NodesGraphHandle[i], TRUE);
+    }
+}
+
+static HDWP PhSipLayoutCpuGraphGrid(
+    _In_ HDWP DeferHandle,
+    _In_ PRECT ClientRect,
+    _In_reads_(NumberOfGraphs) HWND *GraphHandles,
+    _In_ ULONG NumberOfGraphs
+    )
+{
+    HDWP deferHandle = DeferHandle;
+    ULONG numberOfRows = 1;
+    ULONG numberOfColumns = NumberOfGraphs;
+
+    for (ULONG rows = 2; rows <= NumberOfGraphs / rows; rows++)
+    {
+        if (NumberOfGraphs % rows != 0)
+            continue;
+
+        numberOfRows = rows;
+        numberOfColumns = NumberOfGraphs / rows;
+    }
+
+    if (numberOfRows == 1)
+    {
+        numberOfRows = (ULONG)sqrt(NumberOfGraphs);
+        numberOfColumns = (NumberOfGraphs + numberOfRows - 1) / numberOfRows;
+    }
+
+    ULONG numberOfYPaddings = numberOfRows - 1;
+    ULONG numberOfXPaddings = numberOfColumns - 1;
+
+    ULONG cellHeight = (ClientRect->bottom - CpuGraphMargin.top - CpuGraphMargin.bottom - CpuSection->Parameters->CpuPadding * numberOfYPaddings) / numberOfRows;
+    ULONG y = CpuGraphMargin.top;
+    ULONG cellWidth;
+    ULONG x;
+    ULONG i = 0;
+
+    for (ULONG row = 0; row < numberOfRows; row++)
+    {
+        // Give the last row the remaining space; the height we calculated might be off by a few
+        // pixels due to integer division.
+        if (row == numberOfRows - 1)
+            cellHeight = ClientRect->bottom - CpuGraphMargin.bottom - y;
+
+        cellWidth = (ClientRect->right - CpuGraphMargin.left - CpuGraphMargin.right - CpuSection->Parameters->CpuPadding * numberOfXPaddings) / numberOfColumns;
+        x = CpuGraphMargin.left;
+
+        for (ULONG column = 0; column < numberOfColumns; column++)
+        {
+            // Give the last cell the remaining space; the width we calculated might be off by a few
+            // pixels due to integer division.
+            if (column == numberOfColumns - 1)
+                cellWidth = ClientRect->right - CpuGraphMargin.right - x;
+
+            if (i < NumberOfGraphs)
+            {
+                deferHandle = DeferWindowPos(
+                    deferHandle,
+                    GraphHandles[i],
+                    NULL,
+                    x,
+                    y,
+                    cellWidth,
+                    cellHeight,
+                    SWP_NOACTIVATE | SWP_NOZORDER
+                    );
+                i++;
+            }
+
+            x += cellWidth + CpuSection->Parameters->CpuPadding;
+        }
+
+        y += cellHeight + CpuSection->Parameters->CpuPadding;
+    }
+
+    return deferHandle;
 }
 
 VOID PhSipLayoutCpuGraphs(
@@ -432,10 +597,20 @@ VOID PhSipLayoutCpuGraphs(
     HDWP deferHandle;
 
     GetClientRect(CpuDialog, &clientRect);
-    deferHandle = BeginDeferWindowPos(OneGraphPerCpu ? NumberOfProcessors : 1);
 
-    if (!OneGraphPerCpu)
+    if (OneGraphPerCpu)
+    {
+        deferHandle = BeginDeferWindowPos(NumberOfProcessors);
+        deferHandle = PhSipLayoutCpuGraphGrid(deferHandle, &clientRect, CpusGraphHandle, NumberOfProcessors);
+    }
+    else if (OneGraphPerNode)
+    {
+        deferHandle = BeginDeferWindowPos(NumberOfNodes);
+        deferHandle = PhSipLayoutCpuGraphGrid(deferHandle, &clientRect, NodesGraphHandle, NumberOfNodes);
+    }
+    else
     {
+        deferHandle = BeginDeferWindowPos(1);
         deferHandle = DeferWindowPos(
             deferHandle,
             CpuGraphHandle,
@@ -447,73 +622,6 @@ VOID PhSipLayoutCpuGraphs(
             SWP_NOACTIVATE | SWP_NOZORDER
             );
     }
-    else
-    {
-        ULONG numberOfRows = 1;
-        ULONG numberOfColumns = NumberOfProcessors;
-
-        for (ULONG rows = 2; rows <= NumberOfProcessors / rows; rows++)
-        {
-            if (NumberOfProcessors % rows != 0)
-                continue;
-
-            numberOfRows = rows;
-            numberOfColumns = NumberOfProcessors / rows;
-        }
-
-        if (numberOfRows == 1)
-        {
-            numberOfRows = (ULONG)sqrt(NumberOfProcessors);
-            numberOfColumns = (NumberOfProcessors + numberOfRows - 1) / numberOfRows;
-        }
-
-        ULONG numberOfYPaddings = numberOfRows - 1;
-        ULONG numberOfXPaddings = numberOfColumns - 1;
-
-        ULONG cellHeight = (clientRect.bottom - CpuGraphMargin.top - CpuGraphMargin.bottom - CpuSection->Parameters->CpuPadding * numberOfYPaddings) / numberOfRows;
-        ULONG y = CpuGraphMargin.top;
-        ULONG cellWidth;
-        ULONG x;
-        ULONG i = 0;
-
-        for (ULONG row = 0; row < numberOfRows; row++)
-        {
-            // Give the last row the remaining space; the height we calculated might be off by a few
-            // pixels due to integer division.
-            if (row == numberOfRows - 1)
-                cellHeight = clientRect.bottom - CpuGraphMargin.bottom - y;
-
-            cellWidth = (clientRect.right - CpuGraphMargin.left - CpuGraphMargin.right - CpuSection->Parameters->CpuPadding * numberOfXPaddings) / numberOfColumns;
-            x = CpuGraphMargin.left;
-
-            for (ULONG column = 0; column < numberOfColumns; column++)
-            {
-                // Give the last cell the remaining space; the width we calculated might be off by a few
-                // pixels due to integer division.
-                if (column == numberOfColumns - 1)
-                    cellWidth = clientRect.right - CpuGraphMargin.right - x;
-
-                if (i < NumberOfProcessors)
-                {
-                    deferHandle = DeferWindowPos(
-                        deferHandle,
-                        CpusGraphHandle[i],
-                        NULL,
-                        x,
-                        y,
-                        cellWidth,
-                        cellHeight,
-                        SWP_NOACTIVATE | SWP_NOZORDER
-                        );
-                    i++;
-                }
-
-                x += cellWidth + CpuSection->Parameters->CpuPadding;
-            }
-
-            y += cellHeight + CpuSection->Parameters->CpuPadding;
-        }
-    }
 
     EndDeferWindowPos(deferHandle);
 }
@@ -524,12 +632,17 @@ VOID PhSipSetOneGraphPerCpu(
 {
     ULONG i;
 
-    ShowWindow(CpuGraphHandle, !OneGraphPerCpu ? SW_SHOW : SW_HIDE);
+    ShowWindow(CpuGraphHandle, !OneGraphPerCpu && !OneGraphPerNode ? SW_SHOW : SW_HIDE);
 
     for (i = 0; i < NumberOfProcessors; i++)
     {
         ShowWindow(CpusGraphHandle[i], OneGraphPerCpu ? SW_SHOW : SW_HIDE);
     }
+
+    for (i = 0; i < NumberOfNodes; i++)
+    {
+        ShowWindow(NodesGraphHandle[i], OneGraphPerNode ? SW_SHOW : SW_HIDE);
+    }
 }
 
 VOID PhSipNotifyCpuGraph(
@@ -547,7 +660,27 @@ VOID PhSipNotifyCpuGraph(
             drawInfo->Flags = PH_GRAPH_USE_GRID_X | PH_GRAPH_USE_GRID_Y | PH_GRAPH_USE_LINE_2;
             PhSiSetColorsGraphDrawInfo(drawInfo, PhCsColorCpuKernel, PhCsColorCpuUser);
 
-            if (Index == -1)
+            if (Index == -1 && CpuGraphHistoryLevel != -1)
+            {
+                PhGraphStateGetDrawInfo(
+                    &CpuGraphState,
+                    getDrawInfo,
+                    PhGetCountSystemHistoryFile(CpuGraphHistoryLevel)
+                    );
+
+                if (!CpuGraphState.Valid)
+                {
+                    ULONG count;
+
+                    // Rows can disappear if the file is closed in the meantime.
+                    count = PhCopySystemHistoryFile(CpuGraphHistoryLevel, PH_HISTORY_FILE_CPU_KERNEL, CpuGraphState.Data1, drawInfo->LineDataCount);
+                    memset(CpuGraphState.Data1 + count, 0, (drawInfo->LineDataCount - count) * sizeof(FLOAT));
+                    count = PhCopySystemHistoryFile(CpuGraphHistoryLevel, PH_HISTORY_FILE_CPU_USER, CpuGraphState.Data2, drawInfo->LineDataCount);
+                    memset(CpuGraphState.Data2 + count, 0, (drawInfo->LineDataCount - count) * sizeof(FLOAT));
+                    CpuGraphState.Valid = TRUE;
+                }
+            }
+            else if (Index == -1)
             {
                 PhGraphStateGetDrawInfo(
                     &CpuGraphState,
@@ -585,7 +718,39 @@ VOID PhSipNotifyCpuGraph(
 
             if (getTooltipText->Index < getTooltipText->TotalCount)
             {
-                if (Index == -1)
+                if (Index == -1 && CpuGraphHistoryLevel != -1)
+                {
+                    if (CpuGraphState.TooltipIndex != getTooltipText->Index)
+                    {
+                        FLOAT cpuKernel;
+                        FLOAT cpuUser;
+                        LARGE_INTEGER time;
+                        SYSTEMTIME systemTime;
+
+                        if (PhGetSampleSystemHistoryFile(CpuGraphHistoryLevel, getTooltipText->Index,
+                            PH_HISTORY_FILE_CPU_KERNEL, &time, &cpuKernel, NULL) &&
+                            PhGetSampleSystemHistoryFile(CpuGraphHistoryLevel, getTooltipText->Index,
+                            PH_HISTORY_FILE_CPU_USER, NULL, &cpuUser, NULL))
+                        {
+                            PhLargeIntegerToLocalSystemTime(&systemTime, &time);
+
+                            PhMoveReference(&CpuGraphState.TooltipText, PhFormatString(
+                                L"%.2f%% (K: %.2f%%, U: %.2f%%)\n%s",
+                                (cpuKernel + cpuUser) * 100,
+                                cpuKernel * 100,
+                                cpuUser * 100,
+                                PH_AUTO_T(PH_STRING, PhFormatDateTime(&systemTime))->Buffer
+                                ));
+                        }
+                        else
+                        {
+                            PhMoveReference(&CpuGraphState.TooltipText, PhCreateString(L"Unknown time"));
+                        }
+                    }
+
+                    getTooltipText->Text = CpuGraphState.TooltipText->sr;
+                }
+                else if (Index == -1)
                 {
                     if (CpuGraphState.TooltipIndex != getTooltipText->Index)
                     {
@@ -637,7 +802,15 @@ VOID PhSipNotifyCpuGraph(
 
             record = NULL;
 
-            if (mouseEvent->Message == WM_LBUTTONDBLCLK && mouseEvent->Index < mouseEvent->TotalCount)
+            if (Index == -1 && mouseEvent->Message == WM_RBUTTONUP)
+            {
+                PhSipShowCpuHistoryMenu(Header->hwndFrom, mouseEvent->Point);
+                break;
+            }
+
+            // Process records only cover the recent history.
+            if (mouseEvent->Message == WM_LBUTTONDBLCLK && mouseEvent->Index < mouseEvent->TotalCount &&
+                (Index != -1 || CpuGraphHistoryLevel == -1))
             {
                 record = PhSipReferenceMaxCpuRecord(mouseEvent->Index);
             }
@@ -652,6 +825,66 @@ VOID PhSipNotifyCpuGraph(
     }
 }
 
+VOID PhSipNotifyCpuNodeGraph(
+    _In_ ULONG Index,
+    _In_ NMHDR *Header
+    )
+{
+    switch (Header->code)
+    {
+    case GCN_GETDRAWINFO:
+        {
+            PPH_GRAPH_GETDRAWINFO getDrawInfo = (PPH_GRAPH_GETDRAWINFO)Header;
+            PPH_GRAPH_DRAW_INFO drawInfo = getDrawInfo->DrawInfo;
+
+            drawInfo->Flags = PH_GRAPH_USE_GRID_X | PH_GRAPH_USE_GRID_Y | PH_GRAPH_USE_LINE_2;
+            PhSiSetColorsGraphDrawInfo(drawInfo, PhCsColorCpuKernel, PhCsColorCpuUser);
+
+            PhGraphStateGetDrawInfo(
+                &NodesGraphState[Index],
+                getDrawInfo,
+                PhCpuKernelHistory.Count
+                );
+
+            if (!NodesGraphState[Index].Valid)
+            {
+                PhCopyCircularBuffer_FLOAT(&PhCpuNodesKernelHistory[Index], NodesGraphState[Index].Data1, drawInfo->LineDataCount);
+                PhCopyCircularBuffer_FLOAT(&PhCpuNodesUserHistory[Index], NodesGraphState[Index].Data2, drawInfo->LineDataCount);
+                NodesGraphState[Index].Valid = TRUE;
+            }
+        }
+        break;
+    case GCN_GETTOOLTIPTEXT:
+        {
+            PPH_GRAPH_GETTOOLTIPTEXT getTooltipText = (PPH_GRAPH_GETTOOLTIPTEXT)Header;
+
+            if (getTooltipText->Index < getTooltipText->TotalCount)
+            {
+                if (NodesGraphState[Index].TooltipIndex != getTooltipText->Index)
+                {
+                    FLOAT cpuKernel;
+                    FLOAT cpuUser;
+
+                    cpuKernel = PhGetItemCircularBuffer_FLOAT(&PhCpuNodesKernelHistory[Index], getTooltipText->Index);
+                    cpuUser = PhGetItemCircularBuffer_FLOAT(&PhCpuNodesUserHistory[Index], getTooltipText->Index);
+
+                    PhMoveReference(&NodesGraphState[Index].TooltipText, PhFormatString(
+                        L"Node %lu: %.2f%% (K: %.2f%%, U: %.2f%%)\n%s",
+                        Index,
+                        (cpuKernel + cpuUser) * 100,
+                        cpuKernel * 100,
+                        cpuUser * 100,
+                        PH_AUTO_T(PH_STRING, PhGetStatisticsTimeString(NULL, getTooltipText->Index))->Buffer
+                        ));
+                }
+
+                getTooltipText->Text = NodesGraphState[Index].TooltipText->sr;
+            }
+        }
+        break;
+    }
+}
+
 VOID PhSipUpdateCpuGraphs(
     VOID
     )
@@ -660,7 +893,11 @@ VOID PhSipUpdateCpuGraphs(
 
     CpuGraphState.Valid = FALSE;
     CpuGraphState.TooltipIndex = -1;
-    Graph_MoveGrid(CpuGraphHandle, 1);
+
+    // Rows of the other history file levels are added much less often than once per update.
+    if (CpuGraphHistoryLevel == -1 || CpuGraphHistoryLevel == PH_HISTORY_FILE_LEVEL_SECOND)
+        Graph_MoveGrid(CpuGraphHandle, 1);
+
     Graph_Draw(CpuGraphHandle);
     Graph_UpdateTooltip(CpuGraphHandle);
     InvalidateRect(CpuGraphHandle, NULL, FALSE);
@@ -674,6 +911,88 @@ VOID PhSipUpdateCpuGraphs(
         Graph_UpdateTooltip(CpusGraphHandle[i]);
         InvalidateRect(CpusGraphHandle[i], NULL, FALSE);
     }
+
+    for (i = 0; i < NumberOfNodes; i++)
+    {
+        NodesGraphState[i].Valid = FALSE;
+        NodesGraphState[i].TooltipIndex = -1;
+        Graph_MoveGrid(NodesGraphHandle[i], 1);
+        Graph_Draw(NodesGraphHandle[i]);
+        Graph_UpdateTooltip(NodesGraphHandle[i]);
+        InvalidateRect(NodesGraphHandle[i], NULL, FALSE);
+    }
+}
+
+VOID PhSipShowCpuHistoryMenu(
+    _In_ HWND GraphHandle,
+    _In_ POINT Point
+    )
+{
+    PPH_EMENU menu;
+    PPH_EMENU_ITEM menuItem;
+    PPH_EMENU_ITEM selectedItem;
+    ULONG id;
+
+    // The long-term history is only available when the history file is enabled.
+    if (PhGetCountSystemHistoryFile(PH_HISTORY_FILE_LEVEL_SECOND) == 0)
+        return;
+
+    menu = PhCreateEMenu();
+    PhInsertEMenuItem(menu, PhCreateEMenuItem(0, CPU_HISTORY_MENU_RECENT, L"Recent", NULL, NULL), -1);
+    PhInsertEMenuItem(menu, PhCreateEMenuItem(PH_EMENU_SEPARATOR, 0, L"", NULL, NULL), -1);
+    PhInsertEMenuItem(menu, PhCreateEMenuItem(0, CPU_HISTORY_MENU_SECONDS, L"Last 6 hours, by second", NULL, NULL), -1);
+    PhInsertEMenuItem(menu, PhCreateEMenuItem(0, CPU_HISTORY_MENU_MINUTES, L"Last week, by minute", NULL, NULL), -1);
+    PhInsertEMenuItem(menu, PhCreateEMenuItem(0, CPU_HISTORY_MENU_HOURS, L"Last year, by hour", NULL, NULL), -1);
+
+    switch (CpuGraphHistoryLevel)
+    {
+    case PH_HISTORY_FILE_LEVEL_SECOND:
+        id = CPU_HISTORY_MENU_SECONDS;
+        break;
+    case PH_HISTORY_FILE_LEVEL_MINUTE:
+        id = CPU_HISTORY_MENU_MINUTES;
+        break;
+    case PH_HISTORY_FILE_LEVEL_HOUR:
+        id = CPU_HISTORY_MENU_HOURS;
+        break;
+    default:
+        id = CPU_HISTORY_MENU_RECENT;
+        break;
+    }
+
+    if (menuItem = PhFindEMenuItem(menu, 0, NULL, id))
+        menuItem->Flags |= PH_EMENU_CHECKED | PH_EMENU_RADIOCHECK;
+
+    ClientToScreen(GraphHandle, &Point);
+    selectedItem = PhShowEMenu(menu, CpuDialog, PH_EMENU_SHOW_LEFTRIGHT,
+        PH_ALIGN_LEFT | PH_ALIGN_TOP, Point.x, Point.y);
+
+    if (selectedItem)
+    {
+        switch (selectedItem->Id)
+        {
+        case CPU_HISTORY_MENU_RECENT:
+            CpuGraphHistoryLevel = -1;
+            break;
+        case CPU_HISTORY_MENU_SECONDS:
+            CpuGraphHistoryLevel = PH_HISTORY_FILE_LEVEL_SECOND;
+            break;
+        case CPU_HISTORY_MENU_MINUTES:
+            CpuGraphHistoryLevel = PH_HISTORY_FILE_LEVEL_MINUTE;
+            break;
+        case CPU_HISTORY_MENU_HOURS:
+            CpuGraphHistoryLevel = PH_HISTORY_FILE_LEVEL_HOUR;
+            break;
+        }
+
+        CpuGraphState.Valid = FALSE;
+        CpuGraphState.TooltipIndex = -1;
+        Graph_Draw(CpuGraphHandle);
+        Graph_UpdateTooltip(CpuGraphHandle);
+        InvalidateRect(CpuGraphHandle, NULL, FALSE);
+    }
+
+    PhDestroyEMenu(menu);
 }
 
 VOID PhSipUpdateCpuPanel(
@@ -853,13 +1172,13 @@ BOOLEAN PhSipGetCpuFrequencyFromDistribution(
 
     // Calculate the differences from the last performance distribution.
 
-    if (CurrentPerformanceDistribution->ProcessorCount != NumberOfProcessors || PreviousPerformanceDistribution->ProcessorCount != NumberOfProcessors)
+    if (CurrentPerformanceDistribution->ProcessorCount != NumberOfGroupProcessors || PreviousPerformanceDistribution->ProcessorCount != NumberOfGroupProcessors)
         return FALSE;
 
     stateSize = FIELD_OFFSET(SYSTEM_PROCESSOR_PERFORMANCE_STATE_DISTRIBUTION, States) + sizeof(SYSTEM_PROCESSOR_PERFORMANCE_HITCOUNT) * 2;
-    differences = PhAllocate(stateSize * NumberOfProcessors);
+    differences = PhAllocate(stateSize * NumberOfGroupProcessors);
 
-    for (i = 0; i < NumberOfProcessors; i++)
+    for (i = 0; i < NumberOfGroupProcessors; i++)
     {
         stateDistribution = (PSYSTEM_PROCESSOR_PERFORMANCE_STATE_DISTRIBUTION)((PCHAR)CurrentPerformanceDistribution + CurrentPerformanceDistribution->Offsets[i]);
         stateDifference = (PSYSTEM_PROCESSOR_PERFORMANCE_STATE_DISTRIBUTION)((PCHAR)differences + stateSize * i);
@@ -885,7 +1204,7 @@ BOOLEAN PhSipGetCpuFrequencyFromDistribution(
         }
     }
 
-    for (i = 0; i < NumberOfProcessors; i++)
+    for (i = 0; i < NumberOfGroupProcessors; i++)
     {
         stateDistribution = (PSYSTEM_PROCESSOR_PERFORMANCE_STATE_DISTRIBUTION)((PCHAR)PreviousPerformanceDistribution + PreviousPerformanceDistribution->Offsets[i]);
         stateDifference = (PSYSTEM_PROCESSOR_PERFORMANCE_STATE_DISTRIBUTION)((PCHAR)differences + stateSize * i);
@@ -915,7 +1234,7 @@ BOOLEAN PhSipGetCpuFrequencyFromDistribution(
     count = 0;
     total = 0;
 
-    for (i = 0; i < NumberOfProcessors; i++)
+    for (i = 0; i < NumberOfGroupProcessors; i++)
     {
         stateDifference = (PSYSTEM_PROCESSOR_PERFORMANCE_STATE_DISTRIBUTION)((PCHAR)differences + stateSize * i);
 
@@ -116,6 +116,22 @@ VOID PhpQueueThreadWorkQueueItem(
     PhQueueItemWorkQueue(&PhThreadProviderWorkQueue, Function, Context);
 }
 
+static PPH_SYMBOL_PROVIDER PhpGetKernelSymbolProvider(
+    VOID
+    )
+{
+    static PH_INITONCE initOnce = PH_INITONCE_INIT;
+    static PPH_SYMBOL_PROVIDER kernelSymbolProvider;
+
+    if (PhBeginInitOnce(&initOnce))
+    {
+        kernelSymbolProvider = PhCreateSymbolProvider(NULL);
+        PhEndInitOnce(&initOnce);
+    }
+
+    return kernelSymbolProvider;
+}
+
 PPH_THREAD_PROVIDER PhCreateThreadProvider(
     _In_ HANDLE ProcessId
     )
@@ -149,6 +165,9 @@ PPH_THREAD_PROVIDER PhCreateThreadProvider(
     {
         if (threadProvider->SymbolProvider->IsRealHandle)
             threadProvider->ProcessHandle = threadProvider->SymbolProvider->ProcessHandle;
+
+        if (ProcessId != SYSTEM_PROCESS_ID)
+            PhSetKernelSymbolProvider(threadProvider->SymbolProvider, PhpGetKernelSymbolProvider());
     }
 
     RtlInitializeSListHead(&threadProvider->QueryListHead);
@@ -251,7 +270,7 @@ static BOOLEAN LoadSymbolsEnumGenericModulesCallback(
         return TRUE;
     }
 
-    PhLoadModuleSymbolProvider(
+    PhAddModuleSymbolProvider(
         symbolProvider,
         Module->FileName->Buffer,
         (ULONG64)Module->BaseAddress,
@@ -275,7 +294,7 @@ static BOOLEAN LoadBasicSymbolsEnumGenericModulesCallback(
     if (PhEqualString2(Module->Name, L"ntdll.dll", TRUE) ||
         PhEqualString2(Module->Name, L"kernel32.dll", TRUE))
     {
-        PhLoadModuleSymbolProvider(
+        PhAddModuleSymbolProvider(
             symbolProvider,
             Module->FileName->Buffer,
             (ULONG64)Module->BaseAddress,
@@ -293,6 +312,9 @@ VOID PhLoadSymbolsThreadProvider(
     PH_THREAD_SYMBOL_LOAD_CONTEXT loadContext;
     ULONG64 runId;
 
+    // Modules are only added as address ranges here. The symbol provider loads the symbols for a
+    // module when an address inside it is resolved for the first time.
+
     loadContext.ThreadProvider = ThreadProvider;
     loadContext.SymbolProvider = ThreadProvider->SymbolProvider;
 
@@ -300,6 +322,8 @@ VOID PhLoadSymbolsThreadProvider(
     runId = ThreadProvider->RunId;
     PhLoadSymbolProviderOptions(ThreadProvider->SymbolProvider);
 
+    // System Idle Process has one thread for each CPU, each having a start address at KiIdleLoop,
+    // so we only need the kernel modules.
     if (ThreadProvider->ProcessId != SYSTEM_IDLE_PROCESS_ID)
     {
         if (ThreadProvider->SymbolProvider->IsRealHandle ||
@@ -326,49 +350,22 @@ VOID PhLoadSymbolsThreadProvider(
                 &loadContext
                 );
         }
-
-        // Load kernel module symbols as well.
-        if (ThreadProvider->ProcessId != SYSTEM_PROCESS_ID)
-        {
-            loadContext.ProcessId = SYSTEM_PROCESS_ID;
-            PhEnumGenericModules(
-                SYSTEM_PROCESS_ID,
-                NULL,
-                0,
-                LoadSymbolsEnumGenericModulesCallback,
-                &loadContext
-                );
-        }
     }
-    else
-    {
-        // System Idle Process has one thread for each CPU, each having a start address at
-        // KiIdleLoop. We need to load symbols for the kernel.
-
-        PRTL_PROCESS_MODULES kernelModules;
 
-        if (NT_SUCCESS(PhEnumKernelModules(&kernelModules)))
-        {
-            if (kernelModules->NumberOfModules > 0)
-            {
-                PPH_STRING fileName;
-                PPH_STRING newFileName;
-
-                fileName = PhConvertMultiByteToUtf16(kernelModules->Modules[0].FullPathName);
-                newFileName = PhGetFileName(fileName);
-                PhDereferenceObject(fileName);
-
-                PhLoadModuleSymbolProvider(
-                    ThreadProvider->SymbolProvider,
-                    newFileName->Buffer,
-                    (ULONG64)kernelModules->Modules[0].ImageBase,
-                    kernelModules->Modules[0].ImageSize
-                    );
-                PhDereferenceObject(newFileName);
-            }
-
-            PhFree(kernelModules);
-        }
+    // Load kernel module symbols as well. These go into the kernel symbol provider which is shared
+    // by all thread providers.
+    if (ThreadProvider->SymbolProvider->KernelSymbolProvider)
+    {
+        loadContext.ProcessId = SYSTEM_PROCESS_ID;
+        loadContext.SymbolProvider = ThreadProvider->SymbolProvider->KernelSymbolProvider;
+        PhLoadSymbolProviderOptions(loadContext.SymbolProvider);
+        PhEnumGenericModules(
+            SYSTEM_PROCESS_ID,
+            NULL,
+            0,
+            LoadSymbolsEnumGenericModulesCallback,
+            &loadContext
+            );
     }
 
     ThreadProvider->SymbolsLoadedRunId = runId;
@@ -653,7 +650,7 @@ static NTSTATUS PhpGetThreadCycleTime(
     }
     else
     {
-        if (HandleToUlong(ThreadItem->ThreadId) < (ULONG)PhSystemBasicInformation.NumberOfProcessors)
+        if (HandleToUlong(ThreadItem->ThreadId) < PhCpuTopology.NumberOfProcessors)
         {
             *CycleTime = PhCpuIdleCycleTime[HandleToUlong(ThreadItem->ThreadId)].QuadPart;
             return STATUS_SUCCESS;
@@ -220,6 +220,7 @@ function SetupSdkHeaders()
         "queuedlock.h",
         "ref.h",
         "secedit.h",
+        "stkprof.h",
         "svcsup.h",
         "symprv.h",
         "templ.h",
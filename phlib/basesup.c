@@ -54,6 +54,11 @@
  *
  * Simple hashtable. A wrapper around the normal hashtable, with PVOID keys and PVOID values.
  *
+ * Flat hashtable. An open addressing hashtable which stores entries directly in its slot array.
+ * Each slot has a control byte containing part of the hash code, and lookups compare a group of
+ * control bytes at a time using SSE2. This avoids the chain of dependent loads in the normal
+ * hashtable, at the cost of moving entries whenever the table is rebuilt.
+ *
  * Free list. A thread-safe memory allocation method where freed blocks are stored in a S-list, and
  * allocations are made from this list whenever possible.
  *
@@ -98,6 +103,11 @@ VOID NTAPI PhpHashtableDeleteProcedure(
     _In_ ULONG Flags
     );
 
+VOID NTAPI PhpFlatHashtableDeleteProcedure(
+    _In_ PVOID Object,
+    _In_ ULONG Flags
+    );
+
 // Types
 
 PPH_OBJECT_TYPE PhStringType;
@@ -105,6 +115,7 @@ PPH_OBJECT_TYPE PhBytesType;
 PPH_OBJECT_TYPE PhListType;
 PPH_OBJECT_TYPE PhPointerListType;
 PPH_OBJECT_TYPE PhHashtableType;
+PPH_OBJECT_TYPE PhFlatHashtableType;
 
 // Misc.
 
@@ -163,6 +174,7 @@ BOOLEAN PhBaseInitialization(
     parameters.FreeListCount = 64;
 
     PhHashtableType = PhCreateObjectTypeEx(L"Hashtable", PH_OBJECT_TYPE_USE_FREE_LIST, PhpHashtableDeleteProcedure, &parameters);
+    PhFlatHashtableType = PhCreateObjectType(L"FlatHashtable", 0, PhpFlatHashtableDeleteProcedure);
 
     PhInitializeFreeList(&PhpBaseThreadContextFreeList, sizeof(PHP_BASE_THREAD_CONTEXT), 16);
 
@@ -3033,6 +3045,115 @@ PPH_BYTES PhConvertUtf16ToMultiByteEx(
     return bytes;
 }
 
+/**
+ * Copies the longest prefix of a UTF-8 string that consists only of ASCII characters.
+ *
+ * \param Utf16String A buffer which receives the widened characters. If NULL, the characters are
+ * only counted.
+ * \param Utf8String The UTF-8 string.
+ * \param Count The maximum number of characters to copy.
+ *
+ * \return The number of characters copied.
+ */
+static SIZE_T PhpCopyAsciiUtf8ToUtf16(
+    _Out_writes_opt_(Count) PWCH Utf16String,
+    _In_reads_(Count) PCH Utf8String,
+    _In_ SIZE_T Count
+    )
+{
+    SIZE_T i;
+
+    i = 0;
+
+    if (PhpVectorLevel >= PH_VECTOR_LEVEL_SSE2)
+    {
+        __m128i b;
+        __m128i z;
+
+        z = _mm_setzero_si128();
+
+        for (; i + 16 <= Count; i += 16)
+        {
+            b = _mm_loadu_si128((__m128i *)(Utf8String + i));
+
+            if (_mm_movemask_epi8(b) != 0)
+                break;
+
+            if (Utf16String)
+            {
+                _mm_storeu_si128((__m128i *)(Utf16String + i), _mm_unpacklo_epi8(b, z));
+                _mm_storeu_si128((__m128i *)(Utf16String + i + 8), _mm_unpackhi_epi8(b, z));
+            }
+        }
+    }
+
+    for (; i < Count; i++)
+    {
+        if ((UCHAR)Utf8String[i] >= 0x80)
+            break;
+
+        if (Utf16String)
+            Utf16String[i] = (WCHAR)Utf8String[i];
+    }
+
+    return i;
+}
+
+/**
+ * Copies the longest prefix of a UTF-16 string that consists only of ASCII characters.
+ *
+ * \param Utf8String A buffer which receives the narrowed characters. If NULL, the characters are
+ * only counted.
+ * \param Utf16String The UTF-16 string.
+ * \param Count The maximum number of characters to copy.
+ *
+ * \return The number of characters copied.
+ */
+static SIZE_T PhpCopyAsciiUtf16ToUtf8(
+    _Out_writes_opt_(Count) PCH Utf8String,
+    _In_reads_(Count) PWCH Utf16String,
+    _In_ SIZE_T Count
+    )
+{
+    SIZE_T i;
+
+    i = 0;
+
+    if (PhpVectorLevel >= PH_VECTOR_LEVEL_SSE2)
+    {
+        __m128i b1;
+        __m128i b2;
+        __m128i nonAscii;
+        __m128i z;
+
+        nonAscii = _mm_set1_epi16((SHORT)0xff80);
+        z = _mm_setzero_si128();
+
+        for (; i + 16 <= Count; i += 16)
+        {
+            b1 = _mm_loadu_si128((__m128i *)(Utf16String + i));
+            b2 = _mm_loadu_si128((__m128i *)(Utf16String + i + 8));
+
+            if (_mm_movemask_epi8(_mm_cmpeq_epi16(_mm_and_si128(_mm_or_si128(b1, b2), nonAscii), z)) != 0xffff)
+                break;
+
+            if (Utf8String)
+                _mm_storeu_si128((__m128i *)(Utf8String + i), _mm_packus_epi16(b1, b2));
+        }
+    }
+
+    for (; i < Count; i++)
+    {
+        if (Utf16String[i] >= 0x80)
+            break;
+
+        if (Utf8String)
+            Utf8String[i] = (CHAR)Utf16String[i];
+    }
+
+    return i;
+}
+
 BOOLEAN PhConvertUtf8ToUtf16Size(
     _Out_ PSIZE_T BytesInUtf16String,
     _In_reads_bytes_(BytesInUtf8String) PCH Utf8String,
@@ -3044,6 +3165,7 @@ BOOLEAN PhConvertUtf8ToUtf16Size(
     PCH in;
     SIZE_T inRemaining;
     SIZE_T bytesInUtf16String;
+    SIZE_T count;
     ULONG codePoint;
     ULONG numberOfCodeUnits;
 
@@ -3055,6 +3177,18 @@ BOOLEAN PhConvertUtf8ToUtf16Size(
 
     while (inRemaining != 0)
     {
+        // Skip runs of ASCII characters when we aren't in the middle of a sequence.
+        if (decoder.State == 0)
+        {
+            count = PhpCopyAsciiUtf8ToUtf16(NULL, in, inRemaining);
+            in += count;
+            inRemaining -= count;
+            bytesInUtf16String += count * sizeof(WCHAR);
+
+            if (inRemaining == 0)
+                break;
+        }
+
         PhWriteUnicodeDecoder(&decoder, (UCHAR)*in);
         in++;
         inRemaining--;
@@ -3088,6 +3222,7 @@ BOOLEAN PhConvertUtf8ToUtf16Buffer(
     PWCH out;
     SIZE_T outRemaining;
     SIZE_T bytesInUtf16String;
+    SIZE_T count;
     ULONG codePoint;
     USHORT codeUnits[2];
     ULONG numberOfCodeUnits;
@@ -3102,6 +3237,20 @@ BOOLEAN PhConvertUtf8ToUtf16Buffer(
 
     while (inRemaining != 0)
     {
+        // Copy runs of ASCII characters when we aren't in the middle of a sequence.
+        if (decoder.State == 0)
+        {
+            count = PhpCopyAsciiUtf8ToUtf16(out, in, min(inRemaining, outRemaining));
+            in += count;
+            inRemaining -= count;
+            out += count;
+            outRemaining -= count;
+            bytesInUtf16String += count * sizeof(WCHAR);
+
+            if (inRemaining == 0)
+                break;
+        }
+
         PhWriteUnicodeDecoder(&decoder, (UCHAR)*in);
         in++;
         inRemaining--;
@@ -3194,6 +3343,7 @@ BOOLEAN PhConvertUtf16ToUtf8Size(
     PWCH in;
     SIZE_T inRemaining;
     SIZE_T bytesInUtf8String;
+    SIZE_T count;
     ULONG codePoint;
     ULONG numberOfCodeUnits;
 
@@ -3205,6 +3355,18 @@ BOOLEAN PhConvertUtf16ToUtf8Size(
 
     while (inRemaining != 0)
     {
+        // Skip runs of ASCII characters when we aren't in the middle of a surrogate pair.
+        if (decoder.State == 0)
+        {
+            count = PhpCopyAsciiUtf16ToUtf8(NULL, in, inRemaining);
+            in += count;
+            inRemaining -= count;
+            bytesInUtf8String += count;
+
+            if (inRemaining == 0)
+                break;
+        }
+
         PhWriteUnicodeDecoder(&decoder, (USHORT)*in);
         in++;
         inRemaining--;
@@ -3238,6 +3400,7 @@ BOOLEAN PhConvertUtf16ToUtf8Buffer(
     PCH out;
     SIZE_T outRemaining;
     SIZE_T bytesInUtf8String;
+    SIZE_T count;
     ULONG codePoint;
     UCHAR codeUnits[4];
     ULONG numberOfCodeUnits;
@@ -3252,6 +3415,20 @@ BOOLEAN PhConvertUtf16ToUtf8Buffer(
 
     while (inRemaining != 0)
     {
+        // Copy runs of ASCII characters when we aren't in the middle of a surrogate pair.
+        if (decoder.State == 0)
+        {
+            count = PhpCopyAsciiUtf16ToUtf8(out, in, min(inRemaining, outRemaining));
+            in += count;
+            inRemaining -= count;
+            out += count;
+            outRemaining -= count;
+            bytesInUtf8String += count;
+
+            if (inRemaining == 0)
+                break;
+        }
+
         PhWriteUnicodeDecoder(&decoder, (USHORT)*in);
         in++;
         inRemaining--;
@@ -5058,6 +5235,485 @@ BOOLEAN PhRemoveItemSimpleHashtable(
     return PhRemoveEntryHashtable(SimpleHashtable, &lookupEntry);
 }
 
+FORCEINLINE ULONG PhpMixFlatHashtableHash(
+    _In_ ULONG Hash
+    )
+{
+    // Hash functions used with hashtables are often weak in some bits (e.g. pointers), so mix
+    // the bits before splitting the hash code between the slot index and the control byte.
+    Hash *= 0x9e3779b1;
+    Hash ^= Hash >> 16;
+
+    return Hash;
+}
+
+/**
+ * Finds control bytes in a group that are equal to a value.
+ *
+ * \return A bit mask where bit i is set if control byte i of the group is equal to \a Value.
+ */
+FORCEINLINE ULONG PhpMatchFlatHashtableGroup(
+    _In_reads_(PH_FLAT_HASHTABLE_GROUP_SIZE) PUCHAR Control,
+    _In_ UCHAR Value
+    )
+{
+    if (PhpVectorLevel >= PH_VECTOR_LEVEL_SSE2)
+    {
+        __m128i group;
+
+        group = _mm_loadu_si128((__m128i *)Control);
+
+        return _mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8(Value)));
+    }
+    else
+    {
+        ULONG mask = 0;
+        ULONG i;
+
+        for (i = 0; i < PH_FLAT_HASHTABLE_GROUP_SIZE; i++)
+        {
+            if (Control[i] == Value)
+                mask |= 1 << i;
+        }
+
+        return mask;
+    }
+}
+
+/**
+ * Finds control bytes in a group that do not belong to an entry.
+ */
+FORCEINLINE ULONG PhpMatchFlatHashtableGroupNotFull(
+    _In_reads_(PH_FLAT_HASHTABLE_GROUP_SIZE) PUCHAR Control
+    )
+{
+    if (PhpVectorLevel >= PH_VECTOR_LEVEL_SSE2)
+    {
+        // Empty and deleted slots are the only ones with the high bit set.
+        return _mm_movemask_epi8(_mm_loadu_si128((__m128i *)Control));
+    }
+    else
+    {
+        ULONG mask = 0;
+        ULONG i;
+
+        for (i = 0; i < PH_FLAT_HASHTABLE_GROUP_SIZE; i++)
+        {
+            if (!PH_FLAT_HASHTABLE_CONTROL_IS_FULL(Control[i]))
+                mask |= 1 << i;
+        }
+
+        return mask;
+    }
+}
+
+FORCEINLINE VOID PhpSetFlatHashtableControl(
+    _Inout_ PPH_FLAT_HASHTABLE Hashtable,
+    _In_ ULONG Index,
+    _In_ UCHAR Value
+    )
+{
+    Hashtable->Control[Index] = Value;
+
+    // Keep the copy of the first group up to date.
+    if (Index < PH_FLAT_HASHTABLE_GROUP_SIZE)
+        Hashtable->Control[Hashtable->Capacity + Index] = Value;
+}
+
+FORCEINLINE ULONG PhpGetFlatHashtableMaximumCount(
+    _In_ ULONG Capacity
+    )
+{
+    // Maximum load factor of 7/8. This always leaves at least one empty slot, which terminates
+    // all probe sequences.
+    return Capacity - Capacity / 8;
+}
+
+/**
+ * Finds the first slot that is not being used in the probe sequence of a hash code.
+ */
+static ULONG PhpFindNotFullFlatHashtable(
+    _In_ PPH_FLAT_HASHTABLE Hashtable,
+    _In_ ULONG Hash
+    )
+{
+    ULONG mask;
+    ULONG position;
+    ULONG stride;
+    ULONG match;
+    ULONG bit;
+
+    mask = Hashtable->Capacity - 1;
+    position = (Hash >> 7) & mask;
+    stride = 0;
+
+    while (TRUE)
+    {
+        match = PhpMatchFlatHashtableGroupNotFull(&Hashtable->Control[position]);
+
+        if (_BitScanForward(&bit, match))
+            return (position + bit) & mask;
+
+        // Triangular probing visits every group when the number of slots is a power of two.
+        stride += PH_FLAT_HASHTABLE_GROUP_SIZE;
+        position = (position + stride) & mask;
+    }
+}
+
+/**
+ * Finds the slot containing an entry.
+ *
+ * \return The index of the slot, or -1 if the entry was not found.
+ */
+static ULONG PhpFindSlotFlatHashtable(
+    _In_ PPH_FLAT_HASHTABLE Hashtable,
+    _In_ PVOID Entry,
+    _In_ ULONG Hash
+    )
+{
+    ULONG mask;
+    ULONG position;
+    ULONG stride;
+    ULONG match;
+    ULONG bit;
+    ULONG index;
+
+    mask = Hashtable->Capacity - 1;
+    position = (Hash >> 7) & mask;
+    stride = 0;
+
+    while (TRUE)
+    {
+        match = PhpMatchFlatHashtableGroup(&Hashtable->Control[position], (UCHAR)(Hash & 0x7f));
+
+        while (_BitScanForward(&bit, match))
+        {
+            index = (position + bit) & mask;
+
+            if (Hashtable->EqualFunction(PH_FLAT_HASHTABLE_GET_ENTRY(Hashtable, index), Entry))
+                return index;
+
+            match &= match - 1;
+        }
+
+        if (PhpMatchFlatHashtableGroup(&Hashtable->Control[position], PH_FLAT_HASHTABLE_CONTROL_EMPTY))
+            return -1;
+
+        stride += PH_FLAT_HASHTABLE_GROUP_SIZE;
+        position = (position + stride) & mask;
+    }
+}
+
+/**
+ * Rebuilds a flat hashtable, discarding deleted slots.
+ *
+ * \param Hashtable A flat hashtable object.
+ * \param NewCapacity The new number of slots. This must be a power of two and at least
+ * PH_FLAT_HASHTABLE_GROUP_SIZE.
+ */
+static VOID PhpResizeFlatHashtable(
+    _Inout_ PPH_FLAT_HASHTABLE Hashtable,
+    _In_ ULONG NewCapacity
+    )
+{
+    PUCHAR oldControl;
+    PVOID oldSlots;
+    ULONG oldCapacity;
+    ULONG i;
+
+    oldControl = Hashtable->Control;
+    oldSlots = Hashtable->Slots;
+    oldCapacity = Hashtable->Capacity;
+
+    Hashtable->Capacity = NewCapacity;
+    Hashtable->Control = PhAllocate(NewCapacity + PH_FLAT_HASHTABLE_GROUP_SIZE);
+    Hashtable->Slots = PhAllocate((SIZE_T)Hashtable->SlotSize * NewCapacity);
+    memset(Hashtable->Control, PH_FLAT_HASHTABLE_CONTROL_EMPTY, NewCapacity + PH_FLAT_HASHTABLE_GROUP_SIZE);
+    Hashtable->GrowthLeft = PhpGetFlatHashtableMaximumCount(NewCapacity) - Hashtable->Count;
+
+    if (oldControl)
+    {
+        for (i = 0; i < oldCapacity; i++)
+        {
+            PVOID entry;
+            ULONG hash;
+            ULONG index;
+
+            if (!PH_FLAT_HASHTABLE_CONTROL_IS_FULL(oldControl[i]))
+                continue;
+
+            entry = PTR_ADD_OFFSET(oldSlots, (SIZE_T)Hashtable->SlotSize * i);
+            hash = PhpMixFlatHashtableHash(Hashtable->HashFunction(entry));
+            index = PhpFindNotFullFlatHashtable(Hashtable, hash);
+
+            PhpSetFlatHashtableControl(Hashtable, index, (UCHAR)(hash & 0x7f));
+            memcpy(PH_FLAT_HASHTABLE_GET_ENTRY(Hashtable, index), entry, Hashtable->EntrySize);
+        }
+
+        PhFree(oldControl);
+        PhFree(oldSlots);
+    }
+}
+
+/**
+ * Creates a flat hashtable object.
+ *
+ * \param EntrySize The size of each hashtable entry, in bytes.
+ * \param EqualFunction A comparison function that is executed to compare two hashtable entries.
+ * \param HashFunction A hash function that is executed to generate a hash code for a hashtable
+ * entry.
+ * \param InitialCapacity The number of entries to allocate storage for initially.
+ */
+PPH_FLAT_HASHTABLE PhCreateFlatHashtable(
+    _In_ ULONG EntrySize,
+    _In_ PPH_HASHTABLE_EQUAL_FUNCTION EqualFunction,
+    _In_ PPH_HASHTABLE_HASH_FUNCTION HashFunction,
+    _In_ ULONG InitialCapacity
+    )
+{
+    PPH_FLAT_HASHTABLE hashtable;
+    ULONG capacity;
+
+    hashtable = PhCreateObject(sizeof(PH_FLAT_HASHTABLE), PhFlatHashtableType);
+
+    hashtable->EntrySize = EntrySize;
+    hashtable->SlotSize = (ULONG)ALIGN_UP_BY(EntrySize, sizeof(PVOID));
+    hashtable->EqualFunction = EqualFunction;
+    hashtable->HashFunction = HashFunction;
+
+    hashtable->Capacity = 0;
+    hashtable->Control = NULL;
+    hashtable->Slots = NULL;
+    hashtable->Count = 0;
+
+    // Make room for InitialCapacity entries without exceeding the maximum load factor.
+    capacity = PhRoundUpToPowerOfTwo(InitialCapacity + InitialCapacity / 7);
+
+    if (capacity < PH_FLAT_HASHTABLE_GROUP_SIZE)
+        capacity = PH_FLAT_HASHTABLE_GROUP_SIZE;
+
+    PhpResizeFlatHashtable(hashtable, capacity);
+
+    return hashtable;
+}
+
+VOID PhpFlatHashtableDeleteProcedure(
+    _In_ PVOID Object,
+    _In_ ULONG Flags
+    )
+{
+    PPH_FLAT_HASHTABLE hashtable = (PPH_FLAT_HASHTABLE)Object;
+
+    PhFree(hashtable->Control);
+    PhFree(hashtable->Slots);
+}
+
+/**
+ * Adds an entry to a flat hashtable or returns the existing one.
+ *
+ * \param Hashtable A flat hashtable object.
+ * \param Entry The entry to add.
+ * \param Added A variable which receives TRUE if a new entry was created, and FALSE if an
+ * existing entry was returned.
+ *
+ * \return A pointer to the entry as stored in the hashtable. This pointer is valid until the
+ * hashtable is modified.
+ */
+PVOID PhAddEntryFlatHashtableEx(
+    _Inout_ PPH_FLAT_HASHTABLE Hashtable,
+    _In_ PVOID Entry,
+    _Out_opt_ PBOOLEAN Added
+    )
+{
+    ULONG hash;
+    ULONG index;
+    PVOID entry;
+
+    hash = PhpMixFlatHashtableHash(Hashtable->HashFunction(Entry));
+    index = PhpFindSlotFlatHashtable(Hashtable, Entry, hash);
+
+    if (index != -1)
+    {
+        if (Added)
+            *Added = FALSE;
+
+        return PH_FLAT_HASHTABLE_GET_ENTRY(Hashtable, index);
+    }
+
+    index = PhpFindNotFullFlatHashtable(Hashtable, hash);
+
+    // Reusing a deleted slot does not reduce the number of empty slots.
+    if (Hashtable->GrowthLeft == 0 && Hashtable->Control[index] == PH_FLAT_HASHTABLE_CONTROL_EMPTY)
+    {
+        // If most of the used slots are deleted slots, rebuild the table at the same size
+        // instead of growing it.
+        if (Hashtable->Count <= PhpGetFlatHashtableMaximumCount(Hashtable->Capacity) / 2)
+            PhpResizeFlatHashtable(Hashtable, Hashtable->Capacity);
+        else
+            PhpResizeFlatHashtable(Hashtable, Hashtable->Capacity * 2);
+
+        index = PhpFindNotFullFlatHashtable(Hashtable, hash);
+    }
+
+    if (Hashtable->Control[index] == PH_FLAT_HASHTABLE_CONTROL_EMPTY)
+        Hashtable->GrowthLeft--;
+
+    PhpSetFlatHashtableControl(Hashtable, index, (UCHAR)(hash & 0x7f));
+    entry = PH_FLAT_HASHTABLE_GET_ENTRY(Hashtable, index);
+    memcpy(entry, Entry, Hashtable->EntrySize);
+    Hashtable->Count++;
+
+    if (Added)
+        *Added = TRUE;
+
+    return entry;
+}
+
+/**
+ * Adds an entry to a flat hashtable.
+ *
+ * \param Hashtable A flat hashtable object.
+ * \param Entry The entry to add.
+ *
+ * \return A pointer to the entry as stored in the hashtable. This pointer is valid until the
+ * hashtable is modified. If the hashtable already contained an equal entry, NULL is returned.
+ */
+PVOID PhAddEntryFlatHashtable(
+    _Inout_ PPH_FLAT_HASHTABLE Hashtable,
+    _In_ PVOID Entry
+    )
+{
+    PVOID entry;
+    BOOLEAN added;
+
+    entry = PhAddEntryFlatHashtableEx(Hashtable, Entry, &added);
+
+    if (added)
+        return entry;
+    else
+        return NULL;
+}
+
+/**
+ * Clears a flat hashtable.
+ *
+ * \param Hashtable A flat hashtable object.
+ */
+VOID PhClearFlatHashtable(
+    _Inout_ PPH_FLAT_HASHTABLE Hashtable
+    )
+{
+    memset(Hashtable->Control, PH_FLAT_HASHTABLE_CONTROL_EMPTY, Hashtable->Capacity + PH_FLAT_HASHTABLE_GROUP_SIZE);
+    Hashtable->Count = 0;
+    Hashtable->GrowthLeft = PhpGetFlatHashtableMaximumCount(Hashtable->Capacity);
+}
+
+/**
+ * Enumerates the entries in a flat hashtable.
+ *
+ * \param Hashtable A flat hashtable object.
+ * \param Entry A variable which receives a pointer to the hashtable entry. The pointer is valid
+ * until the hashtable is modified.
+ * \param EnumerationKey A variable which is initialized to 0 before first calling this function.
+ *
+ * \return TRUE if an entry pointer was stored in \a Entry, FALSE if there are no more entries.
+ */
+BOOLEAN PhEnumFlatHashtable(
+    _In_ PPH_FLAT_HASHTABLE Hashtable,
+    _Out_ PVOID *Entry,
+    _Inout_ PULONG EnumerationKey
+    )
+{
+    while (*EnumerationKey < Hashtable->Capacity)
+    {
+        ULONG index = (*EnumerationKey)++;
+
+        if (PH_FLAT_HASHTABLE_CONTROL_IS_FULL(Hashtable->Control[index]))
+        {
+            *Entry = PH_FLAT_HASHTABLE_GET_ENTRY(Hashtable, index);
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+/**
+ * Locates an entry in a flat hashtable.
+ *
+ * \param Hashtable A flat hashtable object.
+ * \param Entry An entry representing the entry to find.
+ *
+ * \return A pointer to the entry as stored in the hashtable. This pointer is valid until the
+ * hashtable is modified. If the entry could not be found, NULL is returned.
+ */
+PVOID PhFindEntryFlatHashtable(
+    _In_ PPH_FLAT_HASHTABLE Hashtable,
+    _In_ PVOID Entry
+    )
+{
+    ULONG index;
+
+    index = PhpFindSlotFlatHashtable(Hashtable, Entry, PhpMixFlatHashtableHash(Hashtable->HashFunction(Entry)));
+
+    if (index != -1)
+        return PH_FLAT_HASHTABLE_GET_ENTRY(Hashtable, index);
+    else
+        return NULL;
+}
+
+/**
+ * Removes an entry from a flat hashtable.
+ *
+ * \param Hashtable A flat hashtable object.
+ * \param Entry The entry to remove.
+ *
+ * \return TRUE if the entry was removed, FALSE if the entry could not be found.
+ */
+BOOLEAN PhRemoveEntryFlatHashtable(
+    _Inout_ PPH_FLAT_HASHTABLE Hashtable,
+    _In_ PVOID Entry
+    )
+{
+    ULONG index;
+    ULONG emptyBefore;
+    ULONG emptyAfter;
+    ULONG firstEmptyAfter;
+    ULONG lastEmptyBefore;
+
+    index = PhpFindSlotFlatHashtable(Hashtable, Entry, PhpMixFlatHashtableHash(Hashtable->HashFunction(Entry)));
+
+    if (index == -1)
+        return FALSE;
+
+    // If every group that contains this slot also contains an empty slot, no probe sequence
+    // can have gone past this slot, so it can be made empty instead of deleted.
+
+    emptyBefore = PhpMatchFlatHashtableGroup(
+        &Hashtable->Control[(index - PH_FLAT_HASHTABLE_GROUP_SIZE) & (Hashtable->Capacity - 1)],
+        PH_FLAT_HASHTABLE_CONTROL_EMPTY
+        );
+    emptyAfter = PhpMatchFlatHashtableGroup(&Hashtable->Control[index], PH_FLAT_HASHTABLE_CONTROL_EMPTY);
+
+    if (
+        _BitScanForward(&firstEmptyAfter, emptyAfter) &&
+        _BitScanReverse(&lastEmptyBefore, emptyBefore) &&
+        firstEmptyAfter + (PH_FLAT_HASHTABLE_GROUP_SIZE - 1 - lastEmptyBefore) < PH_FLAT_HASHTABLE_GROUP_SIZE
+        )
+    {
+        PhpSetFlatHashtableControl(Hashtable, index, PH_FLAT_HASHTABLE_CONTROL_EMPTY);
+        Hashtable->GrowthLeft++;
+    }
+    else
+    {
+        PhpSetFlatHashtableControl(Hashtable, index, PH_FLAT_HASHTABLE_CONTROL_DELETED);
+    }
+
+    Hashtable->Count--;
+
+    return TRUE;
+}
+
 /**
  * Initializes a free list object.
  *
@@ -5169,6 +5825,101 @@ VOID PhInitializeCallback(
     InitializeListHead(&Callback->ListHead);
     PhInitializeQueuedLock(&Callback->ListLock);
     PhInitializeCondition(&Callback->BusyCondition);
+    Callback->Snapshot = NULL;
+    Callback->InvokeCount = 0;
+    Callback->RetiredSnapshots = NULL;
+}
+
+/**
+ * Frees snapshots which have been replaced.
+ *
+ * \param Callback A pointer to a callback object.
+ *
+ * \remarks The list lock must be held exclusively, and no invocations may be in progress.
+ */
+static VOID PhpFreeRetiredCallbackSnapshots(
+    _Inout_ PPH_CALLBACK Callback
+    )
+{
+    PPH_CALLBACK_SNAPSHOT snapshot;
+    PPH_CALLBACK_SNAPSHOT nextSnapshot;
+
+    snapshot = Callback->RetiredSnapshots;
+    Callback->RetiredSnapshots = NULL;
+
+    while (snapshot)
+    {
+        nextSnapshot = snapshot->NextRetired;
+
+        if (snapshot->RemovedEntry)
+            PhFree(snapshot->RemovedEntry);
+
+        PhFree(snapshot);
+        snapshot = nextSnapshot;
+    }
+}
+
+/**
+ * Publishes a new snapshot of the callbacks list.
+ *
+ * \param Callback A pointer to a callback object.
+ * \param RemovedEntry The entry of a registration which was just removed from the list. It is
+ * freed once no invocation can be using it.
+ *
+ * \remarks The list lock must be held exclusively.
+ */
+static VOID PhpUpdateCallbackSnapshot(
+    _Inout_ PPH_CALLBACK Callback,
+    _In_opt_ PPH_CALLBACK_ENTRY RemovedEntry
+    )
+{
+    PPH_CALLBACK_SNAPSHOT snapshot;
+    PPH_CALLBACK_SNAPSHOT oldSnapshot;
+    PLIST_ENTRY listEntry;
+    ULONG count;
+
+    count = 0;
+
+    for (listEntry = Callback->ListHead.Flink; listEntry != &Callback->ListHead; listEntry = listEntry->Flink)
+        count++;
+
+    if (count != 0)
+    {
+        snapshot = PhAllocate(FIELD_OFFSET(PH_CALLBACK_SNAPSHOT, Entries) + sizeof(PPH_CALLBACK_ENTRY) * count);
+        snapshot->NextRetired = NULL;
+        snapshot->RemovedEntry = NULL;
+        snapshot->Count = 0;
+
+        for (listEntry = Callback->ListHead.Flink; listEntry != &Callback->ListHead; listEntry = listEntry->Flink)
+        {
+            snapshot->Entries[snapshot->Count++] =
+                CONTAINING_RECORD(listEntry, PH_CALLBACK_REGISTRATION, ListEntry)->Entry;
+        }
+    }
+    else
+    {
+        snapshot = NULL;
+    }
+
+    oldSnapshot = _InterlockedExchangePointer(&Callback->Snapshot, snapshot);
+
+    // Invocations which started before the exchange may still be walking the old snapshot (and
+    // the removed entry), so we can only free them once there are no invocations in progress. If
+    // there are, the last invocation to finish frees them instead.
+
+    if (oldSnapshot)
+    {
+        oldSnapshot->RemovedEntry = RemovedEntry;
+        oldSnapshot->NextRetired = Callback->RetiredSnapshots;
+        Callback->RetiredSnapshots = oldSnapshot;
+    }
+    else
+    {
+        assert(!RemovedEntry);
+    }
+
+    if (Callback->InvokeCount == 0)
+        PhpFreeRetiredCallbackSnapshots(Callback);
 }
 
 /**
@@ -5180,7 +5931,30 @@ VOID PhDeleteCallback(
     _Inout_ PPH_CALLBACK Callback
     )
 {
-    // Nothing for now
+    PLIST_ENTRY listEntry;
+
+    PhAcquireQueuedLockExclusive(&Callback->ListLock);
+
+    assert(Callback->InvokeCount == 0);
+    PhpFreeRetiredCallbackSnapshots(Callback);
+
+    // Free the entries of registrations which were never unregistered.
+    for (listEntry = Callback->ListHead.Flink; listEntry != &Callback->ListHead; listEntry = listEntry->Flink)
+    {
+        PPH_CALLBACK_REGISTRATION registration;
+
+        registration = CONTAINING_RECORD(listEntry, PH_CALLBACK_REGISTRATION, ListEntry);
+        PhFree(registration->Entry);
+        registration->Entry = NULL;
+    }
+
+    if (Callback->Snapshot)
+    {
+        PhFree(Callback->Snapshot);
+        Callback->Snapshot = NULL;
+    }
+
+    PhReleaseQueuedLockExclusive(&Callback->ListLock);
 }
 
 /**
@@ -5228,14 +6002,24 @@ VOID PhRegisterCallbackEx(
     _Out_ PPH_CALLBACK_REGISTRATION Registration
     )
 {
+    PPH_CALLBACK_ENTRY entry;
+
+    entry = PhAllocate(sizeof(PH_CALLBACK_ENTRY));
+    entry->Function = Function;
+    entry->Context = Context;
+    entry->Busy = 0;
+    entry->Unregistering = FALSE;
+    entry->Flags = Flags;
+
     Registration->Function = Function;
     Registration->Context = Context;
-    Registration->Busy = 0;
-    Registration->Unregistering = FALSE;
-    Registration->Flags = Flags;
+    Registration->Reserved[0] = 0;
+    Registration->Reserved[1] = 0;
+    Registration->Entry = entry;
 
     PhAcquireQueuedLockExclusive(&Callback->ListLock);
     InsertTailList(&Callback->ListHead, &Registration->ListEntry);
+    PhpUpdateCallbackSnapshot(Callback, NULL);
     PhReleaseQueuedLockExclusive(&Callback->ListLock);
 }
 
@@ -5254,15 +6038,22 @@ VOID PhUnregisterCallback(
     _Inout_ PPH_CALLBACK_REGISTRATION Registration
     )
 {
-    Registration->Unregistering = TRUE;
+    PPH_CALLBACK_ENTRY entry;
+
+    entry = Registration->Entry;
+    entry->Unregistering = TRUE;
+    // Make sure invocations see the flag before we check the busy count. See PhInvokeCallback.
+    MemoryBarrier();
 
     PhAcquireQueuedLockExclusive(&Callback->ListLock);
 
     // Wait for the callback to be unbusy.
-    while (Registration->Busy)
+    while (entry->Busy)
         PhWaitForCondition(&Callback->BusyCondition, &Callback->ListLock, NULL);
 
     RemoveEntryList(&Registration->ListEntry);
+    PhpUpdateCallbackSnapshot(Callback, entry);
+    Registration->Entry = NULL;
 
     PhReleaseQueuedLockExclusive(&Callback->ListLock);
 }
@@ -5278,47 +6069,66 @@ VOID PhInvokeCallback(
     _In_opt_ PVOID Parameter
     )
 {
-    PLIST_ENTRY listEntry;
+    PPH_CALLBACK_SNAPSHOT snapshot;
+    ULONG i;
 
-    PhAcquireQueuedLockShared(&Callback->ListLock);
+    // Most callbacks have no registrations most of the time. A registration which races with
+    // this check wouldn't be guaranteed to be called anyway.
+    if (!Callback->Snapshot)
+        return;
 
-    listEntry = Callback->ListHead.Flink;
+    // The snapshot can't be freed while we are counted as an invocation in progress.
+    _InterlockedIncrement(&Callback->InvokeCount);
+    snapshot = Callback->Snapshot;
 
-    while (listEntry != &Callback->ListHead)
+    if (snapshot)
     {
-        PPH_CALLBACK_REGISTRATION registration;
-        LONG busy;
-
-        registration = CONTAINING_RECORD(listEntry, PH_CALLBACK_REGISTRATION, ListEntry);
+        for (i = 0; i < snapshot->Count; i++)
+        {
+            PPH_CALLBACK_ENTRY entry;
 
-        // Don't bother executing the callback function if it is being unregistered.
-        if (registration->Unregistering)
-            continue;
+            entry = snapshot->Entries[i];
 
-        _InterlockedIncrement(&registration->Busy);
+            // Don't bother executing the callback function if it is being unregistered.
+            if (entry->Unregistering)
+                continue;
 
-        // Execute the callback function.
+            _InterlockedIncrement(&entry->Busy);
 
-        PhReleaseQueuedLockShared(&Callback->ListLock);
-        registration->Function(
-            Parameter,
-            registration->Context
-            );
-        PhAcquireQueuedLockShared(&Callback->ListLock);
+            // Check again now that we are busy. PhUnregisterCallback sets the flag before checking
+            // the busy count, so either it waits for us or we see the flag here.
+            if (!entry->Unregistering)
+            {
+                // Execute the callback function.
+                entry->Function(
+                    Parameter,
+                    entry->Context
+                    );
+            }
 
-        busy = _InterlockedDecrement(&registration->Busy);
+            if (_InterlockedDecrement(&entry->Busy) == 0 && entry->Unregistering)
+            {
+                // Someone started unregistering while the callback function was executing, and we
+                // must wake them. Acquiring the lock makes sure they are already waiting.
+                PhAcquireQueuedLockShared(&Callback->ListLock);
+                PhPulseAllCondition(&Callback->BusyCondition);
+                PhReleaseQueuedLockShared(&Callback->ListLock);
+            }
+        }
+    }
 
-        if (registration->Unregistering && busy == 0)
+    if (_InterlockedDecrement(&Callback->InvokeCount) == 0 && Callback->RetiredSnapshots)
+    {
+        // We were the last invocation which could be using the retired snapshots. If the lock is
+        // busy, they will be freed by a later invocation or update instead.
+        if (PhTryAcquireQueuedLockExclusive(&Callback->ListLock))
         {
-            // Someone started unregistering while the callback function was executing, and we must
-            // wake them.
-            PhPulseAllCondition(&Callback->BusyCondition);
-        }
+            if (Callback->InvokeCount == 0)
+                PhpFreeRetiredCallbackSnapshots(Callback);
 
-        listEntry = listEntry->Flink;
+            PhReleaseQueuedLockExclusive(&Callback->ListLock);
+        }
     }
-
-    PhReleaseQueuedLockShared(&Callback->ListLock);
 }
 
 /**
@@ -5983,3 +6793,99 @@ VOID PhDivideSinglesBySingle(
         break;
     }
 }
+
+/**
+ * Adds an array of numbers to another array of numbers.
+ *
+ * \param A The destination array, to which \a B is added.
+ * \param B The source array.
+ * \param Count The number of elements.
+ */
+VOID PhAddSingles(
+    _Inout_updates_(Count) PFLOAT A,
+    _In_reads_(Count) PFLOAT B,
+    _In_ SIZE_T Count
+    )
+{
+    if (PhpVectorLevel >= PH_VECTOR_LEVEL_SSE2)
+    {
+        // The arrays usually have different alignments, so use unaligned loads.
+        while (Count >= 4)
+        {
+            __m128 a;
+            __m128 b;
+
+            a = _mm_loadu_ps(A);
+            b = _mm_loadu_ps(B);
+            a = _mm_add_ps(a, b);
+            _mm_storeu_ps(A, a);
+
+            A += 4;
+            B += 4;
+            Count -= 4;
+        }
+    }
+
+    while (Count--)
+        *A++ += *B++;
+}
+
+/**
+ * Finds the largest sum of corresponding elements in two arrays.
+ *
+ * \param A The first array.
+ * \param B The second array.
+ * \param Count The number of elements.
+ *
+ * \return The largest value of A[i] + B[i], or 0 if \a Count is 0.
+ */
+FLOAT PhMaximumSumSingles(
+    _In_reads_(Count) PFLOAT A,
+    _In_reads_(Count) PFLOAT B,
+    _In_ SIZE_T Count
+    )
+{
+    FLOAT max;
+
+    if (Count == 0)
+        return 0;
+
+    max = *A + *B;
+
+    if (PhpVectorLevel >= PH_VECTOR_LEVEL_SSE2 && Count >= 4)
+    {
+        __m128 m;
+
+        m = _mm_load1_ps(&max);
+
+        while (Count >= 4)
+        {
+            __m128 a;
+            __m128 b;
+
+            a = _mm_loadu_ps(A);
+            b = _mm_loadu_ps(B);
+            m = _mm_max_ps(m, _mm_add_ps(a, b));
+
+            A += 4;
+            B += 4;
+            Count -= 4;
+        }
+
+        m = _mm_max_ps(m, _mm_shuffle_ps(m, m, _MM_SHUFFLE(2, 3, 0, 1)));
+        m = _mm_max_ps(m, _mm_shuffle_ps(m, m, _MM_SHUFFLE(1, 0, 3, 2)));
+        _mm_store_ss(&max, m);
+    }
+
+    while (Count--)
+    {
+        FLOAT sum;
+
+        sum = *A++ + *B++;
+
+        if (max < sum)
+            max = sum;
+    }
+
+    return max;
+}
@@ -20,3 +20,53 @@
 #undef T
 #define T FLOAT
 #include "circbuf_i.h"
+
+VOID PhInitializeHistoryBuffer(
+    _Out_ PPH_HISTORY_BUFFER Buffer,
+    _In_ ULONG NumberOfSeries,
+    _In_ ULONG Size
+    )
+{
+    Buffer->Size = PhRoundUpToPowerOfTwo(Size);
+    Buffer->SizeMinusOne = Buffer->Size - 1;
+    Buffer->Count = 0;
+    Buffer->Index = 0;
+    Buffer->NumberOfSeries = NumberOfSeries;
+    Buffer->Data = PhAllocate(sizeof(FLOAT) * NumberOfSeries * Buffer->Size);
+}
+
+VOID PhDeleteHistoryBuffer(
+    _Inout_ PPH_HISTORY_BUFFER Buffer
+    )
+{
+    PhFree(Buffer->Data);
+}
+
+VOID PhCopyHistoryBuffer(
+    _In_ PPH_HISTORY_BUFFER Buffer,
+    _In_ ULONG Series,
+    _Out_writes_(Count) PFLOAT Destination,
+    _In_ ULONG Count
+    )
+{
+    PFLOAT data;
+    ULONG tailSize;
+
+    data = &Buffer->Data[(SIZE_T)Series * Buffer->Size];
+    tailSize = (ULONG)(Buffer->Size - Buffer->Index);
+
+    if (Count > Buffer->Count)
+        Count = Buffer->Count;
+
+    if (tailSize >= Count)
+    {
+        // Copy only a part of the tail.
+        memcpy(Destination, &data[Buffer->Index], sizeof(FLOAT) * Count);
+    }
+    else
+    {
+        // Copy the tail, then only part of the head.
+        memcpy(Destination, &data[Buffer->Index], sizeof(FLOAT) * tailSize);
+        memcpy(&Destination[tailSize], data, sizeof(FLOAT) * (Count - tailSize));
+    }
+}
@@ -30,7 +30,7 @@
 
 VOID PhpEscapeStringForCsv(
     _Inout_ PPH_STRING_BUILDER StringBuilder,
-    _In_ PPH_STRING String
+    _In_ PPH_STRINGREF String
     )
 {
     SIZE_T i;
@@ -74,6 +74,185 @@ VOID PhpEscapeStringForCsv(
         PhAppendStringBuilderEx(StringBuilder, runStart, runLength * sizeof(WCHAR));
 }
 
+VOID PhpEscapeStringForJson(
+    _Inout_ PPH_STRING_BUILDER StringBuilder,
+    _In_ PPH_STRINGREF String
+    )
+{
+    SIZE_T i;
+    SIZE_T length;
+    PWCHAR runStart;
+    SIZE_T runLength;
+    WCHAR c;
+
+    length = String->Length / sizeof(WCHAR);
+    runStart = NULL;
+
+    for (i = 0; i < length; i++)
+    {
+        c = String->Buffer[i];
+
+        if (c == '\"' || c == '\\' || c < 0x20)
+        {
+            if (runStart)
+            {
+                PhAppendStringBuilderEx(StringBuilder, runStart, runLength * sizeof(WCHAR));
+                runStart = NULL;
+            }
+
+            switch (c)
+            {
+            case '\"':
+                PhAppendStringBuilder2(StringBuilder, L"\\\"");
+                break;
+            case '\\':
+                PhAppendStringBuilder2(StringBuilder, L"\\\\");
+                break;
+            case '\t':
+                PhAppendStringBuilder2(StringBuilder, L"\\t");
+                break;
+            case '\r':
+                PhAppendStringBuilder2(StringBuilder, L"\\r");
+                break;
+            case '\n':
+                PhAppendStringBuilder2(StringBuilder, L"\\n");
+                break;
+            default:
+                PhAppendFormatStringBuilder(StringBuilder, L"\\u%04x", c);
+                break;
+            }
+        }
+        else
+        {
+            if (runStart)
+            {
+                runLength++;
+            }
+            else
+            {
+                runStart = &String->Buffer[i];
+                runLength = 1;
+            }
+        }
+    }
+
+    if (runStart)
+        PhAppendStringBuilderEx(StringBuilder, runStart, runLength * sizeof(WCHAR));
+}
+
+/**
+ * Creates the key used for a column in JSON Lines output.
+ *
+ * \param Name The name of the column.
+ *
+ * \return A string containing the quoted and escaped name followed by a colon.
+ */
+PPH_STRING PhpCreateJsonColumnName(
+    _In_ PPH_STRINGREF Name
+    )
+{
+    PH_STRING_BUILDER stringBuilder;
+
+    PhInitializeStringBuilder(&stringBuilder, Name->Length + 3 * sizeof(WCHAR));
+    PhAppendCharStringBuilder(&stringBuilder, '\"');
+    PhpEscapeStringForJson(&stringBuilder, Name);
+    PhAppendStringBuilder2(&stringBuilder, L"\":");
+
+    return PhFinalStringBuilderString(&stringBuilder);
+}
+
+/**
+ * Appends a cell to a line of a text table.
+ *
+ * \param StringBuilder The line being built.
+ * \param Mode The export formatting mode.
+ * \param Column The column of the cell.
+ * \param Columns The number of columns in the table.
+ * \param Text The text of the cell, or NULL if the cell is empty.
+ * \param TabCount The number of tabs needed to fill the biggest cell in each column. This is
+ * required for PH_EXPORT_MODE_TABS and PH_EXPORT_MODE_SPACES.
+ * \param ColumnNames The keys created by PhpCreateJsonColumnName() for each column. This is
+ * required for PH_EXPORT_MODE_JSON_LINES.
+ */
+VOID PhpAppendTextTableCell(
+    _Inout_ PPH_STRING_BUILDER StringBuilder,
+    _In_ ULONG Mode,
+    _In_ ULONG Column,
+    _In_ ULONG Columns,
+    _In_opt_ PPH_STRINGREF Text,
+    _In_opt_ PULONG TabCount,
+    _In_opt_ PPH_STRING *ColumnNames
+    )
+{
+    ULONG k;
+
+    switch (Mode)
+    {
+    case PH_EXPORT_MODE_TABS:
+        {
+            if (Text)
+            {
+                // Calculate the number of tabs needed.
+                k = (ULONG)(TabCount[Column] + 1 - Text->Length / sizeof(WCHAR) / TAB_SIZE);
+
+                PhAppendStringBuilder(StringBuilder, Text);
+            }
+            else
+            {
+                k = TabCount[Column] + 1;
+            }
+
+            PhAppendCharStringBuilder2(StringBuilder, '\t', k);
+        }
+        break;
+    case PH_EXPORT_MODE_SPACES:
+        {
+            if (Text)
+            {
+                // Calculate the number of spaces needed.
+                k = (ULONG)((TabCount[Column] + 1) * TAB_SIZE - Text->Length / sizeof(WCHAR));
+
+                PhAppendStringBuilder(StringBuilder, Text);
+            }
+            else
+            {
+                k = (TabCount[Column] + 1) * TAB_SIZE;
+            }
+
+            PhAppendCharStringBuilder2(StringBuilder, ' ', k);
+        }
+        break;
+    case PH_EXPORT_MODE_CSV:
+        {
+            PhAppendCharStringBuilder(StringBuilder, '\"');
+
+            if (Text)
+                PhpEscapeStringForCsv(StringBuilder, Text);
+
+            PhAppendCharStringBuilder(StringBuilder, '\"');
+
+            if (Column != Columns - 1)
+                PhAppendCharStringBuilder(StringBuilder, ',');
+        }
+        break;
+    case PH_EXPORT_MODE_JSON_LINES:
+        {
+            PhAppendCharStringBuilder(StringBuilder, Column == 0 ? '{' : ',');
+            PhAppendStringBuilder(StringBuilder, &ColumnNames[Column]->sr);
+            PhAppendCharStringBuilder(StringBuilder, '\"');
+
+            if (Text)
+                PhpEscapeStringForJson(StringBuilder, Text);
+
+            PhAppendCharStringBuilder(StringBuilder, '\"');
+
+            if (Column == Columns - 1)
+                PhAppendCharStringBuilder(StringBuilder, '}');
+        }
+        break;
+    }
+}
+
 /**
  * Allocates a text table.
  *
@@ -111,6 +290,9 @@ VOID PhaCreateTextTable(
  *
  * \return A list of strings for each line in the output. The list object and
  * string objects are not auto-dereferenced.
+ *
+ * \remarks In PH_EXPORT_MODE_JSON_LINES mode, the first row of the table is used as the keys
+ * of each object and no line is produced for it.
  */
 PPH_LIST PhaFormatTextTable(
     _In_ PPH_STRING **Table,
@@ -122,11 +304,12 @@ PPH_LIST PhaFormatTextTable(
     PPH_LIST lines;
     // The tab count array contains the number of tabs need to fill the biggest
     // row cell in each column.
-    PULONG tabCount;
+    PULONG tabCount = NULL;
+    PPH_STRING *columnNames = NULL;
     ULONG i;
     ULONG j;
 
-    if (Mode == PH_EXPORT_MODE_TABS || Mode == PH_EXPORT_MODE_SPACES)
+    if (PH_EXPORT_MODE_ALIGNED(Mode))
     {
         // Create the tab count array.
 
@@ -151,88 +334,195 @@ PPH_LIST PhaFormatTextTable(
         }
     }
 
+    i = 0;
+
+    if (Mode == PH_EXPORT_MODE_JSON_LINES && Rows != 0)
+    {
+        columnNames = PH_AUTO(PhCreateAlloc(sizeof(PPH_STRING) * Columns));
+
+        for (j = 0; j < Columns; j++)
+        {
+            PH_STRINGREF name;
+
+            if (Table[0][j])
+                name = Table[0][j]->sr;
+            else
+                PhInitializeEmptyStringRef(&name);
+
+            columnNames[j] = PH_AUTO(PhpCreateJsonColumnName(&name));
+        }
+
+        i = 1;
+    }
+
     // Create the final list of lines by going through each cell and appending
     // the proper tab count (if we are using tabs). This will make sure each column
     // is properly aligned.
 
     lines = PhCreateList(Rows);
 
-    for (i = 0; i < Rows; i++)
+    for (; i < Rows; i++)
     {
         PH_STRING_BUILDER stringBuilder;
 
         PhInitializeStringBuilder(&stringBuilder, 100);
 
-        switch (Mode)
+        for (j = 0; j < Columns; j++)
         {
-        case PH_EXPORT_MODE_TABS:
-            {
-                for (j = 0; j < Columns; j++)
-                {
-                    ULONG k;
+            PhpAppendTextTableCell(
+                &stringBuilder,
+                Mode,
+                j,
+                Columns,
+                Table[i][j] ? &Table[i][j]->sr : NULL,
+                tabCount,
+                columnNames
+                );
+        }
 
-                    if (Table[i][j])
-                    {
-                        // Calculate the number of tabs needed.
-                        k = (ULONG)(tabCount[j] + 1 - Table[i][j]->Length / sizeof(WCHAR) / TAB_SIZE);
+        PhAddItemList(lines, PhFinalStringBuilderString(&stringBuilder));
+    }
 
-                        PhAppendStringBuilder(&stringBuilder, &Table[i][j]->sr);
-                    }
-                    else
-                    {
-                        k = tabCount[j] + 1;
-                    }
+    return lines;
+}
 
-                    PhAppendCharStringBuilder2(&stringBuilder, '\t', k);
-                }
-            }
-            break;
-        case PH_EXPORT_MODE_SPACES:
-            {
-                for (j = 0; j < Columns; j++)
-                {
-                    ULONG k;
+/**
+ * Initializes a text table writer, which formats a table directly to a file stream.
+ *
+ * \param Writer A text table writer structure.
+ * \param FileStream The file stream to write to.
+ * \param Mode The export formatting mode.
+ * \param Columns The number of columns in the table.
+ *
+ * \remarks The first row written is the column headers. In PH_EXPORT_MODE_TABS and
+ * PH_EXPORT_MODE_SPACES mode, every cell (including the headers) must be passed to
+ * PhMeasureTextTableCell() before any cells are written. Only one line is kept in memory at a
+ * time, so the memory used does not depend on the number of rows.
+ */
+VOID PhInitializeTextTableWriter(
+    _Out_ PPH_TEXT_TABLE_WRITER Writer,
+    _In_ PPH_FILE_STREAM FileStream,
+    _In_ ULONG Mode,
+    _In_ ULONG Columns
+    )
+{
+    Writer->FileStream = FileStream;
+    Writer->Mode = Mode;
+    Writer->Columns = Columns;
+    Writer->Column = 0;
+    Writer->Row = 0;
+    Writer->TabCount = NULL;
+    Writer->ColumnNames = NULL;
+
+    if (PH_EXPORT_MODE_ALIGNED(Mode))
+    {
+        Writer->TabCount = PhAllocate(sizeof(ULONG) * Columns);
+        memset(Writer->TabCount, 0, sizeof(ULONG) * Columns);
+    }
+    else if (Mode == PH_EXPORT_MODE_JSON_LINES)
+    {
+        Writer->ColumnNames = PhAllocate(sizeof(PPH_STRING) * Columns);
+        memset(Writer->ColumnNames, 0, sizeof(PPH_STRING) * Columns);
+    }
 
-                    if (Table[i][j])
-                    {
-                        // Calculate the number of spaces needed.
-                        k = (ULONG)((tabCount[j] + 1) * TAB_SIZE - Table[i][j]->Length / sizeof(WCHAR));
+    PhInitializeStringBuilder(&Writer->Line, 0x100);
+}
 
-                        PhAppendStringBuilder(&stringBuilder, &Table[i][j]->sr);
-                    }
-                    else
-                    {
-                        k = (tabCount[j] + 1) * TAB_SIZE;
-                    }
+/**
+ * Frees resources used by a text table writer.
+ *
+ * \param Writer A text table writer structure.
+ */
+VOID PhDeleteTextTableWriter(
+    _Inout_ PPH_TEXT_TABLE_WRITER Writer
+    )
+{
+    ULONG i;
 
-                    PhAppendCharStringBuilder2(&stringBuilder, ' ', k);
-                }
-            }
-            break;
-        case PH_EXPORT_MODE_CSV:
-            {
-                for (j = 0; j < Columns; j++)
-                {
-                    PhAppendCharStringBuilder(&stringBuilder, '\"');
+    if (Writer->TabCount)
+        PhFree(Writer->TabCount);
 
-                    if (Table[i][j])
-                    {
-                        PhpEscapeStringForCsv(&stringBuilder, Table[i][j]);
-                    }
+    if (Writer->ColumnNames)
+    {
+        for (i = 0; i < Writer->Columns; i++)
+            PhClearReference(&Writer->ColumnNames[i]);
 
-                    PhAppendCharStringBuilder(&stringBuilder, '\"');
+        PhFree(Writer->ColumnNames);
+    }
 
-                    if (j != Columns - 1)
-                        PhAppendCharStringBuilder(&stringBuilder, ',');
-                }
-            }
-            break;
+    PhDeleteStringBuilder(&Writer->Line);
+}
+
+/**
+ * Records the width of a cell.
+ *
+ * \param Writer A text table writer structure.
+ * \param Column The column of the cell.
+ * \param Text The text of the cell.
+ */
+VOID PhMeasureTextTableCell(
+    _Inout_ PPH_TEXT_TABLE_WRITER Writer,
+    _In_ ULONG Column,
+    _In_ PPH_STRINGREF Text
+    )
+{
+    ULONG newCount;
+
+    if (!Writer->TabCount)
+        return;
+
+    newCount = (ULONG)(Text->Length / sizeof(WCHAR) / TAB_SIZE);
+
+    if (Writer->TabCount[Column] < newCount)
+        Writer->TabCount[Column] = newCount;
+}
+
+/**
+ * Writes the next cell of a table. Cells are written from left to right, and each row is written
+ * to the file stream once its last cell has been added.
+ *
+ * \param Writer A text table writer structure.
+ * \param Text The text of the cell.
+ */
+NTSTATUS PhWriteTextTableCell(
+    _Inout_ PPH_TEXT_TABLE_WRITER Writer,
+    _In_ PPH_STRINGREF Text
+    )
+{
+    NTSTATUS status = STATUS_SUCCESS;
+
+    if (Writer->Row == 0 && Writer->Mode == PH_EXPORT_MODE_JSON_LINES)
+    {
+        // The headers become the keys of each object.
+        Writer->ColumnNames[Writer->Column] = PhpCreateJsonColumnName(Text);
+    }
+    else
+    {
+        PhpAppendTextTableCell(
+            &Writer->Line,
+            Writer->Mode,
+            Writer->Column,
+            Writer->Columns,
+            Text,
+            Writer->TabCount,
+            Writer->ColumnNames
+            );
+    }
+
+    if (++Writer->Column == Writer->Columns)
+    {
+        if (Writer->Line.String->Length != 0)
+        {
+            PhAppendStringBuilder2(&Writer->Line, L"\r\n");
+            status = PhWriteStringAsUtf8FileStream(Writer->FileStream, &Writer->Line.String->sr);
+            PhRemoveEndStringBuilder(&Writer->Line, Writer->Line.String->Length / sizeof(WCHAR));
         }
 
-        PhAddItemList(lines, PhFinalStringBuilderString(&stringBuilder));
+        Writer->Column = 0;
+        Writer->Row++;
     }
 
-    return lines;
+    return status;
 }
 
 VOID PhMapDisplayIndexTreeNew(
@@ -403,6 +693,87 @@ PPH_LIST PhGetGenericTreeNewLines(
     return lines;
 }
 
+/**
+ * Writes the contents of a tree list to a file stream.
+ *
+ * \param TreeNewHandle A handle to the tree list control.
+ * \param FileStream The file stream to write to.
+ * \param Mode The export formatting mode.
+ *
+ * \remarks Unlike PhGetGenericTreeNewLines(), this function does not keep a copy of the table in
+ * memory. In PH_EXPORT_MODE_TABS and PH_EXPORT_MODE_SPACES mode, the cell text is retrieved twice:
+ * once to calculate the column widths and once to write the cells.
+ */
+NTSTATUS PhWriteGenericTreeNew(
+    _In_ HWND TreeNewHandle,
+    _Inout_ PPH_FILE_STREAM FileStream,
+    _In_ ULONG Mode
+    )
+{
+    NTSTATUS status = STATUS_SUCCESS;
+    PH_TEXT_TABLE_WRITER writer;
+    ULONG columns;
+    ULONG numberOfNodes;
+    PULONG displayToId;
+    PWSTR *displayToText;
+    ULONG pass;
+    ULONG i;
+    ULONG j;
+
+    numberOfNodes = TreeNew_GetFlatNodeCount(TreeNewHandle);
+    PhMapDisplayIndexTreeNew(TreeNewHandle, &displayToId, &displayToText, &columns);
+    PhInitializeTextTableWriter(&writer, FileStream, Mode, columns);
+
+    // Pass 0 calculates the column widths, and pass 1 writes the cells.
+
+    for (pass = PH_EXPORT_MODE_ALIGNED(Mode) ? 0 : 1; pass < 2 && NT_SUCCESS(status); pass++)
+    {
+        for (j = 0; j < columns && NT_SUCCESS(status); j++)
+        {
+            PH_STRINGREF text;
+
+            PhInitializeStringRef(&text, displayToText[j]);
+
+            if (pass == 0)
+                PhMeasureTextTableCell(&writer, j, &text);
+            else
+                status = PhWriteTextTableCell(&writer, &text);
+        }
+
+        for (i = 0; i < numberOfNodes && NT_SUCCESS(status); i++)
+        {
+            PPH_TREENEW_NODE node;
+
+            node = TreeNew_GetFlatNode(TreeNewHandle, i);
+
+            for (j = 0; j < columns && NT_SUCCESS(status); j++)
+            {
+                PH_TREENEW_GET_CELL_TEXT getCellText;
+
+                PhInitializeEmptyStringRef(&getCellText.Text);
+
+                if (node)
+                {
+                    getCellText.Node = node;
+                    getCellText.Id = displayToId[j];
+                    TreeNew_GetCellText(TreeNewHandle, &getCellText);
+                }
+
+                if (pass == 0)
+                    PhMeasureTextTableCell(&writer, j, &getCellText.Text);
+                else
+                    status = PhWriteTextTableCell(&writer, &getCellText.Text);
+            }
+        }
+    }
+
+    PhDeleteTextTableWriter(&writer);
+    PhFree(displayToText);
+    PhFree(displayToId);
+
+    return status;
+}
+
 VOID PhaMapDisplayIndexListView(
     _In_ HWND ListViewHandle,
     _Out_writes_(Count) PULONG DisplayToId,
@@ -53,6 +53,25 @@ NTSTATUS PhCreateFileStream(
     PPH_FILE_STREAM fileStream;
     HANDLE fileHandle;
     ULONG createOptions;
+    ULONG bufferLength;
+
+    // Write-only streams are written behind by default. Nothing can read the file through the
+    // stream, and data is only guaranteed to reach the file when the stream is flushed anyway.
+    if (!(DesiredAccess & (FILE_READ_DATA | GENERIC_READ | GENERIC_ALL)) &&
+        !(Flags & (PH_FILE_STREAM_UNBUFFERED | PH_FILE_STREAM_ASYNCHRONOUS)))
+    {
+        Flags |= PH_FILE_STREAM_WRITE_BEHIND;
+    }
+
+    if (Flags & PH_FILE_STREAM_WRITE_BEHIND)
+    {
+        Flags |= PH_FILE_STREAM_ASYNCHRONOUS | PH_FILE_STREAM_OWN_POSITION;
+        bufferLength = PH_FILE_STREAM_WRITE_BEHIND_BUFFER_SIZE;
+    }
+    else
+    {
+        bufferLength = PAGE_SIZE;
+    }
 
     if (Flags & PH_FILE_STREAM_ASYNCHRONOUS)
         createOptions = FILE_NON_DIRECTORY_FILE;
@@ -74,7 +93,7 @@ NTSTATUS PhCreateFileStream(
         &fileStream,
         fileHandle,
         Flags,
-        PAGE_SIZE
+        bufferLength
         )))
     {
         NtClose(fileHandle);
@@ -112,6 +131,11 @@ NTSTATUS PhCreateFileStream2(
 {
     PPH_FILE_STREAM fileStream;
 
+    if (Flags & PH_FILE_STREAM_UNBUFFERED)
+        Flags &= ~PH_FILE_STREAM_WRITE_BEHIND;
+    if (Flags & PH_FILE_STREAM_WRITE_BEHIND)
+        Flags |= PH_FILE_STREAM_ASYNCHRONOUS | PH_FILE_STREAM_OWN_POSITION;
+
     fileStream = PhCreateObject(sizeof(PH_FILE_STREAM), PhFileStreamType);
     fileStream->FileHandle = FileHandle;
     fileStream->Flags = Flags;
@@ -132,6 +156,12 @@ NTSTATUS PhCreateFileStream2(
     fileStream->ReadLength = 0;
     fileStream->WritePosition = 0;
 
+    fileStream->WriteBufferIndex = 0;
+    fileStream->PendingWrites = 0;
+    memset(fileStream->WriteBuffers, 0, sizeof(fileStream->WriteBuffers));
+    memset(fileStream->WriteEvents, 0, sizeof(fileStream->WriteEvents));
+    memset(fileStream->WriteLength, 0, sizeof(fileStream->WriteLength));
+
     *FileStream = fileStream;
 
     return STATUS_SUCCESS;
@@ -143,14 +173,36 @@ VOID NTAPI PhpFileStreamDeleteProcedure(
     )
 {
     PPH_FILE_STREAM fileStream = (PPH_FILE_STREAM)Object;
+    ULONG i;
 
     PhFlushFileStream(fileStream, FALSE);
 
+    if (fileStream->Flags & PH_FILE_STREAM_WRITE_BEHIND)
+    {
+        // Even if the flush failed, the buffers can't be freed until the writes using them have
+        // completed.
+        for (i = 0; i < PH_FILE_STREAM_WRITE_BUFFERS; i++)
+            PhpWaitWriteFileStream(fileStream, i);
+    }
+
     if (!(fileStream->Flags & PH_FILE_STREAM_HANDLE_UNOWNED))
         NtClose(fileStream->FileHandle);
 
-    if (fileStream->Buffer)
-        PhFreePage(fileStream->Buffer);
+    if (fileStream->Flags & PH_FILE_STREAM_WRITE_BEHIND)
+    {
+        for (i = 0; i < PH_FILE_STREAM_WRITE_BUFFERS; i++)
+        {
+            if (fileStream->WriteBuffers[i])
+                PhFreePage(fileStream->WriteBuffers[i]);
+            if (fileStream->WriteEvents[i])
+                NtClose(fileStream->WriteEvents[i]);
+        }
+    }
+    else
+    {
+        if (fileStream->Buffer)
+            PhFreePage(fileStream->Buffer);
+    }
 }
 
 /**
@@ -189,6 +241,31 @@ NTSTATUS PhpAllocateBufferFileStream(
     _Inout_ PPH_FILE_STREAM FileStream
     )
 {
+    if (FileStream->Flags & PH_FILE_STREAM_WRITE_BEHIND)
+    {
+        NTSTATUS status;
+        ULONG i;
+
+        for (i = 0; i < PH_FILE_STREAM_WRITE_BUFFERS; i++)
+        {
+            if (!FileStream->WriteEvents[i])
+            {
+                if (!NT_SUCCESS(status = NtCreateEvent(&FileStream->WriteEvents[i], EVENT_ALL_ACCESS, NULL, NotificationEvent, FALSE)))
+                    return status;
+            }
+
+            if (!FileStream->WriteBuffers[i])
+            {
+                if (!(FileStream->WriteBuffers[i] = PhAllocatePage(FileStream->BufferLength, NULL)))
+                    return STATUS_NO_MEMORY;
+            }
+        }
+
+        FileStream->Buffer = FileStream->WriteBuffers[FileStream->WriteBufferIndex];
+
+        return STATUS_SUCCESS;
+    }
+
     FileStream->Buffer = PhAllocatePage(FileStream->BufferLength, NULL);
 
     if (FileStream->Buffer)
@@ -273,7 +350,7 @@ NTSTATUS PhReadFileStream(
     if (availableLength == 0)
     {
         // Make sure buffered writes are flushed.
-        if (FileStream->WritePosition != 0)
+        if (FileStream->WritePosition != 0 || FileStream->PendingWrites != 0)
         {
             if (!NT_SUCCESS(status = PhpFlushWriteFileStream(FileStream)))
                 return status;
@@ -441,6 +518,42 @@ NTSTATUS PhWriteFileStream(
             return status;
     }
 
+    if (FileStream->Flags & PH_FILE_STREAM_WRITE_BEHIND)
+    {
+        if (!FileStream->Buffer)
+        {
+            if (!NT_SUCCESS(status = PhpAllocateBufferFileStream(FileStream)))
+                return status;
+        }
+
+        // Large writes are copied through the buffers as well, so that they are pipelined with
+        // the caller instead of blocking it.
+        while (Length != 0)
+        {
+            writtenLength = FileStream->BufferLength - FileStream->WritePosition;
+
+            if (writtenLength > Length)
+                writtenLength = Length;
+
+            memcpy(
+                (PCHAR)FileStream->Buffer + FileStream->WritePosition,
+                Buffer,
+                writtenLength
+                );
+            FileStream->WritePosition += writtenLength;
+            Buffer = (PCHAR)Buffer + writtenLength;
+            Length -= writtenLength;
+
+            if (FileStream->WritePosition == FileStream->BufferLength)
+            {
+                if (!NT_SUCCESS(status = PhpQueueWriteFileStream(FileStream)))
+                    return status;
+            }
+        }
+
+        return status;
+    }
+
     if (FileStream->WritePosition != 0)
     {
         availableLength = FileStream->BufferLength - FileStream->WritePosition;
@@ -511,6 +624,77 @@ NTSTATUS PhWriteFileStream(
     return status;
 }
 
+/**
+ * Issues an asynchronous write for the current buffer of a write-behind stream and switches to the
+ * next buffer, waiting for that buffer's previous write to complete if necessary.
+ */
+NTSTATUS PhpQueueWriteFileStream(
+    _Inout_ PPH_FILE_STREAM FileStream
+    )
+{
+    NTSTATUS status;
+    ULONG index;
+
+    index = FileStream->WriteBufferIndex;
+
+    status = NtWriteFile(
+        FileStream->FileHandle,
+        FileStream->WriteEvents[index],
+        NULL,
+        NULL,
+        &FileStream->WriteIsb[index],
+        FileStream->Buffer,
+        FileStream->WritePosition,
+        &FileStream->Position,
+        NULL
+        );
+
+    // The event is only signaled if the write was actually started.
+    if (!NT_SUCCESS(status))
+        return status;
+
+    FileStream->WriteLength[index] = FileStream->WritePosition;
+    FileStream->PendingWrites++;
+    FileStream->Position.QuadPart += FileStream->WritePosition;
+    FileStream->Flags |= PH_FILE_STREAM_WRITTEN;
+
+    index = (index + 1) % PH_FILE_STREAM_WRITE_BUFFERS;
+    FileStream->WriteBufferIndex = index;
+    FileStream->Buffer = FileStream->WriteBuffers[index];
+    FileStream->WritePosition = 0;
+
+    return PhpWaitWriteFileStream(FileStream, index);
+}
+
+/**
+ * Waits for the write that uses a buffer of a write-behind stream to complete.
+ */
+NTSTATUS PhpWaitWriteFileStream(
+    _Inout_ PPH_FILE_STREAM FileStream,
+    _In_ ULONG Index
+    )
+{
+    NTSTATUS status;
+
+    if (FileStream->WriteLength[Index] == 0)
+        return STATUS_SUCCESS;
+
+    status = NtWaitForSingleObject(FileStream->WriteEvents[Index], FALSE, NULL);
+
+    if (NT_SUCCESS(status))
+    {
+        status = FileStream->WriteIsb[Index].Status;
+
+        if (NT_SUCCESS(status) && FileStream->WriteIsb[Index].Information != FileStream->WriteLength[Index])
+            status = STATUS_UNEXPECTED_IO_ERROR;
+    }
+
+    FileStream->WriteLength[Index] = 0;
+    FileStream->PendingWrites--;
+
+    return status;
+}
+
 NTSTATUS PhpFlushReadFileStream(
     _Inout_ PPH_FILE_STREAM FileStream
     )
@@ -545,6 +729,26 @@ NTSTATUS PhpFlushWriteFileStream(
 {
     NTSTATUS status = STATUS_SUCCESS;
 
+    if (FileStream->Flags & PH_FILE_STREAM_WRITE_BEHIND)
+    {
+        NTSTATUS waitStatus;
+        ULONG i;
+
+        if (FileStream->WritePosition != 0)
+            status = PhpQueueWriteFileStream(FileStream);
+
+        // Wait for all writes, even if one of them failed, and report the first error.
+        for (i = 0; i < PH_FILE_STREAM_WRITE_BUFFERS; i++)
+        {
+            waitStatus = PhpWaitWriteFileStream(FileStream, i);
+
+            if (NT_SUCCESS(status))
+                status = waitStatus;
+        }
+
+        return status;
+    }
+
     if (!NT_SUCCESS(status = PhpWriteFileStream(
         FileStream,
         FileStream->Buffer,
@@ -563,6 +767,9 @@ NTSTATUS PhpFlushWriteFileStream(
  * \param FileStream A file stream object.
  * \param Full TRUE to flush the file object through the operating system, otherwise FALSE to only
  * ensure the buffer is flushed to the operating system.
+ *
+ * \remarks For write-behind streams, this function waits for all outstanding writes to complete
+ * and reports any errors from them.
  */
 NTSTATUS PhFlushFileStream(
     _Inout_ PPH_FILE_STREAM FileStream,
@@ -571,7 +778,7 @@ NTSTATUS PhFlushFileStream(
 {
     NTSTATUS status = STATUS_SUCCESS;
 
-    if (FileStream->WritePosition != 0)
+    if (FileStream->WritePosition != 0 || FileStream->PendingWrites != 0)
     {
         if (!NT_SUCCESS(status = PhpFlushWriteFileStream(FileStream)))
             return status;
@@ -672,7 +879,7 @@ NTSTATUS PhSeekFileStream(
 
     offset = *Offset;
 
-    if (FileStream->WritePosition != 0)
+    if (FileStream->WritePosition != 0 || FileStream->PendingWrites != 0)
     {
         if (!NT_SUCCESS(status = PhpFlushWriteFileStream(FileStream)))
             return status;
@@ -124,6 +124,815 @@ VOID PhpCropZeros(
     }
 }
 
+static CHAR PhpDecimalDigitPairs[201] =
+    "00010203040506070809"
+    "10111213141516171819"
+    "20212223242526272829"
+    "30313233343536373839"
+    "40414243444546474849"
+    "50515253545556575859"
+    "60616263646566676869"
+    "70717273747576777879"
+    "80818283848586878889"
+    "90919293949596979899";
+
+/**
+ * Converts an integer to decimal digits. The digits are written backwards from the end of the
+ * buffer.
+ *
+ * \param Value The integer to convert.
+ * \param End A pointer to the character after the last digit.
+ * \param Separator The thousand separator, or 0 to disable digit grouping.
+ *
+ * \return The number of characters written.
+ */
+static ULONG PhpFormatDecimal(
+    _In_ ULONG64 Value,
+    _In_ PWCHAR End,
+    _In_ WCHAR Separator
+    )
+{
+    PWCHAR p;
+    ULONG value32;
+    ULONG r;
+
+    p = End;
+
+    // Produce two or three digits per division. Division of 64-bit integers is expensive on
+    // 32-bit platforms, so we switch to 32-bit arithmetic as soon as the value fits.
+
+    if (Separator)
+    {
+        while (Value >= 1000)
+        {
+            r = (ULONG)(Value % 1000);
+            Value /= 1000;
+            p -= 3;
+            p[0] = '0' + (WCHAR)(r / 100);
+            p[1] = PhpDecimalDigitPairs[(r % 100) * 2];
+            p[2] = PhpDecimalDigitPairs[(r % 100) * 2 + 1];
+            *--p = Separator;
+        }
+
+        value32 = (ULONG)Value;
+    }
+    else
+    {
+        while (Value > MAXULONG)
+        {
+            r = (ULONG)(Value % 100);
+            Value /= 100;
+            p -= 2;
+            p[0] = PhpDecimalDigitPairs[r * 2];
+            p[1] = PhpDecimalDigitPairs[r * 2 + 1];
+        }
+
+        value32 = (ULONG)Value;
+
+        while (value32 >= 100)
+        {
+            r = value32 % 100;
+            value32 /= 100;
+            p -= 2;
+            p[0] = PhpDecimalDigitPairs[r * 2];
+            p[1] = PhpDecimalDigitPairs[r * 2 + 1];
+        }
+    }
+
+    do
+    {
+        *--p = '0' + (WCHAR)(value32 % 10);
+        value32 /= 10;
+    } while (value32 != 0);
+
+    return (ULONG)(End - p);
+}
+
+#define PHP_FORMAT_DOUBLE_MAXIMUM_LIMBS 36
+
+/**
+ * Formats a floating-point number in fixed-point notation.
+ *
+ * \param Value The number to format.
+ * \param Precision The number of digits after the decimal point.
+ * \param Buffer A buffer which receives the null-terminated string. The buffer must have space for
+ * at least 313 + \a Precision characters.
+ *
+ * \return TRUE if the number was formatted, or FALSE if the number is an infinity or a NaN.
+ *
+ * \remarks The number is converted to decimal exactly and then rounded to \a Precision digits,
+ * with ties rounded to even (0.125 becomes "0.12"). This matches the UCRT in Windows 10 version
+ * 2004 and later, but older versions of the UCRT round ties away from zero (0.125 becomes "0.13"),
+ * so output for exact ties can differ from printf on those systems. Numbers with no more than 60
+ * fractional bits and an integer part that fits in 64 bits are handled using 64-bit arithmetic;
+ * other numbers use a small multi-precision integer.
+ */
+static BOOLEAN PhpFormatDoubleFixed(
+    _In_ DOUBLE Value,
+    _In_ ULONG Precision,
+    _Out_ PSTR Buffer
+    )
+{
+    ULONG64 bits;
+    ULONG64 mantissa;
+    LONG exponent;
+    CHAR decimalSeparator;
+    PSTR p;
+    PSTR integerStart;
+    BOOLEAN roundUp;
+    ULONG i;
+
+    memcpy(&bits, &Value, sizeof(ULONG64));
+    exponent = (LONG)((bits >> 52) & 0x7ff);
+    mantissa = bits & 0xfffffffffffffULL;
+
+    if (exponent == 0x7ff)
+        return FALSE;
+
+    // Value = mantissa * 2^exponent
+
+    if (exponent != 0)
+    {
+        mantissa |= 0x10000000000000ULL;
+        exponent -= 1075;
+    }
+    else
+    {
+        exponent = -1074;
+    }
+
+    decimalSeparator = (CHAR)PhpFormatDecimalSeparator;
+    p = Buffer;
+
+    if (bits >> 63)
+        *p++ = '-';
+
+    integerStart = p;
+    roundUp = FALSE;
+
+    if (exponent >= -60 && exponent <= 11)
+    {
+        ULONG shift;
+        ULONG64 integer;
+        ULONG64 fraction;
+        ULONG64 mask;
+        CHAR digits[20];
+        PCHAR d;
+
+        if (exponent >= 0)
+        {
+            shift = 0;
+            integer = mantissa << exponent;
+        }
+        else
+        {
+            shift = -exponent;
+            integer = mantissa >> shift;
+        }
+
+        mask = (1ULL << shift) - 1;
+        fraction = mantissa & mask;
+
+        d = digits + sizeof(digits);
+
+        do
+        {
+            *--d = '0' + (CHAR)(integer % 10);
+            integer /= 10;
+        } while (integer != 0);
+
+        memcpy(p, d, digits + sizeof(digits) - d);
+        p += digits + sizeof(digits) - d;
+
+        if (Precision != 0)
+        {
+            *p++ = decimalSeparator;
+
+            for (i = 0; i < Precision; i++)
+            {
+                if (fraction == 0)
+                {
+                    memset(p, '0', Precision - i);
+                    p += Precision - i;
+                    break;
+                }
+
+                // The fraction has at most 60 bits, so this cannot overflow.
+                fraction *= 10;
+                *p++ = '0' + (CHAR)(fraction >> shift);
+                fraction &= mask;
+            }
+        }
+
+        if (shift != 0)
+        {
+            ULONG64 half = 1ULL << (shift - 1);
+
+            roundUp = fraction > half || (fraction == half && ((p[-1] - '0') & 1));
+        }
+    }
+    else if (exponent > 0)
+    {
+        ULONG limbs[PHP_FORMAT_DOUBLE_MAXIMUM_LIMBS];
+        ULONG numberOfLimbs;
+        ULONG index;
+        ULONG bitShift;
+        CHAR digits[320];
+        PCHAR d;
+
+        // There is no fractional part. Shift the mantissa into place, then produce 9 digits at a
+        // time by repeatedly dividing by 10^9.
+
+        index = exponent / 32;
+        bitShift = exponent % 32;
+        memset(limbs, 0, index * sizeof(ULONG));
+
+        if (bitShift != 0)
+        {
+            limbs[index] = (ULONG)(mantissa << bitShift);
+            limbs[index + 1] = (ULONG)(mantissa >> (32 - bitShift));
+            limbs[index + 2] = (ULONG)(mantissa >> (64 - bitShift));
+        }
+        else
+        {
+            limbs[index] = (ULONG)mantissa;
+            limbs[index + 1] = (ULONG)(mantissa >> 32);
+            limbs[index + 2] = 0;
+        }
+
+        numberOfLimbs = index + 3;
+        d = digits + sizeof(digits);
+
+        while (numberOfLimbs != 0 && limbs[numberOfLimbs - 1] == 0)
+            numberOfLimbs--;
+
+        while (numberOfLimbs != 0)
+        {
+            ULONG64 remainder;
+            ULONG r;
+
+            remainder = 0;
+
+            for (i = numberOfLimbs; i != 0; i--)
+            {
+                remainder = (remainder << 32) | limbs[i - 1];
+                limbs[i - 1] = (ULONG)(remainder / 1000000000);
+                remainder %= 1000000000;
+            }
+
+            while (numberOfLimbs != 0 && limbs[numberOfLimbs - 1] == 0)
+                numberOfLimbs--;
+
+            // Leading zeros are only needed if there are more significant digits to come.
+
+            r = (ULONG)remainder;
+
+            for (i = 0; i < 9 && (numberOfLimbs != 0 || r != 0); i++)
+            {
+                *--d = '0' + (CHAR)(r % 10);
+                r /= 10;
+            }
+        }
+
+        memcpy(p, d, digits + sizeof(digits) - d);
+        p += digits + sizeof(digits) - d;
+
+        if (Precision != 0)
+        {
+            *p++ = decimalSeparator;
+            memset(p, '0', Precision);
+            p += Precision;
+        }
+    }
+    else
+    {
+        ULONG limbs[PHP_FORMAT_DOUBLE_MAXIMUM_LIMBS];
+        ULONG numberOfLimbs;
+        ULONG shift;
+        ULONG index;
+        ULONG bitShift;
+
+        // The value is less than 2^-7, so the integer part is 0. The fraction has more than 60
+        // bits, so we use enough limbs to hold the fraction multiplied by 10. Each digit is taken
+        // from the 4 bits above the fraction.
+
+        shift = -exponent;
+        numberOfLimbs = (shift + 4) / 32 + 1;
+        memset(limbs, 0, numberOfLimbs * sizeof(ULONG));
+        limbs[0] = (ULONG)mantissa;
+        limbs[1] = (ULONG)(mantissa >> 32);
+        index = shift / 32;
+        bitShift = shift % 32;
+
+        *p++ = '0';
+
+        if (Precision != 0)
+        {
+            *p++ = decimalSeparator;
+
+            for (i = 0; i < Precision; i++)
+            {
+                ULONG64 carry;
+                ULONG64 top;
+                ULONG j;
+
+                carry = 0;
+
+                for (j = 0; j < numberOfLimbs; j++)
+                {
+                    carry += (ULONG64)limbs[j] * 10;
+                    limbs[j] = (ULONG)carry;
+                    carry >>= 32;
+                }
+
+                top = limbs[index];
+
+                if (index + 1 < numberOfLimbs)
+                {
+                    top |= (ULONG64)limbs[index + 1] << 32;
+                    limbs[index + 1] = 0;
+                }
+
+                *p++ = '0' + (CHAR)((top >> bitShift) & 0xf);
+                limbs[index] &= (1UL << bitShift) - 1;
+            }
+        }
+
+        index = (shift - 1) / 32;
+        bitShift = (shift - 1) % 32;
+
+        if (limbs[index] & (1UL << bitShift))
+        {
+            BOOLEAN tie;
+
+            tie = (limbs[index] & ((1UL << bitShift) - 1)) == 0;
+
+            for (i = 0; tie && i < index; i++)
+            {
+                if (limbs[i] != 0)
+                    tie = FALSE;
+            }
+
+            roundUp = !tie || ((p[-1] - '0') & 1);
+        }
+    }
+
+    if (roundUp)
+    {
+        PSTR q;
+
+        for (q = p - 1; q >= integerStart; q--)
+        {
+            if (*q == decimalSeparator)
+                continue;
+
+            if (*q != '9')
+            {
+                (*q)++;
+                break;
+            }
+
+            *q = '0';
+        }
+
+        if (q < integerStart)
+        {
+            // The carry propagated out of the most significant digit.
+            memmove(integerStart + 1, integerStart, p - integerStart);
+            *integerStart = '1';
+            p++;
+        }
+    }
+
+    *p = 0;
+
+    return TRUE;
+}
+
+#define PHP_BIGNUM_MAXIMUM_LIMBS 40
+
+typedef struct _PHP_BIGNUM
+{
+    ULONG Count;
+    ULONG Limbs[PHP_BIGNUM_MAXIMUM_LIMBS];
+} PHP_BIGNUM, *PPHP_BIGNUM;
+
+static VOID PhpSetBignum(
+    _Out_ PPHP_BIGNUM Number,
+    _In_ ULONG64 Value
+    )
+{
+    Number->Limbs[0] = (ULONG)Value;
+    Number->Limbs[1] = (ULONG)(Value >> 32);
+    Number->Count = Number->Limbs[1] ? 2 : (Number->Limbs[0] ? 1 : 0);
+}
+
+static VOID PhpShiftLeftBignum(
+    _Inout_ PPHP_BIGNUM Number,
+    _In_ ULONG Shift
+    )
+{
+    ULONG index;
+    ULONG bitShift;
+    ULONG i;
+
+    if (Number->Count == 0)
+        return;
+
+    index = Shift / 32;
+    bitShift = Shift % 32;
+
+    if (bitShift != 0)
+    {
+        Number->Limbs[Number->Count + index] = Number->Limbs[Number->Count - 1] >> (32 - bitShift);
+
+        for (i = Number->Count - 1; i != 0; i--)
+        {
+            Number->Limbs[i + index] = (Number->Limbs[i] << bitShift) |
+                (Number->Limbs[i - 1] >> (32 - bitShift));
+        }
+
+        Number->Limbs[index] = Number->Limbs[0] << bitShift;
+        Number->Count += index + 1;
+
+        if (Number->Limbs[Number->Count - 1] == 0)
+            Number->Count--;
+    }
+    else
+    {
+        memmove(&Number->Limbs[index], Number->Limbs, Number->Count * sizeof(ULONG));
+        Number->Count += index;
+    }
+
+    memset(Number->Limbs, 0, index * sizeof(ULONG));
+}
+
+static VOID PhpMultiplyBignum(
+    _Inout_ PPHP_BIGNUM Number,
+    _In_ ULONG Factor
+    )
+{
+    ULONG64 carry;
+    ULONG i;
+
+    carry = 0;
+
+    for (i = 0; i < Number->Count; i++)
+    {
+        carry += (ULONG64)Number->Limbs[i] * Factor;
+        Number->Limbs[i] = (ULONG)carry;
+        carry >>= 32;
+    }
+
+    if (carry != 0)
+        Number->Limbs[Number->Count++] = (ULONG)carry;
+}
+
+static VOID PhpMultiplyPower10Bignum(
+    _Inout_ PPHP_BIGNUM Number,
+    _In_ ULONG Exponent
+    )
+{
+    static ULONG powers[10] = { 1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000 };
+
+    for (; Exponent >= 9; Exponent -= 9)
+        PhpMultiplyBignum(Number, powers[9]);
+
+    if (Exponent != 0)
+        PhpMultiplyBignum(Number, powers[Exponent]);
+}
+
+static LONG PhpCompareBignum(
+    _In_ PPHP_BIGNUM Number1,
+    _In_ PPHP_BIGNUM Number2
+    )
+{
+    ULONG i;
+
+    if (Number1->Count != Number2->Count)
+        return Number1->Count < Number2->Count ? -1 : 1;
+
+    for (i = Number1->Count; i != 0; i--)
+    {
+        if (Number1->Limbs[i - 1] != Number2->Limbs[i - 1])
+            return Number1->Limbs[i - 1] < Number2->Limbs[i - 1] ? -1 : 1;
+    }
+
+    return 0;
+}
+
+/**
+ * Compares the sum of two numbers with a third number.
+ */
+static LONG PhpCompareSumBignum(
+    _In_ PPHP_BIGNUM Number1,
+    _In_ PPHP_BIGNUM Number2,
+    _In_ PPHP_BIGNUM Number3
+    )
+{
+    PHP_BIGNUM sum;
+    ULONG64 carry;
+    ULONG count;
+    ULONG i;
+
+    count = max(Number1->Count, Number2->Count);
+    carry = 0;
+
+    for (i = 0; i < count; i++)
+    {
+        if (i < Number1->Count)
+            carry += Number1->Limbs[i];
+        if (i < Number2->Count)
+            carry += Number2->Limbs[i];
+
+        sum.Limbs[i] = (ULONG)carry;
+        carry >>= 32;
+    }
+
+    if (carry != 0)
+        sum.Limbs[count++] = (ULONG)carry;
+
+    sum.Count = count;
+
+    return PhpCompareBignum(&sum, Number3);
+}
+
+/**
+ * Subtracts a number from another number which is not smaller.
+ */
+static VOID PhpSubtractBignum(
+    _Inout_ PPHP_BIGNUM Number1,
+    _In_ PPHP_BIGNUM Number2
+    )
+{
+    LONG64 borrow;
+    ULONG i;
+
+    borrow = 0;
+
+    for (i = 0; i < Number1->Count; i++)
+    {
+        borrow += Number1->Limbs[i];
+
+        if (i < Number2->Count)
+            borrow -= Number2->Limbs[i];
+
+        Number1->Limbs[i] = (ULONG)borrow;
+        borrow >>= 32;
+    }
+
+    while (Number1->Count != 0 && Number1->Limbs[Number1->Count - 1] == 0)
+        Number1->Count--;
+}
+
+/**
+ * Formats a floating-point number in fixed-point notation using the fewest digits that convert
+ * back to the same number.
+ *
+ * \param Value The number to format.
+ * \param Buffer A buffer which receives the null-terminated string. The buffer must have space for
+ * at least 350 characters.
+ *
+ * \return TRUE if the number was formatted, or FALSE if the number is an infinity or a NaN.
+ *
+ * \remarks Integers below 2^53 are formatted directly. Other numbers use the free-format algorithm
+ * of Burger and Dybvig: digits are generated until the number is the only double which rounds to
+ * them, and the last digit is chosen so that the result is as close as possible to \a Value.
+ */
+static BOOLEAN PhpFormatDoubleShortest(
+    _In_ DOUBLE Value,
+    _Out_ PSTR Buffer
+    )
+{
+    ULONG64 bits;
+    ULONG64 mantissa;
+    LONG exponent;
+    PSTR p;
+    CHAR digits[20];
+    ULONG numberOfDigits;
+    LONG k;
+    ULONG i;
+
+    memcpy(&bits, &Value, sizeof(ULONG64));
+    exponent = (LONG)((bits >> 52) & 0x7ff);
+    mantissa = bits & 0xfffffffffffffULL;
+
+    if (exponent == 0x7ff)
+        return FALSE;
+
+    p = Buffer;
+
+    if (bits >> 63)
+        *p++ = '-';
+
+    if (exponent == 0 && mantissa == 0)
+    {
+        p[0] = '0';
+        p[1] = 0;
+        return TRUE;
+    }
+
+    // Value = mantissa * 2^exponent
+
+    if (exponent != 0)
+    {
+        mantissa |= 0x10000000000000ULL;
+        exponent -= 1075;
+    }
+    else
+    {
+        exponent = -1074;
+    }
+
+    if (exponent <= 0 && exponent > -53 && (mantissa & ((1ULL << -exponent) - 1)) == 0)
+    {
+        ULONG64 integer;
+        PCHAR d;
+
+        // Fast path for integers below 2^53. These are always exact.
+
+        integer = mantissa >> -exponent;
+        d = digits + sizeof(digits);
+
+        do
+        {
+            *--d = '0' + (CHAR)(integer % 10);
+            integer /= 10;
+        } while (integer != 0);
+
+        numberOfDigits = (ULONG)(digits + sizeof(digits) - d);
+        memcpy(p, d, numberOfDigits);
+        p[numberOfDigits] = 0;
+
+        return TRUE;
+    }
+    else
+    {
+        PHP_BIGNUM r;
+        PHP_BIGNUM s;
+        PHP_BIGNUM mPlus;
+        PHP_BIGNUM mMinus;
+        BOOLEAN even;
+        BOOLEAN low;
+        BOOLEAN high;
+        ULONG bitLength;
+        LONG64 temp;
+
+        // Value = r / s, and the doubles on either side of Value are (r - mMinus) / s and
+        // (r + mPlus) / s. All numbers are scaled by 2 so that the midpoints are integers.
+        // When the mantissa is a power of 2, the gap below Value is half the gap above it.
+
+        even = (mantissa & 1) == 0;
+
+        if (exponent >= 0)
+        {
+            PhpSetBignum(&r, mantissa);
+            PhpSetBignum(&s, 2);
+            PhpSetBignum(&mPlus, 1);
+            PhpShiftLeftBignum(&mPlus, exponent);
+            mMinus = mPlus;
+
+            if (mantissa == 0x10000000000000ULL)
+            {
+                PhpShiftLeftBignum(&r, exponent + 2);
+                PhpShiftLeftBignum(&s, 1);
+                PhpShiftLeftBignum(&mPlus, 1);
+            }
+            else
+            {
+                PhpShiftLeftBignum(&r, exponent + 1);
+            }
+        }
+        else
+        {
+            PhpSetBignum(&r, mantissa);
+            PhpSetBignum(&s, 1);
+            PhpSetBignum(&mPlus, 1);
+            PhpSetBignum(&mMinus, 1);
+
+            if (mantissa == 0x10000000000000ULL && exponent != -1074)
+            {
+                PhpShiftLeftBignum(&r, 2);
+                PhpShiftLeftBignum(&s, 2 - exponent);
+                PhpShiftLeftBignum(&mPlus, 1);
+            }
+            else
+            {
+                PhpShiftLeftBignum(&r, 1);
+                PhpShiftLeftBignum(&s, 1 - exponent);
+            }
+        }
+
+        // Estimate k = ceil(log10(Value)) from the bit length. The estimate is never too large, and
+        // is corrected below.
+
+        bitLength = 64;
+
+        while (!(mantissa >> (bitLength - 1)))
+            bitLength--;
+
+        temp = ((LONG64)exponent + bitLength - 1) * 1233;
+        k = (LONG)(temp / 4096) - 2;
+
+        if (k >= 0)
+        {
+            PhpMultiplyPower10Bignum(&s, k);
+        }
+        else
+        {
+            PhpMultiplyPower10Bignum(&r, -k);
+            PhpMultiplyPower10Bignum(&mPlus, -k);
+            PhpMultiplyPower10Bignum(&mMinus, -k);
+        }
+
+        while (PhpCompareSumBignum(&r, &mPlus, &s) >= (even ? 0 : 1))
+        {
+            PhpMultiplyBignum(&s, 10);
+            k++;
+        }
+
+        // Generate digits.
+
+        numberOfDigits = 0;
+
+        while (TRUE)
+        {
+            CHAR digit;
+
+            PhpMultiplyBignum(&r, 10);
+            PhpMultiplyBignum(&mPlus, 10);
+            PhpMultiplyBignum(&mMinus, 10);
+
+            digit = 0;
+
+            while (PhpCompareBignum(&r, &s) >= 0)
+            {
+                PhpSubtractBignum(&r, &s);
+                digit++;
+            }
+
+            low = PhpCompareBignum(&r, &mMinus) < (even ? 1 : 0);
+            high = PhpCompareSumBignum(&r, &mPlus, &s) >= (even ? 0 : 1);
+
+            if (low || high)
+            {
+                if (low && high)
+                {
+                    LONG result;
+
+                    // Both candidates are close enough, so use the nearer one. Ties go to even.
+
+                    result = PhpCompareSumBignum(&r, &r, &s);
+
+                    if (result > 0 || (result == 0 && (digit & 1)))
+                        digit++;
+                }
+                else if (high)
+                {
+                    digit++;
+                }
+
+                digits[numberOfDigits++] = '0' + digit;
+                break;
+            }
+
+            digits[numberOfDigits++] = '0' + digit;
+        }
+    }
+
+    // Value = 0.digits * 10^k
+
+    if (k <= 0)
+    {
+        *p++ = '0';
+        *p++ = (CHAR)PhpFormatDecimalSeparator;
+        memset(p, '0', -k);
+        p += -k;
+        memcpy(p, digits, numberOfDigits);
+        p += numberOfDigits;
+    }
+    else if ((ULONG)k < numberOfDigits)
+    {
+        memcpy(p, digits, k);
+        p += k;
+        *p++ = (CHAR)PhpFormatDecimalSeparator;
+        memcpy(p, digits + k, numberOfDigits - k);
+        p += numberOfDigits - k;
+    }
+    else
+    {
+        memcpy(p, digits, numberOfDigits);
+        p += numberOfDigits;
+
+        for (i = numberOfDigits; i < (ULONG)k; i++)
+            *p++ = '0';
+    }
+
+    *p = 0;
+
+    return TRUE;
+}
+
 PPH_STRING PhpResizeFormatBuffer(
     _In_ PPH_STRING String,
     _Inout_ PSIZE_T AllocatedLength,
@@ -275,3 +1084,51 @@ BOOLEAN PhFormatToBuffer(
 
     return OK_BUFFER;
 }
+
+/**
+ * Writes a number of formatted strings to a buffer.
+ *
+ * \param Format An array of format structures, one for each string.
+ * \param Count The number of structures supplied in \a Format.
+ * \param Buffer A buffer which receives the strings. The string for Format[i] is written at byte
+ * offset i * \a BufferLength.
+ * \param BufferLength The number of bytes available for each string, including space for the null
+ * terminator.
+ * \param ReturnLengths An array which receives the number of bytes required to hold each string,
+ * including the null terminator.
+ *
+ * \return TRUE if every string was written, otherwise FALSE. A string which does not fit is
+ * replaced with an empty string.
+ *
+ * \remarks This function is intended for callers that format many cells at once, such as a row of
+ * numeric columns.
+ */
+BOOLEAN PhFormatToBufferBatch(
+    _In_reads_(Count) PPH_FORMAT Format,
+    _In_ ULONG Count,
+    _Out_writes_bytes_(Count * BufferLength) PWSTR Buffer,
+    _In_ SIZE_T BufferLength,
+    _Out_writes_opt_(Count) PSIZE_T ReturnLengths
+    )
+{
+    BOOLEAN result;
+    ULONG i;
+
+    result = TRUE;
+
+    for (i = 0; i < Count; i++)
+    {
+        if (!PhFormatToBuffer(
+            &Format[i],
+            1,
+            (PWSTR)((PCHAR)Buffer + i * BufferLength),
+            BufferLength,
+            ReturnLengths ? &ReturnLengths[i] : NULL
+            ))
+        {
+            result = FALSE;
+        }
+    }
+
+    return result;
+}
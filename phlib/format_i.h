@@ -151,7 +151,16 @@
         temp = tempBuffer + BUFFER_SIZE - 1; \
         tempCount = 0; \
         \
-        if (Input != 0) \
+        if (radix == 10) \
+        { \
+            tempCount = PhpFormatDecimal( \
+                Input, \
+                tempBuffer + BUFFER_SIZE, \
+                ((Format)->Type & FormatGroupDigits) ? PhpFormatThousandSeparator : 0 \
+                ); \
+            temp -= tempCount; \
+        } \
+        else if (Input != 0) \
         { \
             if ((Format)->Type & FormatGroupDigits) \
             { \
@@ -307,19 +316,25 @@ CommonInt64Format:
         else if ((Format)->Type & FormatHexadecimalForm) \
             c = 'a'; \
         \
-        /* Use MS CRT routines to do the work. */ \
+        /* Fixed-point and shortest notation are handled by our own code. Use MS CRT routines */ \
+        /* to do the rest of the work. */ \
         \
         value = (Format)->u.Double; \
         temp = (PSTR)tempBuffer + 1; /* leave one character so we can insert a prefix if needed */ \
-        _cfltcvt_l( \
-            &value, \
-            temp, \
-            sizeof(tempBuffer) - 1, \
-            c, \
-            precision, \
-            !!((Format)->Type & FormatUpperCase), \
-            PhpFormatUserLocale \
-            ); \
+        if (c != 'f' || ( \
+            ((Format)->Type & FormatShortestForm) ? !PhpFormatDoubleShortest(value, temp) : \
+            !PhpFormatDoubleFixed(value, precision, temp))) \
+        { \
+            _cfltcvt_l( \
+                &value, \
+                temp, \
+                sizeof(tempBuffer) - 1, \
+                c, \
+                precision, \
+                !!((Format)->Type & FormatUpperCase), \
+                PhpFormatUserLocale \
+                ); \
+        } \
         \
         /* if (((Format)->Type & FormatForceDecimalPoint) && precision == 0) */ \
              /* _forcdecpt_l(tempBufferAnsi, PhpFormatUserLocale); */ \
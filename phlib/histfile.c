@@ -0,0 +1,575 @@
+/*
+ * Process Hacker -
+ *   file-based history
+ *
+ * This file is part of Process Hacker.
+ *
+ * Process Hacker is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Process Hacker is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Process Hacker.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * A history file keeps samples of a set of series in a file pool, so that history survives
+ * restarts and long periods can be kept without using memory for every sample. Levels with lower
+ * resolutions are built as samples are added: when a sample falls in a new period of level N + 1,
+ * the rows of level N from the previous period are summarized into one row of level N + 1. The
+ * partial summaries are stored in the file as well, so nothing is lost when the file is reopened.
+ *
+ * Adding a sample writes one row to each level at most, into views which the file pool keeps
+ * mapped, so it is cheap enough to do on every update.
+ */
+
+#include <ph.h>
+#include <histfile.h>
+
+static VOID PhpDestroyHistoryFile(
+    _In_ PPH_HISTORY_FILE HistoryFile
+    )
+{
+    ULONG i;
+
+    if (HistoryFile->Header)
+    {
+        for (i = 0; i < HistoryFile->Header->NumberOfLevels; i++)
+        {
+            if (HistoryFile->ChunkTables[i])
+                PhDereferenceFilePool(HistoryFile->Pool, HistoryFile->ChunkTables[i]);
+            if (HistoryFile->Pending[i])
+                PhDereferenceFilePool(HistoryFile->Pool, HistoryFile->Pending[i]);
+        }
+
+        PhDereferenceFilePool(HistoryFile->Pool, HistoryFile->Header);
+    }
+
+    if (HistoryFile->Pool)
+        PhDestroyFilePool(HistoryFile->Pool);
+
+    if (HistoryFile->Scratch)
+        PhFree(HistoryFile->Scratch);
+
+    PhFree(HistoryFile);
+}
+
+static BOOLEAN PhpMatchHistoryFile(
+    _In_ PPH_HF_HEADER Header,
+    _In_ ULONG NumberOfSeries,
+    _In_ ULONG NumberOfLevels,
+    _In_reads_(NumberOfLevels) PPH_HISTORY_FILE_LEVEL Levels
+    )
+{
+    ULONG rowsPerChunk;
+    ULONG i;
+
+    if (Header->Magic != PH_HF_MAGIC)
+        return FALSE;
+    if (Header->NumberOfSeries != NumberOfSeries || Header->NumberOfLevels != NumberOfLevels)
+        return FALSE;
+
+    rowsPerChunk = PH_HISTORY_FILE_CHUNK_SIZE / (sizeof(ULONG) + NumberOfSeries * 2 * sizeof(FLOAT));
+
+    for (i = 0; i < NumberOfLevels; i++)
+    {
+        if (Header->Levels[i].Resolution != Levels[i].Resolution)
+            return FALSE;
+        if (Header->Levels[i].RowsPerChunk != rowsPerChunk)
+            return FALSE;
+        if (Header->Levels[i].NumberOfChunks != (Levels[i].Capacity + rowsPerChunk - 1) / rowsPerChunk)
+            return FALSE;
+    }
+
+    return TRUE;
+}
+
+static NTSTATUS PhpInitializeHistoryFile(
+    _Inout_ PPH_HISTORY_FILE HistoryFile,
+    _In_ ULONG NumberOfLevels,
+    _In_reads_(NumberOfLevels) PPH_HISTORY_FILE_LEVEL Levels
+    )
+{
+    PPH_HF_HEADER header;
+    ULONGLONG userContext;
+    ULONG i;
+
+    header = PhAllocateFilePool(HistoryFile->Pool, sizeof(PH_HF_HEADER), &HistoryFile->HeaderRva);
+
+    if (!header)
+        return STATUS_NO_MEMORY;
+
+    memset(header, 0, sizeof(PH_HF_HEADER));
+    header->NumberOfSeries = HistoryFile->NumberOfSeries;
+    header->NumberOfLevels = NumberOfLevels;
+    HistoryFile->Header = header;
+
+    for (i = 0; i < NumberOfLevels; i++)
+    {
+        PPH_HF_LEVEL_HEADER level = &header->Levels[i];
+        PVOID block;
+
+        level->Resolution = Levels[i].Resolution;
+        level->RowsPerChunk = PH_HISTORY_FILE_CHUNK_SIZE / HistoryFile->RowSize;
+        level->NumberOfChunks = (Levels[i].Capacity + level->RowsPerChunk - 1) / level->RowsPerChunk;
+        level->Capacity = level->NumberOfChunks * level->RowsPerChunk;
+
+        if (!(block = PhAllocateFilePool(HistoryFile->Pool, level->NumberOfChunks * sizeof(ULONG), &level->ChunkTableRva)))
+            return STATUS_NO_MEMORY;
+
+        memset(block, 0, level->NumberOfChunks * sizeof(ULONG));
+        PhDereferenceFilePool(HistoryFile->Pool, block);
+
+        if (!(block = PhAllocateFilePool(HistoryFile->Pool, HistoryFile->NumberOfSeries * 2 * sizeof(FLOAT), &level->PendingRva)))
+            return STATUS_NO_MEMORY;
+
+        PhDereferenceFilePool(HistoryFile->Pool, block);
+    }
+
+    // Only mark the header as valid once everything else has been allocated.
+    header->Magic = PH_HF_MAGIC;
+    userContext = HistoryFile->HeaderRva;
+    PhSetUserContextFilePool(HistoryFile->Pool, &userContext);
+
+    return STATUS_SUCCESS;
+}
+
+/**
+ * Creates or opens a history file.
+ *
+ * \param HistoryFile A variable which receives the history file instance.
+ * \param FileName The file name of the history file.
+ * \param NumberOfSeries The number of values in each sample.
+ * \param NumberOfLevels The number of levels, up to PH_HISTORY_FILE_MAXIMUM_LEVELS.
+ * \param Levels The resolution and capacity of each level.
+ *
+ * \remarks If the file exists but was created with a different number of series or different
+ * levels, it is replaced.
+ */
+NTSTATUS PhCreateHistoryFile(
+    _Out_ PPH_HISTORY_FILE *HistoryFile,
+    _In_ PWSTR FileName,
+    _In_ ULONG NumberOfSeries,
+    _In_ ULONG NumberOfLevels,
+    _In_reads_(NumberOfLevels) PPH_HISTORY_FILE_LEVEL Levels
+    )
+{
+    NTSTATUS status;
+    PPH_HISTORY_FILE historyFile;
+    PH_FILE_POOL_PARAMETERS parameters;
+    ULONGLONG userContext;
+    ULONG i;
+
+    if (NumberOfSeries == 0 || sizeof(ULONG) + NumberOfSeries * 2 * sizeof(FLOAT) > PH_HISTORY_FILE_CHUNK_SIZE)
+        return STATUS_INVALID_PARAMETER_3;
+    if (NumberOfLevels == 0 || NumberOfLevels > PH_HISTORY_FILE_MAXIMUM_LEVELS)
+        return STATUS_INVALID_PARAMETER_4;
+
+    for (i = 0; i < NumberOfLevels; i++)
+    {
+        if (Levels[i].Resolution == 0 || Levels[i].Capacity == 0)
+            return STATUS_INVALID_PARAMETER_5;
+        if (i != 0 && Levels[i].Resolution % Levels[i - 1].Resolution != 0)
+            return STATUS_INVALID_PARAMETER_5;
+    }
+
+    historyFile = PhAllocate(sizeof(PH_HISTORY_FILE));
+    memset(historyFile, 0, sizeof(PH_HISTORY_FILE));
+    PhInitializeQueuedLock(&historyFile->Lock);
+    historyFile->NumberOfSeries = NumberOfSeries;
+    historyFile->RowSize = sizeof(ULONG) + NumberOfSeries * 2 * sizeof(FLOAT);
+    historyFile->Scratch = PhAllocate(NumberOfLevels * NumberOfSeries * 2 * sizeof(FLOAT));
+
+    parameters.SegmentShift = 20; // 1MB
+    parameters.MaximumInactiveViews = 16;
+
+    status = PhCreateFilePool2(&historyFile->Pool, FileName, FALSE, FILE_SHARE_READ, FILE_OPEN_IF, &parameters);
+
+    if (NT_SUCCESS(status))
+    {
+        PhGetUserContextFilePool(historyFile->Pool, &userContext);
+
+        if ((ULONG)userContext != 0)
+        {
+            historyFile->HeaderRva = (ULONG)userContext;
+            historyFile->Header = PhReferenceFilePoolByRva(historyFile->Pool, historyFile->HeaderRva);
+
+            if (historyFile->Header && !PhpMatchHistoryFile(historyFile->Header, NumberOfSeries, NumberOfLevels, Levels))
+            {
+                PhDereferenceFilePool(historyFile->Pool, historyFile->Header);
+                historyFile->Header = NULL;
+            }
+
+            if (!historyFile->Header)
+            {
+                PhDestroyFilePool(historyFile->Pool);
+                historyFile->Pool = NULL;
+                status = STATUS_BAD_FILE_TYPE;
+            }
+        }
+        else
+        {
+            status = PhpInitializeHistoryFile(historyFile, NumberOfLevels, Levels);
+        }
+    }
+
+    if (status == STATUS_BAD_FILE_TYPE)
+    {
+        // The file is not a history file, or it was created with different parameters. Start over.
+        status = PhCreateFilePool2(&historyFile->Pool, FileName, FALSE, FILE_SHARE_READ, FILE_OVERWRITE_IF, &parameters);
+
+        if (NT_SUCCESS(status))
+            status = PhpInitializeHistoryFile(historyFile, NumberOfLevels, Levels);
+    }
+
+    if (NT_SUCCESS(status))
+    {
+        for (i = 0; i < NumberOfLevels; i++)
+        {
+            historyFile->ChunkTables[i] = PhReferenceFilePoolByRva(historyFile->Pool, historyFile->Header->Levels[i].ChunkTableRva);
+            historyFile->Pending[i] = PhReferenceFilePoolByRva(historyFile->Pool, historyFile->Header->Levels[i].PendingRva);
+
+            if (!historyFile->ChunkTables[i] || !historyFile->Pending[i])
+                status = STATUS_FILE_CORRUPT_ERROR;
+        }
+    }
+
+    if (NT_SUCCESS(status))
+    {
+        *HistoryFile = historyFile;
+    }
+    else
+    {
+        PhpDestroyHistoryFile(historyFile);
+    }
+
+    return status;
+}
+
+/**
+ * Closes a history file.
+ *
+ * \param HistoryFile The history file.
+ */
+VOID PhDestroyHistoryFile(
+    _In_ _Post_invalid_ PPH_HISTORY_FILE HistoryFile
+    )
+{
+    PhpDestroyHistoryFile(HistoryFile);
+}
+
+static BOOLEAN PhpWriteRowHistoryFile(
+    _Inout_ PPH_HISTORY_FILE HistoryFile,
+    _In_ ULONG Level,
+    _In_ ULONG Time,
+    _In_ PFLOAT Averages,
+    _In_ PFLOAT Maximums
+    )
+{
+    PPH_HF_LEVEL_HEADER level;
+    PULONG chunkRva;
+    PCHAR chunk;
+    PCHAR row;
+    PFLOAT values;
+    ULONG i;
+
+    level = &HistoryFile->Header->Levels[Level];
+    chunkRva = &HistoryFile->ChunkTables[Level][level->Next / level->RowsPerChunk];
+
+    if (*chunkRva == 0)
+        chunk = PhAllocateFilePool(HistoryFile->Pool, level->RowsPerChunk * HistoryFile->RowSize, chunkRva);
+    else
+        chunk = PhReferenceFilePoolByRva(HistoryFile->Pool, *chunkRva);
+
+    if (!chunk)
+        return FALSE;
+
+    row = chunk + (level->Next % level->RowsPerChunk) * HistoryFile->RowSize;
+    *(PULONG)row = Time;
+    values = (PFLOAT)(row + sizeof(ULONG));
+
+    for (i = 0; i < HistoryFile->NumberOfSeries; i++)
+    {
+        values[i * 2] = Averages[i];
+        values[i * 2 + 1] = Maximums[i];
+    }
+
+    PhDereferenceFilePool(HistoryFile->Pool, chunk);
+
+    level->Next++;
+
+    if (level->Next == level->Capacity)
+        level->Next = 0;
+    if (level->Count < level->Capacity)
+        level->Count++;
+
+    return TRUE;
+}
+
+static BOOLEAN PhpAccumulateHistoryFile(
+    _Inout_ PPH_HISTORY_FILE HistoryFile,
+    _In_ ULONG Level,
+    _In_ ULONG Time,
+    _In_ PFLOAT Averages,
+    _In_ PFLOAT Maximums
+    )
+{
+    PPH_HF_LEVEL_HEADER level;
+    ULONG numberOfSeries;
+    PFLOAT sums;
+    PFLOAT maximums;
+    ULONG periodTime;
+    ULONG i;
+
+    level = &HistoryFile->Header->Levels[Level];
+    numberOfSeries = HistoryFile->NumberOfSeries;
+    sums = HistoryFile->Pending[Level];
+    maximums = sums + numberOfSeries;
+    periodTime = Time - Time % level->Resolution;
+
+    if (level->PendingCount != 0 && level->PendingTime != periodTime)
+    {
+        PFLOAT averages;
+
+        // The previous period is complete. Write its summary and pass it on to the next level.
+
+        averages = HistoryFile->Scratch + Level * numberOfSeries * 2;
+
+        for (i = 0; i < numberOfSeries; i++)
+            averages[i] = sums[i] / level->PendingCount;
+
+        if (!PhpWriteRowHistoryFile(HistoryFile, Level, level->PendingTime, averages, maximums))
+            return FALSE;
+
+        if (Level + 1 < HistoryFile->Header->NumberOfLevels)
+        {
+            if (!PhpAccumulateHistoryFile(HistoryFile, Level + 1, level->PendingTime, averages, maximums))
+                return FALSE;
+        }
+
+        level->PendingCount = 0;
+    }
+
+    if (level->PendingCount == 0)
+    {
+        level->PendingTime = periodTime;
+        memcpy(sums, Averages, numberOfSeries * sizeof(FLOAT));
+        memcpy(maximums, Maximums, numberOfSeries * sizeof(FLOAT));
+    }
+    else
+    {
+        for (i = 0; i < numberOfSeries; i++)
+        {
+            sums[i] += Averages[i];
+
+            if (maximums[i] < Maximums[i])
+                maximums[i] = Maximums[i];
+        }
+    }
+
+    level->PendingCount++;
+
+    return TRUE;
+}
+
+/**
+ * Adds a sample to a history file.
+ *
+ * \param HistoryFile The history file.
+ * \param Time The time of the sample, in seconds since 1980.
+ * \param Values The value of each series.
+ *
+ * \return TRUE if the sample was added, otherwise FALSE if space could not be allocated in the
+ * file.
+ */
+BOOLEAN PhAddSampleHistoryFile(
+    _Inout_ PPH_HISTORY_FILE HistoryFile,
+    _In_ ULONG Time,
+    _In_reads_(HistoryFile->NumberOfSeries) PFLOAT Values
+    )
+{
+    BOOLEAN result;
+
+    PhAcquireQueuedLockExclusive(&HistoryFile->Lock);
+
+    result = PhpWriteRowHistoryFile(HistoryFile, 0, Time, Values, Values);
+
+    if (result && HistoryFile->Header->NumberOfLevels > 1)
+        result = PhpAccumulateHistoryFile(HistoryFile, 1, Time, Values, Values);
+
+    PhReleaseQueuedLockExclusive(&HistoryFile->Lock);
+
+    return result;
+}
+
+/**
+ * Gets the number of rows stored in a level of a history file.
+ *
+ * \param HistoryFile The history file.
+ * \param Level The level.
+ */
+ULONG PhGetCountHistoryFile(
+    _In_ PPH_HISTORY_FILE HistoryFile,
+    _In_ ULONG Level
+    )
+{
+    ULONG count;
+
+    if (Level >= HistoryFile->Header->NumberOfLevels)
+        return 0;
+
+    PhAcquireQueuedLockShared(&HistoryFile->Lock);
+    count = HistoryFile->Header->Levels[Level].Count;
+    PhReleaseQueuedLockShared(&HistoryFile->Lock);
+
+    return count;
+}
+
+/**
+ * Retrieves a row from a history file.
+ *
+ * \param HistoryFile The history file.
+ * \param Level The level.
+ * \param Index The index of the row, where 0 is the most recent row.
+ * \param Series The index of the series.
+ * \param Time A variable which receives the time of the row, in seconds since 1980. For levels
+ * other than level 0, this is the start of the period covered by the row.
+ * \param Average A variable which receives the average value of the series.
+ * \param Maximum A variable which receives the maximum value of the series.
+ */
+BOOLEAN PhGetSampleHistoryFile(
+    _In_ PPH_HISTORY_FILE HistoryFile,
+    _In_ ULONG Level,
+    _In_ ULONG Index,
+    _In_ ULONG Series,
+    _Out_opt_ PULONG Time,
+    _Out_opt_ PFLOAT Average,
+    _Out_opt_ PFLOAT Maximum
+    )
+{
+    BOOLEAN result = FALSE;
+    PPH_HF_LEVEL_HEADER level;
+    ULONG rowIndex;
+    ULONG chunkRva;
+    PCHAR chunk;
+    PCHAR row;
+
+    if (Level >= HistoryFile->Header->NumberOfLevels || Series >= HistoryFile->NumberOfSeries)
+        return FALSE;
+
+    PhAcquireQueuedLockExclusive(&HistoryFile->Lock);
+
+    level = &HistoryFile->Header->Levels[Level];
+
+    if (Index < level->Count)
+    {
+        rowIndex = (level->Next + level->Capacity - 1 - Index) % level->Capacity;
+        chunkRva = HistoryFile->ChunkTables[Level][rowIndex / level->RowsPerChunk];
+
+        if (chunk = PhReferenceFilePoolByRva(HistoryFile->Pool, chunkRva))
+        {
+            row = chunk + (rowIndex % level->RowsPerChunk) * HistoryFile->RowSize;
+
+            if (Time)
+                *Time = *(PULONG)row;
+            if (Average)
+                *Average = ((PFLOAT)(row + sizeof(ULONG)))[Series * 2];
+            if (Maximum)
+                *Maximum = ((PFLOAT)(row + sizeof(ULONG)))[Series * 2 + 1];
+
+            PhDereferenceFilePool(HistoryFile->Pool, chunk);
+            result = TRUE;
+        }
+    }
+
+    PhReleaseQueuedLockExclusive(&HistoryFile->Lock);
+
+    return result;
+}
+
+/**
+ * Copies the values of a series from a history file.
+ *
+ * \param HistoryFile The history file.
+ * \param Level The level.
+ * \param Series The index of the series.
+ * \param Maximum TRUE to copy the maximum value of each row, FALSE to copy the average value.
+ * \param Buffer A buffer which receives the values, starting with the most recent row.
+ * \param Count The number of elements in \a Buffer.
+ *
+ * \return The number of values copied.
+ */
+ULONG PhCopyHistoryFile(
+    _In_ PPH_HISTORY_FILE HistoryFile,
+    _In_ ULONG Level,
+    _In_ ULONG Series,
+    _In_ BOOLEAN Maximum,
+    _Out_writes_to_(Count, return) PFLOAT Buffer,
+    _In_ ULONG Count
+    )
+{
+    PPH_HF_LEVEL_HEADER level;
+    ULONG copied;
+    ULONG rowIndex;
+    ULONG offset;
+
+    if (Level >= HistoryFile->Header->NumberOfLevels || Series >= HistoryFile->NumberOfSeries)
+        return 0;
+
+    offset = sizeof(ULONG) + (Series * 2 + (Maximum ? 1 : 0)) * sizeof(FLOAT);
+
+    // The file pool isn't thread-safe, even for lookups.
+    PhAcquireQueuedLockExclusive(&HistoryFile->Lock);
+
+    level = &HistoryFile->Header->Levels[Level];
+
+    if (Count > level->Count)
+        Count = level->Count;
+
+    copied = 0;
+    rowIndex = level->Next;
+
+    while (copied < Count)
+    {
+        PCHAR chunk;
+        ULONG chunkRowIndex;
+
+        if (rowIndex == 0)
+            rowIndex = level->Capacity;
+
+        rowIndex--;
+
+        // Copy backwards through the chunk containing the row, so that each chunk is only
+        // referenced once.
+
+        chunk = PhReferenceFilePoolByRva(HistoryFile->Pool, HistoryFile->ChunkTables[Level][rowIndex / level->RowsPerChunk]);
+
+        if (!chunk)
+            break;
+
+        chunkRowIndex = rowIndex % level->RowsPerChunk;
+
+        while (TRUE)
+        {
+            Buffer[copied++] = *(PFLOAT)(chunk + chunkRowIndex * HistoryFile->RowSize + offset);
+
+            if (copied == Count || chunkRowIndex == 0)
+                break;
+
+            chunkRowIndex--;
+            rowIndex--;
+        }
+
+        PhDereferenceFilePool(HistoryFile->Pool, chunk);
+    }
+
+    PhReleaseQueuedLockExclusive(&HistoryFile->Lock);
+
+    return copied;
+}
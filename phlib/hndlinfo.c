@@ -27,6 +27,7 @@
 #include <lsasup.h>
 
 #define PH_QUERY_HACK_MAX_THREADS 20
+#define PH_HANDLE_NAME_CACHE_MAX_AGE 16
 
 typedef struct _PHP_CALL_WITH_TIMEOUT_THREAD_CONTEXT
 {
@@ -79,6 +80,26 @@ typedef struct _PHP_QUERY_OBJECT_COMMON_CONTEXT
     } u;
 } PHP_QUERY_OBJECT_COMMON_CONTEXT, *PPHP_QUERY_OBJECT_COMMON_CONTEXT;
 
+typedef struct _PHP_HANDLE_NAME_CACHE_ENTRY
+{
+    PVOID Object;
+    ULONG ObjectTypeIndex;
+
+    // The handle that the names were queried from. The object can't be freed (and its address
+    // re-used) while this handle is open.
+    HANDLE ProcessId;
+    HANDLE Handle;
+
+    // The range of snapshot generations in which the handle was seen referring to the object.
+    ULONG FirstGeneration;
+    ULONG Generation;
+
+    NTSTATUS SubStatus;
+    PPH_STRING TypeName;
+    PPH_STRING ObjectName;
+    PPH_STRING BestObjectName;
+} PHP_HANDLE_NAME_CACHE_ENTRY, *PPHP_HANDLE_NAME_CACHE_ENTRY;
+
 PPHP_CALL_WITH_TIMEOUT_THREAD_CONTEXT PhpAcquireCallWithTimeoutThread(
     _In_opt_ PLARGE_INTEGER Timeout
     );
@@ -104,6 +125,10 @@ static PPH_GET_CLIENT_ID_NAME PhHandleGetClientIdName = PhStdGetClientIdName;
 static SLIST_HEADER PhpCallWithTimeoutThreadListHead;
 static PH_WAKE_EVENT PhpCallWithTimeoutThreadReleaseEvent = PH_WAKE_EVENT_INIT;
 
+static PPH_HASHTABLE PhpHandleNameCacheHashtable = NULL;
+static PH_QUEUED_LOCK PhpHandleNameCacheLock = PH_QUEUED_LOCK_INIT;
+static ULONG PhpHandleNameCacheGeneration = 0;
+
 PPH_GET_CLIENT_ID_NAME PhSetHandleClientIdFunction(
     _In_ PPH_GET_CLIENT_ID_NAME GetClientIdName
     )
@@ -1388,6 +1413,246 @@ CleanupExit:
     return status;
 }
 
+BOOLEAN NTAPI PhpHandleNameCacheEqualFunction(
+    _In_ PVOID Entry1,
+    _In_ PVOID Entry2
+    )
+{
+    PPHP_HANDLE_NAME_CACHE_ENTRY entry1 = Entry1;
+    PPHP_HANDLE_NAME_CACHE_ENTRY entry2 = Entry2;
+
+    return entry1->Object == entry2->Object && entry1->ObjectTypeIndex == entry2->ObjectTypeIndex;
+}
+
+ULONG NTAPI PhpHandleNameCacheHashFunction(
+    _In_ PVOID Entry
+    )
+{
+    PPHP_HANDLE_NAME_CACHE_ENTRY entry = Entry;
+
+    return PhHashIntPtr((ULONG_PTR)entry->Object) ^ entry->ObjectTypeIndex;
+}
+
+VOID PhpDeleteHandleNameCacheEntry(
+    _In_ PPHP_HANDLE_NAME_CACHE_ENTRY Entry
+    )
+{
+    PhClearReference(&Entry->TypeName);
+    PhClearReference(&Entry->ObjectName);
+    PhClearReference(&Entry->BestObjectName);
+}
+
+/**
+ * Validates the handle name cache against a snapshot of handles.
+ *
+ * \param Handles A snapshot of handles, from PhEnumHandlesEx or an equivalent function.
+ * \param ProcessId The ID of the process whose handles are in \a Handles, or NULL if \a Handles
+ * contains the handles of all processes.
+ *
+ * \return A generation number which must be passed to PhGetHandleInformationCached for handles
+ * in \a Handles.
+ *
+ * \remarks Names are cached by object address and type. A cached name is only used for a snapshot
+ * if the handle it was queried from was seen in every snapshot since, so names of freed objects
+ * are never returned for new objects at the same address.
+ */
+ULONG PhUpdateHandleNameCache(
+    _In_ PSYSTEM_HANDLE_INFORMATION_EX Handles,
+    _In_opt_ HANDLE ProcessId
+    )
+{
+    ULONG generation;
+    ULONG_PTR i;
+    PHP_HANDLE_NAME_CACHE_ENTRY lookupEntry;
+    PPHP_HANDLE_NAME_CACHE_ENTRY entry;
+    ULONG enumerationKey;
+
+    PhAcquireQueuedLockExclusive(&PhpHandleNameCacheLock);
+
+    generation = ++PhpHandleNameCacheGeneration;
+
+    if (PhpHandleNameCacheHashtable)
+    {
+        // Extend the validity of entries whose handle still refers to the same object.
+        for (i = 0; i < Handles->NumberOfHandles; i++)
+        {
+            PSYSTEM_HANDLE_TABLE_ENTRY_INFO_EX handle = &Handles->Handles[i];
+
+            lookupEntry.Object = handle->Object;
+            lookupEntry.ObjectTypeIndex = handle->ObjectTypeIndex;
+            entry = PhFindEntryHashtable(PhpHandleNameCacheHashtable, &lookupEntry);
+
+            if (entry && entry->ProcessId == (HANDLE)handle->UniqueProcessId &&
+                entry->Handle == (HANDLE)handle->HandleValue)
+            {
+                entry->Generation = generation;
+            }
+        }
+
+        // Remove entries whose handle was closed. Entries for processes not covered by the
+        // snapshot are removed once they haven't been validated for a while.
+        enumerationKey = 0;
+
+        while (PhEnumHashtable(PhpHandleNameCacheHashtable, &entry, &enumerationKey))
+        {
+            if (entry->Generation == generation)
+                continue;
+
+            if (!ProcessId || entry->ProcessId == ProcessId ||
+                generation - entry->Generation > PH_HANDLE_NAME_CACHE_MAX_AGE)
+            {
+                PhpDeleteHandleNameCacheEntry(entry);
+                PhRemoveEntryHashtable(PhpHandleNameCacheHashtable, entry);
+            }
+        }
+    }
+
+    PhReleaseQueuedLockExclusive(&PhpHandleNameCacheLock);
+
+    return generation;
+}
+
+/**
+ * Gets information for a handle, using the handle name cache.
+ *
+ * \param ProcessHandle A handle to the process in which the handle resides.
+ * \param HandleInfo The handle, from the snapshot passed to PhUpdateHandleNameCache.
+ * \param Generation The generation number returned by PhUpdateHandleNameCache.
+ * \param SubStatus A variable which receives the NTSTATUS value of the last component that fails.
+ * If all operations succeed, the value will be STATUS_SUCCESS. If the function returns an error
+ * status, this variable is not set.
+ * \param TypeName A variable which receives the object type name.
+ * \param ObjectName A variable which receives the object name.
+ * \param BestObjectName A variable which receives the formatted object name.
+ *
+ * \remarks This function behaves like PhGetHandleInformationEx, but only queries each object
+ * once. Objects whose names could not be queried because the query timed out are also cached, so
+ * the query is not attempted again for other handles to the same object.
+ */
+NTSTATUS PhGetHandleInformationCached(
+    _In_ HANDLE ProcessHandle,
+    _In_ PSYSTEM_HANDLE_TABLE_ENTRY_INFO_EX HandleInfo,
+    _In_ ULONG Generation,
+    _Out_opt_ PNTSTATUS SubStatus,
+    _Out_opt_ PPH_STRING *TypeName,
+    _Out_opt_ PPH_STRING *ObjectName,
+    _Out_opt_ PPH_STRING *BestObjectName
+    )
+{
+    NTSTATUS status;
+    PHP_HANDLE_NAME_CACHE_ENTRY lookupEntry;
+    PPHP_HANDLE_NAME_CACHE_ENTRY entry;
+    BOOLEAN added;
+
+    // Some systems don't report object addresses to unprivileged callers.
+    if (!HandleInfo->Object)
+    {
+        return PhGetHandleInformationEx(
+            ProcessHandle,
+            (HANDLE)HandleInfo->HandleValue,
+            HandleInfo->ObjectTypeIndex,
+            0,
+            SubStatus,
+            NULL,
+            TypeName,
+            ObjectName,
+            BestObjectName,
+            NULL
+            );
+    }
+
+    lookupEntry.Object = HandleInfo->Object;
+    lookupEntry.ObjectTypeIndex = HandleInfo->ObjectTypeIndex;
+
+    PhAcquireQueuedLockShared(&PhpHandleNameCacheLock);
+
+    if (PhpHandleNameCacheHashtable &&
+        (entry = PhFindEntryHashtable(PhpHandleNameCacheHashtable, &lookupEntry)) &&
+        entry->FirstGeneration <= Generation && Generation <= entry->Generation)
+    {
+        if (SubStatus)
+            *SubStatus = entry->SubStatus;
+        if (TypeName)
+            PhSetReference(TypeName, entry->TypeName);
+        if (ObjectName)
+            PhSetReference(ObjectName, entry->ObjectName);
+        if (BestObjectName)
+            PhSetReference(BestObjectName, entry->BestObjectName);
+
+        PhReleaseQueuedLockShared(&PhpHandleNameCacheLock);
+
+        return STATUS_SUCCESS;
+    }
+
+    PhReleaseQueuedLockShared(&PhpHandleNameCacheLock);
+
+    lookupEntry.ProcessId = (HANDLE)HandleInfo->UniqueProcessId;
+    lookupEntry.Handle = (HANDLE)HandleInfo->HandleValue;
+    lookupEntry.FirstGeneration = Generation;
+    lookupEntry.Generation = Generation;
+
+    status = PhGetHandleInformationEx(
+        ProcessHandle,
+        lookupEntry.Handle,
+        lookupEntry.ObjectTypeIndex,
+        0,
+        &lookupEntry.SubStatus,
+        NULL,
+        &lookupEntry.TypeName,
+        &lookupEntry.ObjectName,
+        &lookupEntry.BestObjectName,
+        NULL
+        );
+
+    if (!NT_SUCCESS(status))
+        return status;
+
+    if (SubStatus)
+        *SubStatus = lookupEntry.SubStatus;
+    if (TypeName)
+        PhSetReference(TypeName, lookupEntry.TypeName);
+    if (ObjectName)
+        PhSetReference(ObjectName, lookupEntry.ObjectName);
+    if (BestObjectName)
+        PhSetReference(BestObjectName, lookupEntry.BestObjectName);
+
+    // Other failures may depend on the access granted to this particular handle, so only cache
+    // complete results and timeouts.
+    if (NT_SUCCESS(lookupEntry.SubStatus) || lookupEntry.SubStatus == STATUS_IO_TIMEOUT)
+    {
+        PhAcquireQueuedLockExclusive(&PhpHandleNameCacheLock);
+
+        if (!PhpHandleNameCacheHashtable)
+        {
+            PhpHandleNameCacheHashtable = PhCreateHashtable(
+                sizeof(PHP_HANDLE_NAME_CACHE_ENTRY),
+                PhpHandleNameCacheEqualFunction,
+                PhpHandleNameCacheHashFunction,
+                64
+                );
+        }
+
+        entry = PhAddEntryHashtableEx(PhpHandleNameCacheHashtable, &lookupEntry, &added);
+
+        if (!added && entry->Generation < Generation)
+        {
+            // Replace the stale entry.
+            PhpDeleteHandleNameCacheEntry(entry);
+            *entry = lookupEntry;
+            added = TRUE;
+        }
+
+        PhReleaseQueuedLockExclusive(&PhpHandleNameCacheLock);
+
+        if (added)
+            return STATUS_SUCCESS;
+    }
+
+    PhpDeleteHandleNameCacheEntry(&lookupEntry);
+
+    return STATUS_SUCCESS;
+}
+
 NTSTATUS PhEnumObjectTypes(
     _Out_ POBJECT_TYPES_INFORMATION *ObjectTypes
     )
@@ -1589,11 +1854,12 @@ NTSTATUS PhpCallWithTimeout(
         // The operation timed out, or there was an error. Kill the thread. On Vista and above, the
         // thread stack is freed automatically.
         NtTerminateThread(ThreadContext->ThreadHandle, STATUS_UNSUCCESSFUL);
-        status = NtWaitForSingleObject(ThreadContext->ThreadHandle, FALSE, NULL);
+        NtWaitForSingleObject(ThreadContext->ThreadHandle, FALSE, NULL);
         NtClose(ThreadContext->ThreadHandle);
         ThreadContext->ThreadHandle = NULL;
 
-        status = STATUS_UNSUCCESSFUL;
+        // Let callers tell hung operations apart from other failures.
+        status = status == STATUS_TIMEOUT ? STATUS_IO_TIMEOUT : STATUS_UNSUCCESSFUL;
     }
 
     return status;
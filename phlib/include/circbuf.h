@@ -23,4 +23,82 @@
 #define T FLOAT
 #include "circbuf_h.h"
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// A set of FLOAT circular buffers which share an index. Series are stored
+// one after another in a single allocation, and a sample is added to every
+// series at once.
+
+typedef struct _PH_HISTORY_BUFFER
+{
+    ULONG Size;
+    ULONG SizeMinusOne;
+    ULONG Count;
+    LONG Index;
+    ULONG NumberOfSeries;
+    PFLOAT Data;
+} PH_HISTORY_BUFFER, *PPH_HISTORY_BUFFER;
+
+PHLIBAPI
+VOID
+NTAPI
+PhInitializeHistoryBuffer(
+    _Out_ PPH_HISTORY_BUFFER Buffer,
+    _In_ ULONG NumberOfSeries,
+    _In_ ULONG Size
+    );
+
+PHLIBAPI
+VOID
+NTAPI
+PhDeleteHistoryBuffer(
+    _Inout_ PPH_HISTORY_BUFFER Buffer
+    );
+
+PHLIBAPI
+VOID
+NTAPI
+PhCopyHistoryBuffer(
+    _In_ PPH_HISTORY_BUFFER Buffer,
+    _In_ ULONG Series,
+    _Out_writes_(Count) PFLOAT Destination,
+    _In_ ULONG Count
+    );
+
+FORCEINLINE FLOAT PhGetSampleHistoryBuffer(
+    _In_ PPH_HISTORY_BUFFER Buffer,
+    _In_ ULONG Series,
+    _In_ LONG Index
+    )
+{
+    return Buffer->Data[(SIZE_T)Series * Buffer->Size + ((Buffer->Index + Index) & Buffer->SizeMinusOne)];
+}
+
+FORCEINLINE VOID PhAddSamplesHistoryBuffer(
+    _Inout_ PPH_HISTORY_BUFFER Buffer,
+    _In_reads_(Buffer->NumberOfSeries) PFLOAT Samples
+    )
+{
+    PFLOAT data;
+    ULONG i;
+
+    Buffer->Index = (Buffer->Index - 1) & Buffer->SizeMinusOne;
+    data = &Buffer->Data[Buffer->Index];
+
+    for (i = 0; i < Buffer->NumberOfSeries; i++)
+    {
+        *data = Samples[i];
+        data += Buffer->Size;
+    }
+
+    if (Buffer->Count < Buffer->Size)
+        Buffer->Count++;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
 #endif
@@ -1,6 +1,8 @@
 #ifndef _PH_CPYSAVE_H
 #define _PH_CPYSAVE_H
 
+#include <filestream.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -8,6 +10,22 @@ extern "C" {
 #define PH_EXPORT_MODE_TABS 0
 #define PH_EXPORT_MODE_SPACES 1
 #define PH_EXPORT_MODE_CSV 2
+#define PH_EXPORT_MODE_JSON_LINES 3
+
+/** Determines whether columns are aligned, which requires the width of every cell to be known. */
+#define PH_EXPORT_MODE_ALIGNED(Mode) ((Mode) == PH_EXPORT_MODE_TABS || (Mode) == PH_EXPORT_MODE_SPACES)
+
+typedef struct _PH_TEXT_TABLE_WRITER
+{
+    PPH_FILE_STREAM FileStream;
+    ULONG Mode;
+    ULONG Columns;
+    ULONG Column;
+    ULONG Row;
+    PULONG TabCount;
+    PPH_STRING *ColumnNames;
+    PH_STRING_BUILDER Line;
+} PH_TEXT_TABLE_WRITER, *PPH_TEXT_TABLE_WRITER;
 
 PHLIBAPI
 VOID PhaCreateTextTable(
@@ -24,6 +42,32 @@ PPH_LIST PhaFormatTextTable(
     _In_ ULONG Mode
     );
 
+PHLIBAPI
+VOID PhInitializeTextTableWriter(
+    _Out_ PPH_TEXT_TABLE_WRITER Writer,
+    _In_ PPH_FILE_STREAM FileStream,
+    _In_ ULONG Mode,
+    _In_ ULONG Columns
+    );
+
+PHLIBAPI
+VOID PhDeleteTextTableWriter(
+    _Inout_ PPH_TEXT_TABLE_WRITER Writer
+    );
+
+PHLIBAPI
+VOID PhMeasureTextTableCell(
+    _Inout_ PPH_TEXT_TABLE_WRITER Writer,
+    _In_ ULONG Column,
+    _In_ PPH_STRINGREF Text
+    );
+
+PHLIBAPI
+NTSTATUS PhWriteTextTableCell(
+    _Inout_ PPH_TEXT_TABLE_WRITER Writer,
+    _In_ PPH_STRINGREF Text
+    );
+
 PHLIBAPI
 VOID PhMapDisplayIndexTreeNew(
     _In_ HWND TreeNewHandle,
@@ -44,6 +88,13 @@ PPH_LIST PhGetGenericTreeNewLines(
     _In_ ULONG Mode
     );
 
+PHLIBAPI
+NTSTATUS PhWriteGenericTreeNew(
+    _In_ HWND TreeNewHandle,
+    _Inout_ PPH_FILE_STREAM FileStream,
+    _In_ ULONG Mode
+    );
+
 PHLIBAPI
 VOID PhaMapDisplayIndexListView(
     _In_ HWND ListViewHandle,
@@ -23,10 +23,21 @@ extern "C" {
  * object's own file position.
  */
 #define PH_FILE_STREAM_OWN_POSITION 0x8
+/**
+ * Indicates that buffered writes should be issued asynchronously, so that the next buffer can be
+ * filled while the previous one is being written. The file handle must support asynchronous
+ * operations, and this flag implies PH_FILE_STREAM_ASYNCHRONOUS and PH_FILE_STREAM_OWN_POSITION.
+ * Errors from a write may not be reported until a later write or PhFlushFileStream().
+ */
+#define PH_FILE_STREAM_WRITE_BEHIND 0x10
 
 // Higher-level flags (PhCreateFileStream)
 #define PH_FILE_STREAM_APPEND 0x00010000
 
+// Write-behind
+#define PH_FILE_STREAM_WRITE_BUFFERS 2
+#define PH_FILE_STREAM_WRITE_BEHIND_BUFFER_SIZE 0x10000
+
 // Internal flags
 /** Indicates that at least one write has been issued to the file handle. */
 #define PH_FILE_STREAM_WRITTEN 0x80000000
@@ -51,6 +62,15 @@ typedef struct _PH_FILE_STREAM
     ULONG ReadPosition; // read position in buffer
     ULONG ReadLength; // how much available to read from buffer
     ULONG WritePosition; // write position in buffer
+
+    // Write-behind (PH_FILE_STREAM_WRITE_BEHIND). Buffer always points to the buffer currently
+    // being filled.
+    ULONG WriteBufferIndex;
+    ULONG PendingWrites;
+    PVOID WriteBuffers[PH_FILE_STREAM_WRITE_BUFFERS];
+    HANDLE WriteEvents[PH_FILE_STREAM_WRITE_BUFFERS];
+    IO_STATUS_BLOCK WriteIsb[PH_FILE_STREAM_WRITE_BUFFERS];
+    ULONG WriteLength[PH_FILE_STREAM_WRITE_BUFFERS]; // 0 if no write is pending
 } PH_FILE_STREAM, *PPH_FILE_STREAM;
 
 extern PPH_OBJECT_TYPE PhFileStreamType;
@@ -23,6 +23,15 @@ NTSTATUS PhpWriteFileStream(
     _In_ ULONG Length
     );
 
+NTSTATUS PhpQueueWriteFileStream(
+    _Inout_ PPH_FILE_STREAM FileStream
+    );
+
+NTSTATUS PhpWaitWriteFileStream(
+    _Inout_ PPH_FILE_STREAM FileStream,
+    _In_ ULONG Index
+    );
+
 NTSTATUS PhpFlushReadFileStream(
     _Inout_ PPH_FILE_STREAM FileStream
     );
@@ -0,0 +1,150 @@
+#ifndef _PH_HISTFILE_H
+#define _PH_HISTFILE_H
+
+#include <filepool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// On-disk structures
+
+// A history file stores a fixed number of series, sampled together at the same times. Samples are
+// stored in several levels of decreasing resolution. Every sample is written to level 0, and each
+// row in level N + 1 summarizes the rows of level N that fall within one period of its resolution.
+//
+// Each level is a ring of rows, so the size of the file is bounded. The ring is split into chunks
+// which are allocated from the file pool when they are first written. Each row consists of the
+// time of the row (in seconds since 1980) followed by the average and maximum of each series.
+
+/** The maximum number of levels in a history file. */
+#define PH_HISTORY_FILE_MAXIMUM_LEVELS 4
+/** The maximum size of each chunk of rows. */
+#define PH_HISTORY_FILE_CHUNK_SIZE 0x10000
+
+#define PH_HF_MAGIC ('siHP')
+
+typedef struct _PH_HF_LEVEL_HEADER
+{
+    /** The number of seconds covered by each row. */
+    ULONG Resolution;
+    /** The number of rows in the ring. */
+    ULONG Capacity;
+    ULONG RowsPerChunk;
+    ULONG NumberOfChunks;
+    /** An array of RVAs of chunks, or 0 for chunks that have not been allocated. */
+    ULONG ChunkTableRva;
+    /** The number of rows that contain data. */
+    ULONG Count;
+    /** The index of the next row to write. */
+    ULONG Next;
+
+    // Rows from the previous level that have not been summarized yet.
+
+    ULONG PendingTime;
+    ULONG PendingCount;
+    /** An array of sums followed by an array of maximums, one for each series. */
+    ULONG PendingRva;
+} PH_HF_LEVEL_HEADER, *PPH_HF_LEVEL_HEADER;
+
+typedef struct _PH_HF_HEADER
+{
+    ULONG Magic;
+    ULONG NumberOfSeries;
+    ULONG NumberOfLevels;
+    ULONG Reserved;
+    PH_HF_LEVEL_HEADER Levels[PH_HISTORY_FILE_MAXIMUM_LEVELS];
+} PH_HF_HEADER, *PPH_HF_HEADER;
+
+// Runtime
+
+typedef struct _PH_HISTORY_FILE_LEVEL
+{
+    /**
+     * The number of seconds covered by each row. For levels other than level 0, this must be a
+     * multiple of the resolution of the previous level.
+     */
+    ULONG Resolution;
+    /** The number of rows to keep. This is rounded up to a whole number of chunks. */
+    ULONG Capacity;
+} PH_HISTORY_FILE_LEVEL, *PPH_HISTORY_FILE_LEVEL;
+
+typedef struct _PH_HISTORY_FILE
+{
+    PH_QUEUED_LOCK Lock;
+    PPH_FILE_POOL Pool;
+    PPH_HF_HEADER Header;
+    ULONG HeaderRva;
+    ULONG NumberOfSeries;
+    ULONG RowSize;
+
+    PULONG ChunkTables[PH_HISTORY_FILE_MAXIMUM_LEVELS];
+    PFLOAT Pending[PH_HISTORY_FILE_MAXIMUM_LEVELS];
+    PFLOAT Scratch;
+} PH_HISTORY_FILE, *PPH_HISTORY_FILE;
+
+PHLIBAPI
+NTSTATUS
+NTAPI
+PhCreateHistoryFile(
+    _Out_ PPH_HISTORY_FILE *HistoryFile,
+    _In_ PWSTR FileName,
+    _In_ ULONG NumberOfSeries,
+    _In_ ULONG NumberOfLevels,
+    _In_reads_(NumberOfLevels) PPH_HISTORY_FILE_LEVEL Levels
+    );
+
+PHLIBAPI
+VOID
+NTAPI
+PhDestroyHistoryFile(
+    _In_ _Post_invalid_ PPH_HISTORY_FILE HistoryFile
+    );
+
+PHLIBAPI
+BOOLEAN
+NTAPI
+PhAddSampleHistoryFile(
+    _Inout_ PPH_HISTORY_FILE HistoryFile,
+    _In_ ULONG Time,
+    _In_reads_(HistoryFile->NumberOfSeries) PFLOAT Values
+    );
+
+PHLIBAPI
+ULONG
+NTAPI
+PhGetCountHistoryFile(
+    _In_ PPH_HISTORY_FILE HistoryFile,
+    _In_ ULONG Level
+    );
+
+PHLIBAPI
+BOOLEAN
+NTAPI
+PhGetSampleHistoryFile(
+    _In_ PPH_HISTORY_FILE HistoryFile,
+    _In_ ULONG Level,
+    _In_ ULONG Index,
+    _In_ ULONG Series,
+    _Out_opt_ PULONG Time,
+    _Out_opt_ PFLOAT Average,
+    _Out_opt_ PFLOAT Maximum
+    );
+
+PHLIBAPI
+ULONG
+NTAPI
+PhCopyHistoryFile(
+    _In_ PPH_HISTORY_FILE HistoryFile,
+    _In_ ULONG Level,
+    _In_ ULONG Series,
+    _In_ BOOLEAN Maximum,
+    _Out_writes_to_(Count, return) PFLOAT Buffer,
+    _In_ ULONG Count
+    );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
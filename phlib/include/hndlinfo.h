@@ -69,6 +69,27 @@ PhGetHandleInformationEx(
     _Reserved_ PVOID *ExtraInformation
     );
 
+PHLIBAPI
+ULONG
+NTAPI
+PhUpdateHandleNameCache(
+    _In_ PSYSTEM_HANDLE_INFORMATION_EX Handles,
+    _In_opt_ HANDLE ProcessId
+    );
+
+PHLIBAPI
+NTSTATUS
+NTAPI
+PhGetHandleInformationCached(
+    _In_ HANDLE ProcessHandle,
+    _In_ PSYSTEM_HANDLE_TABLE_ENTRY_INFO_EX HandleInfo,
+    _In_ ULONG Generation,
+    _Out_opt_ PNTSTATUS SubStatus,
+    _Out_opt_ PPH_STRING *TypeName,
+    _Out_opt_ PPH_STRING *ObjectName,
+    _Out_opt_ PPH_STRING *BestObjectName
+    );
+
 #define PH_FIRST_OBJECT_TYPE(ObjectTypes) \
     (POBJECT_TYPE_INFORMATION)((PCHAR)(ObjectTypes) + ALIGN_UP(sizeof(OBJECT_TYPES_INFORMATION), ULONG_PTR))
 
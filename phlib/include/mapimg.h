@@ -280,6 +280,14 @@ PhCheckSumMappedImage(
     _In_ PPH_MAPPED_IMAGE MappedImage
     );
 
+PHLIBAPI
+ULONG
+NTAPI
+PhCheckSumMappedImageEx(
+    _In_ PPH_MAPPED_IMAGE MappedImage,
+    _In_ ULONG NumberOfThreads
+    );
+
 // maplib
 
 struct _PH_MAPPED_ARCHIVE;
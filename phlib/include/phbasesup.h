@@ -3040,6 +3040,159 @@ PhRemoveItemSimpleHashtable(
     _In_opt_ PVOID Key
     );
 
+// Flat hashtable
+
+extern PPH_OBJECT_TYPE PhFlatHashtableType;
+
+/** The number of control bytes examined at once. */
+#define PH_FLAT_HASHTABLE_GROUP_SIZE 16
+
+#define PH_FLAT_HASHTABLE_CONTROL_EMPTY ((UCHAR)0x80)
+#define PH_FLAT_HASHTABLE_CONTROL_DELETED ((UCHAR)0xfe)
+#define PH_FLAT_HASHTABLE_CONTROL_IS_FULL(Control) (((Control) & 0x80) == 0)
+
+/**
+ * An open addressing hashtable structure.
+ *
+ * \remarks Entries are stored directly in a power-of-two sized slot array, with one control
+ * byte per slot that holds 7 bits of the hash code of the entry, or a marker for empty and
+ * deleted slots. Lookups compare a whole group of control bytes at once and usually touch only
+ * one entry, instead of following a chain of indices. The interface is the same as that of the
+ * normal hashtable, but pointers to entries are invalidated by any insertion, not just by
+ * resizing.
+ */
+typedef struct _PH_FLAT_HASHTABLE
+{
+    /** Size of user data in each entry. */
+    ULONG EntrySize;
+    /** Size of each slot. This is the entry size rounded up to pointer alignment. */
+    ULONG SlotSize;
+    /** The comparison function. */
+    PPH_HASHTABLE_EQUAL_FUNCTION EqualFunction;
+    /** The hash function. */
+    PPH_HASHTABLE_HASH_FUNCTION HashFunction;
+
+    /** The number of slots. This is a power of two. */
+    ULONG Capacity;
+    /**
+     * The control byte array. The first PH_FLAT_HASHTABLE_GROUP_SIZE bytes are repeated at the
+     * end so that a group can be loaded at any position.
+     */
+    PUCHAR Control;
+    /** The slot array. */
+    PVOID Slots;
+
+    /** Number of entries in the hashtable. */
+    ULONG Count;
+    /** Number of empty slots that can be used before the hashtable needs to be rebuilt. */
+    ULONG GrowthLeft;
+} PH_FLAT_HASHTABLE, *PPH_FLAT_HASHTABLE;
+
+#define PH_FLAT_HASHTABLE_GET_ENTRY(Hashtable, Index) \
+    PTR_ADD_OFFSET((Hashtable)->Slots, (SIZE_T)(Hashtable)->SlotSize * (Index))
+
+PHLIBAPI
+PPH_FLAT_HASHTABLE
+NTAPI
+PhCreateFlatHashtable(
+    _In_ ULONG EntrySize,
+    _In_ PPH_HASHTABLE_EQUAL_FUNCTION EqualFunction,
+    _In_ PPH_HASHTABLE_HASH_FUNCTION HashFunction,
+    _In_ ULONG InitialCapacity
+    );
+
+PHLIBAPI
+PVOID
+NTAPI
+PhAddEntryFlatHashtable(
+    _Inout_ PPH_FLAT_HASHTABLE Hashtable,
+    _In_ PVOID Entry
+    );
+
+PHLIBAPI
+PVOID
+NTAPI
+PhAddEntryFlatHashtableEx(
+    _Inout_ PPH_FLAT_HASHTABLE Hashtable,
+    _In_ PVOID Entry,
+    _Out_opt_ PBOOLEAN Added
+    );
+
+PHLIBAPI
+VOID
+NTAPI
+PhClearFlatHashtable(
+    _Inout_ PPH_FLAT_HASHTABLE Hashtable
+    );
+
+PHLIBAPI
+BOOLEAN
+NTAPI
+PhEnumFlatHashtable(
+    _In_ PPH_FLAT_HASHTABLE Hashtable,
+    _Out_ PVOID *Entry,
+    _Inout_ PULONG EnumerationKey
+    );
+
+PHLIBAPI
+PVOID
+NTAPI
+PhFindEntryFlatHashtable(
+    _In_ PPH_FLAT_HASHTABLE Hashtable,
+    _In_ PVOID Entry
+    );
+
+PHLIBAPI
+BOOLEAN
+NTAPI
+PhRemoveEntryFlatHashtable(
+    _Inout_ PPH_FLAT_HASHTABLE Hashtable,
+    _In_ PVOID Entry
+    );
+
+typedef struct _PH_FLAT_HASHTABLE_ENUM_CONTEXT
+{
+    PUCHAR Control;
+    ULONG_PTR Current;
+    ULONG Index;
+    ULONG Capacity;
+    ULONG Step;
+} PH_FLAT_HASHTABLE_ENUM_CONTEXT, *PPH_FLAT_HASHTABLE_ENUM_CONTEXT;
+
+FORCEINLINE
+VOID
+PhBeginEnumFlatHashtable(
+    _In_ PPH_FLAT_HASHTABLE Hashtable,
+    _Out_ PPH_FLAT_HASHTABLE_ENUM_CONTEXT Context
+    )
+{
+    Context->Control = Hashtable->Control;
+    Context->Current = (ULONG_PTR)Hashtable->Slots;
+    Context->Index = 0;
+    Context->Capacity = Hashtable->Capacity;
+    Context->Step = Hashtable->SlotSize;
+}
+
+FORCEINLINE
+PVOID
+PhNextEnumFlatHashtable(
+    _Inout_ PPH_FLAT_HASHTABLE_ENUM_CONTEXT Context
+    )
+{
+    PVOID entry;
+
+    while (Context->Index < Context->Capacity)
+    {
+        entry = (PVOID)Context->Current;
+        Context->Current += Context->Step;
+
+        if (PH_FLAT_HASHTABLE_CONTROL_IS_FULL(Context->Control[Context->Index++]))
+            return entry;
+    }
+
+    return NULL;
+}
+
 // Free list
 
 typedef struct _PH_FREE_LIST
@@ -3109,22 +3262,50 @@ typedef VOID (NTAPI *PPH_CALLBACK_FUNCTION)(
     _In_opt_ PVOID Context
     );
 
-/** A callback registration structure. */
-typedef struct _PH_CALLBACK_REGISTRATION
+/**
+ * The part of a callback registration used by PhInvokeCallback(). It is owned by the callback
+ * object so that it can outlive the registration structure.
+ */
+typedef struct _PH_CALLBACK_ENTRY
 {
-    /** The list entry in the callbacks list. */
-    LIST_ENTRY ListEntry;
     /** The callback function. */
     PPH_CALLBACK_FUNCTION Function;
     /** A user-defined value to be passed to the callback function. */
     PVOID Context;
-    /** A value indicating whether the registration structure is being used. */
+    /** The number of threads executing the callback function. */
     LONG Busy;
-    /** Whether the registration structure is being removed. */
+    /** Whether the registration is being removed. */
     BOOLEAN Unregistering;
-    BOOLEAN Reserved;
     /** Flags controlling the callback. */
     USHORT Flags;
+} PH_CALLBACK_ENTRY, *PPH_CALLBACK_ENTRY;
+
+/** An immutable array of the entries registered with a callback object. */
+typedef struct _PH_CALLBACK_SNAPSHOT
+{
+    /** The next snapshot waiting to be freed. */
+    struct _PH_CALLBACK_SNAPSHOT *NextRetired;
+    /** An entry to free along with this snapshot. */
+    PPH_CALLBACK_ENTRY RemovedEntry;
+    ULONG Count;
+    PPH_CALLBACK_ENTRY Entries[1];
+} PH_CALLBACK_SNAPSHOT, *PPH_CALLBACK_SNAPSHOT;
+
+/** A callback registration structure. */
+typedef struct _PH_CALLBACK_REGISTRATION
+{
+    /** The list entry in the callbacks list. */
+    LIST_ENTRY ListEntry;
+    /** The callback function. */
+    PPH_CALLBACK_FUNCTION Function;
+    /** A user-defined value to be passed to the callback function. */
+    PVOID Context;
+    union
+    {
+        /** The entry used to invoke the callback function. */
+        PPH_CALLBACK_ENTRY Entry;
+        ULONG Reserved[2]; // Keeps the size of the structure the same on 32-bit
+    };
 } PH_CALLBACK_REGISTRATION, *PPH_CALLBACK_REGISTRATION;
 
 /**
@@ -3139,9 +3320,15 @@ typedef struct _PH_CALLBACK
     PH_QUEUED_LOCK ListLock;
     /** A condition variable pulsed when the callback becomes free. */
     PH_CONDITION BusyCondition;
+    /** The registered entries, or NULL if there are none. Read without locking. */
+    PPH_CALLBACK_SNAPSHOT Snapshot;
+    /** The number of PhInvokeCallback() calls in progress. */
+    LONG InvokeCount;
+    /** Replaced snapshots which may still be in use. */
+    PPH_CALLBACK_SNAPSHOT RetiredSnapshots;
 } PH_CALLBACK, *PPH_CALLBACK;
 
-#define PH_CALLBACK_DECLARE(Name) PH_CALLBACK Name = { &Name.ListHead, &Name.ListHead, PH_QUEUED_LOCK_INIT, PH_CONDITION_INIT }
+#define PH_CALLBACK_DECLARE(Name) PH_CALLBACK Name = { &Name.ListHead, &Name.ListHead, PH_QUEUED_LOCK_INIT, PH_CONDITION_INIT, NULL, 0, NULL }
 
 PHLIBAPI
 VOID
@@ -3311,6 +3498,24 @@ PhDivideSinglesBySingle(
     _In_ SIZE_T Count
     );
 
+PHLIBAPI
+VOID
+NTAPI
+PhAddSingles(
+    _Inout_updates_(Count) PFLOAT A,
+    _In_reads_(Count) PFLOAT B,
+    _In_ SIZE_T Count
+    );
+
+PHLIBAPI
+FLOAT
+NTAPI
+PhMaximumSumSingles(
+    _In_reads_(Count) PFLOAT A,
+    _In_reads_(Count) PFLOAT B,
+    _In_ SIZE_T Count
+    );
+
 // Auto-dereference convenience functions
 
 FORCEINLINE
@@ -3447,6 +3652,8 @@ typedef enum _PH_FORMAT_TYPE
     FormatUseParameter = 0x200,
 
     // Floating-point flags
+    /** Use the fewest digits that convert back to the same number. Precision is ignored. */
+    FormatShortestForm = 0x800,
     /** Use standard form instead of normal form */
     FormatStandardForm = 0x1000,
     /** Use hexadecimal form instead of normal form */
@@ -3540,6 +3747,7 @@ typedef struct _PH_FORMAT
 #define PhInitFormatF(f, v, p) do { (f)->Type = DoubleFormatType | FormatUsePrecision; (f)->u.Double = (v); (f)->Precision = (p); } while (0)
 #define PhInitFormatE(f, v, p) do { (f)->Type = DoubleFormatType | FormatStandardForm | FormatUsePrecision; (f)->u.Double = (v); (f)->Precision = (p); } while (0)
 #define PhInitFormatA(f, v, p) do { (f)->Type = DoubleFormatType | FormatHexadecimalForm | FormatUsePrecision; (f)->u.Double = (v); (f)->Precision = (p); } while (0)
+#define PhInitFormatR(f, v) do { (f)->Type = DoubleFormatType | FormatShortestForm; (f)->u.Double = (v); } while (0)
 #define PhInitFormatSize(f, v) do { (f)->Type = SizeFormatType; (f)->u.Size = (v); } while (0)
 
 PHLIBAPI
@@ -3562,6 +3770,17 @@ PhFormatToBuffer(
     _Out_opt_ PSIZE_T ReturnLength
     );
 
+PHLIBAPI
+BOOLEAN
+NTAPI
+PhFormatToBufferBatch(
+    _In_reads_(Count) PPH_FORMAT Format,
+    _In_ ULONG Count,
+    _Out_writes_bytes_(Count * BufferLength) PWSTR Buffer,
+    _In_ SIZE_T BufferLength,
+    _Out_writes_opt_(Count) PSIZE_T ReturnLengths
+    );
+
 // error
 
 PHLIBAPI
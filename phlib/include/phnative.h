@@ -973,6 +973,76 @@ PhDeleteFileWin32(
     _In_ PWSTR FileName
     );
 
+typedef struct _PH_PROCESSOR_TOPOLOGY
+{
+    /** The number of active logical processors in all processor groups. */
+    ULONG NumberOfProcessors;
+    /** The number of active processor groups. */
+    USHORT NumberOfGroups;
+    /** The number of NUMA nodes, i.e. the highest node number plus one. */
+    USHORT NumberOfNodes;
+
+    /**
+     * The index of the first processor in each group. There is an additional element at the end
+     * which contains the number of processors.
+     */
+    PULONG GroupFirstProcessor;
+    /** The active processors in each group. */
+    PKAFFINITY GroupActiveMask;
+
+    /** The group of each processor. */
+    PUSHORT ProcessorGroup;
+    /** The number of each processor within its group. */
+    PUCHAR ProcessorNumber;
+    /** The NUMA node of each processor. */
+    PUSHORT ProcessorNode;
+} PH_PROCESSOR_TOPOLOGY, *PPH_PROCESSOR_TOPOLOGY;
+
+PHLIBAPI
+NTSTATUS
+NTAPI
+PhInitializeProcessorTopology(
+    _Out_ PPH_PROCESSOR_TOPOLOGY Topology,
+    _In_reads_bytes_(GroupLength) PSYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX GroupInformation,
+    _In_ ULONG GroupLength,
+    _In_reads_bytes_opt_(NodeLength) PSYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX NodeInformation,
+    _In_ ULONG NodeLength
+    );
+
+PHLIBAPI
+NTSTATUS
+NTAPI
+PhQueryProcessorTopology(
+    _Out_ PPH_PROCESSOR_TOPOLOGY Topology
+    );
+
+PHLIBAPI
+VOID
+NTAPI
+PhDeleteProcessorTopology(
+    _Inout_ PPH_PROCESSOR_TOPOLOGY Topology
+    );
+
+PHLIBAPI
+NTSTATUS
+NTAPI
+PhQueryProcessorInformation(
+    _In_ PPH_PROCESSOR_TOPOLOGY Topology,
+    _In_ SYSTEM_INFORMATION_CLASS SystemInformationClass,
+    _In_ ULONG EntrySize,
+    _Out_writes_bytes_(EntrySize * Topology->NumberOfProcessors) PVOID Buffer
+    );
+
+PHLIBAPI
+VOID
+NTAPI
+PhSumProcessorPerformanceInformation(
+    _In_ PPH_PROCESSOR_TOPOLOGY Topology,
+    _Inout_updates_(Topology->NumberOfProcessors) PSYSTEM_PROCESSOR_PERFORMANCE_INFORMATION Information,
+    _Out_ PSYSTEM_PROCESSOR_PERFORMANCE_INFORMATION Totals,
+    _Out_writes_opt_(Topology->NumberOfNodes) PSYSTEM_PROCESSOR_PERFORMANCE_INFORMATION NodeTotals
+    );
+
 PHLIBAPI
 NTSTATUS
 NTAPI
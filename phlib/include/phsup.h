@@ -454,6 +454,21 @@ FORCEINLINE ULONG PhCountBits(
     return count;
 }
 
+FORCEINLINE ULONG PhCountBitsUlongPtr(
+    _In_ ULONG_PTR Value
+    )
+{
+    ULONG count = 0;
+
+    while (Value)
+    {
+        count++;
+        Value &= Value - 1;
+    }
+
+    return count;
+}
+
 FORCEINLINE ULONG PhRoundNumber(
     _In_ ULONG Value,
     _In_ ULONG Granularity
@@ -34,6 +34,17 @@ typedef struct _PH_PROVIDER_REGISTRATION
     BOOLEAN Enabled;
     BOOLEAN Unregistering;
     BOOLEAN Boosting;
+
+    /** The interval between each run, in milliseconds, or 0 to run every time the thread runs. */
+    ULONG Interval;
+    /** The delay before the next run after the interval is set, in milliseconds. */
+    ULONG Phase;
+    /** The tick count at which the provider is next due to run. */
+    ULONG64 DueTime;
+    /** The duration of the last run, in 100 nanosecond units. */
+    ULONG64 LastRunTime;
+    /** The total duration of all runs, in 100 nanosecond units. */
+    ULONG64 TotalRunTime;
 } PH_PROVIDER_REGISTRATION, *PPH_PROVIDER_REGISTRATION;
 
 typedef struct _PH_PROVIDER_THREAD
@@ -46,6 +57,9 @@ typedef struct _PH_PROVIDER_THREAD
     PH_QUEUED_LOCK Lock;
     LIST_ENTRY ListHead;
     ULONG BoostCount;
+
+    /** The registration of the provider being run, or NULL if it was unregistered. */
+    PPH_PROVIDER_REGISTRATION CurrentRegistration;
 } PH_PROVIDER_THREAD, *PPH_PROVIDER_THREAD;
 
 PHLIBAPI
@@ -117,6 +131,24 @@ PhGetRunIdProvider(
     _In_ PPH_PROVIDER_REGISTRATION Registration
     );
 
+PHLIBAPI
+VOID
+NTAPI
+PhGetRunTimeProvider(
+    _In_ PPH_PROVIDER_REGISTRATION Registration,
+    _Out_opt_ PULONG64 LastRunTime,
+    _Out_opt_ PULONG64 TotalRunTime
+    );
+
+PHLIBAPI
+VOID
+NTAPI
+PhSetIntervalProvider(
+    _Inout_ PPH_PROVIDER_REGISTRATION Registration,
+    _In_ ULONG Interval,
+    _In_ ULONG Phase
+    );
+
 PHLIBAPI
 BOOLEAN
 NTAPI
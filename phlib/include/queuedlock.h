@@ -55,6 +55,53 @@ BOOLEAN PhQueuedLockInitialization(
     VOID
     );
 
+// Contention profiling
+
+#define PH_QUEUED_LOCK_PROFILE_SIZE 256 // must be a power of two
+
+typedef struct _PH_QUEUED_LOCK_SITE
+{
+    /** The return address of the acquire call. */
+    PVOID Address;
+    /** The number of times an acquire at this site had to wait. */
+    ULONG Blocks;
+    /** The number of threads currently waiting at this site. */
+    ULONG CurrentWaiters;
+    /** The largest number of threads waiting at this site at the same time. */
+    ULONG MaximumWaiters;
+    /** The total time spent waiting, in 100 nanosecond units. */
+    ULONG64 WaitTime;
+} PH_QUEUED_LOCK_SITE, *PPH_QUEUED_LOCK_SITE;
+
+PHLIBAPI
+VOID
+NTAPI
+PhSetQueuedLockProfiling(
+    _In_ BOOLEAN Enable
+    );
+
+PHLIBAPI
+BOOLEAN
+NTAPI
+PhGetQueuedLockProfiling(
+    VOID
+    );
+
+PHLIBAPI
+ULONG
+NTAPI
+PhGetQueuedLockProfile(
+    _Out_writes_to_(Count, return) PPH_QUEUED_LOCK_SITE Sites,
+    _In_ ULONG Count
+    );
+
+PHLIBAPI
+VOID
+NTAPI
+PhResetQueuedLockProfile(
+    VOID
+    );
+
 // Queued lock
 
 FORCEINLINE
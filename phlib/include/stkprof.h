@@ -0,0 +1,93 @@
+#ifndef _PH_STKPROF_H
+#define _PH_STKPROF_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * A node in a stack profile. Each node represents a unique call path, and nodes with the same
+ * parent are linked together in the order they were first seen.
+ */
+typedef struct _PH_STACK_PROFILE_NODE
+{
+    /** The address of the frame. */
+    ULONG64 Address;
+    ULONG Parent;
+    ULONG FirstChild;
+    ULONG LastChild;
+    ULONG NextSibling;
+    /** The number of samples whose innermost frame is this node. */
+    ULONG Count;
+} PH_STACK_PROFILE_NODE, *PPH_STACK_PROFILE_NODE;
+
+/**
+ * A stack profile structure.
+ *
+ * \remarks Samples are merged into a trie keyed by frame address, so each unique call path is
+ * stored only once no matter how many times it was sampled. Addresses are not resolved to
+ * symbols until the profile is formatted.
+ */
+typedef struct _PH_STACK_PROFILE
+{
+    /** The nodes of the trie. Node 0 is the root, which does not correspond to any frame. */
+    PPH_STACK_PROFILE_NODE Nodes;
+    ULONG NumberOfNodes;
+    ULONG AllocatedNodes;
+    /** Maps a parent node and a frame address to a child node. */
+    PPH_FLAT_HASHTABLE ChildHashtable;
+    /** The number of samples added to the profile. */
+    ULONG NumberOfSamples;
+} PH_STACK_PROFILE, *PPH_STACK_PROFILE;
+
+/**
+ * A callback function passed to PhFormatStackProfileFolded() to resolve a frame address.
+ *
+ * \param Address The address of the frame.
+ * \param Context A user-defined value passed to PhFormatStackProfileFolded().
+ *
+ * \return The name of the frame, or NULL to use the address. The reference to the returned
+ * string is released by the caller.
+ */
+typedef PPH_STRING (NTAPI *PPH_STACK_PROFILE_RESOLVE_FUNCTION)(
+    _In_ ULONG64 Address,
+    _In_opt_ PVOID Context
+    );
+
+PHLIBAPI
+VOID
+NTAPI
+PhInitializeStackProfile(
+    _Out_ PPH_STACK_PROFILE Profile
+    );
+
+PHLIBAPI
+VOID
+NTAPI
+PhDeleteStackProfile(
+    _Inout_ PPH_STACK_PROFILE Profile
+    );
+
+PHLIBAPI
+VOID
+NTAPI
+PhAddStackProfileSample(
+    _Inout_ PPH_STACK_PROFILE Profile,
+    _In_reads_(NumberOfFrames) PULONG64 Frames,
+    _In_ ULONG NumberOfFrames
+    );
+
+PHLIBAPI
+PPH_STRING
+NTAPI
+PhFormatStackProfileFolded(
+    _In_ PPH_STACK_PROFILE Profile,
+    _In_opt_ PPH_STACK_PROFILE_RESOLVE_FUNCTION ResolveFunction,
+    _In_opt_ PVOID Context
+    );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -21,6 +21,9 @@ typedef struct _PH_SYMBOL_PROVIDER
     PH_INITONCE InitOnce;
     PH_AVL_TREE ModulesSet;
     PH_CALLBACK EventCallback;
+
+    /** A provider shared between processes which is used to resolve kernel addresses. */
+    struct _PH_SYMBOL_PROVIDER *KernelSymbolProvider;
 } PH_SYMBOL_PROVIDER, *PPH_SYMBOL_PROVIDER;
 
 typedef enum _PH_SYMBOL_RESOLVE_LEVEL
@@ -137,6 +140,24 @@ PhLoadModuleSymbolProvider(
     _In_ ULONG Size
     );
 
+PHLIBAPI
+VOID
+NTAPI
+PhAddModuleSymbolProvider(
+    _In_ PPH_SYMBOL_PROVIDER SymbolProvider,
+    _In_ PWSTR FileName,
+    _In_ ULONG64 BaseAddress,
+    _In_ ULONG Size
+    );
+
+PHLIBAPI
+VOID
+NTAPI
+PhSetKernelSymbolProvider(
+    _In_ PPH_SYMBOL_PROVIDER SymbolProvider,
+    _In_opt_ PPH_SYMBOL_PROVIDER KernelSymbolProvider
+    );
+
 PHLIBAPI
 VOID
 NTAPI
@@ -396,7 +396,8 @@ typedef struct _PH_TREENEW_SEARCH_EVENT
 #define TNM_SETEMPTYTEXT (WM_USER + 43)
 #define TNM_SETROWHEIGHT (WM_USER + 44)
 #define TNM_ISFLATNODEVALID (WM_USER + 45)
-#define TNM_LAST (WM_USER + 45)
+#define TNM_NODECHILDRENSTRUCTURED (WM_USER + 46)
+#define TNM_LAST (WM_USER + 46)
 
 #define TreeNew_SetCallback(hWnd, Callback, Context) \
     SendMessage((hWnd), TNM_SETCALLBACK, (WPARAM)(Context), (LPARAM)(Callback))
@@ -527,6 +528,12 @@ typedef struct _PH_TREENEW_SEARCH_EVENT
 #define TreeNew_IsFlatNodeValid(hWnd) \
     ((BOOLEAN)SendMessage((hWnd), TNM_ISFLATNODEVALID, 0, 0))
 
+// Notifies the control that the descendants of a node have changed, but the node itself has not
+// moved. Only the rows below the node are rebuilt. If the node is not currently displayed, the
+// whole tree is restructured.
+#define TreeNew_NodeChildrenStructured(hWnd, Node) \
+    SendMessage((hWnd), TNM_NODECHILDRENSTRUCTURED, 0, (LPARAM)(Node))
+
 typedef struct _PH_TREENEW_VIEW_PARTS
 {
     RECT ClientRect;
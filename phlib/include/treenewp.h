@@ -57,7 +57,8 @@ typedef struct _PH_TREENEW_CONTEXT
             ULONG DragSelectionActive : 1;
             ULONG SelectionRectangleAlpha : 1; // use alpha blending for the selection rectangle
             ULONG CustomRowHeight : 1;
-            ULONG Spare : 4;
+            ULONG FlatListLevelReset : 1; // whether the children of a hidden node were placed at level 0
+            ULONG Spare : 3;
         };
         ULONG Flags;
     };
@@ -516,6 +517,17 @@ VOID PhTnpInsertNodeChildren(
     _In_ ULONG Level
     );
 
+VOID PhTnpInsertChildNodes(
+    _In_ PPH_TREENEW_CONTEXT Context,
+    _In_ PPH_TREENEW_NODE Node,
+    _In_ ULONG NextLevel
+    );
+
+VOID PhTnpRestructureNodeChildren(
+    _In_ PPH_TREENEW_CONTEXT Context,
+    _In_ PPH_TREENEW_NODE Node
+    );
+
 VOID PhTnpSetExpandedNode(
     _In_ PPH_TREENEW_CONTEXT Context,
     _In_ PPH_TREENEW_NODE Node,
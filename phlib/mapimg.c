@@ -1177,32 +1177,208 @@ NTSTATUS PhGetMappedImageDelayImports(
     return STATUS_SUCCESS;
 }
 
-USHORT PhCheckSum(
-    _In_ ULONG Sum,
+/**
+ * Sums a buffer of 16-bit words. The result is congruent to the ones' complement sum of the
+ * words modulo 0xffff, and is zero only if all words are zero.
+ */
+static ULONG64 PhpCheckSumBlock(
     _In_reads_(Count) PUSHORT Buffer,
-    _In_ ULONG Count
+    _In_ SIZE_T Count
     )
 {
-    while (Count--)
+    ULONG64 sum = 0;
+
+    // Since 0x10000 is congruent to 1 modulo 0xffff, we can add up whole 32-bit dwords instead
+    // of words and fold the carries once at the end. A 64-bit accumulator cannot overflow for
+    // any buffer smaller than 16 GB.
+
+#if defined(_M_IX86) || defined(_M_AMD64)
+    if (Count >= 16 && USER_SHARED_DATA->ProcessorFeatures[PF_XMMI64_INSTRUCTIONS_AVAILABLE])
     {
-        Sum += *Buffer++;
-        Sum = (Sum >> 16) + (Sum & 0xffff);
+        __m128i zero;
+        __m128i sum1;
+        __m128i sum2;
+        __m128i block1;
+        __m128i block2;
+        SIZE_T count;
+        ULONG64 lanes[2];
+
+        zero = _mm_setzero_si128();
+        sum1 = _mm_setzero_si128();
+        sum2 = _mm_setzero_si128();
+        count = Count / 16;
+
+        do
+        {
+            block1 = _mm_loadu_si128((__m128i *)Buffer);
+            block2 = _mm_loadu_si128((__m128i *)(Buffer + 8));
+            sum1 = _mm_add_epi64(sum1, _mm_unpacklo_epi32(block1, zero));
+            sum2 = _mm_add_epi64(sum2, _mm_unpackhi_epi32(block1, zero));
+            sum1 = _mm_add_epi64(sum1, _mm_unpacklo_epi32(block2, zero));
+            sum2 = _mm_add_epi64(sum2, _mm_unpackhi_epi32(block2, zero));
+            Buffer += 16;
+        } while (--count != 0);
+
+        _mm_storeu_si128((__m128i *)lanes, _mm_add_epi64(sum1, sum2));
+        sum = lanes[0] + lanes[1];
+        Count &= 15;
     }
+#endif
 
-    Sum = (Sum >> 16) + Sum;
+    while (Count >= 2)
+    {
+        sum += *(ULONG UNALIGNED *)Buffer;
+        Buffer += 2;
+        Count -= 2;
+    }
+
+    if (Count != 0)
+        sum += *Buffer;
+
+    return sum;
+}
+
+/**
+ * Folds a sum produced by PhpCheckSumBlock() into a 16-bit ones' complement sum.
+ */
+static USHORT PhpFoldCheckSum(
+    _In_ ULONG64 Sum
+    )
+{
+    while (Sum >> 16)
+        Sum = (Sum >> 16) + (Sum & 0xffff);
 
     return (USHORT)Sum;
 }
 
+USHORT PhCheckSum(
+    _In_ ULONG Sum,
+    _In_reads_(Count) PUSHORT Buffer,
+    _In_ ULONG Count
+    )
+{
+    if (Count == 0)
+        return (USHORT)((Sum >> 16) + Sum);
+
+    // Process the first word separately so that large initial sums are treated the same way
+    // as in the word-by-word algorithm.
+    Sum += *Buffer++;
+    Sum = (Sum >> 16) + (Sum & 0xffff);
+    Count--;
+
+    return PhpFoldCheckSum(Sum + PhpCheckSumBlock(Buffer, Count));
+}
+
+#define PH_CHECKSUM_MINIMUM_CHUNK_SIZE (16 * 1024 * 1024)
+#define PH_CHECKSUM_MAXIMUM_THREADS 16
+
+typedef struct _PH_CHECKSUM_CHUNK
+{
+    PUSHORT Buffer;
+    SIZE_T Count;
+    ULONG64 Sum;
+} PH_CHECKSUM_CHUNK, *PPH_CHECKSUM_CHUNK;
+
+static NTSTATUS PhpCheckSumChunkThreadStart(
+    _In_ PVOID Parameter
+    )
+{
+    PPH_CHECKSUM_CHUNK chunk = Parameter;
+
+    chunk->Sum = PhpCheckSumBlock(chunk->Buffer, chunk->Count);
+
+    return STATUS_SUCCESS;
+}
+
 ULONG PhCheckSumMappedImage(
     _In_ PPH_MAPPED_IMAGE MappedImage
     )
+{
+    return PhCheckSumMappedImageEx(MappedImage, 1);
+}
+
+/**
+ * Computes the check sum of a mapped image.
+ *
+ * \param MappedImage A mapped image.
+ * \param NumberOfThreads The maximum number of threads to use. Specify 0 to choose a number
+ * based on the size of the image and the number of processors. The result does not depend on
+ * the number of threads.
+ */
+ULONG PhCheckSumMappedImageEx(
+    _In_ PPH_MAPPED_IMAGE MappedImage,
+    _In_ ULONG NumberOfThreads
+    )
 {
     ULONG checkSum;
     USHORT partialSum;
     PUSHORT adjust;
+    SIZE_T count;
+
+    count = (MappedImage->Size + 1) / 2;
+
+    if (NumberOfThreads == 0)
+    {
+        NumberOfThreads = (ULONG)(MappedImage->Size / PH_CHECKSUM_MINIMUM_CHUNK_SIZE);
+
+        if (NumberOfThreads > PhSystemBasicInformation.NumberOfProcessors)
+            NumberOfThreads = PhSystemBasicInformation.NumberOfProcessors;
+    }
+
+    if (NumberOfThreads > PH_CHECKSUM_MAXIMUM_THREADS)
+        NumberOfThreads = PH_CHECKSUM_MAXIMUM_THREADS;
+
+    if (NumberOfThreads > 1 && count >= NumberOfThreads * 16)
+    {
+        PH_CHECKSUM_CHUNK chunks[PH_CHECKSUM_MAXIMUM_THREADS];
+        HANDLE threadHandles[PH_CHECKSUM_MAXIMUM_THREADS];
+        SIZE_T chunkCount;
+        ULONG64 sum;
+        ULONG i;
+
+        // Each chunk except the last is a multiple of 16 words, so it starts on a 32-byte
+        // boundary relative to the view.
+        chunkCount = ALIGN_UP_BY(count / NumberOfThreads, 16);
+
+        for (i = 0; i < NumberOfThreads; i++)
+        {
+            SIZE_T offset = chunkCount * i;
+
+            chunks[i].Buffer = (PUSHORT)MappedImage->ViewBase + offset;
+            chunks[i].Count = offset < count ? min(chunkCount, count - offset) : 0;
+            chunks[i].Sum = 0;
+        }
+
+        // The current thread computes the first chunk.
+        for (i = 1; i < NumberOfThreads; i++)
+        {
+            threadHandles[i] = PhCreateThread(0, PhpCheckSumChunkThreadStart, &chunks[i]);
+
+            // Compute the chunk here if we couldn't create a thread for it.
+            if (!threadHandles[i])
+                PhpCheckSumChunkThreadStart(&chunks[i]);
+        }
+
+        PhpCheckSumChunkThreadStart(&chunks[0]);
+        sum = chunks[0].Sum;
+
+        for (i = 1; i < NumberOfThreads; i++)
+        {
+            if (threadHandles[i])
+            {
+                NtWaitForSingleObject(threadHandles[i], FALSE, NULL);
+                NtClose(threadHandles[i]);
+            }
+
+            sum = PhpFoldCheckSum(sum) + chunks[i].Sum;
+        }
 
-    partialSum = PhCheckSum(0, (PUSHORT)MappedImage->ViewBase, (ULONG)(MappedImage->Size + 1) / 2);
+        partialSum = PhpFoldCheckSum(sum);
+    }
+    else
+    {
+        partialSum = PhCheckSum(0, (PUSHORT)MappedImage->ViewBase, (ULONG)count);
+    }
 
     // This is actually the same for 32-bit and 64-bit executables.
     adjust = (PUSHORT)&MappedImage->NtHeaders->OptionalHeader.CheckSum;
@@ -6459,3 +6459,386 @@ NTSTATUS PhImpersonateClientOfNamedPipe(
 
     return status;
 }
+
+typedef NTSTATUS (NTAPI *_NtQuerySystemInformationEx)(
+    _In_ SYSTEM_INFORMATION_CLASS SystemInformationClass,
+    _In_reads_bytes_(InputBufferLength) PVOID InputBuffer,
+    _In_ ULONG InputBufferLength,
+    _Out_writes_bytes_opt_(SystemInformationLength) PVOID SystemInformation,
+    _In_ ULONG SystemInformationLength,
+    _Out_opt_ PULONG ReturnLength
+    );
+
+static _NtQuerySystemInformationEx PhpGetNtQuerySystemInformationEx(
+    VOID
+    )
+{
+    static PH_INITONCE initOnce = PH_INITONCE_INIT;
+    static _NtQuerySystemInformationEx ntQuerySystemInformationEx = NULL;
+
+    if (PhBeginInitOnce(&initOnce))
+    {
+        if (WindowsVersion >= WINDOWS_7)
+            ntQuerySystemInformationEx = PhGetModuleProcAddress(L"ntdll.dll", "NtQuerySystemInformationEx");
+
+        PhEndInitOnce(&initOnce);
+    }
+
+    return ntQuerySystemInformationEx;
+}
+
+static VOID PhpAllocateProcessorTopology(
+    _Out_ PPH_PROCESSOR_TOPOLOGY Topology,
+    _In_ USHORT NumberOfGroups,
+    _In_reads_(NumberOfGroups) PKAFFINITY ActiveMasks
+    )
+{
+    ULONG numberOfProcessors;
+    ULONG processor;
+    USHORT i;
+    UCHAR j;
+
+    numberOfProcessors = 0;
+
+    for (i = 0; i < NumberOfGroups; i++)
+        numberOfProcessors += PhCountBitsUlongPtr(ActiveMasks[i]);
+
+    Topology->NumberOfProcessors = numberOfProcessors;
+    Topology->NumberOfGroups = NumberOfGroups;
+    Topology->NumberOfNodes = 1;
+    Topology->GroupFirstProcessor = PhAllocate(sizeof(ULONG) * (NumberOfGroups + 1));
+    Topology->GroupActiveMask = PhAllocateCopy(ActiveMasks, sizeof(KAFFINITY) * NumberOfGroups);
+    Topology->ProcessorGroup = PhAllocate(sizeof(USHORT) * numberOfProcessors);
+    Topology->ProcessorNumber = PhAllocate(sizeof(UCHAR) * numberOfProcessors);
+    Topology->ProcessorNode = PhAllocate(sizeof(USHORT) * numberOfProcessors);
+    memset(Topology->ProcessorNode, 0, sizeof(USHORT) * numberOfProcessors);
+
+    // Processors are numbered in group order, and in order of their number within each group. This
+    // is the same order in which per-group system information classes return their entries.
+
+    processor = 0;
+
+    for (i = 0; i < NumberOfGroups; i++)
+    {
+        Topology->GroupFirstProcessor[i] = processor;
+
+        for (j = 0; j < sizeof(KAFFINITY) * 8; j++)
+        {
+            if (ActiveMasks[i] & ((KAFFINITY)1 << j))
+            {
+                Topology->ProcessorGroup[processor] = i;
+                Topology->ProcessorNumber[processor] = j;
+                processor++;
+            }
+        }
+    }
+
+    Topology->GroupFirstProcessor[NumberOfGroups] = processor;
+}
+
+/**
+ * Creates a processor topology from logical processor information.
+ *
+ * \param Topology A variable which receives the topology. You must free it using
+ * PhDeleteProcessorTopology() when you no longer need it.
+ * \param GroupInformation Logical processor information containing a RelationGroup entry.
+ * \param GroupLength The size of \a GroupInformation, in bytes.
+ * \param NodeInformation Logical processor information containing RelationNumaNode entries. If this
+ * is NULL, all processors are assigned to node 0.
+ * \param NodeLength The size of \a NodeInformation, in bytes.
+ */
+NTSTATUS PhInitializeProcessorTopology(
+    _Out_ PPH_PROCESSOR_TOPOLOGY Topology,
+    _In_reads_bytes_(GroupLength) PSYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX GroupInformation,
+    _In_ ULONG GroupLength,
+    _In_reads_bytes_opt_(NodeLength) PSYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX NodeInformation,
+    _In_ ULONG NodeLength
+    )
+{
+    PSYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX entry;
+    PGROUP_RELATIONSHIP groupRelationship;
+    KAFFINITY activeMasks[256];
+    USHORT numberOfGroups;
+    ULONG offset;
+    USHORT i;
+
+    groupRelationship = NULL;
+
+    for (offset = 0; offset + FIELD_OFFSET(SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX, Processor) <= GroupLength; offset += entry->Size)
+    {
+        entry = PTR_ADD_OFFSET(GroupInformation, offset);
+
+        if (entry->Size == 0 || offset + entry->Size > GroupLength)
+            break;
+
+        if (entry->Relationship == RelationGroup)
+        {
+            groupRelationship = &entry->Group;
+            break;
+        }
+    }
+
+    if (!groupRelationship || groupRelationship->ActiveGroupCount == 0)
+        return STATUS_INVALID_PARAMETER;
+
+    numberOfGroups = min(groupRelationship->ActiveGroupCount, RTL_NUMBER_OF(activeMasks));
+
+    for (i = 0; i < numberOfGroups; i++)
+        activeMasks[i] = groupRelationship->GroupInfo[i].ActiveProcessorMask;
+
+    PhpAllocateProcessorTopology(Topology, numberOfGroups, activeMasks);
+
+    if (NodeInformation)
+    {
+        for (offset = 0; offset + FIELD_OFFSET(SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX, Processor) <= NodeLength; offset += entry->Size)
+        {
+            KAFFINITY mask;
+            USHORT group;
+            UCHAR j;
+
+            entry = PTR_ADD_OFFSET(NodeInformation, offset);
+
+            if (entry->Size == 0 || offset + entry->Size > NodeLength)
+                break;
+
+            if (entry->Relationship != RelationNumaNode)
+                continue;
+
+            group = entry->NumaNode.GroupMask.Group;
+
+            if (group >= numberOfGroups || entry->NumaNode.NodeNumber >= MAXUSHORT)
+                continue;
+
+            mask = entry->NumaNode.GroupMask.Mask & activeMasks[group];
+
+            for (j = 0; j < sizeof(KAFFINITY) * 8; j++)
+            {
+                if (mask & ((KAFFINITY)1 << j))
+                {
+                    ULONG processor;
+
+                    // The index of the processor within its group is the number of active processors
+                    // with a lower number.
+                    processor = Topology->GroupFirstProcessor[group] +
+                        PhCountBitsUlongPtr(activeMasks[group] & (((KAFFINITY)1 << j) - 1));
+                    Topology->ProcessorNode[processor] = (USHORT)entry->NumaNode.NodeNumber;
+                }
+            }
+
+            if (Topology->NumberOfNodes < entry->NumaNode.NodeNumber + 1)
+                Topology->NumberOfNodes = (USHORT)(entry->NumaNode.NodeNumber + 1);
+        }
+    }
+
+    return STATUS_SUCCESS;
+}
+
+static NTSTATUS PhpQueryLogicalProcessorInformation(
+    _In_ LOGICAL_PROCESSOR_RELATIONSHIP RelationshipType,
+    _Out_ PSYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX *Buffer,
+    _Out_ PULONG BufferLength
+    )
+{
+    NTSTATUS status;
+    _NtQuerySystemInformationEx ntQuerySystemInformationEx;
+    PVOID buffer;
+    ULONG bufferSize;
+
+    if (!(ntQuerySystemInformationEx = PhpGetNtQuerySystemInformationEx()))
+        return STATUS_NOT_SUPPORTED;
+
+    bufferSize = 0x400;
+    buffer = PhAllocate(bufferSize);
+
+    while ((status = ntQuerySystemInformationEx(
+        SystemLogicalProcessorAndGroupInformation,
+        &RelationshipType,
+        sizeof(LOGICAL_PROCESSOR_RELATIONSHIP),
+        buffer,
+        bufferSize,
+        &bufferSize
+        )) == STATUS_INFO_LENGTH_MISMATCH)
+    {
+        PhFree(buffer);
+        buffer = PhAllocate(bufferSize);
+    }
+
+    if (!NT_SUCCESS(status))
+    {
+        PhFree(buffer);
+        return status;
+    }
+
+    *Buffer = buffer;
+    *BufferLength = bufferSize;
+
+    return status;
+}
+
+/**
+ * Gets the processor topology of the system.
+ *
+ * \param Topology A variable which receives the topology. You must free it using
+ * PhDeleteProcessorTopology() when you no longer need it.
+ *
+ * \remarks If processor groups are not supported, the topology contains a single group and a
+ * single node.
+ */
+NTSTATUS PhQueryProcessorTopology(
+    _Out_ PPH_PROCESSOR_TOPOLOGY Topology
+    )
+{
+    NTSTATUS status;
+    PSYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX groupInformation;
+    ULONG groupLength;
+    PSYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX nodeInformation;
+    ULONG nodeLength;
+
+    if (NT_SUCCESS(status = PhpQueryLogicalProcessorInformation(RelationGroup, &groupInformation, &groupLength)))
+    {
+        if (!NT_SUCCESS(PhpQueryLogicalProcessorInformation(RelationNumaNode, &nodeInformation, &nodeLength)))
+        {
+            nodeInformation = NULL;
+            nodeLength = 0;
+        }
+
+        status = PhInitializeProcessorTopology(Topology, groupInformation, groupLength, nodeInformation, nodeLength);
+
+        PhFree(groupInformation);
+
+        if (nodeInformation)
+            PhFree(nodeInformation);
+    }
+
+    if (!NT_SUCCESS(status))
+    {
+        KAFFINITY activeMask;
+
+        activeMask = PhSystemBasicInformation.ActiveProcessorsAffinityMask;
+        PhpAllocateProcessorTopology(Topology, 1, &activeMask);
+        status = STATUS_SUCCESS;
+    }
+
+    return status;
+}
+
+/**
+ * Frees a processor topology.
+ *
+ * \param Topology A processor topology.
+ */
+VOID PhDeleteProcessorTopology(
+    _Inout_ PPH_PROCESSOR_TOPOLOGY Topology
+    )
+{
+    PhFree(Topology->GroupFirstProcessor);
+    PhFree(Topology->GroupActiveMask);
+    PhFree(Topology->ProcessorGroup);
+    PhFree(Topology->ProcessorNumber);
+    PhFree(Topology->ProcessorNode);
+}
+
+/**
+ * Queries per-processor system information for all processor groups.
+ *
+ * \param Topology The processor topology.
+ * \param SystemInformationClass The information class to query. The class must return an array
+ * with one element for each processor, and must accept a processor group number as input to
+ * NtQuerySystemInformationEx.
+ * \param EntrySize The size of each element, in bytes.
+ * \param Buffer A buffer which receives one element for each processor in \a Topology.
+ */
+NTSTATUS PhQueryProcessorInformation(
+    _In_ PPH_PROCESSOR_TOPOLOGY Topology,
+    _In_ SYSTEM_INFORMATION_CLASS SystemInformationClass,
+    _In_ ULONG EntrySize,
+    _Out_writes_bytes_(EntrySize * Topology->NumberOfProcessors) PVOID Buffer
+    )
+{
+    NTSTATUS status;
+    _NtQuerySystemInformationEx ntQuerySystemInformationEx;
+    USHORT i;
+    ULONG count;
+
+    // Without processor groups, the normal query returns all processors.
+    if (Topology->NumberOfGroups == 1 || !(ntQuerySystemInformationEx = PhpGetNtQuerySystemInformationEx()))
+    {
+        return NtQuerySystemInformation(
+            SystemInformationClass,
+            Buffer,
+            EntrySize * Topology->NumberOfProcessors,
+            NULL
+            );
+    }
+
+    for (i = 0; i < Topology->NumberOfGroups; i++)
+    {
+        count = Topology->GroupFirstProcessor[i + 1] - Topology->GroupFirstProcessor[i];
+
+        status = ntQuerySystemInformationEx(
+            SystemInformationClass,
+            &i,
+            sizeof(USHORT),
+            PTR_ADD_OFFSET(Buffer, EntrySize * Topology->GroupFirstProcessor[i]),
+            EntrySize * count,
+            NULL
+            );
+
+        if (!NT_SUCCESS(status))
+            return status;
+    }
+
+    return STATUS_SUCCESS;
+}
+
+/**
+ * Sums processor performance information over all processors and over each NUMA node.
+ *
+ * \param Topology The processor topology.
+ * \param Information An array of processor performance information, as returned by
+ * PhQueryProcessorInformation(). The idle time is subtracted from the kernel time of each
+ * element.
+ * \param Totals A variable which receives the totals for all processors.
+ * \param NodeTotals An array which receives the totals for each NUMA node in \a Topology.
+ */
+VOID PhSumProcessorPerformanceInformation(
+    _In_ PPH_PROCESSOR_TOPOLOGY Topology,
+    _Inout_updates_(Topology->NumberOfProcessors) PSYSTEM_PROCESSOR_PERFORMANCE_INFORMATION Information,
+    _Out_ PSYSTEM_PROCESSOR_PERFORMANCE_INFORMATION Totals,
+    _Out_writes_opt_(Topology->NumberOfNodes) PSYSTEM_PROCESSOR_PERFORMANCE_INFORMATION NodeTotals
+    )
+{
+    ULONG i;
+
+    memset(Totals, 0, sizeof(SYSTEM_PROCESSOR_PERFORMANCE_INFORMATION));
+
+    if (NodeTotals)
+        memset(NodeTotals, 0, sizeof(SYSTEM_PROCESSOR_PERFORMANCE_INFORMATION) * Topology->NumberOfNodes);
+
+    for (i = 0; i < Topology->NumberOfProcessors; i++)
+    {
+        PSYSTEM_PROCESSOR_PERFORMANCE_INFORMATION information = &Information[i];
+
+        // KernelTime includes IdleTime.
+        information->KernelTime.QuadPart -= information->IdleTime.QuadPart;
+
+        Totals->DpcTime.QuadPart += information->DpcTime.QuadPart;
+        Totals->IdleTime.QuadPart += information->IdleTime.QuadPart;
+        Totals->InterruptCount += information->InterruptCount;
+        Totals->InterruptTime.QuadPart += information->InterruptTime.QuadPart;
+        Totals->KernelTime.QuadPart += information->KernelTime.QuadPart;
+        Totals->UserTime.QuadPart += information->UserTime.QuadPart;
+
+        if (NodeTotals)
+        {
+            PSYSTEM_PROCESSOR_PERFORMANCE_INFORMATION nodeTotals = &NodeTotals[Topology->ProcessorNode[i]];
+
+            nodeTotals->DpcTime.QuadPart += information->DpcTime.QuadPart;
+            nodeTotals->IdleTime.QuadPart += information->IdleTime.QuadPart;
+            nodeTotals->InterruptCount += information->InterruptCount;
+            nodeTotals->InterruptTime.QuadPart += information->InterruptTime.QuadPart;
+            nodeTotals->KernelTime.QuadPart += information->KernelTime.QuadPart;
+            nodeTotals->UserTime.QuadPart += information->UserTime.QuadPart;
+        }
+    }
+}
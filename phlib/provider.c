@@ -36,6 +36,12 @@
  * even when boosted, always run on the same provider thread. The other option would be to have the
  * boosting thread run the provider function directly, which would involve unnecessary blocking and
  * synchronization.
+ *
+ * Each provider can also have its own interval, which must be longer than the interval of the
+ * provider thread. Such providers are skipped until they are due, so slow providers can run less
+ * often than the fast providers sharing their thread. A phase can be given to delay the first run,
+ * so that providers with the same interval are spread over different runs of the thread instead of
+ * all running at once.
  */
 
 #include <ph.h>
@@ -65,6 +71,7 @@ VOID PhInitializeProviderThread(
     PhInitializeQueuedLock(&ProviderThread->Lock);
     InitializeListHead(&ProviderThread->ListHead);
     ProviderThread->BoostCount = 0;
+    ProviderThread->CurrentRegistration = NULL;
 
 #ifdef DEBUG
     PhAcquireQueuedLockExclusive(&PhDbgProviderListLock);
@@ -109,8 +116,14 @@ NTSTATUS NTAPI PhpProviderThreadStart(
     PPH_PROVIDER_FUNCTION providerFunction;
     PVOID object;
     LIST_ENTRY tempListHead;
+    ULONG64 currentTime;
+    LARGE_INTEGER frequency;
+    LARGE_INTEGER startCounter;
+    LARGE_INTEGER endCounter;
+    ULONG64 runTime;
 
     PhInitializeAutoPool(&autoPool);
+    NtQueryPerformanceCounter(&startCounter, &frequency);
 
     while (providerThread->State != ProviderThreadStopping)
     {
@@ -123,6 +136,7 @@ NTSTATUS NTAPI PhpProviderThreadStart(
         // (main list or the temp list).
 
         InitializeListHead(&tempListHead);
+        currentTime = NtGetTickCount64();
 
         PhAcquireQueuedLockExclusive(&providerThread->Lock);
 
@@ -158,6 +172,21 @@ NTSTATUS NTAPI PhpProviderThreadStart(
             {
                 if (!registration->Enabled || registration->Unregistering)
                     continue;
+
+                if (registration->Interval != 0)
+                {
+                    // The timer may be signaled slightly early, so allow half of the thread's
+                    // interval. Otherwise a provider whose interval is a multiple of the thread's
+                    // interval would regularly miss a run.
+                    if (currentTime + providerThread->Interval / 2 < registration->DueTime)
+                        continue;
+
+                    registration->DueTime += registration->Interval;
+
+                    // Don't try to catch up on runs that were missed.
+                    if (registration->DueTime <= currentTime)
+                        registration->DueTime = currentTime + registration->Interval;
+                }
             }
             else
             {
@@ -188,14 +217,27 @@ NTSTATUS NTAPI PhpProviderThreadStart(
                 PhReferenceObject(object);
 
             registration->RunId++;
+            providerThread->CurrentRegistration = registration;
 
             PhReleaseQueuedLockExclusive(&providerThread->Lock);
+            NtQueryPerformanceCounter(&startCounter, NULL);
             providerFunction(object);
+            NtQueryPerformanceCounter(&endCounter, NULL);
             PhDrainAutoPool(&autoPool);
             PhAcquireQueuedLockExclusive(&providerThread->Lock);
 
             if (object)
                 PhDereferenceObject(object);
+
+            // The registration may have been unregistered and freed while the provider was running.
+            if (providerThread->CurrentRegistration)
+            {
+                runTime = (endCounter.QuadPart - startCounter.QuadPart) * PH_TICKS_PER_SEC / frequency.QuadPart;
+                // Written atomically so that PhGetRunTimeProvider does not need the lock.
+                InterlockedExchange64((PLONG64)&registration->LastRunTime, runTime);
+                InterlockedExchangeAdd64((PLONG64)&registration->TotalRunTime, runTime);
+                providerThread->CurrentRegistration = NULL;
+            }
         }
 
         // Re-add the items in the temp list to the main list.
@@ -328,6 +370,11 @@ VOID PhRegisterProvider(
     Registration->Enabled = FALSE;
     Registration->Unregistering = FALSE;
     Registration->Boosting = FALSE;
+    Registration->Interval = 0;
+    Registration->Phase = 0;
+    Registration->DueTime = 0;
+    Registration->LastRunTime = 0;
+    Registration->TotalRunTime = 0;
 
     if (Object)
         PhReferenceObject(Object);
@@ -367,6 +414,9 @@ VOID PhUnregisterProvider(
     if (Registration->Boosting)
         providerThread->BoostCount--;
 
+    if (providerThread->CurrentRegistration == Registration)
+        providerThread->CurrentRegistration = NULL;
+
     // The user-supplied object must be dereferenced
     // while the mutex is held.
     if (Registration->Object)
@@ -443,6 +493,59 @@ ULONG PhGetRunIdProvider(
     return Registration->RunId;
 }
 
+/**
+ * Gets the time spent running a provider.
+ *
+ * \param Registration A pointer to the registration object for a provider.
+ * \param LastRunTime A variable which receives the duration of the last run, in 100 nanosecond
+ * units.
+ * \param TotalRunTime A variable which receives the total duration of all runs, in 100 nanosecond
+ * units.
+ *
+ * \remarks The values are read without acquiring the provider thread lock, so this function may
+ * be called while the lock is held.
+ */
+VOID PhGetRunTimeProvider(
+    _In_ PPH_PROVIDER_REGISTRATION Registration,
+    _Out_opt_ PULONG64 LastRunTime,
+    _Out_opt_ PULONG64 TotalRunTime
+    )
+{
+    if (LastRunTime)
+        *LastRunTime = InterlockedCompareExchange64((PLONG64)&Registration->LastRunTime, 0, 0);
+    if (TotalRunTime)
+        *TotalRunTime = InterlockedCompareExchange64((PLONG64)&Registration->TotalRunTime, 0, 0);
+}
+
+/**
+ * Sets the run interval for a provider.
+ *
+ * \param Registration A pointer to the registration object for a provider.
+ * \param Interval The interval between each run, in milliseconds. Specify 0 to run the provider
+ * every time the provider thread runs.
+ * \param Phase The delay before the next run, in milliseconds.
+ *
+ * \remarks The provider thread still wakes up at its own interval, so an interval shorter than
+ * the interval of the provider thread has no effect. Boosting a provider is not affected by its
+ * interval.
+ */
+VOID PhSetIntervalProvider(
+    _Inout_ PPH_PROVIDER_REGISTRATION Registration,
+    _In_ ULONG Interval,
+    _In_ ULONG Phase
+    )
+{
+    PPH_PROVIDER_THREAD providerThread;
+
+    providerThread = Registration->ProviderThread;
+
+    PhAcquireQueuedLockExclusive(&providerThread->Lock);
+    Registration->Interval = Interval;
+    Registration->Phase = Phase;
+    Registration->DueTime = NtGetTickCount64() + Phase;
+    PhReleaseQueuedLockExclusive(&providerThread->Lock);
+}
+
 /**
  * Gets whether a provider is enabled.
  *
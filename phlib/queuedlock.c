@@ -68,6 +68,14 @@
  *
  * Queued locks can act as wake events. These are designed for tiny one-bit locks which share a
  * single event to block on. Spurious wake-ups are a part of normal operation.
+ *
+ * All blocking goes through two primitives, PhpWaitQueuedLockAddress and PhpWakeQueuedLockAddress,
+ * which wait on and wake the address of a wait block. A wake is never lost: if the waiter has not
+ * blocked yet, the waker blocks until it does.
+ *
+ * Contention profiling can be enabled at run time. When it is enabled, each blocking acquire is
+ * recorded against the address it was called from, along with the time spent waiting and the
+ * number of threads waiting at that address. Uncontended acquires are not affected.
  */
 
 #include <phbase.h>
@@ -96,6 +104,11 @@ VOID FASTCALL PhpfWakeQueuedLockEx(
 static HANDLE PhQueuedLockKeyedEventHandle;
 static ULONG PhQueuedLockSpinCount = 2000;
 
+static BOOLEAN PhQueuedLockProfiling = FALSE;
+static LARGE_INTEGER PhQueuedLockProfileFrequency;
+static PH_QUEUED_LOCK_SITE PhQueuedLockSites[PH_QUEUED_LOCK_PROFILE_SIZE];
+static PH_QUEUED_LOCK_SITE PhQueuedLockOverflowSite;
+
 BOOLEAN PhQueuedLockInitialization(
     VOID
     )
@@ -116,6 +129,32 @@ BOOLEAN PhQueuedLockInitialization(
     return TRUE;
 }
 
+/**
+ * Blocks until an address is woken.
+ *
+ * \param Address The address to wait on.
+ * \param Timeout A timeout value.
+ */
+FORCEINLINE NTSTATUS PhpWaitQueuedLockAddress(
+    _In_ PVOID Address,
+    _In_opt_ PLARGE_INTEGER Timeout
+    )
+{
+    return NtWaitForKeyedEvent(PhQueuedLockKeyedEventHandle, Address, FALSE, Timeout);
+}
+
+/**
+ * Wakes a thread waiting on an address, blocking until there is one.
+ *
+ * \param Address The address to wake.
+ */
+FORCEINLINE NTSTATUS PhpWakeQueuedLockAddress(
+    _In_ PVOID Address
+    )
+{
+    return NtReleaseKeyedEvent(PhQueuedLockKeyedEventHandle, Address, FALSE, NULL);
+}
+
 /**
  * Pushes a wait block onto a queued lock's waiters list.
  *
@@ -302,12 +341,7 @@ _May_raise_ FORCEINLINE NTSTATUS PhpBlockOnQueuedWaitBlock(
     {
         PHLIB_INC_STATISTIC(QlBlockWaits);
 
-        status = NtWaitForKeyedEvent(
-            PhQueuedLockKeyedEventHandle,
-            WaitBlock,
-            FALSE,
-            Timeout
-            );
+        status = PhpWaitQueuedLockAddress(WaitBlock, Timeout);
 
         // If an error occurred (timeout is not an error), raise an exception as it is nearly
         // impossible to recover from this situation.
@@ -322,6 +356,75 @@ _May_raise_ FORCEINLINE NTSTATUS PhpBlockOnQueuedWaitBlock(
     return status;
 }
 
+/**
+ * Finds or creates the profile entry for a call site.
+ *
+ * \param Address The return address of the acquire call.
+ */
+static PPH_QUEUED_LOCK_SITE PhpGetQueuedLockSite(
+    _In_ PVOID Address
+    )
+{
+    ULONG index;
+    ULONG i;
+    PPH_QUEUED_LOCK_SITE site;
+    PVOID address;
+
+    index = (ULONG)((ULONG_PTR)Address * 0x9e3779b1) >> 24;
+
+    for (i = 0; i < PH_QUEUED_LOCK_PROFILE_SIZE; i++)
+    {
+        site = &PhQueuedLockSites[(index + i) & (PH_QUEUED_LOCK_PROFILE_SIZE - 1)];
+        address = site->Address;
+
+        if (!address)
+            address = _InterlockedCompareExchangePointer(&site->Address, Address, NULL);
+
+        if (!address || address == Address)
+            return site;
+    }
+
+    return &PhQueuedLockOverflowSite;
+}
+
+/**
+ * Waits for a wait block to be unblocked, recording the wait in the contention profile.
+ *
+ * \param WaitBlock A wait block.
+ * \param Address The return address of the acquire call.
+ */
+static VOID PhpProfileBlockOnQueuedWaitBlock(
+    _Inout_ PPH_QUEUED_WAIT_BLOCK WaitBlock,
+    _In_ PVOID Address
+    )
+{
+    PPH_QUEUED_LOCK_SITE site;
+    LARGE_INTEGER startCounter;
+    LARGE_INTEGER endCounter;
+    ULONG waiters;
+    ULONG maximumWaiters;
+
+    site = PhpGetQueuedLockSite(Address);
+    _InterlockedIncrement((PLONG)&site->Blocks);
+    waiters = _InterlockedIncrement((PLONG)&site->CurrentWaiters);
+
+    while ((maximumWaiters = site->MaximumWaiters) < waiters)
+    {
+        if ((ULONG)_InterlockedCompareExchange((PLONG)&site->MaximumWaiters, waiters, maximumWaiters) == maximumWaiters)
+            break;
+    }
+
+    NtQueryPerformanceCounter(&startCounter, NULL);
+    PhpBlockOnQueuedWaitBlock(WaitBlock, TRUE, NULL);
+    NtQueryPerformanceCounter(&endCounter, NULL);
+
+    _InterlockedDecrement((PLONG)&site->CurrentWaiters);
+    InterlockedExchangeAdd64(
+        (PLONG64)&site->WaitTime,
+        (endCounter.QuadPart - startCounter.QuadPart) * PH_TICKS_PER_SEC / PhQueuedLockProfileFrequency.QuadPart
+        );
+}
+
 /**
  * Unblocks a wait block.
  *
@@ -338,12 +441,7 @@ _May_raise_ FORCEINLINE VOID PhpUnblockQueuedWaitBlock(
 
     if (!_interlockedbittestandreset((PLONG)&WaitBlock->Flags, PH_QUEUED_WAITER_SPINNING_SHIFT))
     {
-        if (!NT_SUCCESS(status = NtReleaseKeyedEvent(
-            PhQueuedLockKeyedEventHandle,
-            WaitBlock,
-            FALSE,
-            NULL
-            )))
+        if (!NT_SUCCESS(status = PhpWakeQueuedLockAddress(WaitBlock)))
             PhRaiseStatus(status);
     }
 }
@@ -675,7 +773,11 @@ VOID FASTCALL PhfAcquireQueuedLockExclusive(
                     PhpfOptimizeQueuedLockList(QueuedLock, currentValue);
 
                 PHLIB_INC_STATISTIC(QlAcquireExclusiveBlocks);
-                PhpBlockOnQueuedWaitBlock(&waitBlock, TRUE, NULL);
+
+                if (!PhQueuedLockProfiling)
+                    PhpBlockOnQueuedWaitBlock(&waitBlock, TRUE, NULL);
+                else
+                    PhpProfileBlockOnQueuedWaitBlock(&waitBlock, _ReturnAddress());
             }
         }
 
@@ -736,7 +838,11 @@ VOID FASTCALL PhfAcquireQueuedLockShared(
                     PhpfOptimizeQueuedLockList(QueuedLock, currentValue);
 
                 PHLIB_INC_STATISTIC(QlAcquireSharedBlocks);
-                PhpBlockOnQueuedWaitBlock(&waitBlock, TRUE, NULL);
+
+                if (!PhQueuedLockProfiling)
+                    PhpBlockOnQueuedWaitBlock(&waitBlock, TRUE, NULL);
+                else
+                    PhpProfileBlockOnQueuedWaitBlock(&waitBlock, _ReturnAddress());
             }
         }
 
@@ -1200,3 +1306,86 @@ NTSTATUS FASTCALL PhfWaitForWakeEvent(
 
     return status;
 }
+
+/**
+ * Enables or disables contention profiling for queued locks.
+ *
+ * \param Enable TRUE to record blocking acquires, otherwise FALSE.
+ */
+VOID PhSetQueuedLockProfiling(
+    _In_ BOOLEAN Enable
+    )
+{
+    if (Enable && PhQueuedLockProfileFrequency.QuadPart == 0)
+    {
+        LARGE_INTEGER counter;
+
+        NtQueryPerformanceCounter(&counter, &PhQueuedLockProfileFrequency);
+    }
+
+    PhQueuedLockProfiling = Enable;
+}
+
+/**
+ * Gets whether contention profiling is enabled for queued locks.
+ */
+BOOLEAN PhGetQueuedLockProfiling(
+    VOID
+    )
+{
+    return PhQueuedLockProfiling;
+}
+
+/**
+ * Copies the contention profile for queued locks.
+ *
+ * \param Sites A buffer which receives the call sites which have blocked. Blocks from call sites
+ * which did not fit in the profile are combined into a site with a NULL address.
+ * \param Count The number of elements in \a Sites.
+ *
+ * \return The number of sites copied.
+ */
+ULONG PhGetQueuedLockProfile(
+    _Out_writes_to_(Count, return) PPH_QUEUED_LOCK_SITE Sites,
+    _In_ ULONG Count
+    )
+{
+    ULONG numberOfSites;
+    ULONG i;
+
+    numberOfSites = 0;
+
+    for (i = 0; i < PH_QUEUED_LOCK_PROFILE_SIZE && numberOfSites < Count; i++)
+    {
+        if (PhQueuedLockSites[i].Address && PhQueuedLockSites[i].Blocks != 0)
+            Sites[numberOfSites++] = PhQueuedLockSites[i];
+    }
+
+    if (PhQueuedLockOverflowSite.Blocks != 0 && numberOfSites < Count)
+        Sites[numberOfSites++] = PhQueuedLockOverflowSite;
+
+    return numberOfSites;
+}
+
+/**
+ * Clears the contention profile for queued locks.
+ *
+ * \remarks Call sites which are currently waiting may be recorded with inaccurate statistics.
+ */
+VOID PhResetQueuedLockProfile(
+    VOID
+    )
+{
+    ULONG i;
+
+    for (i = 0; i < PH_QUEUED_LOCK_PROFILE_SIZE; i++)
+    {
+        PhQueuedLockSites[i].Blocks = 0;
+        PhQueuedLockSites[i].MaximumWaiters = PhQueuedLockSites[i].CurrentWaiters;
+        PhQueuedLockSites[i].WaitTime = 0;
+    }
+
+    PhQueuedLockOverflowSite.Blocks = 0;
+    PhQueuedLockOverflowSite.MaximumWaiters = PhQueuedLockOverflowSite.CurrentWaiters;
+    PhQueuedLockOverflowSite.WaitTime = 0;
+}
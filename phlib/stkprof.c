@@ -0,0 +1,363 @@
+/*
+ * Process Hacker -
+ *   stack profile aggregation
+ *
+ * This file is part of Process Hacker.
+ *
+ * Process Hacker is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Process Hacker is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Process Hacker.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * A stack profile merges sampled call stacks into a trie. Each node is identified by its parent
+ * and the address of its frame, so the cost of adding a sample is one hashtable lookup per frame
+ * and no memory is allocated for call paths that have been seen before. Frame addresses are only
+ * resolved when the profile is formatted, and each unique address is resolved once.
+ *
+ * The output format is the "folded stacks" format used by flame graph tools: one line per unique
+ * call path, with frames separated by semicolons from the outermost to the innermost, followed by
+ * a space and the number of samples.
+ */
+
+#include <phbase.h>
+#include <stkprof.h>
+
+typedef struct _PH_STACK_PROFILE_CHILD_ENTRY
+{
+    ULONG64 Address;
+    ULONG Parent;
+    ULONG Node;
+} PH_STACK_PROFILE_CHILD_ENTRY, *PPH_STACK_PROFILE_CHILD_ENTRY;
+
+typedef struct _PH_STACK_PROFILE_NAME_ENTRY
+{
+    ULONG64 Address;
+    PPH_STRING Name;
+} PH_STACK_PROFILE_NAME_ENTRY, *PPH_STACK_PROFILE_NAME_ENTRY;
+
+static BOOLEAN NTAPI PhpStackProfileChildEqualFunction(
+    _In_ PVOID Entry1,
+    _In_ PVOID Entry2
+    )
+{
+    PPH_STACK_PROFILE_CHILD_ENTRY entry1 = Entry1;
+    PPH_STACK_PROFILE_CHILD_ENTRY entry2 = Entry2;
+
+    return entry1->Address == entry2->Address && entry1->Parent == entry2->Parent;
+}
+
+static ULONG NTAPI PhpStackProfileChildHashFunction(
+    _In_ PVOID Entry
+    )
+{
+    PPH_STACK_PROFILE_CHILD_ENTRY entry = Entry;
+
+    return PhHashInt64(entry->Address) ^ PhHashInt32(entry->Parent);
+}
+
+static BOOLEAN NTAPI PhpStackProfileNameEqualFunction(
+    _In_ PVOID Entry1,
+    _In_ PVOID Entry2
+    )
+{
+    return ((PPH_STACK_PROFILE_NAME_ENTRY)Entry1)->Address == ((PPH_STACK_PROFILE_NAME_ENTRY)Entry2)->Address;
+}
+
+static ULONG NTAPI PhpStackProfileNameHashFunction(
+    _In_ PVOID Entry
+    )
+{
+    return PhHashInt64(((PPH_STACK_PROFILE_NAME_ENTRY)Entry)->Address);
+}
+
+/**
+ * Initializes a stack profile.
+ *
+ * \param Profile A stack profile structure.
+ */
+VOID PhInitializeStackProfile(
+    _Out_ PPH_STACK_PROFILE Profile
+    )
+{
+    Profile->AllocatedNodes = 64;
+    Profile->Nodes = PhAllocate(Profile->AllocatedNodes * sizeof(PH_STACK_PROFILE_NODE));
+    Profile->NumberOfNodes = 1;
+    Profile->ChildHashtable = PhCreateFlatHashtable(
+        sizeof(PH_STACK_PROFILE_CHILD_ENTRY),
+        PhpStackProfileChildEqualFunction,
+        PhpStackProfileChildHashFunction,
+        64
+        );
+    Profile->NumberOfSamples = 0;
+
+    memset(&Profile->Nodes[0], 0, sizeof(PH_STACK_PROFILE_NODE));
+}
+
+/**
+ * Frees resources used by a stack profile.
+ *
+ * \param Profile A stack profile structure.
+ */
+VOID PhDeleteStackProfile(
+    _Inout_ PPH_STACK_PROFILE Profile
+    )
+{
+    PhDereferenceObject(Profile->ChildHashtable);
+    PhFree(Profile->Nodes);
+}
+
+static ULONG PhpAddChildStackProfile(
+    _Inout_ PPH_STACK_PROFILE Profile,
+    _In_ ULONG Parent,
+    _In_ ULONG64 Address
+    )
+{
+    PH_STACK_PROFILE_CHILD_ENTRY lookupEntry;
+    PPH_STACK_PROFILE_CHILD_ENTRY entry;
+    BOOLEAN added;
+    PPH_STACK_PROFILE_NODE node;
+    ULONG index;
+
+    lookupEntry.Address = Address;
+    lookupEntry.Parent = Parent;
+    lookupEntry.Node = Profile->NumberOfNodes;
+    entry = PhAddEntryFlatHashtableEx(Profile->ChildHashtable, &lookupEntry, &added);
+
+    if (!added)
+        return entry->Node;
+
+    if (Profile->NumberOfNodes == Profile->AllocatedNodes)
+    {
+        Profile->AllocatedNodes *= 2;
+        Profile->Nodes = PhReAllocate(Profile->Nodes, Profile->AllocatedNodes * sizeof(PH_STACK_PROFILE_NODE));
+    }
+
+    index = Profile->NumberOfNodes++;
+    node = &Profile->Nodes[index];
+    node->Address = Address;
+    node->Parent = Parent;
+    node->FirstChild = 0;
+    node->LastChild = 0;
+    node->NextSibling = 0;
+    node->Count = 0;
+
+    // The root is never a child, so 0 can be used to indicate the absence of a node.
+    if (Profile->Nodes[Parent].LastChild)
+        Profile->Nodes[Profile->Nodes[Parent].LastChild].NextSibling = index;
+    else
+        Profile->Nodes[Parent].FirstChild = index;
+
+    Profile->Nodes[Parent].LastChild = index;
+
+    return index;
+}
+
+/**
+ * Adds a sampled call stack to a stack profile.
+ *
+ * \param Profile A stack profile structure.
+ * \param Frames An array of frame addresses, starting with the innermost frame. This is the
+ * order in which frames are returned by PhWalkThreadStack().
+ * \param NumberOfFrames The number of elements in \a Frames. Empty stacks are ignored.
+ */
+VOID PhAddStackProfileSample(
+    _Inout_ PPH_STACK_PROFILE Profile,
+    _In_reads_(NumberOfFrames) PULONG64 Frames,
+    _In_ ULONG NumberOfFrames
+    )
+{
+    ULONG node;
+    ULONG i;
+
+    if (NumberOfFrames == 0)
+        return;
+
+    node = 0;
+
+    for (i = NumberOfFrames; i != 0; i--)
+        node = PhpAddChildStackProfile(Profile, node, Frames[i - 1]);
+
+    Profile->Nodes[node].Count++;
+    Profile->NumberOfSamples++;
+}
+
+static PPH_STRING PhpEscapeStackProfileName(
+    _In_ _Assume_refs_(1) PPH_STRING Name
+    )
+{
+    PPH_STRING escapedName;
+    SIZE_T i;
+
+    // Frames are separated by semicolons and the count is separated from the path by a space, so
+    // these characters (and line breaks) can't appear in a frame name.
+
+    escapedName = Name;
+
+    for (i = 0; i < Name->Length / sizeof(WCHAR); i++)
+    {
+        switch (Name->Buffer[i])
+        {
+        case ';':
+        case ' ':
+        case '\t':
+        case '\r':
+        case '\n':
+            if (escapedName == Name)
+                escapedName = PhCreateStringEx(Name->Buffer, Name->Length);
+
+            escapedName->Buffer[i] = '_';
+            break;
+        }
+    }
+
+    if (escapedName != Name)
+        PhDereferenceObject(Name);
+
+    return escapedName;
+}
+
+static PPH_STRING PhpResolveStackProfileAddress(
+    _Inout_ PPH_FLAT_HASHTABLE NameHashtable,
+    _In_ ULONG64 Address,
+    _In_opt_ PPH_STACK_PROFILE_RESOLVE_FUNCTION ResolveFunction,
+    _In_opt_ PVOID Context
+    )
+{
+    PH_STACK_PROFILE_NAME_ENTRY lookupEntry;
+    PPH_STACK_PROFILE_NAME_ENTRY entry;
+    PPH_STRING name;
+
+    lookupEntry.Address = Address;
+    entry = PhFindEntryFlatHashtable(NameHashtable, &lookupEntry);
+
+    if (entry)
+        return entry->Name;
+
+    name = NULL;
+
+    if (ResolveFunction)
+        name = ResolveFunction(Address, Context);
+
+    if (name)
+    {
+        name = PhpEscapeStackProfileName(name);
+    }
+    else
+    {
+        WCHAR pointer[PH_PTR_STR_LEN_1];
+
+        PhPrintPointer(pointer, (PVOID)(ULONG_PTR)Address);
+        name = PhCreateString(pointer);
+    }
+
+    lookupEntry.Name = name;
+    PhAddEntryFlatHashtable(NameHashtable, &lookupEntry);
+
+    return name;
+}
+
+/**
+ * Formats a stack profile as folded stacks.
+ *
+ * \param Profile A stack profile structure.
+ * \param ResolveFunction A function which resolves frame addresses to names. The function is
+ * called once for each unique address. If this parameter is NULL or the function returns NULL,
+ * the address is used as the name. Semicolons and whitespace in names are replaced with
+ * underscores.
+ * \param Context A user-defined value to pass to the resolve function.
+ *
+ * \return A string containing one line for each unique call path. Paths are listed in depth-first
+ * order, and paths with the same parent are listed in the order they were first sampled.
+ */
+PPH_STRING PhFormatStackProfileFolded(
+    _In_ PPH_STACK_PROFILE Profile,
+    _In_opt_ PPH_STACK_PROFILE_RESOLVE_FUNCTION ResolveFunction,
+    _In_opt_ PVOID Context
+    )
+{
+    PH_STRING_BUILDER stringBuilder;
+    PH_STRING_BUILDER pathBuilder;
+    PPH_FLAT_HASHTABLE nameHashtable;
+    PSIZE_T pathLengths;
+    ULONG index;
+    PH_FLAT_HASHTABLE_ENUM_CONTEXT enumContext;
+    PPH_STACK_PROFILE_NAME_ENTRY nameEntry;
+
+    PhInitializeStringBuilder(&stringBuilder, 0x1000);
+    PhInitializeStringBuilder(&pathBuilder, 0x400);
+    nameHashtable = PhCreateFlatHashtable(
+        sizeof(PH_STACK_PROFILE_NAME_ENTRY),
+        PhpStackProfileNameEqualFunction,
+        PhpStackProfileNameHashFunction,
+        256
+        );
+
+    // The length of the path up to and including each node. This lets us build the path of a
+    // node from the path of its parent without walking back up the trie.
+    pathLengths = PhAllocate(Profile->NumberOfNodes * sizeof(SIZE_T));
+    pathLengths[0] = 0;
+
+    index = Profile->Nodes[0].FirstChild;
+
+    while (index != 0)
+    {
+        PPH_STACK_PROFILE_NODE node = &Profile->Nodes[index];
+        PPH_STRING name;
+
+        PhRemoveEndStringBuilder(&pathBuilder, (pathBuilder.String->Length - pathLengths[node->Parent]) / sizeof(WCHAR));
+
+        if (node->Parent != 0)
+            PhAppendCharStringBuilder(&pathBuilder, ';');
+
+        name = PhpResolveStackProfileAddress(nameHashtable, node->Address, ResolveFunction, Context);
+        PhAppendStringBuilder(&pathBuilder, &name->sr);
+        pathLengths[index] = pathBuilder.String->Length;
+
+        if (node->Count != 0)
+        {
+            WCHAR count[PH_INT32_STR_LEN_1];
+
+            PhAppendStringBuilder(&stringBuilder, &pathBuilder.String->sr);
+            PhAppendCharStringBuilder(&stringBuilder, ' ');
+            PhPrintUInt32(count, node->Count);
+            PhAppendStringBuilder2(&stringBuilder, count);
+            PhAppendCharStringBuilder(&stringBuilder, '\n');
+        }
+
+        // Move to the next node in depth-first order.
+
+        if (node->FirstChild != 0)
+        {
+            index = node->FirstChild;
+            continue;
+        }
+
+        while (index != 0 && Profile->Nodes[index].NextSibling == 0)
+            index = Profile->Nodes[index].Parent;
+
+        if (index != 0)
+            index = Profile->Nodes[index].NextSibling;
+    }
+
+    PhFree(pathLengths);
+
+    PhBeginEnumFlatHashtable(nameHashtable, &enumContext);
+
+    while (nameEntry = PhNextEnumFlatHashtable(&enumContext))
+        PhDereferenceObject(nameEntry->Name);
+
+    PhDereferenceObject(nameHashtable);
+    PhDeleteStringBuilder(&pathBuilder);
+
+    return PhFinalStringBuilderString(&stringBuilder);
+}
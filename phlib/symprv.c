@@ -39,6 +39,7 @@ typedef struct _PH_SYMBOL_MODULE
     ULONG Size;
     PPH_STRING FileName;
     ULONG BaseNameIndex;
+    BOOLEAN Loaded;
 } PH_SYMBOL_MODULE, *PPH_SYMBOL_MODULE;
 
 VOID NTAPI PhpSymbolProviderDeleteProcedure(
@@ -59,6 +60,15 @@ LONG NTAPI PhpSymbolModuleCompareFunction(
     _In_ PPH_AVL_LINKS Links2
     );
 
+VOID PhpLoadDeferredModuleSymbolProvider(
+    _In_ PPH_SYMBOL_PROVIDER SymbolProvider,
+    _In_ ULONG64 Address
+    );
+
+VOID PhpLoadDeferredModulesSymbolProvider(
+    _In_ PPH_SYMBOL_PROVIDER SymbolProvider
+    );
+
 PPH_OBJECT_TYPE PhSymbolProviderType;
 
 static PH_INITONCE PhSymInitOnce = PH_INITONCE_INIT;
@@ -238,6 +248,7 @@ VOID NTAPI PhpSymbolProviderDeleteProcedure(
         PhpFreeSymbolModule(module);
     }
 
+    if (symbolProvider->KernelSymbolProvider) PhDereferenceObject(symbolProvider->KernelSymbolProvider);
     if (symbolProvider->IsRealHandle) NtClose(symbolProvider->ProcessHandle);
 }
 
@@ -351,6 +362,17 @@ static LONG NTAPI PhpSymbolModuleCompareFunction(
     return uint64cmp(symbolModule1->BaseAddress, symbolModule2->BaseAddress);
 }
 
+static PPH_SYMBOL_PROVIDER PhpSelectSymbolProvider(
+    _In_ PPH_SYMBOL_PROVIDER SymbolProvider,
+    _In_ ULONG64 Address
+    )
+{
+    if (SymbolProvider->KernelSymbolProvider && Address > PhSystemBasicInformation.MaximumUserModeAddress)
+        return SymbolProvider->KernelSymbolProvider;
+    else
+        return SymbolProvider;
+}
+
 BOOLEAN PhGetLineFromAddress(
     _In_ PPH_SYMBOL_PROVIDER SymbolProvider,
     _In_ ULONG64 Address,
@@ -364,11 +386,14 @@ BOOLEAN PhGetLineFromAddress(
     ULONG displacement;
     PPH_STRING fileName;
 
+    SymbolProvider = PhpSelectSymbolProvider(SymbolProvider, Address);
     PhpRegisterSymbolProvider(SymbolProvider);
 
     if (!SymGetLineFromAddrW64_I && !SymGetLineFromAddr64_I)
         return FALSE;
 
+    PhpLoadDeferredModuleSymbolProvider(SymbolProvider, Address);
+
     line.SizeOfStruct = sizeof(IMAGEHLP_LINEW64);
 
     PH_LOCK_SYMBOLS();
@@ -440,6 +465,8 @@ ULONG64 PhGetModuleFromAddress(
     foundFileName = NULL;
     foundBaseAddress = 0;
 
+    SymbolProvider = PhpSelectSymbolProvider(SymbolProvider, Address);
+
     PhAcquireQueuedLockShared(&SymbolProvider->ModulesListLock);
 
     // Do an approximate search on the modules set to locate the module with the largest
@@ -540,11 +567,14 @@ PPH_STRING PhGetSymbolFromAddress(
         return NULL;
     }
 
+    SymbolProvider = PhpSelectSymbolProvider(SymbolProvider, Address);
     PhpRegisterSymbolProvider(SymbolProvider);
 
     if (!SymFromAddrW_I && !SymFromAddr_I)
         return NULL;
 
+    PhpLoadDeferredModuleSymbolProvider(SymbolProvider, Address);
+
     symbolInfo = PhAllocate(FIELD_OFFSET(SYMBOL_INFOW, Name) + PH_MAX_SYMBOL_NAME_LEN * 2);
     memset(symbolInfo, 0, sizeof(SYMBOL_INFOW));
     symbolInfo->SizeOfStruct = sizeof(SYMBOL_INFOW);
@@ -753,6 +783,9 @@ BOOLEAN PhGetSymbolFromName(
     if (!SymFromNameW_I && !SymFromName_I)
         return FALSE;
 
+    // The name may refer to any module, so we need symbols for all of them.
+    PhpLoadDeferredModulesSymbolProvider(SymbolProvider);
+
     symbolInfo = (PSYMBOL_INFOW)symbolInfoBuffer;
     memset(symbolInfo, 0, sizeof(SYMBOL_INFOW));
     symbolInfo->SizeOfStruct = sizeof(SYMBOL_INFOW);
@@ -812,98 +845,238 @@ BOOLEAN PhGetSymbolFromName(
     return TRUE;
 }
 
-BOOLEAN PhLoadModuleSymbolProvider(
+static PPH_SYMBOL_MODULE PhpAddSymbolModule(
     _In_ PPH_SYMBOL_PROVIDER SymbolProvider,
     _In_ PWSTR FileName,
     _In_ ULONG64 BaseAddress,
     _In_ ULONG Size
     )
 {
-    ULONG64 baseAddress;
-    PPH_SYMBOL_MODULE symbolModule = NULL;
+    PPH_SYMBOL_MODULE symbolModule;
     PPH_AVL_LINKS existingLinks;
     PH_SYMBOL_MODULE lookupSymbolModule;
 
-    PhpRegisterSymbolProvider(SymbolProvider);
-
-    if (!SymLoadModuleExW_I && !SymLoadModule64_I)
-        return FALSE;
+    PhAcquireQueuedLockExclusive(&SymbolProvider->ModulesListLock);
 
     // Check for duplicates. It is better to do this before calling SymLoadModuleExW, because it
     // seems to force symbol loading when it is called twice on the same module even if deferred
     // loading is enabled.
-    PhAcquireQueuedLockExclusive(&SymbolProvider->ModulesListLock);
     lookupSymbolModule.BaseAddress = BaseAddress;
     existingLinks = PhFindElementAvlTree(&SymbolProvider->ModulesSet, &lookupSymbolModule.Links);
-    PhReleaseQueuedLockExclusive(&SymbolProvider->ModulesListLock);
 
     if (existingLinks)
-        return TRUE;
-
-    PH_LOCK_SYMBOLS();
-
-    if (SymLoadModuleExW_I)
     {
-        baseAddress = SymLoadModuleExW_I(
-            SymbolProvider->ProcessHandle,
-            NULL,
-            FileName,
-            NULL,
-            BaseAddress,
-            Size,
-            NULL,
-            0
-            );
+        symbolModule = CONTAINING_RECORD(existingLinks, PH_SYMBOL_MODULE, Links);
     }
     else
     {
-        PPH_BYTES fileName;
+        symbolModule = PhAllocate(sizeof(PH_SYMBOL_MODULE));
+        symbolModule->BaseAddress = BaseAddress;
+        symbolModule->Size = Size;
+        symbolModule->Loaded = FALSE;
 
-        fileName = PhConvertUtf16ToMultiByte(FileName);
-        baseAddress = SymLoadModule64_I(
-            SymbolProvider->ProcessHandle,
-            NULL,
-            fileName->Buffer,
-            NULL,
-            BaseAddress,
-            Size
-            );
-        PhDereferenceObject(fileName);
+        // Keep the original name if we can't get the full path, since we need it to load the
+        // symbols later.
+        if (!(symbolModule->FileName = PhGetFullPath(FileName, &symbolModule->BaseNameIndex)))
+        {
+            symbolModule->FileName = PhCreateString(FileName);
+            symbolModule->BaseNameIndex = 0;
+        }
+
+        PhAddElementAvlTree(&SymbolProvider->ModulesSet, &symbolModule->Links);
+        InsertTailList(&SymbolProvider->ModulesListHead, &symbolModule->ListEntry);
+    }
+
+    PhReleaseQueuedLockExclusive(&SymbolProvider->ModulesListLock);
+
+    return symbolModule;
+}
+
+static BOOLEAN PhpLoadSymbolModule(
+    _In_ PPH_SYMBOL_PROVIDER SymbolProvider,
+    _In_ PPH_SYMBOL_MODULE SymbolModule
+    )
+{
+    ULONG64 baseAddress;
+    BOOLEAN result;
+
+    result = TRUE;
+
+    PH_LOCK_SYMBOLS();
+
+    // The Loaded flag is only modified while the symbols lock is held.
+    if (!SymbolModule->Loaded)
+    {
+        if (SymLoadModuleExW_I)
+        {
+            baseAddress = SymLoadModuleExW_I(
+                SymbolProvider->ProcessHandle,
+                NULL,
+                SymbolModule->FileName->Buffer,
+                NULL,
+                SymbolModule->BaseAddress,
+                SymbolModule->Size,
+                NULL,
+                0
+                );
+        }
+        else
+        {
+            PPH_BYTES fileName;
+
+            fileName = PhConvertUtf16ToMultiByte(SymbolModule->FileName->Buffer);
+            baseAddress = SymLoadModule64_I(
+                SymbolProvider->ProcessHandle,
+                NULL,
+                fileName->Buffer,
+                NULL,
+                SymbolModule->BaseAddress,
+                SymbolModule->Size
+                );
+            PhDereferenceObject(fileName);
+        }
+
+        // Don't try again, even if we couldn't load symbols for the module.
+        SymbolModule->Loaded = TRUE;
+
+        if (!baseAddress && GetLastError() != ERROR_SUCCESS)
+            result = FALSE;
     }
 
     PH_UNLOCK_SYMBOLS();
 
-    // Add the module to the list, even if we couldn't load symbols for the module.
+    return result;
+}
 
-    PhAcquireQueuedLockExclusive(&SymbolProvider->ModulesListLock);
+VOID PhpLoadDeferredModuleSymbolProvider(
+    _In_ PPH_SYMBOL_PROVIDER SymbolProvider,
+    _In_ ULONG64 Address
+    )
+{
+    PH_SYMBOL_MODULE lookupModule;
+    PPH_AVL_LINKS links;
+    PPH_SYMBOL_MODULE module;
 
-    // Check for duplicates again.
-    lookupSymbolModule.BaseAddress = BaseAddress;
-    existingLinks = PhFindElementAvlTree(&SymbolProvider->ModulesSet, &lookupSymbolModule.Links);
+    if (!SymLoadModuleExW_I && !SymLoadModule64_I)
+        return;
+
+    module = NULL;
+
+    PhAcquireQueuedLockShared(&SymbolProvider->ModulesListLock);
+
+    lookupModule.BaseAddress = Address;
+    links = PhUpperDualBoundElementAvlTree(&SymbolProvider->ModulesSet, &lookupModule.Links);
 
-    if (!existingLinks)
+    if (links)
     {
-        symbolModule = PhAllocate(sizeof(PH_SYMBOL_MODULE));
-        symbolModule->BaseAddress = BaseAddress;
-        symbolModule->Size = Size;
-        symbolModule->FileName = PhGetFullPath(FileName, &symbolModule->BaseNameIndex);
+        module = CONTAINING_RECORD(links, PH_SYMBOL_MODULE, Links);
 
-        existingLinks = PhAddElementAvlTree(&SymbolProvider->ModulesSet, &symbolModule->Links);
-        assert(!existingLinks);
-        InsertTailList(&SymbolProvider->ModulesListHead, &symbolModule->ListEntry);
+        if (module->Loaded || Address >= module->BaseAddress + module->Size)
+            module = NULL;
     }
 
-    PhReleaseQueuedLockExclusive(&SymbolProvider->ModulesListLock);
+    PhReleaseQueuedLockShared(&SymbolProvider->ModulesListLock);
+
+    // Modules are only freed when the provider is deleted, so it is safe to use the module outside
+    // of the lock.
+    if (module)
+        PhpLoadSymbolModule(SymbolProvider, module);
+}
 
-    if (!baseAddress)
+VOID PhpLoadDeferredModulesSymbolProvider(
+    _In_ PPH_SYMBOL_PROVIDER SymbolProvider
+    )
+{
+    PPH_LIST modules;
+    PLIST_ENTRY listEntry;
+    ULONG i;
+
+    if (!SymLoadModuleExW_I && !SymLoadModule64_I)
+        return;
+
+    modules = PhCreateList(16);
+
+    PhAcquireQueuedLockShared(&SymbolProvider->ModulesListLock);
+
+    listEntry = SymbolProvider->ModulesListHead.Flink;
+
+    while (listEntry != &SymbolProvider->ModulesListHead)
     {
-        if (GetLastError() != ERROR_SUCCESS)
-            return FALSE;
-        else
-            return TRUE;
+        PPH_SYMBOL_MODULE module;
+
+        module = CONTAINING_RECORD(listEntry, PH_SYMBOL_MODULE, ListEntry);
+        listEntry = listEntry->Flink;
+
+        if (!module->Loaded)
+            PhAddItemList(modules, module);
     }
 
-    return TRUE;
+    PhReleaseQueuedLockShared(&SymbolProvider->ModulesListLock);
+
+    for (i = 0; i < modules->Count; i++)
+        PhpLoadSymbolModule(SymbolProvider, modules->Items[i]);
+
+    PhDereferenceObject(modules);
+}
+
+BOOLEAN PhLoadModuleSymbolProvider(
+    _In_ PPH_SYMBOL_PROVIDER SymbolProvider,
+    _In_ PWSTR FileName,
+    _In_ ULONG64 BaseAddress,
+    _In_ ULONG Size
+    )
+{
+    PPH_SYMBOL_MODULE symbolModule;
+
+    PhpRegisterSymbolProvider(SymbolProvider);
+
+    if (!SymLoadModuleExW_I && !SymLoadModule64_I)
+        return FALSE;
+
+    // Add the module to the list, even if we can't load symbols for the module.
+    symbolModule = PhpAddSymbolModule(SymbolProvider, FileName, BaseAddress, Size);
+
+    return PhpLoadSymbolModule(SymbolProvider, symbolModule);
+}
+
+/**
+ * Adds a module to a symbol provider without loading its symbols.
+ *
+ * \param SymbolProvider The symbol provider.
+ * \param FileName The file name of the module.
+ * \param BaseAddress The base address of the module.
+ * \param Size The size of the module.
+ *
+ * \remarks The symbols for the module are loaded when an address within the module is first
+ * resolved. This is much cheaper than calling PhLoadModuleSymbolProvider for every module in a
+ * process when only a few addresses are going to be resolved.
+ */
+VOID PhAddModuleSymbolProvider(
+    _In_ PPH_SYMBOL_PROVIDER SymbolProvider,
+    _In_ PWSTR FileName,
+    _In_ ULONG64 BaseAddress,
+    _In_ ULONG Size
+    )
+{
+    PhpAddSymbolModule(SymbolProvider, FileName, BaseAddress, Size);
+}
+
+/**
+ * Sets the symbol provider used to resolve kernel addresses.
+ *
+ * \param SymbolProvider The symbol provider.
+ * \param KernelSymbolProvider A symbol provider containing the kernel modules, or NULL to resolve
+ * kernel addresses using \a SymbolProvider. This provider can be shared by any number of other
+ * providers, so that symbols for each kernel module only need to be loaded once.
+ *
+ * \remarks This function must be called before the symbol provider is used.
+ */
+VOID PhSetKernelSymbolProvider(
+    _In_ PPH_SYMBOL_PROVIDER SymbolProvider,
+    _In_opt_ PPH_SYMBOL_PROVIDER KernelSymbolProvider
+    )
+{
+    PhSwapReference(&SymbolProvider->KernelSymbolProvider, KernelSymbolProvider);
 }
 
 VOID PhSetOptionsSymbolProvider(
@@ -1387,6 +1560,10 @@ BOOLEAN PhStackWalk(
     if (!StackWalk64_I)
         return FALSE;
 
+    // We need the unwind information for the current frame.
+    if (SymbolProvider)
+        PhpLoadDeferredModuleSymbolProvider(SymbolProvider, StackFrame->AddrPC.Offset);
+
     if (!FunctionTableAccessRoutine)
     {
         if (MachineType == IMAGE_FILE_MACHINE_AMD64)
@@ -1647,6 +1647,27 @@ ULONG_PTR PhTnpOnUserMessage(
             InvalidateRect(Context->Handle, NULL, FALSE);
         }
         return TRUE;
+    case TNM_NODECHILDRENSTRUCTURED:
+        {
+            PPH_TREENEW_NODE node = (PPH_TREENEW_NODE)LParam;
+
+            if (Context->EnableRedraw <= 0)
+            {
+                Context->SuspendUpdateStructure = TRUE;
+                Context->SuspendUpdateLayout = TRUE;
+                InvalidateRect(Context->Handle, NULL, FALSE);
+                return TRUE;
+            }
+
+            if (node)
+                PhTnpRestructureNodeChildren(Context, node);
+            else
+                PhTnpRestructureNodes(Context);
+
+            PhTnpLayout(Context);
+            InvalidateRect(Context->Handle, NULL, FALSE);
+        }
+        return TRUE;
     case TNM_ADDCOLUMN:
         return PhTnpAddColumn(Context, (PPH_TREENEW_COLUMN)LParam);
     case TNM_REMOVECOLUMN:
@@ -3204,6 +3225,7 @@ VOID PhTnpRestructureNodes(
 
     PhClearList(Context->FlatList);
     Context->CanAnyExpand = FALSE;
+    Context->FlatListLevelReset = FALSE;
 
     for (i = 0; i < numberOfChildren; i++)
     {
@@ -3226,9 +3248,6 @@ VOID PhTnpInsertNodeChildren(
     _In_ ULONG Level
     )
 {
-    PPH_TREENEW_NODE *children;
-    ULONG numberOfChildren;
-    ULONG i;
     ULONG nextLevel;
 
     if (Node->Visible)
@@ -3246,8 +3265,26 @@ VOID PhTnpInsertNodeChildren(
     else
     {
         nextLevel = 0; // children of this node should be level 0
+
+        // The children of this node no longer follow their visible ancestors in the flat list, so
+        // the rows belonging to those ancestors can't be found by their level.
+        if (Level != 0)
+            Context->FlatListLevelReset = TRUE;
     }
 
+    PhTnpInsertChildNodes(Context, Node, nextLevel);
+}
+
+VOID PhTnpInsertChildNodes(
+    _In_ PPH_TREENEW_CONTEXT Context,
+    _In_ PPH_TREENEW_NODE Node,
+    _In_ ULONG NextLevel
+    )
+{
+    PPH_TREENEW_NODE *children;
+    ULONG numberOfChildren;
+    ULONG i;
+
     if (!(Node->s.IsLeaf = PhTnpIsNodeLeaf(Context, Node)))
     {
         Context->CanAnyExpand = TRUE;
@@ -3258,7 +3295,7 @@ VOID PhTnpInsertNodeChildren(
             {
                 for (i = 0; i < numberOfChildren; i++)
                 {
-                    PhTnpInsertNodeChildren(Context, children[i], nextLevel);
+                    PhTnpInsertNodeChildren(Context, children[i], NextLevel);
                 }
 
                 if (numberOfChildren == 0)
@@ -3268,6 +3305,119 @@ VOID PhTnpInsertNodeChildren(
     }
 }
 
+static VOID PhTnpFixupRowIndex(
+    _Inout_ PULONG Index,
+    _In_ ULONG Start,
+    _In_ ULONG OldEnd,
+    _In_ ULONG NewEnd
+    )
+{
+    if (*Index == -1 || *Index < Start)
+        return;
+
+    if (*Index >= OldEnd)
+        *Index = *Index - OldEnd + NewEnd;
+    else if (*Index >= NewEnd)
+        *Index = -1;
+}
+
+/**
+ * Rebuilds the rows below a node without restructuring the rest of the tree.
+ *
+ * \param Context The tree list context.
+ * \param Node The node whose descendants have changed. The node must not have moved since the
+ * tree was last restructured.
+ *
+ * \remarks The rows belonging to the node are found by their level, replaced by the node's
+ * current descendants, and the indices of the following rows are updated. If the node is not
+ * in the flat list, the whole tree is restructured.
+ */
+VOID PhTnpRestructureNodeChildren(
+    _In_ PPH_TREENEW_CONTEXT Context,
+    _In_ PPH_TREENEW_NODE Node
+    )
+{
+    PPH_LIST flatList;
+    PPH_LIST newList;
+    ULONG start;
+    ULONG end;
+    ULONG newEnd;
+    ULONG fixupEnd;
+    ULONG i;
+    BOOLEAN focusNodeRemoved;
+
+    flatList = Context->FlatList;
+
+    if (
+        Context->SuspendUpdateStructure ||
+        Context->FlatListLevelReset ||
+        !Node->Visible ||
+        Node->Index >= flatList->Count ||
+        flatList->Items[Node->Index] != Node
+        )
+    {
+        PhTnpRestructureNodes(Context);
+        return;
+    }
+
+    // Find the existing rows. Since every node in this range is still in the flat list, it is
+    // safe to follow the pointers.
+
+    start = Node->Index + 1;
+    focusNodeRemoved = FALSE;
+
+    for (end = start; end < flatList->Count; end++)
+    {
+        PPH_TREENEW_NODE node = flatList->Items[end];
+
+        if (node->Level <= Node->Level)
+            break;
+
+        if (node == Context->FocusNode)
+            focusNodeRemoved = TRUE;
+    }
+
+    // Build the new rows in a separate list, then replace the old rows.
+
+    newList = PhCreateList(end - start + 1);
+    Context->FlatList = newList;
+    Context->FocusNodeFound = FALSE;
+    PhTnpInsertChildNodes(Context, Node, Node->Level + 1);
+    Context->FlatList = flatList;
+
+    if (focusNodeRemoved && !Context->FocusNodeFound)
+        Context->FocusNode = NULL; // focused node is no longer present
+
+    newEnd = start + newList->Count;
+
+    if (newEnd == end)
+    {
+        memcpy(&flatList->Items[start], newList->Items, newList->Count * sizeof(PVOID));
+    }
+    else
+    {
+        PhRemoveItemsList(flatList, start, end - start);
+
+        if (newList->Count != 0)
+            PhInsertItemsList(flatList, start, newList->Items, newList->Count);
+    }
+
+    PhDereferenceObject(newList);
+
+    // Only the new rows need their indices updated, unless the number of rows has changed.
+
+    if (newEnd == end)
+        fixupEnd = newEnd;
+    else
+        fixupEnd = flatList->Count;
+
+    for (i = start; i < fixupEnd; i++)
+        ((PPH_TREENEW_NODE)flatList->Items[i])->Index = i;
+
+    PhTnpFixupRowIndex(&Context->HotNodeIndex, start, end, newEnd);
+    PhTnpFixupRowIndex(&Context->MarkNodeIndex, start, end, newEnd);
+}
+
 VOID PhTnpSetExpandedNode(
     _In_ PPH_TREENEW_CONTEXT Context,
     _In_ PPH_TREENEW_NODE Node,
@@ -3315,7 +3465,7 @@ VOID PhTnpSetExpandedNode(
             }
 
             Node->Expanded = Expanded;
-            PhTnpRestructureNodes(Context);
+            PhTnpRestructureNodeChildren(Context, Node);
             // We need to update the window before the scrollbars get updated in order for the
             // scroll processing to work properly.
             InvalidateRect(Context->Handle, NULL, FALSE);
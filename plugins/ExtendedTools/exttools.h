@@ -196,6 +196,11 @@ typedef struct _ET_PROCESS_BLOCK
     FLOAT GpuNodeUsage;
     ULONG64 GpuDedicatedUsage;
     ULONG64 GpuSharedUsage;
+    DOUBLE GpuElapsedTime; // time since GPU statistics were last queried, in micro-seconds
+    ULONG GpuQueryCountdown; // updates until GPU statistics are next queried, for idle processes
+    BOOLEAN GpuActive; // GPU usage changed when statistics were last queried
+    BOOLEAN GpuPresent; // the process has used the GPU at some point
+    LONG GpuWatchCount; // number of GPU property pages open for the process
 
     PH_UINT32_DELTA HardFaultsDelta;
 
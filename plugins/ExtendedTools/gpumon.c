@@ -547,6 +547,102 @@ VOID EtpUpdateNodeInformation(
     }
 }
 
+/**
+ * Checks whether a process has any GPU state, using one query per adapter.
+ */
+BOOLEAN NTAPI EtpQueryProcessGpuPresence(
+    _In_ PET_PROCESS_BLOCK Block
+    )
+{
+    ULONG i;
+    PETP_GPU_ADAPTER gpuAdapter;
+    D3DKMT_QUERYSTATISTICS queryStatistics;
+
+    if (!Block->ProcessItem->QueryHandle)
+        return FALSE;
+
+    for (i = 0; i < EtpGpuAdapterList->Count; i++)
+    {
+        gpuAdapter = EtpGpuAdapterList->Items[i];
+
+        memset(&queryStatistics, 0, sizeof(D3DKMT_QUERYSTATISTICS));
+        queryStatistics.Type = D3DKMT_QUERYSTATISTICS_PROCESS;
+        queryStatistics.AdapterLuid = gpuAdapter->AdapterLuid;
+        queryStatistics.hProcess = Block->ProcessItem->QueryHandle;
+
+        if (NT_SUCCESS(D3DKMTQueryStatistics(&queryStatistics)))
+        {
+            if (queryStatistics.QueryResult.ProcessInformation.NodeCount != 0 ||
+                queryStatistics.QueryResult.ProcessInformation.SystemMemory.BytesAllocated != 0 ||
+                queryStatistics.QueryResult.ProcessInformation.SystemMemory.BytesReserved != 0)
+            {
+                return TRUE;
+            }
+        }
+    }
+
+    return FALSE;
+}
+
+/**
+ * Determines whether to query the per-node and per-segment statistics of a process in this
+ * update.
+ *
+ * \param Block The process block.
+ * \param Budget The number of queries that can still be made for idle processes in this update.
+ * \param QueryPresence A function which checks whether a process has any GPU state. This is
+ * normally EtpQueryProcessGpuPresence.
+ */
+BOOLEAN EtpScheduleProcessGpuQuery(
+    _Inout_ PET_PROCESS_BLOCK Block,
+    _Inout_ PULONG Budget,
+    _In_ PETP_QUERY_GPU_PRESENCE QueryPresence
+    )
+{
+    ULONG cost;
+
+    // Processes using the GPU are always queried, and so are processes shown in a GPU property
+    // page since the page graphs every update.
+    if (Block->GpuActive || Block->GpuWatchCount != 0)
+        return TRUE;
+
+    if (Block->GpuQueryCountdown != 0)
+    {
+        Block->GpuQueryCountdown--;
+        return FALSE;
+    }
+
+    // Processes which don't fit in the budget are queried in the next update.
+
+    if (!Block->GpuPresent)
+    {
+        // Most processes never use the GPU, so check that first.
+
+        if (*Budget < EtpGpuAdapterList->Count)
+            return FALSE;
+
+        *Budget -= EtpGpuAdapterList->Count;
+
+        if (!QueryPresence(Block))
+        {
+            Block->GpuQueryCountdown = ETP_GPU_IDLE_QUERY_INTERVAL;
+            return FALSE;
+        }
+
+        Block->GpuPresent = TRUE;
+    }
+
+    cost = EtGpuTotalSegmentCount + EtGpuNodeBitMapBitsSet;
+
+    if (*Budget < cost)
+        return FALSE;
+
+    *Budget -= cost;
+    Block->GpuQueryCountdown = ETP_GPU_IDLE_QUERY_INTERVAL;
+
+    return TRUE;
+}
+
 VOID NTAPI EtGpuProcessesUpdatedCallback(
     _In_opt_ PVOID Parameter,
     _In_opt_ PVOID Context
@@ -559,6 +655,7 @@ VOID NTAPI EtGpuProcessesUpdatedCallback(
     PLIST_ENTRY listEntry;
     FLOAT maxNodeValue = 0;
     PET_PROCESS_BLOCK maxNodeBlock = NULL;
+    ULONG budget;
 
     // Update global statistics.
 
@@ -596,22 +693,41 @@ VOID NTAPI EtGpuProcessesUpdatedCallback(
     // Note: no lock is needed because we only ever modify the list on this same thread.
 
     listEntry = EtProcessBlockListHead.Flink;
+    budget = ETP_GPU_IDLE_QUERY_BUDGET;
 
     while (listEntry != &EtProcessBlockListHead)
     {
         PET_PROCESS_BLOCK block;
 
         block = CONTAINING_RECORD(listEntry, ET_PROCESS_BLOCK, ListEntry);
+        block->GpuElapsedTime += elapsedTime;
 
-        EtpUpdateSegmentInformation(block);
-        EtpUpdateNodeInformation(block);
-
-        if (elapsedTime != 0)
+        // Idle processes keep their last values (zero usage) until they are queried again.
+        if (EtpScheduleProcessGpuQuery(block, &budget, EtpQueryProcessGpuPresence))
         {
-            block->GpuNodeUsage = (FLOAT)(block->GpuRunningTimeDelta.Delta / (elapsedTime * EtGpuNodeBitMapBitsSet));
+            ULONG64 oldDedicatedUsage = block->GpuDedicatedUsage;
+            ULONG64 oldSharedUsage = block->GpuSharedUsage;
+
+            EtpUpdateSegmentInformation(block);
+            EtpUpdateNodeInformation(block);
+
+            // The running time delta covers all updates since the last query.
+            if (block->GpuElapsedTime != 0)
+            {
+                block->GpuNodeUsage = (FLOAT)(block->GpuRunningTimeDelta.Delta / (block->GpuElapsedTime * EtGpuNodeBitMapBitsSet));
+
+                if (block->GpuNodeUsage > 1)
+                    block->GpuNodeUsage = 1;
+            }
+
+            block->GpuElapsedTime = 0;
+            block->GpuActive =
+                block->GpuRunningTimeDelta.Delta != 0 ||
+                block->GpuDedicatedUsage != oldDedicatedUsage ||
+                block->GpuSharedUsage != oldSharedUsage;
 
-            if (block->GpuNodeUsage > 1)
-                block->GpuNodeUsage = 1;
+            if (block->GpuActive)
+                block->GpuPresent = TRUE;
         }
 
         if (maxNodeValue < block->GpuNodeUsage)
@@ -3,10 +3,19 @@
 
 // Macros
 
+// Idle processes are only queried every few updates.
+#define ETP_GPU_IDLE_QUERY_INTERVAL 5
+// Maximum number of statistics queries per update for idle processes.
+#define ETP_GPU_IDLE_QUERY_BUDGET 1024
+
 #define BYTES_NEEDED_FOR_BITS(Bits) ((((Bits) + sizeof(ULONG) * 8 - 1) / 8) & ~(SIZE_T)(sizeof(ULONG) - 1)) // divide round up
 
 // Structures
 
+typedef BOOLEAN (NTAPI *PETP_QUERY_GPU_PRESENCE)(
+    _In_ PET_PROCESS_BLOCK Block
+    );
+
 typedef struct _ETP_GPU_ADAPTER
 {
     LUID AdapterLuid;
@@ -35,6 +44,16 @@ PPH_STRING EtpQueryDeviceDescription(
     _In_ PWSTR DeviceInterface
     );
 
+BOOLEAN NTAPI EtpQueryProcessGpuPresence(
+    _In_ PET_PROCESS_BLOCK Block
+    );
+
+BOOLEAN EtpScheduleProcessGpuQuery(
+    _Inout_ PET_PROCESS_BLOCK Block,
+    _Inout_ PULONG Budget,
+    _In_ PETP_QUERY_GPU_PRESENCE QueryPresence
+    );
+
 VOID NTAPI EtGpuProcessesUpdatedCallback(
     _In_opt_ PVOID Parameter,
     _In_opt_ PVOID Context
@@ -453,6 +453,7 @@ INT_PTR CALLBACK EtpGpuPageDlgProc(
             context->WindowHandle = hwndDlg;
             context->Block = EtGetProcessBlock(processItem);
             context->Enabled = TRUE;
+            _InterlockedIncrement(&context->Block->GpuWatchCount); // query the process every update
             context->GpuGroupBox = GetDlgItem(hwndDlg, IDC_GROUPGPU);
             context->MemGroupBox = GetDlgItem(hwndDlg, IDC_GROUPMEM);
             context->SharedGroupBox = GetDlgItem(hwndDlg, IDC_GROUPSHARED);
@@ -503,6 +504,7 @@ INT_PTR CALLBACK EtpGpuPageDlgProc(
                 DestroyWindow(context->PanelHandle);
 
             PhUnregisterCallback(&PhProcessesUpdatedEvent, &context->ProcessesUpdatedRegistration);
+            _InterlockedDecrement(&context->Block->GpuWatchCount);
             PhFree(context);
 
             PhPropPageDlgProcDestroy(hwndDlg);
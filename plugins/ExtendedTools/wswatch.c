@@ -33,7 +33,9 @@ typedef struct _WS_WATCH_CONTEXT
     HWND ListViewHandle;
     BOOLEAN Enabled;
     BOOLEAN Destroying;
-    PPH_HASHTABLE Hashtable;
+    PPH_HASHTABLE Hashtable; // Faulting PC to entry
+    PPH_LIST Entries; // Sorted by count, in descending order
+    PPH_LIST ChangedEntries;
     HANDLE ProcessHandle;
     PVOID Buffer;
     ULONG BufferSize;
@@ -44,6 +46,15 @@ typedef struct _WS_WATCH_CONTEXT
     PH_QUEUED_LOCK ResultListLock;
 } WS_WATCH_CONTEXT, *PWS_WATCH_CONTEXT;
 
+typedef struct _WS_WATCH_ENTRY
+{
+    PVOID FaultingPc;
+    ULONG Count;
+    ULONG Index; // Index in the list view
+    BOOLEAN Changed;
+    PPH_STRING Symbol;
+} WS_WATCH_ENTRY, *PWS_WATCH_ENTRY;
+
 typedef struct _SYMBOL_LOOKUP_RESULT
 {
     SINGLE_LIST_ENTRY ListEntry;
@@ -224,6 +235,175 @@ static PPH_STRING EtpGetBasicSymbol(
     return symbol;
 }
 
+static int __cdecl EtpWsWatchEntryIndexCompareFunction(
+    _In_ const void *elem1,
+    _In_ const void *elem2
+    )
+{
+    PWS_WATCH_ENTRY entry1 = *(PWS_WATCH_ENTRY *)elem1;
+    PWS_WATCH_ENTRY entry2 = *(PWS_WATCH_ENTRY *)elem2;
+
+    return uintcmp(entry1->Index, entry2->Index);
+}
+
+static BOOLEAN NTAPI EtpWsWatchEntryEqualFunction(
+    _In_ PVOID Entry1,
+    _In_ PVOID Entry2
+    )
+{
+    return (*(PWS_WATCH_ENTRY *)Entry1)->FaultingPc == (*(PWS_WATCH_ENTRY *)Entry2)->FaultingPc;
+}
+
+static ULONG NTAPI EtpWsWatchEntryHashFunction(
+    _In_ PVOID Entry
+    )
+{
+    return PhHashIntPtr((ULONG_PTR)(*(PWS_WATCH_ENTRY *)Entry)->FaultingPc);
+}
+
+static PWS_WATCH_ENTRY EtpLookupWsWatchEntry(
+    _In_ PWS_WATCH_CONTEXT Context,
+    _In_ PVOID FaultingPc
+    )
+{
+    WS_WATCH_ENTRY lookupEntry;
+    PWS_WATCH_ENTRY lookupEntryPtr = &lookupEntry;
+    PWS_WATCH_ENTRY *entryPtr;
+
+    lookupEntry.FaultingPc = FaultingPc;
+    entryPtr = PhFindEntryHashtable(Context->Hashtable, &lookupEntryPtr);
+
+    if (entryPtr)
+        return *entryPtr;
+    else
+        return NULL;
+}
+
+static VOID EtpFreeWsWatchEntries(
+    _In_ PWS_WATCH_CONTEXT Context
+    )
+{
+    ULONG i;
+
+    for (i = 0; i < Context->Entries->Count; i++)
+    {
+        PWS_WATCH_ENTRY entry = Context->Entries->Items[i];
+
+        if (entry->Symbol)
+            PhDereferenceObject(entry->Symbol);
+
+        PhFree(entry);
+    }
+
+    PhDereferenceObject(Context->Entries);
+    PhDereferenceObject(Context->ChangedEntries);
+    PhDereferenceObject(Context->Hashtable);
+}
+
+/**
+ * Adds page faults to the per-instruction counts.
+ *
+ * \param Context The WS watch context.
+ * \param WsWatchInfo An array of page fault records, terminated by a record with a NULL faulting
+ * PC.
+ *
+ * \return TRUE if any counts changed, otherwise FALSE.
+ *
+ * \remarks The list of entries is kept sorted without re-sorting all of it; only the entries that
+ * changed are moved.
+ */
+static BOOLEAN EtpAddWsWatchFaults(
+    _Inout_ PWS_WATCH_CONTEXT Context,
+    _In_ PPROCESS_WS_WATCH_INFORMATION_EX WsWatchInfo
+    )
+{
+    PPH_LIST changedEntries = Context->ChangedEntries;
+    ULONG i;
+
+    // Update the count in the entry for each instruction pointer, or add a new entry if it doesn't
+    // exist. New entries go to the end of the list.
+
+    for (; WsWatchInfo->BasicInfo.FaultingPc; WsWatchInfo++)
+    {
+        PWS_WATCH_ENTRY entry;
+
+        entry = EtpLookupWsWatchEntry(Context, WsWatchInfo->BasicInfo.FaultingPc);
+
+        if (!entry)
+        {
+            entry = PhAllocate(sizeof(WS_WATCH_ENTRY));
+            entry->FaultingPc = WsWatchInfo->BasicInfo.FaultingPc;
+            entry->Count = 0;
+            entry->Index = Context->Entries->Count;
+            entry->Changed = FALSE;
+
+            // Get a basic symbol name (module+offset) and queue a full symbol lookup.
+            entry->Symbol = EtpGetBasicSymbol(Context->SymbolProvider, (ULONG64)entry->FaultingPc);
+            EtpQueueSymbolLookup(Context, entry->FaultingPc);
+
+            PhAddEntryHashtable(Context->Hashtable, &entry);
+            PhAddItemList(Context->Entries, entry);
+        }
+
+        if (!entry->Changed)
+        {
+            entry->Changed = TRUE;
+            PhAddItemList(changedEntries, entry);
+        }
+
+        entry->Count++;
+    }
+
+    if (changedEntries->Count == 0)
+        return FALSE;
+
+    // Counts only ever increase, so changed entries only need to move up. Process them from the top
+    // of the list down; the entries above the one being moved are then already sorted, and we can
+    // binary search for its new position.
+
+    qsort(changedEntries->Items, changedEntries->Count, sizeof(PVOID), EtpWsWatchEntryIndexCompareFunction);
+
+    for (i = 0; i < changedEntries->Count; i++)
+    {
+        PWS_WATCH_ENTRY entry = changedEntries->Items[i];
+        PWS_WATCH_ENTRY *items = (PWS_WATCH_ENTRY *)Context->Entries->Items;
+        ULONG low;
+        ULONG high;
+        ULONG j;
+
+        // Find the first entry with a smaller count.
+
+        low = 0;
+        high = entry->Index;
+
+        while (low < high)
+        {
+            ULONG mid = low + (high - low) / 2;
+
+            if (items[mid]->Count < entry->Count)
+                high = mid;
+            else
+                low = mid + 1;
+        }
+
+        if (low != entry->Index)
+        {
+            high = entry->Index;
+            memmove(&items[low + 1], &items[low], (high - low) * sizeof(PVOID));
+            items[low] = entry;
+
+            for (j = low; j <= high; j++)
+                items[j]->Index = j;
+        }
+
+        entry->Changed = FALSE;
+    }
+
+    PhClearList(changedEntries);
+
+    return TRUE;
+}
+
 static VOID EtpProcessSymbolLookupResults(
     _In_ HWND hwndDlg,
     _In_ PWS_WATCH_CONTEXT Context
@@ -237,22 +417,25 @@ static VOID EtpProcessSymbolLookupResults(
     Context->ResultListHead.Next = NULL;
     PhReleaseQueuedLockExclusive(&Context->ResultListLock);
 
-    // Update the list view with the results.
+    // Update the entries with the results.
     while (listEntry)
     {
         PSYMBOL_LOOKUP_RESULT result;
+        PWS_WATCH_ENTRY entry;
 
         result = CONTAINING_RECORD(listEntry, SYMBOL_LOOKUP_RESULT, ListEntry);
         listEntry = listEntry->Next;
 
-        PhSetListViewSubItem(
-            Context->ListViewHandle,
-            PhFindListViewItemByParam(Context->ListViewHandle, -1, result->Address),
-            0,
-            result->Symbol->Buffer
-            );
+        if (entry = EtpLookupWsWatchEntry(Context, result->Address))
+        {
+            PhMoveReference(&entry->Symbol, result->Symbol);
+            ListView_RedrawItems(Context->ListViewHandle, entry->Index, entry->Index);
+        }
+        else
+        {
+            PhDereferenceObject(result->Symbol);
+        }
 
-        PhDereferenceObject(result->Symbol);
         PhFree(result);
     }
 }
@@ -265,7 +448,6 @@ static BOOLEAN EtpUpdateWsWatch(
     NTSTATUS status;
     BOOLEAN result;
     ULONG returnLength;
-    PPROCESS_WS_WATCH_INFORMATION_EX wsWatchInfo;
 
     // Query WS watch information.
 
@@ -315,64 +497,18 @@ static BOOLEAN EtpUpdateWsWatch(
         goto SkipBuffer;
     }
 
-    // Update the hashtable and list view.
+    // Update the counts and the list view.
 
-    ExtendedListView_SetRedraw(Context->ListViewHandle, FALSE);
-
-    wsWatchInfo = Context->Buffer;
-
-    while (wsWatchInfo->BasicInfo.FaultingPc)
+    if (EtpAddWsWatchFaults(Context, Context->Buffer))
     {
-        PVOID *entry;
-        WCHAR buffer[PH_INT32_STR_LEN_1];
-        INT lvItemIndex;
-        ULONG newCount;
-
-        // Update the count in the entry for this instruction pointer, or add a new entry if it doesn't exist.
-
-        entry = PhFindItemSimpleHashtable(Context->Hashtable, wsWatchInfo->BasicInfo.FaultingPc);
-
-        if (entry)
-        {
-            newCount = PtrToUlong(*entry) + 1;
-            *entry = UlongToPtr(newCount);
-            lvItemIndex = PhFindListViewItemByParam(Context->ListViewHandle, -1, wsWatchInfo->BasicInfo.FaultingPc);
-        }
-        else
-        {
-            PPH_STRING basicSymbol;
-
-            newCount = 1;
-            PhAddItemSimpleHashtable(Context->Hashtable, wsWatchInfo->BasicInfo.FaultingPc, UlongToPtr(1));
-
-            // Get a basic symbol name (module+offset).
-            basicSymbol = EtpGetBasicSymbol(Context->SymbolProvider, (ULONG64)wsWatchInfo->BasicInfo.FaultingPc);
-
-            lvItemIndex = PhAddListViewItem(Context->ListViewHandle, MAXINT, basicSymbol->Buffer, wsWatchInfo->BasicInfo.FaultingPc);
-            PhDereferenceObject(basicSymbol);
-
-            // Queue a full symbol lookup.
-            EtpQueueSymbolLookup(Context, wsWatchInfo->BasicInfo.FaultingPc);
-        }
-
-        // Update the count in the list view item.
-        PhPrintUInt32(buffer, newCount);
-        PhSetListViewSubItem(
-            Context->ListViewHandle,
-            lvItemIndex,
-            1,
-            buffer
-            );
-
-        wsWatchInfo++;
+        ListView_SetItemCountEx(Context->ListViewHandle, Context->Entries->Count, LVSICF_NOSCROLL);
+        InvalidateRect(Context->ListViewHandle, NULL, FALSE);
     }
 
-    ExtendedListView_SetRedraw(Context->ListViewHandle, TRUE);
     result = TRUE;
 
 SkipBuffer:
     EtpProcessSymbolLookupResults(hwndDlg, Context);
-    ExtendedListView_SortItems(Context->ListViewHandle);
 
     return result;
 }
@@ -439,10 +575,15 @@ INT_PTR CALLBACK EtpWsWatchDlgProc(
             PhSetControlTheme(lvHandle, L"explorer");
             PhAddListViewColumn(lvHandle, 0, 0, 0, LVCFMT_LEFT, 340, L"Instruction");
             PhAddListViewColumn(lvHandle, 1, 1, 1, LVCFMT_LEFT, 80, L"Count");
-            PhSetExtendedListView(lvHandle);
-            ExtendedListView_SetSort(lvHandle, 1, DescendingSortOrder);
 
-            context->Hashtable = PhCreateSimpleHashtable(64);
+            context->Hashtable = PhCreateHashtable(
+                sizeof(PWS_WATCH_ENTRY),
+                EtpWsWatchEntryEqualFunction,
+                EtpWsWatchEntryHashFunction,
+                64
+                );
+            context->Entries = PhCreateList(64);
+            context->ChangedEntries = PhCreateList(64);
             context->BufferSize = 0x2000;
             context->Buffer = PhAllocate(context->BufferSize);
 
@@ -496,7 +637,7 @@ INT_PTR CALLBACK EtpWsWatchDlgProc(
         {
             context->Destroying = TRUE;
 
-            PhDereferenceObject(context->Hashtable);
+            EtpFreeWsWatchEntries(context);
 
             if (context->Buffer)
             {
@@ -550,7 +691,48 @@ INT_PTR CALLBACK EtpWsWatchDlgProc(
         break;
     case WM_NOTIFY:
         {
+            LPNMHDR header = (LPNMHDR)lParam;
+
             PhHandleListViewNotifyForCopy(lParam, context->ListViewHandle);
+
+            switch (header->code)
+            {
+            case LVN_GETDISPINFO:
+                {
+                    NMLVDISPINFO *dispInfo = (NMLVDISPINFO *)header;
+
+                    if ((dispInfo->item.mask & LVIF_TEXT) && (ULONG)dispInfo->item.iItem < context->Entries->Count)
+                    {
+                        PWS_WATCH_ENTRY entry = context->Entries->Items[dispInfo->item.iItem];
+
+                        switch (dispInfo->item.iSubItem)
+                        {
+                        case 0:
+                            wcsncpy_s(
+                                dispInfo->item.pszText,
+                                dispInfo->item.cchTextMax,
+                                entry->Symbol->Buffer,
+                                _TRUNCATE
+                                );
+                            break;
+                        case 1:
+                            {
+                                WCHAR countString[PH_INT32_STR_LEN_1];
+
+                                PhPrintUInt32(countString, entry->Count);
+                                wcsncpy_s(
+                                    dispInfo->item.pszText,
+                                    dispInfo->item.cchTextMax,
+                                    countString,
+                                    _TRUNCATE
+                                    );
+                            }
+                            break;
+                        }
+                    }
+                }
+                break;
+            }
         }
         break;
     case WM_TIMER:
@@ -33,10 +33,67 @@ ULONG NTAPI ObjectDbHashFunction(
     _In_ PVOID Entry
     );
 
+// The database is stored as a snapshot of all objects followed by an append-only journal of
+// changes made since the snapshot was written. Both files contain a DB_FILE_HEADER followed by a
+// sequence of DB_RECORDs. The journal sequence number is incremented each time the database is
+// compacted, and journals alternate between two files so that the previous journal survives until
+// the new snapshot has been written. The XML file is only used for import and export, and is only
+// rewritten on exit if there were changes since it was last written.
+
+#define DB_SNAPSHOT_MAGIC ('snDU')
+#define DB_JOURNAL_MAGIC ('njDU')
+#define DB_FILE_VERSION 1
+
+#define DB_SNAPSHOT_XML_CURRENT 0x1 // the XML file contains the same objects as the snapshot
+
+#define DB_RECORD_PUT 1
+#define DB_RECORD_DELETE 2
+
+#define DB_JOURNAL_COMPACT_THRESHOLD (1024 * 1024)
+
+typedef struct _DB_FILE_HEADER
+{
+    ULONG Magic;
+    ULONG Version;
+    ULONG Sequence;
+    ULONG Flags;
+    LARGE_INTEGER XmlLastWriteTime;
+} DB_FILE_HEADER, *PDB_FILE_HEADER;
+
+typedef struct _DB_RECORD
+{
+    ULONG Length; // including the header and the strings
+    ULONG Checksum; // CRC32 of everything after this field
+    UCHAR Type;
+    BOOLEAN Collapse;
+    USHORT Reserved;
+    ULONG Tag;
+    ULONG PriorityClass;
+    ULONG IoPriorityPlusOne;
+    COLORREF BackColor;
+    ULONG AffinityMask;
+    ULONG NameLength;
+    ULONG CommentLength;
+    // WCHAR Name[NameLength / sizeof(WCHAR)];
+    // WCHAR Comment[CommentLength / sizeof(WCHAR)];
+} DB_RECORD, *PDB_RECORD;
+
 PPH_HASHTABLE ObjectDb;
 PH_QUEUED_LOCK ObjectDbLock = PH_QUEUED_LOCK_INIT;
 PPH_STRING ObjectDbPath;
 
+LIST_ENTRY ObjectDbDirtyListHead;
+PH_BYTES_BUILDER ObjectDbPendingRecords;
+PH_QUEUED_LOCK ObjectDbJournalLock = PH_QUEUED_LOCK_INIT;
+PH_QUEUED_LOCK ObjectDbCompactLock = PH_QUEUED_LOCK_INIT;
+HANDLE ObjectDbJournalHandle;
+ULONG ObjectDbJournalSequence;
+ULONG64 ObjectDbJournalLength;
+ULONG ObjectDbSnapshotSequence;
+LARGE_INTEGER ObjectDbXmlLastWriteTime;
+BOOLEAN ObjectDbXmlStale;
+BOOLEAN ObjectDbCompactQueued;
+
 VOID InitializeDb(
     VOID
     )
@@ -47,6 +104,9 @@ VOID InitializeDb(
         ObjectDbHashFunction,
         64
         );
+
+    InitializeListHead(&ObjectDbDirtyListHead);
+    PhInitializeBytesBuilder(&ObjectDbPendingRecords, 256);
 }
 
 BOOLEAN NTAPI ObjectDbEqualFunction(
@@ -111,6 +171,97 @@ PDB_OBJECT FindDbObject(
         return NULL;
 }
 
+static VOID AppendDbRecord(
+    _Inout_ PPH_BYTES_BUILDER BytesBuilder,
+    _In_ UCHAR Type,
+    _In_ PDB_OBJECT Object
+    )
+{
+    DB_RECORD record;
+    SIZE_T offset;
+    PDB_RECORD recordInBuffer;
+
+    memset(&record, 0, sizeof(DB_RECORD));
+    record.Type = Type;
+    record.Tag = Object->Tag;
+    record.NameLength = (ULONG)Object->Name->Length;
+
+    if (Type == DB_RECORD_PUT)
+    {
+        record.Collapse = Object->Collapse;
+        record.PriorityClass = Object->PriorityClass;
+        record.IoPriorityPlusOne = Object->IoPriorityPlusOne;
+        record.BackColor = Object->BackColor;
+        record.AffinityMask = Object->AffinityMask;
+        record.CommentLength = (ULONG)Object->Comment->Length;
+    }
+
+    record.Length = sizeof(DB_RECORD) + record.NameLength + record.CommentLength;
+
+    PhAppendBytesBuilderEx(BytesBuilder, &record, sizeof(DB_RECORD), sizeof(ULONG), &offset);
+    PhAppendBytesBuilderEx(BytesBuilder, Object->Name->Buffer, record.NameLength, 0, NULL);
+
+    if (record.CommentLength != 0)
+        PhAppendBytesBuilderEx(BytesBuilder, Object->Comment->Buffer, record.CommentLength, 0, NULL);
+
+    // Pad to a 4-byte boundary so the next record is aligned.
+    if (record.Length & 3)
+    {
+        ULONG padding = 0;
+
+        PhAppendBytesBuilderEx(BytesBuilder, &padding, 4 - (record.Length & 3), 0, NULL);
+        record.Length = (record.Length + 3) & ~3;
+    }
+
+    recordInBuffer = PhOffsetBytesBuilder(BytesBuilder, offset);
+    recordInBuffer->Length = record.Length;
+    recordInBuffer->Checksum = PhCrc32(
+        0,
+        (PCHAR)recordInBuffer + FIELD_OFFSET(DB_RECORD, Type),
+        record.Length - FIELD_OFFSET(DB_RECORD, Type)
+        );
+}
+
+/**
+ * Records a change to an object. This must be called with the database locked,
+ * whenever fields of an existing object are modified directly.
+ */
+VOID MarkDbObjectDirty(
+    _In_ PDB_OBJECT Object
+    )
+{
+    if (!Object->Dirty)
+    {
+        InsertTailList(&ObjectDbDirtyListHead, &Object->DirtyListEntry);
+        Object->Dirty = TRUE;
+    }
+}
+
+static VOID ClearDbObjectDirty(
+    _In_ PDB_OBJECT Object
+    )
+{
+    if (Object->Dirty)
+    {
+        RemoveEntryList(&Object->DirtyListEntry);
+        Object->Dirty = FALSE;
+    }
+}
+
+static VOID ResetDbChanges(
+    VOID
+    )
+{
+    while (!IsListEmpty(&ObjectDbDirtyListHead))
+    {
+        PDB_OBJECT object = CONTAINING_RECORD(ObjectDbDirtyListHead.Flink, DB_OBJECT, DirtyListEntry);
+
+        ClearDbObjectDirty(object);
+    }
+
+    ObjectDbPendingRecords.Bytes->Length = 0;
+}
+
 PDB_OBJECT CreateDbObject(
     _In_ ULONG Tag,
     _In_ PPH_STRINGREF Name,
@@ -148,6 +299,8 @@ PDB_OBJECT CreateDbObject(
             PhSwapReference(&object->Comment, Comment);
     }
 
+    MarkDbObjectDirty(object);
+
     return object;
 }
 
@@ -155,6 +308,9 @@ VOID DeleteDbObject(
     _In_ PDB_OBJECT Object
     )
 {
+    ClearDbObjectDirty(Object);
+    AppendDbRecord(&ObjectDbPendingRecords, DB_RECORD_DELETE, Object);
+
     PhRemoveEntryHashtable(ObjectDb, &Object);
 
     PhDereferenceObject(Object->Name);
@@ -183,7 +339,19 @@ PPH_STRING GetOpaqueXmlNodeText(
     }
 }
 
-NTSTATUS LoadDb(
+static VOID UpdateDbXmlLastWriteTime(
+    VOID
+    )
+{
+    FILE_NETWORK_OPEN_INFORMATION networkOpenInfo;
+
+    if (NT_SUCCESS(PhQueryFullAttributesFileWin32(ObjectDbPath->Buffer, &networkOpenInfo)))
+        ObjectDbXmlLastWriteTime = networkOpenInfo.LastWriteTime;
+    else
+        ObjectDbXmlLastWriteTime.QuadPart = 0;
+}
+
+NTSTATUS ImportDb(
     VOID
     )
 {
@@ -210,6 +378,7 @@ NTSTATUS LoadDb(
     {
         // A blank file is OK. There are no objects to load.
         NtClose(fileHandle);
+        UpdateDbXmlLastWriteTime();
         return status;
     }
 
@@ -323,6 +492,7 @@ NTSTATUS LoadDb(
     UnlockDb();
 
     mxmlDelete(topNode);
+    UpdateDbXmlLastWriteTime();
 
     return STATUS_SUCCESS;
 }
@@ -395,7 +565,23 @@ PPH_STRING UInt64ToBase10String(
     return PH_AUTO(PhIntegerToString64(Integer, 10, FALSE));
 }
 
-NTSTATUS SaveDb(
+static VOID CreateDbDirectory(
+    VOID
+    )
+{
+    PPH_STRING fullPath;
+    ULONG indexOfFileName;
+
+    if (fullPath = PhGetFullPath(ObjectDbPath->Buffer, &indexOfFileName))
+    {
+        if (indexOfFileName != -1)
+            SHCreateDirectoryEx(NULL, PH_AUTO_T(PH_STRING, PhSubstring(fullPath, 0, indexOfFileName))->Buffer, NULL);
+
+        PhDereferenceObject(fullPath);
+    }
+}
+
+NTSTATUS ExportDb(
     VOID
     )
 {
@@ -412,6 +598,8 @@ NTSTATUS SaveDb(
 
     LockDb();
 
+    ObjectDbXmlStale = FALSE;
+
     while (PhEnumHashtable(ObjectDb, (PVOID*)&object, &enumerationKey))
     {
         CreateObjectElement(
@@ -431,38 +619,652 @@ NTSTATUS SaveDb(
     UnlockDb();
 
     // Create the directory if it does not exist.
+    CreateDbDirectory();
+
+    PhDeleteAutoPool(&autoPool);
+
+    status = PhCreateFileWin32(
+        &fileHandle,
+        ObjectDbPath->Buffer,
+        FILE_GENERIC_WRITE,
+        0,
+        FILE_SHARE_READ,
+        FILE_OVERWRITE_IF,
+        FILE_NON_DIRECTORY_FILE | FILE_SYNCHRONOUS_IO_NONALERT
+        );
+
+    if (NT_SUCCESS(status))
+    {
+        if (mxmlSaveFd(topNode, fileHandle, MxmlSaveCallback) == -1)
+            status = STATUS_UNSUCCESSFUL;
+
+        NtClose(fileHandle);
+    }
+
+    mxmlDelete(topNode);
+
+    if (!NT_SUCCESS(status))
     {
-        PPH_STRING fullPath;
-        ULONG indexOfFileName;
+        LockDb();
+        ObjectDbXmlStale = TRUE;
+        UnlockDb();
 
-        if (fullPath = PH_AUTO(PhGetFullPath(ObjectDbPath->Buffer, &indexOfFileName)))
+        return status;
+    }
+
+    UpdateDbXmlLastWriteTime();
+
+    return STATUS_SUCCESS;
+}
+
+static PPH_STRING GetDbFileName(
+    _In_ PWSTR Suffix
+    )
+{
+    PH_STRINGREF suffix;
+
+    PhInitializeStringRefLongHint(&suffix, Suffix);
+
+    return PhConcatStringRef2(&ObjectDbPath->sr, &suffix);
+}
+
+static PPH_STRING GetDbJournalFileName(
+    _In_ ULONG Sequence
+    )
+{
+    return GetDbFileName((Sequence & 1) ? L".journal1" : L".journal0");
+}
+
+static NTSTATUS ReadDbFile(
+    _In_ PWSTR FileName,
+    _In_ ULONG Magic,
+    _Out_ PDB_FILE_HEADER Header,
+    _Out_ PVOID *Records,
+    _Out_ PULONG RecordsLength
+    )
+{
+    NTSTATUS status;
+    HANDLE fileHandle;
+    LARGE_INTEGER fileSize;
+    IO_STATUS_BLOCK isb;
+    PVOID buffer;
+
+    status = PhCreateFileWin32(
+        &fileHandle,
+        FileName,
+        FILE_GENERIC_READ,
+        0,
+        FILE_SHARE_READ | FILE_SHARE_DELETE,
+        FILE_OPEN,
+        FILE_NON_DIRECTORY_FILE | FILE_SYNCHRONOUS_IO_NONALERT
+        );
+
+    if (!NT_SUCCESS(status))
+        return status;
+
+    if (!NT_SUCCESS(status = PhGetFileSize(fileHandle, &fileSize)))
+        goto CleanupExit;
+
+    if (fileSize.QuadPart < sizeof(DB_FILE_HEADER) || fileSize.QuadPart > 0x40000000)
+    {
+        status = STATUS_FILE_CORRUPT_ERROR;
+        goto CleanupExit;
+    }
+
+    buffer = PhAllocate((SIZE_T)fileSize.QuadPart);
+    status = NtReadFile(fileHandle, NULL, NULL, NULL, &isb, buffer, (ULONG)fileSize.QuadPart, NULL, NULL);
+
+    if (NT_SUCCESS(status) && isb.Information != (ULONG_PTR)fileSize.QuadPart)
+        status = STATUS_FILE_CORRUPT_ERROR;
+
+    if (NT_SUCCESS(status))
+    {
+        memcpy(Header, buffer, sizeof(DB_FILE_HEADER));
+
+        if (Header->Magic != Magic || Header->Version != DB_FILE_VERSION)
+            status = STATUS_FILE_CORRUPT_ERROR;
+    }
+
+    if (NT_SUCCESS(status))
+    {
+        *RecordsLength = (ULONG)fileSize.QuadPart - sizeof(DB_FILE_HEADER);
+        *Records = buffer;
+        memmove(buffer, (PCHAR)buffer + sizeof(DB_FILE_HEADER), *RecordsLength);
+    }
+    else
+    {
+        PhFree(buffer);
+    }
+
+CleanupExit:
+    NtClose(fileHandle);
+
+    return status;
+}
+
+/**
+ * Applies records to the database. The database must be locked.
+ *
+ * \return The number of bytes of valid records. Processing stops at the
+ * first record which is truncated or damaged, e.g. by a crash during a write.
+ */
+static ULONG ApplyDbRecords(
+    _In_reads_bytes_(Length) PVOID Records,
+    _In_ ULONG Length
+    )
+{
+    ULONG offset = 0;
+
+    while (Length - offset >= sizeof(DB_RECORD))
+    {
+        PDB_RECORD record = (PDB_RECORD)((PCHAR)Records + offset);
+        PH_STRINGREF name;
+        PDB_OBJECT object;
+
+        if (record->Length < sizeof(DB_RECORD) || record->Length > Length - offset || (record->Length & 3))
+            break;
+        if ((ULONG64)record->NameLength + record->CommentLength > record->Length - sizeof(DB_RECORD))
+            break;
+        if ((record->NameLength | record->CommentLength) & 1)
+            break;
+        if (PhCrc32(0, (PCHAR)record + FIELD_OFFSET(DB_RECORD, Type), record->Length - FIELD_OFFSET(DB_RECORD, Type)) != record->Checksum)
+            break;
+
+        name.Buffer = (PWCHAR)PTR_ADD_OFFSET(record, sizeof(DB_RECORD));
+        name.Length = record->NameLength;
+
+        if (record->Type == DB_RECORD_PUT)
         {
-            if (indexOfFileName != -1)
-                SHCreateDirectoryEx(NULL, PhaSubstring(fullPath, 0, indexOfFileName)->Buffer, NULL);
+            PPH_STRING comment;
+
+            comment = PhCreateStringEx((PWCHAR)PTR_ADD_OFFSET(name.Buffer, name.Length), record->CommentLength);
+            object = CreateDbObject(record->Tag, &name, comment);
+            PhDereferenceObject(comment);
+
+            object->PriorityClass = record->PriorityClass;
+            object->IoPriorityPlusOne = record->IoPriorityPlusOne;
+            object->BackColor = record->BackColor;
+            object->Collapse = record->Collapse;
+            object->AffinityMask = record->AffinityMask;
+        }
+        else if (record->Type == DB_RECORD_DELETE)
+        {
+            if (object = FindDbObject(record->Tag, &name))
+                DeleteDbObject(object);
         }
+
+        offset += record->Length;
     }
 
-    PhDeleteAutoPool(&autoPool);
+    return offset;
+}
+
+static NTSTATUS WriteDbFile(
+    _In_ HANDLE FileHandle,
+    _In_ ULONG64 Offset,
+    _In_reads_bytes_(Length) PVOID Buffer,
+    _In_ ULONG Length
+    )
+{
+    IO_STATUS_BLOCK isb;
+    LARGE_INTEGER offset;
+
+    offset.QuadPart = Offset;
 
+    return NtWriteFile(FileHandle, NULL, NULL, NULL, &isb, Buffer, Length, &offset, NULL);
+}
+
+static NTSTATUS CreateDbJournal(
+    _In_ ULONG Sequence
+    )
+{
+    NTSTATUS status;
+    HANDLE fileHandle;
+    PPH_STRING fileName;
+    DB_FILE_HEADER header;
+    IO_STATUS_BLOCK isb;
+
+    fileName = GetDbJournalFileName(Sequence);
     status = PhCreateFileWin32(
         &fileHandle,
-        ObjectDbPath->Buffer,
-        FILE_GENERIC_WRITE,
+        fileName->Buffer,
+        FILE_GENERIC_READ | FILE_GENERIC_WRITE,
         0,
         FILE_SHARE_READ,
         FILE_OVERWRITE_IF,
         FILE_NON_DIRECTORY_FILE | FILE_SYNCHRONOUS_IO_NONALERT
         );
+    PhDereferenceObject(fileName);
 
     if (!NT_SUCCESS(status))
+        return status;
+
+    memset(&header, 0, sizeof(DB_FILE_HEADER));
+    header.Magic = DB_JOURNAL_MAGIC;
+    header.Version = DB_FILE_VERSION;
+    header.Sequence = Sequence;
+
+    if (!NT_SUCCESS(status = WriteDbFile(fileHandle, 0, &header, sizeof(DB_FILE_HEADER))) ||
+        !NT_SUCCESS(status = NtFlushBuffersFile(fileHandle, &isb)))
     {
-        mxmlDelete(topNode);
+        NtClose(fileHandle);
         return status;
     }
 
-    mxmlSaveFd(topNode, fileHandle, MxmlSaveCallback);
-    mxmlDelete(topNode);
-    NtClose(fileHandle);
+    if (ObjectDbJournalHandle)
+        NtClose(ObjectDbJournalHandle);
+
+    ObjectDbJournalHandle = fileHandle;
+    ObjectDbJournalSequence = Sequence;
+    ObjectDbJournalLength = sizeof(DB_FILE_HEADER);
+
+    return status;
+}
+
+static NTSTATUS OpenDbJournal(
+    _In_ ULONG Sequence,
+    _In_ ULONG64 ValidLength
+    )
+{
+    NTSTATUS status;
+    HANDLE fileHandle;
+    PPH_STRING fileName;
+    LARGE_INTEGER fileSize;
+
+    fileName = GetDbJournalFileName(Sequence);
+    status = PhCreateFileWin32(
+        &fileHandle,
+        fileName->Buffer,
+        FILE_GENERIC_READ | FILE_GENERIC_WRITE,
+        0,
+        FILE_SHARE_READ,
+        FILE_OPEN,
+        FILE_NON_DIRECTORY_FILE | FILE_SYNCHRONOUS_IO_NONALERT
+        );
+    PhDereferenceObject(fileName);
+
+    if (!NT_SUCCESS(status))
+        return status;
+
+    // Discard any partially written record at the end of the journal.
+    fileSize.QuadPart = ValidLength;
+
+    if (!NT_SUCCESS(status = PhSetFileSize(fileHandle, &fileSize)))
+    {
+        NtClose(fileHandle);
+        return status;
+    }
+
+    if (ObjectDbJournalHandle)
+        NtClose(ObjectDbJournalHandle);
+
+    ObjectDbJournalHandle = fileHandle;
+    ObjectDbJournalSequence = Sequence;
+    ObjectDbJournalLength = ValidLength;
+
+    return status;
+}
+
+/**
+ * Writes pending changes to the journal. The journal lock must be held.
+ */
+static NTSTATUS FlushDbChanges(
+    VOID
+    )
+{
+    NTSTATUS status;
+    PH_BYTES_BUILDER records;
+    IO_STATUS_BLOCK isb;
+
+    LockDb();
+
+    records = ObjectDbPendingRecords;
+    PhInitializeBytesBuilder(&ObjectDbPendingRecords, 256);
+
+    while (!IsListEmpty(&ObjectDbDirtyListHead))
+    {
+        PDB_OBJECT object = CONTAINING_RECORD(ObjectDbDirtyListHead.Flink, DB_OBJECT, DirtyListEntry);
+
+        AppendDbRecord(&records, DB_RECORD_PUT, object);
+        ClearDbObjectDirty(object);
+    }
+
+    if (records.Bytes->Length != 0)
+        ObjectDbXmlStale = TRUE;
+
+    UnlockDb();
+
+    if (records.Bytes->Length == 0)
+    {
+        PhDeleteBytesBuilder(&records);
+        return STATUS_SUCCESS;
+    }
+
+    if (ObjectDbJournalHandle)
+    {
+        status = WriteDbFile(ObjectDbJournalHandle, ObjectDbJournalLength, records.Bytes->Buffer, (ULONG)records.Bytes->Length);
+
+        if (NT_SUCCESS(status))
+            status = NtFlushBuffersFile(ObjectDbJournalHandle, &isb);
+    }
+    else
+    {
+        status = STATUS_INVALID_HANDLE;
+    }
+
+    if (NT_SUCCESS(status))
+    {
+        ObjectDbJournalLength += records.Bytes->Length;
+        PhDeleteBytesBuilder(&records);
+    }
+    else
+    {
+        // Keep the records so they can be written later. Any records added in the meantime
+        // must stay after them.
+
+        LockDb();
+        PhAppendBytesBuilderEx(&records, ObjectDbPendingRecords.Bytes->Buffer, ObjectDbPendingRecords.Bytes->Length, 0, NULL);
+        PhDeleteBytesBuilder(&ObjectDbPendingRecords);
+        ObjectDbPendingRecords = records;
+        UnlockDb();
+    }
+
+    return status;
+}
+
+static NTSTATUS WriteDbSnapshot(
+    _In_reads_bytes_(Length) PVOID Buffer,
+    _In_ ULONG Length
+    )
+{
+    NTSTATUS status;
+    HANDLE fileHandle;
+    PPH_STRING snapshotFileName;
+    PPH_STRING tempFileName;
+    IO_STATUS_BLOCK isb;
+
+    snapshotFileName = GetDbFileName(L".snapshot");
+    tempFileName = GetDbFileName(L".snapshot.tmp");
+
+    status = PhCreateFileWin32(
+        &fileHandle,
+        tempFileName->Buffer,
+        FILE_GENERIC_WRITE,
+        0,
+        FILE_SHARE_READ,
+        FILE_OVERWRITE_IF,
+        FILE_NON_DIRECTORY_FILE | FILE_SYNCHRONOUS_IO_NONALERT
+        );
+
+    if (NT_SUCCESS(status))
+    {
+        if (NT_SUCCESS(status = WriteDbFile(fileHandle, 0, Buffer, Length)))
+            status = NtFlushBuffersFile(fileHandle, &isb);
+
+        NtClose(fileHandle);
+
+        // Replace the old snapshot atomically.
+        if (NT_SUCCESS(status) && !MoveFileEx(tempFileName->Buffer, snapshotFileName->Buffer, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH))
+            status = PhDosErrorToNtStatus(GetLastError());
+
+        if (!NT_SUCCESS(status))
+            PhDeleteFileWin32(tempFileName->Buffer);
+    }
+
+    PhDereferenceObject(tempFileName);
+    PhDereferenceObject(snapshotFileName);
+
+    return status;
+}
+
+/**
+ * Writes all objects to a new snapshot and starts a new journal.
+ */
+NTSTATUS CompactDb(
+    VOID
+    )
+{
+    NTSTATUS status;
+    PH_BYTES_BUILDER snapshot;
+    DB_FILE_HEADER header;
+    ULONG enumerationKey = 0;
+    PDB_OBJECT *object;
+    ULONG oldSequence;
+    ULONG sequence;
+    BOOLEAN rotate;
+
+    PhAcquireQueuedLockExclusive(&ObjectDbCompactLock);
+    PhAcquireQueuedLockExclusive(&ObjectDbJournalLock);
+
+    ObjectDbCompactQueued = FALSE;
+
+    // Every change must be in the journal before the objects are captured. Replaying the
+    // journal over the new snapshot is then harmless.
+    FlushDbChanges();
+
+    memset(&header, 0, sizeof(DB_FILE_HEADER));
+    header.Magic = DB_SNAPSHOT_MAGIC;
+    header.Version = DB_FILE_VERSION;
+    header.XmlLastWriteTime = ObjectDbXmlLastWriteTime;
+
+    PhInitializeBytesBuilder(&snapshot, sizeof(DB_FILE_HEADER) + GetNumberOfDbObjects() * (sizeof(DB_RECORD) + 64));
+    PhAppendBytesBuilderEx(&snapshot, &header, sizeof(DB_FILE_HEADER), 0, NULL);
+
+    LockDb();
+
+    while (PhEnumHashtable(ObjectDb, (PVOID *)&object, &enumerationKey))
+        AppendDbRecord(&snapshot, DB_RECORD_PUT, *object);
+
+    if (!ObjectDbXmlStale && IsListEmpty(&ObjectDbDirtyListHead) && ObjectDbPendingRecords.Bytes->Length == 0)
+        ((PDB_FILE_HEADER)snapshot.Bytes->Buffer)->Flags |= DB_SNAPSHOT_XML_CURRENT;
+
+    UnlockDb();
+
+    // Start a new journal so that changes can be written while the snapshot is being
+    // written. The previous journal is kept until the snapshot is in place. If the snapshot
+    // on disk is older than the current journal (e.g. the last compaction failed), the
+    // current journal is still needed, so we keep using it and block writers instead.
+
+    oldSequence = ObjectDbJournalSequence;
+    sequence = oldSequence;
+    rotate = FALSE;
+
+    if (ObjectDbJournalHandle && ObjectDbSnapshotSequence == oldSequence)
+    {
+        if (NT_SUCCESS(CreateDbJournal(oldSequence + 1)))
+        {
+            sequence = oldSequence + 1;
+            rotate = TRUE;
+            PhReleaseQueuedLockExclusive(&ObjectDbJournalLock);
+        }
+    }
+
+    ((PDB_FILE_HEADER)snapshot.Bytes->Buffer)->Sequence = sequence;
+    status = WriteDbSnapshot(snapshot.Bytes->Buffer, (ULONG)snapshot.Bytes->Length);
+
+    if (!rotate)
+        PhReleaseQueuedLockExclusive(&ObjectDbJournalLock);
+
+    if (NT_SUCCESS(status))
+    {
+        ObjectDbSnapshotSequence = sequence;
+
+        if (rotate)
+        {
+            PPH_STRING fileName;
+
+            fileName = GetDbJournalFileName(oldSequence);
+            PhDeleteFileWin32(fileName->Buffer);
+            PhDereferenceObject(fileName);
+        }
+    }
+
+    PhDeleteBytesBuilder(&snapshot);
+
+    PhReleaseQueuedLockExclusive(&ObjectDbCompactLock);
+
+    return status;
+}
+
+static NTSTATUS NTAPI CompactDbWorkItem(
+    _In_ PVOID Parameter
+    )
+{
+    CompactDb();
 
     return STATUS_SUCCESS;
 }
+
+NTSTATUS LoadDb(
+    VOID
+    )
+{
+    NTSTATUS status;
+    PPH_STRING fileName;
+    DB_FILE_HEADER header;
+    PVOID records;
+    ULONG recordsLength;
+    BOOLEAN snapshotLoaded = FALSE;
+
+    CreateDbDirectory();
+
+    fileName = GetDbFileName(L".snapshot");
+    status = ReadDbFile(fileName->Buffer, DB_SNAPSHOT_MAGIC, &header, &records, &recordsLength);
+    PhDereferenceObject(fileName);
+
+    if (NT_SUCCESS(status))
+    {
+        FILE_NETWORK_OPEN_INFORMATION networkOpenInfo;
+
+        // If the XML file was modified outside of Process Hacker, it takes precedence.
+        if (NT_SUCCESS(PhQueryFullAttributesFileWin32(ObjectDbPath->Buffer, &networkOpenInfo)) &&
+            networkOpenInfo.LastWriteTime.QuadPart != header.XmlLastWriteTime.QuadPart)
+        {
+            PhFree(records);
+        }
+        else
+        {
+            snapshotLoaded = TRUE;
+        }
+    }
+
+    if (snapshotLoaded)
+    {
+        DB_FILE_HEADER journalHeader;
+        ULONG sequence = header.Sequence;
+        ULONG64 journalLength = 0;
+        ULONG i;
+
+        LockDb();
+
+        ApplyDbRecords(records, recordsLength);
+        PhFree(records);
+
+        ObjectDbSnapshotSequence = header.Sequence;
+        ObjectDbXmlLastWriteTime = header.XmlLastWriteTime;
+
+        // Replay the journal that follows the snapshot, as well as the next journal in case
+        // a compaction was interrupted before the new snapshot was written.
+        for (i = 0; i < 2; i++)
+        {
+            fileName = GetDbJournalFileName(header.Sequence + i);
+
+            if (NT_SUCCESS(ReadDbFile(fileName->Buffer, DB_JOURNAL_MAGIC, &journalHeader, &records, &recordsLength)))
+            {
+                if (journalHeader.Sequence == header.Sequence + i)
+                {
+                    sequence = journalHeader.Sequence;
+                    journalLength = sizeof(DB_FILE_HEADER) + ApplyDbRecords(records, recordsLength);
+                }
+
+                PhFree(records);
+            }
+
+            PhDereferenceObject(fileName);
+        }
+
+        ResetDbChanges();
+        ObjectDbXmlStale = !(header.Flags & DB_SNAPSHOT_XML_CURRENT) || journalLength > sizeof(DB_FILE_HEADER);
+        UnlockDb();
+
+        PhAcquireQueuedLockExclusive(&ObjectDbJournalLock);
+
+        if (journalLength != 0)
+            status = OpenDbJournal(sequence, journalLength);
+        else
+            status = CreateDbJournal(sequence);
+
+        PhReleaseQueuedLockExclusive(&ObjectDbJournalLock);
+    }
+    else
+    {
+        // Journals without a matching snapshot are stale.
+        fileName = GetDbJournalFileName(0);
+        PhDeleteFileWin32(fileName->Buffer);
+        PhDereferenceObject(fileName);
+        fileName = GetDbJournalFileName(1);
+        PhDeleteFileWin32(fileName->Buffer);
+        PhDereferenceObject(fileName);
+
+        status = ImportDb();
+
+        LockDb();
+        ResetDbChanges();
+        ObjectDbXmlStale = FALSE;
+        UnlockDb();
+
+        PhAcquireQueuedLockExclusive(&ObjectDbJournalLock);
+        ObjectDbSnapshotSequence = 0;
+        CreateDbJournal(1);
+        PhReleaseQueuedLockExclusive(&ObjectDbJournalLock);
+
+        CompactDb();
+    }
+
+    return status;
+}
+
+/**
+ * Determines whether the XML file is missing changes that are in the snapshot or the journal.
+ */
+BOOLEAN IsDbExportNeeded(
+    VOID
+    )
+{
+    BOOLEAN stale;
+
+    LockDb();
+    stale = ObjectDbXmlStale || !IsListEmpty(&ObjectDbDirtyListHead) || ObjectDbPendingRecords.Bytes->Length != 0;
+    UnlockDb();
+
+    return stale;
+}
+
+/**
+ * Appends pending changes to the journal, and schedules a compaction
+ * if the journal has grown too large.
+ */
+NTSTATUS SaveDb(
+    VOID
+    )
+{
+    NTSTATUS status;
+    BOOLEAN compact = FALSE;
+
+    PhAcquireQueuedLockExclusive(&ObjectDbJournalLock);
+
+    status = FlushDbChanges();
+
+    if (ObjectDbJournalLength >= DB_JOURNAL_COMPACT_THRESHOLD && !ObjectDbCompactQueued)
+    {
+        ObjectDbCompactQueued = TRUE;
+        compact = TRUE;
+    }
+
+    PhReleaseQueuedLockExclusive(&ObjectDbJournalLock);
+
+    if (compact)
+        PhQueueItemWorkQueue(PhGetGlobalWorkQueue(), CompactDbWorkItem, NULL);
+
+    return status;
+}
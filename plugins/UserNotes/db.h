@@ -44,6 +44,9 @@ typedef struct _DB_OBJECT
     COLORREF BackColor;
     BOOLEAN Collapse;
     ULONG AffinityMask;
+
+    BOOLEAN Dirty;
+    LIST_ENTRY DirtyListEntry;
 } DB_OBJECT, *PDB_OBJECT;
 
 VOID InitializeDb(
@@ -77,6 +80,10 @@ VOID DeleteDbObject(
     _In_ PDB_OBJECT Object
     );
 
+VOID MarkDbObjectDirty(
+    _In_ PDB_OBJECT Object
+    );
+
 VOID SetDbPath(
     _In_ PPH_STRING Path
     );
@@ -89,4 +96,20 @@ NTSTATUS SaveDb(
     VOID
     );
 
+NTSTATUS CompactDb(
+    VOID
+    );
+
+BOOLEAN IsDbExportNeeded(
+    VOID
+    );
+
+NTSTATUS ImportDb(
+    VOID
+    );
+
+NTSTATUS ExportDb(
+    VOID
+    );
+
 #endif
@@ -116,6 +116,10 @@ VOID DeleteDbObjectForProcessIfUnused(
     {
         DeleteDbObject(Object);
     }
+    else
+    {
+        MarkDbObjectDirty(Object);
+    }
 }
 
 VOID LoadCustomColors(
@@ -307,6 +311,13 @@ VOID NTAPI UnloadCallback(
     )
 {
     SaveDb();
+
+    // Nothing needs to be written if the XML file and the snapshot are already up to date.
+    if (IsDbExportNeeded())
+    {
+        ExportDb();
+        CompactDb();
+    }
 }
 
 VOID NTAPI ShowOptionsCallback(
@@ -559,6 +570,7 @@ VOID NTAPI MenuHookCallback(
                     if (object->PriorityClass != newPriorityClass)
                     {
                         object->PriorityClass = newPriorityClass;
+                        MarkDbObjectDirty(object);
                         changed = TRUE;
                     }
                 }
@@ -595,6 +607,7 @@ VOID NTAPI MenuHookCallback(
                     if (object->IoPriorityPlusOne != newIoPriorityPlusOne)
                     {
                         object->IoPriorityPlusOne = newIoPriorityPlusOne;
+                        MarkDbObjectDirty(object);
                         changed = TRUE;
                     }
                 }
@@ -636,6 +649,7 @@ VOID NTAPI MenuHookCallback(
                     if (object->AffinityMask != (ULONG)newAffinityMask)
                     {
                         object->AffinityMask = (ULONG)newAffinityMask;
+                        MarkDbObjectDirty(object);
                         changed = TRUE;
                     }
                 }
@@ -35,6 +35,8 @@ typedef struct _WINDOWS_CONTEXT
 
     HWND HighlightingWindow;
     ULONG HighlightingWindowCount;
+
+    BOOLEAN Refreshing;
 } WINDOWS_CONTEXT, *PWINDOWS_CONTEXT;
 
 VOID WepShowWindowsDialogCallback(
@@ -93,55 +95,80 @@ VOID WepDeleteWindowSelector(
     }
 }
 
-VOID WepFillWindowInfo(
-    _In_ PWE_WINDOW_NODE Node
+VOID WepAddChildWindows(
+    _In_ PWINDOWS_CONTEXT Context,
+    _In_opt_ PWE_WINDOW_NODE ParentNode,
+    _In_ HWND hwnd,
+    _In_opt_ HANDLE FilterProcessId,
+    _In_opt_ HANDLE FilterThreadId
+    );
+
+VOID WepAddChildWindowNode(
+    _In_ PWINDOWS_CONTEXT Context,
+    _In_opt_ PWE_WINDOW_NODE ParentNode,
+    _In_ HWND hwnd,
+    _In_ PCLIENT_ID ClientId,
+    _Inout_ PPH_LIST Children
     )
 {
-    HWND hwnd;
-    ULONG threadId;
-    ULONG processId;
+    PWE_WINDOW_NODE childNode;
 
-    hwnd = Node->WindowHandle;
+    if (childNode = WeFindWindowNode(&Context->TreeContext, hwnd))
+    {
+        // The window can show up twice if it was moved while we were enumerating. Found is only
+        // valid during a refresh; when a node is expanded, windows found by the last refresh may
+        // have been moved under the node since then.
+        if (Context->Refreshing && childNode->Found)
+            return;
 
-    GetClassName(hwnd, Node->WindowClass, sizeof(Node->WindowClass) / sizeof(WCHAR));
-    Node->WindowText = PhGetWindowText(hwnd);
+        if (childNode->Parent != ParentNode)
+        {
+            PPH_LIST oldChildren;
+            ULONG index;
 
-    if (!Node->WindowText)
-        Node->WindowText = PhReferenceEmptyString();
+            // The window has a new parent.
+            oldChildren = childNode->Parent ? childNode->Parent->Children : Context->TreeContext.NodeRootList;
 
-    threadId = GetWindowThreadProcessId(hwnd, &processId);
-    Node->ClientId.UniqueProcess = UlongToHandle(processId);
-    Node->ClientId.UniqueThread = UlongToHandle(threadId);
+            if ((index = PhFindItemList(oldChildren, childNode)) != -1)
+                PhRemoveItemList(oldChildren, index);
+        }
+
+        if (childNode->ClientId.UniqueThread != ClientId->UniqueThread)
+        {
+            // The handle was reused by another window.
+            childNode->ClientId = *ClientId;
+            PhClearReference(&childNode->ThreadString);
+        }
 
-    Node->WindowVisible = !!IsWindowVisible(hwnd);
-    Node->HasChildren = !!FindWindowEx(hwnd, NULL, NULL, NULL);
+        WeUpdateWindowNode(&Context->TreeContext, childNode);
+    }
+    else
+    {
+        childNode = WeAddWindowNode(&Context->TreeContext, hwnd);
+        childNode->ClientId = *ClientId;
+        childNode->Node.Expanded = FALSE;
+    }
+
+    childNode->Found = TRUE;
+    childNode->Parent = ParentNode;
+    childNode->HasChildren = !!FindWindowEx(hwnd, NULL, NULL, NULL);
+    PhAddItemList(Children, childNode);
+
+    // Keep the children of expanded nodes up to date as well.
+    if (childNode->Opened)
+        WepAddChildWindows(Context, childNode, hwnd, NULL, NULL);
 }
 
-VOID WepAddChildWindowNode(
-    _In_ PWE_WINDOW_TREE_CONTEXT Context,
+VOID WepSetChildWindowNodes(
+    _In_ PWINDOWS_CONTEXT Context,
     _In_opt_ PWE_WINDOW_NODE ParentNode,
-    _In_ HWND hwnd
+    _In_ PPH_LIST Children
     )
 {
-    PWE_WINDOW_NODE childNode;
-
-    childNode = WeAddWindowNode(Context);
-    childNode->WindowHandle = hwnd;
-    WepFillWindowInfo(childNode);
-
-    childNode->Node.Expanded = FALSE;
-
     if (ParentNode)
-    {
-        // This is a child node.
-        childNode->Parent = ParentNode;
-        PhAddItemList(ParentNode->Children, childNode);
-    }
+        PhMoveReference(&ParentNode->Children, Children);
     else
-    {
-        // This is a root node.
-        PhAddItemList(Context->NodeRootList, childNode);
-    }
+        PhMoveReference(&Context->TreeContext.NodeRootList, Children);
 }
 
 VOID WepAddChildWindows(
@@ -153,37 +180,58 @@ VOID WepAddChildWindows(
     )
 {
     HWND childWindow = NULL;
+    PPH_LIST children;
     ULONG i = 0;
 
+    children = PhCreateList(10);
+
     // We use FindWindowEx because EnumWindows doesn't return Metro app windows.
     // Set a reasonable limit to prevent infinite loops.
     while (i < 0x800 && (childWindow = FindWindowEx(hwnd, childWindow, NULL, NULL)))
     {
         ULONG processId;
         ULONG threadId;
+        CLIENT_ID clientId;
 
         threadId = GetWindowThreadProcessId(childWindow, &processId);
+        clientId.UniqueProcess = UlongToHandle(processId);
+        clientId.UniqueThread = UlongToHandle(threadId);
 
         if (
-            (!FilterProcessId || UlongToHandle(processId) == FilterProcessId) &&
-            (!FilterThreadId || UlongToHandle(threadId) == FilterThreadId)
+            (!FilterProcessId || clientId.UniqueProcess == FilterProcessId) &&
+            (!FilterThreadId || clientId.UniqueThread == FilterThreadId)
             )
         {
-            WepAddChildWindowNode(&Context->TreeContext, ParentNode, childWindow);
+            WepAddChildWindowNode(Context, ParentNode, childWindow, &clientId, children);
         }
 
         i++;
     }
+
+    WepSetChildWindowNodes(Context, ParentNode, children);
 }
 
+typedef struct _ENUM_DESKTOP_WINDOWS_CONTEXT
+{
+    PWINDOWS_CONTEXT Context;
+    PPH_LIST Children;
+} ENUM_DESKTOP_WINDOWS_CONTEXT, *PENUM_DESKTOP_WINDOWS_CONTEXT;
+
 BOOL CALLBACK WepEnumDesktopWindowsProc(
     _In_ HWND hwnd,
     _In_ LPARAM lParam
     )
 {
-    PWINDOWS_CONTEXT context = (PWINDOWS_CONTEXT)lParam;
+    PENUM_DESKTOP_WINDOWS_CONTEXT context = (PENUM_DESKTOP_WINDOWS_CONTEXT)lParam;
+    ULONG processId;
+    ULONG threadId;
+    CLIENT_ID clientId;
 
-    WepAddChildWindowNode(&context->TreeContext, NULL, hwnd);
+    threadId = GetWindowThreadProcessId(hwnd, &processId);
+    clientId.UniqueProcess = UlongToHandle(processId);
+    clientId.UniqueThread = UlongToHandle(threadId);
+
+    WepAddChildWindowNode(context->Context, NULL, hwnd, &clientId, context->Children);
 
     return TRUE;
 }
@@ -194,38 +242,70 @@ VOID WepAddDesktopWindows(
     )
 {
     HDESK desktopHandle;
+    ENUM_DESKTOP_WINDOWS_CONTEXT enumContext;
+
+    enumContext.Context = Context;
+    enumContext.Children = PhCreateList(30);
 
     if (desktopHandle = OpenDesktop(DesktopName, 0, FALSE, DESKTOP_ENUMERATE))
     {
-        EnumDesktopWindows(desktopHandle, WepEnumDesktopWindowsProc, (LPARAM)Context);
+        EnumDesktopWindows(desktopHandle, WepEnumDesktopWindowsProc, (LPARAM)&enumContext);
         CloseDesktop(desktopHandle);
     }
+
+    WepSetChildWindowNodes(Context, NULL, enumContext.Children);
 }
 
 VOID WepRefreshWindows(
     _In_ PWINDOWS_CONTEXT Context
     )
 {
+    ULONG i;
+
+    // Instead of rebuilding the tree we walk the windows again and reuse the nodes we already
+    // have, so expanded and selected nodes stay that way. Nodes for windows that weren't found
+    // are removed afterwards.
+
     TreeNew_SetRedraw(Context->TreeNewHandle, FALSE);
-    WeClearWindowTree(&Context->TreeContext);
-    TreeNew_NodesStructured(Context->TreeNewHandle);
+    Context->Refreshing = TRUE;
+
+    for (i = 0; i < Context->TreeContext.NodeList->Count; i++)
+        ((PWE_WINDOW_NODE)Context->TreeContext.NodeList->Items[i])->Found = FALSE;
 
     switch (Context->Selector.Type)
     {
     case WeWindowSelectorAll:
         {
+            HWND desktopWindow;
             PWE_WINDOW_NODE desktopNode;
+            PPH_LIST children;
 
-            desktopNode = WeAddWindowNode(&Context->TreeContext);
-            desktopNode->WindowHandle = GetDesktopWindow();
-            WepFillWindowInfo(desktopNode);
+            desktopWindow = GetDesktopWindow();
 
-            PhAddItemList(Context->TreeContext.NodeRootList, desktopNode);
+            if (desktopNode = WeFindWindowNode(&Context->TreeContext, desktopWindow))
+            {
+                WeUpdateWindowNode(&Context->TreeContext, desktopNode);
+            }
+            else
+            {
+                ULONG processId;
+                ULONG threadId;
+
+                desktopNode = WeAddWindowNode(&Context->TreeContext, desktopWindow);
+                threadId = GetWindowThreadProcessId(desktopWindow, &processId);
+                desktopNode->ClientId.UniqueProcess = UlongToHandle(processId);
+                desktopNode->ClientId.UniqueThread = UlongToHandle(threadId);
+                desktopNode->HasChildren = TRUE;
+                desktopNode->Opened = TRUE;
+            }
+
+            desktopNode->Found = TRUE;
 
-            WepAddChildWindows(Context, desktopNode, desktopNode->WindowHandle, NULL, NULL);
+            children = PhCreateList(1);
+            PhAddItemList(children, desktopNode);
+            WepSetChildWindowNodes(Context, NULL, children);
 
-            desktopNode->HasChildren = TRUE;
-            desktopNode->Opened = TRUE;
+            WepAddChildWindows(Context, desktopNode, desktopWindow, NULL, NULL);
         }
         break;
     case WeWindowSelectorThread:
@@ -245,6 +325,11 @@ VOID WepRefreshWindows(
         break;
     }
 
+    WeRemoveStaleWindowNodes(&Context->TreeContext);
+    TreeNew_NodesStructured(Context->TreeNewHandle);
+
+    Context->Refreshing = FALSE;
+
     TreeNew_SetRedraw(Context->TreeNewHandle, TRUE);
 }
 
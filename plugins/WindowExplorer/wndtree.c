@@ -36,6 +36,10 @@ VOID WepDestroyWindowNode(
     _In_ PWE_WINDOW_NODE WindowNode
     );
 
+VOID WepFillWindowInfo(
+    _In_ PWE_WINDOW_NODE Node
+    );
+
 BOOLEAN NTAPI WepWindowTreeNewCallback(
     _In_ HWND hwnd,
     _In_ PH_TREENEW_MESSAGE Message,
@@ -122,7 +126,8 @@ ULONG WepWindowNodeHashtableHashFunction(
 }
 
 PWE_WINDOW_NODE WeAddWindowNode(
-    _Inout_ PWE_WINDOW_TREE_CONTEXT Context
+    _Inout_ PWE_WINDOW_TREE_CONTEXT Context,
+    _In_ HWND WindowHandle
     )
 {
     PWE_WINDOW_NODE windowNode;
@@ -131,6 +136,8 @@ PWE_WINDOW_NODE WeAddWindowNode(
     memset(windowNode, 0, sizeof(WE_WINDOW_NODE));
     PhInitializeTreeNewNode(&windowNode->Node);
 
+    windowNode->WindowHandle = WindowHandle;
+
     memset(windowNode->TextCache, 0, sizeof(PH_STRINGREF) * WEWNTLC_MAXIMUM);
     windowNode->Node.TextCache = windowNode->TextCache;
     windowNode->Node.TextCacheSize = WEWNTLC_MAXIMUM;
@@ -186,6 +193,48 @@ VOID WeRemoveWindowNode(
     TreeNew_NodesStructured(Context->TreeNewHandle);
 }
 
+VOID WeUpdateWindowNode(
+    _In_ PWE_WINDOW_TREE_CONTEXT Context,
+    _In_ PWE_WINDOW_NODE WindowNode
+    )
+{
+    // The details are queried again when the node is next displayed.
+    WindowNode->DetailsValid = FALSE;
+
+    memset(WindowNode->TextCache, 0, sizeof(PH_STRINGREF) * WEWNTLC_MAXIMUM);
+    PhInvalidateTreeNewNode(&WindowNode->Node, TN_CACHE_COLOR);
+}
+
+VOID WeRemoveStaleWindowNodes(
+    _In_ PWE_WINDOW_TREE_CONTEXT Context
+    )
+{
+    ULONG count;
+    ULONG i;
+
+    // Remove all nodes that weren't found during the last refresh. The caller must call
+    // TreeNew_NodesStructured afterwards.
+
+    count = 0;
+
+    for (i = 0; i < Context->NodeList->Count; i++)
+    {
+        PWE_WINDOW_NODE windowNode = Context->NodeList->Items[i];
+
+        if (windowNode->Found)
+        {
+            Context->NodeList->Items[count++] = windowNode;
+        }
+        else
+        {
+            PhRemoveEntryHashtable(Context->NodeHashtable, &windowNode);
+            WepDestroyWindowNode(windowNode);
+        }
+    }
+
+    Context->NodeList->Count = count;
+}
+
 VOID WepDestroyWindowNode(
     _In_ PWE_WINDOW_NODE WindowNode
     )
@@ -199,6 +248,27 @@ VOID WepDestroyWindowNode(
     PhFree(WindowNode);
 }
 
+VOID WepFillWindowInfo(
+    _In_ PWE_WINDOW_NODE Node
+    )
+{
+    HWND hwnd;
+
+    if (Node->DetailsValid)
+        return;
+
+    hwnd = Node->WindowHandle;
+
+    GetClassName(hwnd, Node->WindowClass, sizeof(Node->WindowClass) / sizeof(WCHAR));
+    PhMoveReference(&Node->WindowText, PhGetWindowText(hwnd));
+
+    if (!Node->WindowText)
+        Node->WindowText = PhReferenceEmptyString();
+
+    Node->WindowVisible = !!IsWindowVisible(hwnd);
+    Node->DetailsValid = TRUE;
+}
+
 #define SORT_FUNCTION(Column) WepWindowTreeNewCompare##Column
 
 #define BEGIN_SORT_FUNCTION(Column) static int __cdecl WepWindowTreeNewCompare##Column( \
@@ -217,6 +287,8 @@ VOID WepDestroyWindowNode(
 
 BEGIN_SORT_FUNCTION(Class)
 {
+    WepFillWindowInfo(node1);
+    WepFillWindowInfo(node2);
     sortResult = _wcsicmp(node1->WindowClass, node2->WindowClass);
 }
 END_SORT_FUNCTION
@@ -229,6 +301,8 @@ END_SORT_FUNCTION
 
 BEGIN_SORT_FUNCTION(Text)
 {
+    WepFillWindowInfo(node1);
+    WepFillWindowInfo(node2);
     sortResult = PhCompareString(node1->WindowText, node2->WindowText, TRUE);
 }
 END_SORT_FUNCTION
@@ -322,6 +396,7 @@ BOOLEAN NTAPI WepWindowTreeNewCallback(
             PPH_TREENEW_GET_CELL_TEXT getCellText = Parameter1;
 
             node = (PWE_WINDOW_NODE)getCellText->Node;
+            WepFillWindowInfo(node);
 
             switch (getCellText->Id)
             {
@@ -352,6 +427,7 @@ BOOLEAN NTAPI WepWindowTreeNewCallback(
             PPH_TREENEW_GET_NODE_COLOR getNodeColor = Parameter1;
 
             node = (PWE_WINDOW_NODE)getNodeColor->Node;
+            WepFillWindowInfo(node);
 
             if (!node->WindowVisible)
                 getNodeColor->ForeColor = RGB(0x55, 0x55, 0x55);
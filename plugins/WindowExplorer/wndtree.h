@@ -22,7 +22,9 @@ typedef struct _WE_WINDOW_NODE
             ULONG HasChildren : 1;
             ULONG Opened : 1;
             ULONG WindowVisible : 1;
-            ULONG Spare : 29;
+            ULONG DetailsValid : 1;
+            ULONG Found : 1;
+            ULONG Spare : 27;
         };
     };
 
@@ -60,7 +62,8 @@ VOID WeDeleteWindowTree(
     );
 
 PWE_WINDOW_NODE WeAddWindowNode(
-    _Inout_ PWE_WINDOW_TREE_CONTEXT Context
+    _Inout_ PWE_WINDOW_TREE_CONTEXT Context,
+    _In_ HWND WindowHandle
     );
 
 PWE_WINDOW_NODE WeFindWindowNode(
@@ -73,6 +76,15 @@ VOID WeRemoveWindowNode(
     _In_ PWE_WINDOW_NODE WindowNode
     );
 
+VOID WeUpdateWindowNode(
+    _In_ PWE_WINDOW_TREE_CONTEXT Context,
+    _In_ PWE_WINDOW_NODE WindowNode
+    );
+
+VOID WeRemoveStaleWindowNodes(
+    _In_ PWE_WINDOW_TREE_CONTEXT Context
+    );
+
 VOID WeClearWindowTree(
     _In_ PWE_WINDOW_TREE_CONTEXT Context
     );
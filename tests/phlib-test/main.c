@@ -11,6 +11,13 @@ int __cdecl wmain(int argc, wchar_t *argv[])
     Test_avltree();
     Test_format();
     Test_util();
+    Test_mapimg();
+    Test_stkprof();
+    Test_histfile();
+    Test_native();
+    Test_symprv();
+    Test_hndlinfo();
+    Test_circbuf();
 
     return 0;
 }
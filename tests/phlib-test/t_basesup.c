@@ -339,6 +339,360 @@ VOID Test_unicode(
     assert(memcmp(utf8_2->Buffer, utf8_3->Buffer, utf8_2->Length) == 0);
 }
 
+VOID Test_unicode_ascii(
+    VOID
+    )
+{
+    static CHAR invalidUtf8[] = "\x80" "a" "\xc0\xaf" "b" "\xe0\x80" "c" "\xf4\x90\x80\x80" "d" "\xe2\x82";
+    static WCHAR invalidUtf8Expected[] =
+    {
+        0xdc80, 'a', 0xdcc0, 0xdcaf, 'b', 0xdce0, 0xdc80, 'c', 0xdcf4, 0xdc90, 0xdc80, 0xdc80, 'd'
+    };
+    PPH_STRING utf16;
+    PPH_BYTES utf8;
+    PPH_STRING string;
+    PWCHAR buffer;
+    ULONG codePoint;
+    ULONG numberOfCodeUnits;
+    SIZE_T length;
+    SIZE_T prefix;
+    SIZE_T i;
+
+    // Every code point, separated by ASCII runs of varying length and alignment.
+
+    buffer = PhAllocate(0x110000 * 2 * sizeof(WCHAR) + 0x110000 / 0x100 * 40 * sizeof(WCHAR));
+    length = 0;
+
+    for (codePoint = 0; codePoint <= PH_UNICODE_MAX_CODE_POINT; codePoint++)
+    {
+        if (codePoint >= 0xd800 && codePoint <= 0xdfff)
+            continue;
+
+        if ((codePoint & 0xff) == 0)
+        {
+            for (i = 0; i < (codePoint >> 8) % 40; i++)
+                buffer[length++] = (WCHAR)('a' + i % 26);
+        }
+
+        PhEncodeUnicode(PH_UNICODE_UTF16, codePoint, buffer + length, &numberOfCodeUnits);
+        length += numberOfCodeUnits;
+    }
+
+    utf8 = PhConvertUtf16ToUtf8Ex(buffer, length * sizeof(WCHAR));
+    assert(utf8);
+    utf16 = PhConvertUtf8ToUtf16Ex(utf8->Buffer, utf8->Length);
+    assert(utf16);
+    assert(utf16->Length == length * sizeof(WCHAR));
+    assert(memcmp(utf16->Buffer, buffer, utf16->Length) == 0);
+    PhDereferenceObject(utf16);
+    PhDereferenceObject(utf8);
+    PhFree(buffer);
+
+    // Invalid sequences following ASCII runs must decode the same way regardless of the length of
+    // the run. The truncated sequence at the end is dropped.
+
+    for (prefix = 0; prefix < 40; prefix++)
+    {
+        PCHAR input;
+
+        input = PhAllocate(prefix + sizeof(invalidUtf8) - 1);
+        memset(input, 'x', prefix);
+        memcpy(input + prefix, invalidUtf8, sizeof(invalidUtf8) - 1);
+
+        string = PhConvertUtf8ToUtf16Ex(input, prefix + sizeof(invalidUtf8) - 1);
+        assert(string);
+        assert(string->Length == (prefix + RTL_NUMBER_OF(invalidUtf8Expected)) * sizeof(WCHAR));
+
+        for (i = 0; i < prefix; i++)
+            assert(string->Buffer[i] == 'x');
+
+        assert(memcmp(string->Buffer + prefix, invalidUtf8Expected, sizeof(invalidUtf8Expected)) == 0);
+        PhDereferenceObject(string);
+        PhFree(input);
+    }
+
+    // Lone surrogates following ASCII runs.
+
+    for (prefix = 0; prefix < 40; prefix++)
+    {
+        buffer = PhAllocate((prefix + 5) * sizeof(WCHAR));
+
+        for (i = 0; i < prefix; i++)
+            buffer[i] = 'y';
+
+        buffer[prefix] = 0xd800;
+        buffer[prefix + 1] = 'z';
+        buffer[prefix + 2] = 0xdc00;
+        buffer[prefix + 3] = 0xdbff;
+        buffer[prefix + 4] = 'w';
+
+        utf8 = PhConvertUtf16ToUtf8Ex(buffer, (prefix + 5) * sizeof(WCHAR));
+        assert(utf8);
+        assert(utf8->Length == prefix + 11);
+        assert(memcmp(utf8->Buffer + prefix, "\xed\xa0\x80" "z" "\xed\xb0\x80" "\xed\xaf\xbf" "w", 11) == 0);
+        PhDereferenceObject(utf8);
+        PhFree(buffer);
+    }
+}
+
+typedef struct _TEST_FLAT_HASHTABLE_ENTRY
+{
+    ULONG Key;
+    ULONG Value;
+} TEST_FLAT_HASHTABLE_ENTRY, *PTEST_FLAT_HASHTABLE_ENTRY;
+
+static BOOLEAN NTAPI TestFlatHashtableEqualFunction(
+    _In_ PVOID Entry1,
+    _In_ PVOID Entry2
+    )
+{
+    return ((PTEST_FLAT_HASHTABLE_ENTRY)Entry1)->Key == ((PTEST_FLAT_HASHTABLE_ENTRY)Entry2)->Key;
+}
+
+static ULONG NTAPI TestFlatHashtableHashFunction(
+    _In_ PVOID Entry
+    )
+{
+    // Deliberately weak, so that many keys share control bytes and probe sequences.
+    return ((PTEST_FLAT_HASHTABLE_ENTRY)Entry)->Key & 0xff;
+}
+
+VOID Test_flathashtable(
+    VOID
+    )
+{
+    PPH_FLAT_HASHTABLE hashtable;
+    PUCHAR present;
+    ULONG count;
+    ULONG seed;
+    ULONG i;
+    ULONG enumerationKey;
+    PTEST_FLAT_HASHTABLE_ENTRY entry;
+
+    hashtable = PhCreateFlatHashtable(sizeof(TEST_FLAT_HASHTABLE_ENTRY), TestFlatHashtableEqualFunction, TestFlatHashtableHashFunction, 0);
+    present = PhAllocate(4096);
+    memset(present, 0, 4096);
+    count = 0;
+    seed = 1;
+
+    // Random mix of insertions, lookups and removals, checked against a bitmap.
+
+    for (i = 0; i < 200000; i++)
+    {
+        TEST_FLAT_HASHTABLE_ENTRY lookupEntry;
+        BOOLEAN added;
+        BOOLEAN removed;
+
+        lookupEntry.Key = RtlRandomEx(&seed) % 4096;
+        lookupEntry.Value = lookupEntry.Key * 3;
+
+        switch (RtlRandomEx(&seed) % 3)
+        {
+        case 0:
+            entry = PhAddEntryFlatHashtableEx(hashtable, &lookupEntry, &added);
+            assert(added == !present[lookupEntry.Key]);
+            assert(entry->Key == lookupEntry.Key && entry->Value == lookupEntry.Value);
+
+            if (added)
+            {
+                present[lookupEntry.Key] = TRUE;
+                count++;
+            }
+            break;
+        case 1:
+            entry = PhFindEntryFlatHashtable(hashtable, &lookupEntry);
+            assert(!!entry == present[lookupEntry.Key]);
+            assert(!entry || entry->Value == lookupEntry.Value);
+            break;
+        case 2:
+            removed = PhRemoveEntryFlatHashtable(hashtable, &lookupEntry);
+            assert(removed == present[lookupEntry.Key]);
+
+            if (present[lookupEntry.Key])
+            {
+                present[lookupEntry.Key] = FALSE;
+                count--;
+            }
+            break;
+        }
+
+        assert(hashtable->Count == count);
+    }
+
+    enumerationKey = 0;
+    i = 0;
+
+    while (PhEnumFlatHashtable(hashtable, (PVOID *)&entry, &enumerationKey))
+    {
+        assert(present[entry->Key]);
+        i++;
+    }
+
+    assert(i == count);
+
+    PhClearFlatHashtable(hashtable);
+    assert(hashtable->Count == 0);
+
+    for (i = 0; i < 4096; i++)
+    {
+        TEST_FLAT_HASHTABLE_ENTRY lookupEntry;
+
+        lookupEntry.Key = i;
+        assert(!PhFindEntryFlatHashtable(hashtable, &lookupEntry));
+    }
+
+    PhFree(present);
+    PhDereferenceObject(hashtable);
+}
+
+VOID Test_singles(
+    VOID
+    )
+{
+    FLOAT a[40];
+    FLOAT b[40];
+    FLOAT expected[40];
+    FLOAT max;
+    ULONG seed;
+    ULONG offset;
+    ULONG count;
+    ULONG i;
+
+    seed = 1;
+
+    // Cover every alignment and remainder of the vector loops.
+
+    for (offset = 0; offset < 4; offset++)
+    {
+        for (count = 0; count <= 40 - offset; count++)
+        {
+            max = 0;
+
+            for (i = 0; i < count; i++)
+            {
+                a[offset + i] = (FLOAT)(RtlRandomEx(&seed) % 1000);
+                b[i] = (FLOAT)(RtlRandomEx(&seed) % 1000);
+                expected[i] = a[offset + i] + b[i];
+
+                if (i == 0 || max < expected[i])
+                    max = expected[i];
+            }
+
+            assert(PhMaximumSumSingles(&a[offset], b, count) == max);
+
+            PhAddSingles(&a[offset], b, count);
+
+            for (i = 0; i < count; i++)
+                assert(a[offset + i] == expected[i]);
+        }
+    }
+}
+
+typedef struct _TEST_CALLBACK_CONTEXT
+{
+    LONG Calls;
+    BOOLEAN Unregistered;
+} TEST_CALLBACK_CONTEXT, *PTEST_CALLBACK_CONTEXT;
+
+#define TEST_CALLBACK_THREADS 4
+#define TEST_CALLBACK_INVOKES 200000
+#define TEST_CALLBACK_REGISTRATIONS 5000
+
+static PH_CALLBACK TestCallback;
+static LONG TestCallbackThreadsRunning;
+
+static VOID NTAPI TestCallbackFunction(
+    _In_opt_ PVOID Parameter,
+    _In_opt_ PVOID Context
+    )
+{
+    PTEST_CALLBACK_CONTEXT context = Context;
+
+    // Nothing may be called after PhUnregisterCallback returns.
+    assert(!context->Unregistered);
+    _InterlockedIncrement(&context->Calls);
+}
+
+static NTSTATUS NTAPI TestCallbackThreadStart(
+    _In_ PVOID Parameter
+    )
+{
+    ULONG i;
+
+    for (i = 0; i < TEST_CALLBACK_INVOKES; i++)
+        PhInvokeCallback(&TestCallback, NULL);
+
+    _InterlockedDecrement(&TestCallbackThreadsRunning);
+
+    return STATUS_SUCCESS;
+}
+
+VOID Test_callback(
+    VOID
+    )
+{
+    PH_CALLBACK_REGISTRATION registrations[3];
+    TEST_CALLBACK_CONTEXT contexts[3];
+    PTEST_CALLBACK_CONTEXT stressContexts;
+    HANDLE threadHandles[TEST_CALLBACK_THREADS];
+    ULONG i;
+
+    PhInitializeCallback(&TestCallback);
+    memset(contexts, 0, sizeof(contexts));
+
+    PhInvokeCallback(&TestCallback, NULL);
+
+    for (i = 0; i < 3; i++)
+        PhRegisterCallback(&TestCallback, TestCallbackFunction, &contexts[i], &registrations[i]);
+
+    PhInvokeCallback(&TestCallback, NULL);
+    assert(contexts[0].Calls == 1 && contexts[1].Calls == 1 && contexts[2].Calls == 1);
+
+    PhUnregisterCallback(&TestCallback, &registrations[1]);
+    contexts[1].Unregistered = TRUE;
+    PhInvokeCallback(&TestCallback, NULL);
+    assert(contexts[0].Calls == 2 && contexts[1].Calls == 1 && contexts[2].Calls == 2);
+
+    // Stress test: invoke from several threads while registering and unregistering. The
+    // registration structures are freed as soon as they are unregistered.
+
+    stressContexts = PhAllocate(sizeof(TEST_CALLBACK_CONTEXT) * TEST_CALLBACK_REGISTRATIONS);
+    memset(stressContexts, 0, sizeof(TEST_CALLBACK_CONTEXT) * TEST_CALLBACK_REGISTRATIONS);
+    TestCallbackThreadsRunning = TEST_CALLBACK_THREADS;
+
+    for (i = 0; i < TEST_CALLBACK_THREADS; i++)
+        threadHandles[i] = PhCreateThread(0, TestCallbackThreadStart, NULL);
+
+    for (i = 0; i < TEST_CALLBACK_REGISTRATIONS && TestCallbackThreadsRunning != 0; i++)
+    {
+        PPH_CALLBACK_REGISTRATION registration;
+
+        registration = PhAllocate(sizeof(PH_CALLBACK_REGISTRATION));
+        PhRegisterCallback(&TestCallback, TestCallbackFunction, &stressContexts[i], registration);
+        YieldProcessor();
+        PhUnregisterCallback(&TestCallback, registration);
+        stressContexts[i].Unregistered = TRUE;
+        PhFree(registration);
+    }
+
+    NtWaitForMultipleObjects(TEST_CALLBACK_THREADS, threadHandles, WaitAll, FALSE, NULL);
+
+    for (i = 0; i < TEST_CALLBACK_THREADS; i++)
+        NtClose(threadHandles[i]);
+
+    // The permanent registrations must not have missed any invocation.
+    assert(contexts[0].Calls == 2 + TEST_CALLBACK_THREADS * TEST_CALLBACK_INVOKES);
+    assert(contexts[2].Calls == contexts[0].Calls);
+    assert(contexts[1].Calls == 1);
+
+    PhUnregisterCallback(&TestCallback, &registrations[0]);
+    PhUnregisterCallback(&TestCallback, &registrations[2]);
+    assert(!TestCallback.Snapshot && !TestCallback.RetiredSnapshots);
+
+    PhFree(stressContexts);
+    PhDeleteCallback(&TestCallback);
+}
+
 VOID Test_basesup(
     VOID
     )
@@ -349,4 +703,8 @@ VOID Test_basesup(
     Test_hexstring();
     Test_strint();
     Test_unicode();
+    Test_unicode_ascii();
+    Test_flathashtable();
+    Test_singles();
+    Test_callback();
 }
@@ -0,0 +1,64 @@
+#include "tests.h"
+#include <circbuf.h>
+
+static VOID Test_history(
+    VOID
+    )
+{
+    PH_HISTORY_BUFFER buffer;
+    PH_CIRCULAR_BUFFER_FLOAT series[3];
+    FLOAT samples[3];
+    FLOAT copy1[80];
+    FLOAT copy2[80];
+    ULONG count;
+    ULONG i;
+    ULONG j;
+
+    // Each series should behave exactly like a separate circular buffer.
+
+    PhInitializeHistoryBuffer(&buffer, 3, 50);
+    assert(buffer.Size == 64 && buffer.Count == 0);
+
+    for (j = 0; j < 3; j++)
+        PhInitializeCircularBuffer_FLOAT(&series[j], 50);
+
+    for (i = 0; i < 200; i++)
+    {
+        for (j = 0; j < 3; j++)
+        {
+            samples[j] = (FLOAT)(i * 3 + j);
+            PhAddItemCircularBuffer_FLOAT(&series[j], samples[j]);
+        }
+
+        PhAddSamplesHistoryBuffer(&buffer, samples);
+        assert(buffer.Count == series[0].Count);
+
+        for (j = 0; j < 3; j++)
+        {
+            assert(PhGetSampleHistoryBuffer(&buffer, j, 0) == samples[j]);
+            assert(PhGetSampleHistoryBuffer(&buffer, j, buffer.Count - 1) ==
+                PhGetItemCircularBuffer_FLOAT(&series[j], series[j].Count - 1));
+
+            for (count = 0; count <= 80; count += 7)
+            {
+                memset(copy1, 0, sizeof(copy1));
+                memset(copy2, 0, sizeof(copy2));
+                PhCopyHistoryBuffer(&buffer, j, copy1, count);
+                PhCopyCircularBuffer_FLOAT(&series[j], copy2, count);
+                assert(memcmp(copy1, copy2, sizeof(copy1)) == 0);
+            }
+        }
+    }
+
+    for (j = 0; j < 3; j++)
+        PhDeleteCircularBuffer_FLOAT(&series[j]);
+
+    PhDeleteHistoryBuffer(&buffer);
+}
+
+VOID Test_circbuf(
+    VOID
+    )
+{
+    Test_history();
+}
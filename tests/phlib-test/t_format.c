@@ -278,6 +278,52 @@ static VOID Test_float(
     result = PhFormatToBuffer(format, 1, buffer, sizeof(buffer), NULL);
     assert(result && wcscmp(buffer, L"3.1416") == 0);
 
+    // Rounding (ties to even, unlike the UCRT before Windows 10 version 2004)
+
+    format[0].Type = DoubleFormatType | FormatUsePrecision;
+    format[0].u.Double = 0.125;
+    format[0].Precision = 2;
+    result = PhFormatToBuffer(format, 1, buffer, sizeof(buffer), NULL);
+    assert(result && wcscmp(buffer, L"0.12") == 0);
+
+    format[0].Type = DoubleFormatType | FormatUsePrecision;
+    format[0].u.Double = 0.375;
+    format[0].Precision = 2;
+    result = PhFormatToBuffer(format, 1, buffer, sizeof(buffer), NULL);
+    assert(result && wcscmp(buffer, L"0.38") == 0);
+
+    format[0].Type = DoubleFormatType | FormatUsePrecision;
+    format[0].u.Double = 0.15;
+    format[0].Precision = 1;
+    result = PhFormatToBuffer(format, 1, buffer, sizeof(buffer), NULL);
+    assert(result && wcscmp(buffer, L"0.1") == 0);
+
+    format[0].Type = DoubleFormatType | FormatUsePrecision;
+    format[0].u.Double = 999.9996;
+    format[0].Precision = 3;
+    result = PhFormatToBuffer(format, 1, buffer, sizeof(buffer), NULL);
+    assert(result && wcscmp(buffer, L"1000.000") == 0);
+
+    format[0].Type = DoubleFormatType | FormatUsePrecision;
+    format[0].u.Double = -0.00999;
+    format[0].Precision = 2;
+    result = PhFormatToBuffer(format, 1, buffer, sizeof(buffer), NULL);
+    assert(result && wcscmp(buffer, L"-0.01") == 0);
+
+    // Large and small numbers
+
+    format[0].Type = DoubleFormatType | FormatUsePrecision;
+    format[0].u.Double = 1e20;
+    format[0].Precision = 1;
+    result = PhFormatToBuffer(format, 1, buffer, sizeof(buffer), NULL);
+    assert(result && wcscmp(buffer, L"100000000000000000000.0") == 0);
+
+    format[0].Type = DoubleFormatType | FormatUsePrecision;
+    format[0].u.Double = 1e-20;
+    format[0].Precision = 25;
+    result = PhFormatToBuffer(format, 1, buffer, sizeof(buffer), NULL);
+    assert(result && wcscmp(buffer, L"0.0000000000000000000100000") == 0);
+
     // Crop zeros
 
     format[0].Type = DoubleFormatType | FormatUsePrecision | FormatCropZeros;
@@ -416,6 +462,110 @@ static VOID Test_float(
     assert(result && wcscmp(buffer, L"-9,876,543.21000") == 0);
 }
 
+static VOID Test_shortest(
+    VOID
+    )
+{
+    BOOLEAN result;
+    PH_FORMAT format[1];
+    WCHAR buffer[1024];
+    ULONG i;
+
+    PhInitFormatR(&format[0], 0.1);
+    result = PhFormatToBuffer(format, 1, buffer, sizeof(buffer), NULL);
+    assert(result && wcscmp(buffer, L"0.1") == 0);
+    PhInitFormatR(&format[0], 0.1 + 0.2);
+    result = PhFormatToBuffer(format, 1, buffer, sizeof(buffer), NULL);
+    assert(result && wcscmp(buffer, L"0.30000000000000004") == 0);
+    PhInitFormatR(&format[0], 1.0 / 3);
+    result = PhFormatToBuffer(format, 1, buffer, sizeof(buffer), NULL);
+    assert(result && wcscmp(buffer, L"0.3333333333333333") == 0);
+    PhInitFormatR(&format[0], -123.456);
+    result = PhFormatToBuffer(format, 1, buffer, sizeof(buffer), NULL);
+    assert(result && wcscmp(buffer, L"-123.456") == 0);
+    PhInitFormatR(&format[0], 0.00001);
+    result = PhFormatToBuffer(format, 1, buffer, sizeof(buffer), NULL);
+    assert(result && wcscmp(buffer, L"0.00001") == 0);
+
+    // Integers
+
+    PhInitFormatR(&format[0], 0.0);
+    result = PhFormatToBuffer(format, 1, buffer, sizeof(buffer), NULL);
+    assert(result && wcscmp(buffer, L"0") == 0);
+    PhInitFormatR(&format[0], -0.0);
+    result = PhFormatToBuffer(format, 1, buffer, sizeof(buffer), NULL);
+    assert(result && wcscmp(buffer, L"-0") == 0);
+    PhInitFormatR(&format[0], 123456789);
+    result = PhFormatToBuffer(format, 1, buffer, sizeof(buffer), NULL);
+    assert(result && wcscmp(buffer, L"123456789") == 0);
+    PhInitFormatR(&format[0], 9007199254740992.0);
+    result = PhFormatToBuffer(format, 1, buffer, sizeof(buffer), NULL);
+    assert(result && wcscmp(buffer, L"9007199254740992") == 0);
+    PhInitFormatR(&format[0], 18014398509481988.0);
+    result = PhFormatToBuffer(format, 1, buffer, sizeof(buffer), NULL);
+    assert(result && wcscmp(buffer, L"18014398509481988") == 0);
+    PhInitFormatR(&format[0], 1e23);
+    result = PhFormatToBuffer(format, 1, buffer, sizeof(buffer), NULL);
+    assert(result && wcscmp(buffer, L"100000000000000000000000") == 0);
+
+    // Limits
+
+    PhInitFormatR(&format[0], 4.9406564584124654e-324);
+    result = PhFormatToBuffer(format, 1, buffer, sizeof(buffer), NULL);
+    assert(result && wcslen(buffer) == 326 && wcsncmp(buffer, L"0.000", 5) == 0 && buffer[325] == '5');
+
+    for (i = 2; i < 325; i++)
+        assert(buffer[i] == '0');
+
+    PhInitFormatR(&format[0], 1.7976931348623157e308);
+    result = PhFormatToBuffer(format, 1, buffer, sizeof(buffer), NULL);
+    assert(result && wcslen(buffer) == 309 && wcsncmp(buffer, L"17976931348623157000", 20) == 0);
+
+    // Flags
+
+    if (IsThousandSepComma())
+    {
+        format[0].Type = DoubleFormatType | FormatShortestForm | FormatGroupDigits;
+        format[0].u.Double = 1234567.25;
+        result = PhFormatToBuffer(format, 1, buffer, sizeof(buffer), NULL);
+        assert(result && wcscmp(buffer, L"1,234,567.25") == 0);
+    }
+
+    format[0].Type = DoubleFormatType | FormatShortestForm | FormatUsePrecision;
+    format[0].u.Double = 2.5;
+    format[0].Precision = 6;
+    result = PhFormatToBuffer(format, 1, buffer, sizeof(buffer), NULL);
+    assert(result && wcscmp(buffer, L"2.5") == 0);
+}
+
+static VOID Test_batch(
+    VOID
+    )
+{
+    BOOLEAN result;
+    PH_FORMAT format[3];
+    WCHAR buffer[3][8];
+    SIZE_T returnLengths[3];
+
+    PhInitFormatF(&format[0], 1.5, 2);
+    PhInitFormatU(&format[1], 42);
+    PhInitFormatS(&format[2], L"abc");
+    result = PhFormatToBufferBatch(format, 3, buffer[0], sizeof(buffer[0]), returnLengths);
+    assert(result);
+    assert(wcscmp(buffer[0], L"1.50") == 0 && returnLengths[0] == 5 * sizeof(WCHAR));
+    assert(wcscmp(buffer[1], L"42") == 0 && returnLengths[1] == 3 * sizeof(WCHAR));
+    assert(wcscmp(buffer[2], L"abc") == 0 && returnLengths[2] == 4 * sizeof(WCHAR));
+
+    // A cell which does not fit is emptied without affecting the others.
+
+    PhInitFormatS(&format[1], L"too long!");
+    result = PhFormatToBufferBatch(format, 3, buffer[0], sizeof(buffer[0]), returnLengths);
+    assert(!result);
+    assert(wcscmp(buffer[0], L"1.50") == 0);
+    assert(buffer[1][0] == 0 && returnLengths[1] == 10 * sizeof(WCHAR));
+    assert(wcscmp(buffer[2], L"abc") == 0);
+}
+
 static VOID Test_width(
     VOID
     )
@@ -507,5 +657,7 @@ VOID Test_format(
     Test_string();
     Test_integer();
     Test_float();
+    Test_shortest();
+    Test_batch();
     Test_width();
 }
@@ -0,0 +1,86 @@
+#include "tests.h"
+#include <histfile.h>
+
+static VOID Test_rollup(
+    _In_ PWSTR FileName
+    )
+{
+    static PH_HISTORY_FILE_LEVEL levels[] = { { 1, 1000 }, { 60, 100 }, { 3600, 10 } };
+    PPH_HISTORY_FILE historyFile;
+    NTSTATUS status;
+    ULONG startTime;
+    ULONG i;
+    BOOLEAN result;
+    ULONG time;
+    FLOAT average;
+    FLOAT maximum;
+    FLOAT buffer[4];
+
+    status = PhCreateHistoryFile(&historyFile, FileName, 2, RTL_NUMBER_OF(levels), levels);
+    assert(NT_SUCCESS(status));
+
+    startTime = 3600 * 1000 + 40;
+
+    for (i = 0; i < 7300; i++)
+    {
+        FLOAT values[2];
+
+        values[0] = (FLOAT)i;
+        values[1] = (FLOAT)(i % 60);
+        result = PhAddSampleHistoryFile(historyFile, startTime + i, values);
+        assert(result);
+
+        // Reopen the file halfway through. Nothing should be lost.
+        if (i == 3000)
+        {
+            PhDestroyHistoryFile(historyFile);
+            status = PhCreateHistoryFile(&historyFile, FileName, 2, RTL_NUMBER_OF(levels), levels);
+            assert(NT_SUCCESS(status));
+        }
+    }
+
+    assert(PhGetSampleHistoryFile(historyFile, 0, 0, 0, &time, &average, &maximum));
+    assert(time == startTime + 7299 && average == 7299 && maximum == 7299);
+
+    // The oldest minute only has 20 samples, because the first sample was 40 seconds into it.
+    assert(PhGetCountHistoryFile(historyFile, 1) == 122);
+    assert(PhGetSampleHistoryFile(historyFile, 1, 121, 0, &time, &average, &maximum));
+    assert(time == startTime - 40 && average == 9.5 && maximum == 19);
+    assert(PhGetSampleHistoryFile(historyFile, 1, 0, 1, &time, &average, &maximum));
+    assert(time % 60 == 0 && average == 29.5 && maximum == 59);
+
+    assert(PhGetCountHistoryFile(historyFile, 2) == 2);
+    assert(PhCopyHistoryFile(historyFile, 2, 0, TRUE, buffer, RTL_NUMBER_OF(buffer)) == 2);
+    assert(buffer[0] == 7159 && buffer[1] == 3559);
+
+    assert(PhCopyHistoryFile(historyFile, 0, 0, FALSE, buffer, RTL_NUMBER_OF(buffer)) == 4);
+    assert(buffer[0] == 7299 && buffer[3] == 7296);
+
+    PhDestroyHistoryFile(historyFile);
+
+    // Different parameters replace the file.
+    levels[1].Resolution = 120;
+    status = PhCreateHistoryFile(&historyFile, FileName, 2, RTL_NUMBER_OF(levels), levels);
+    assert(NT_SUCCESS(status));
+    assert(PhGetCountHistoryFile(historyFile, 0) == 0);
+    PhDestroyHistoryFile(historyFile);
+    levels[1].Resolution = 60;
+}
+
+VOID Test_histfile(
+    VOID
+    )
+{
+    WCHAR tempPath[MAX_PATH];
+    ULONG length;
+    PPH_STRING fileName;
+
+    length = GetTempPath(MAX_PATH, tempPath);
+    assert(length != 0);
+    fileName = PhConcatStrings2(tempPath, L"phlib-test-history.db");
+
+    Test_rollup(fileName->Buffer);
+
+    PhDeleteFileWin32(fileName->Buffer);
+    PhDereferenceObject(fileName);
+}
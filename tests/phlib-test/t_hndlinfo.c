@@ -0,0 +1,103 @@
+#include "tests.h"
+#include <hndlinfo.h>
+
+static PSYSTEM_HANDLE_TABLE_ENTRY_INFO_EX Test_FindHandle(
+    _In_ PSYSTEM_HANDLE_INFORMATION_EX Handles,
+    _In_ HANDLE Handle
+    )
+{
+    ULONG_PTR i;
+
+    for (i = 0; i < Handles->NumberOfHandles; i++)
+    {
+        if (Handles->Handles[i].UniqueProcessId == (ULONG_PTR)NtCurrentProcessId() &&
+            Handles->Handles[i].HandleValue == (ULONG_PTR)Handle)
+        {
+            return &Handles->Handles[i];
+        }
+    }
+
+    return NULL;
+}
+
+static PPH_STRING Test_GetCachedName(
+    _In_ PSYSTEM_HANDLE_INFORMATION_EX Handles,
+    _In_ ULONG Generation,
+    _In_ HANDLE Handle
+    )
+{
+    PSYSTEM_HANDLE_TABLE_ENTRY_INFO_EX handleInfo;
+    NTSTATUS status;
+    NTSTATUS subStatus;
+    PPH_STRING typeName;
+    PPH_STRING objectName;
+
+    handleInfo = Test_FindHandle(Handles, Handle);
+    assert(handleInfo);
+
+    status = PhGetHandleInformationCached(
+        NtCurrentProcess(),
+        handleInfo,
+        Generation,
+        &subStatus,
+        &typeName,
+        &objectName,
+        NULL
+        );
+    assert(NT_SUCCESS(status));
+    assert(NT_SUCCESS(subStatus));
+    assert(PhEqualString2(typeName, L"Event", FALSE));
+    assert(PhEndsWithString2(objectName, L"\\PhlibTestHandleNameCache", FALSE));
+    PhDereferenceObject(typeName);
+
+    return objectName;
+}
+
+VOID Test_hndlinfo(
+    VOID
+    )
+{
+    NTSTATUS status;
+    HANDLE eventHandle;
+    HANDLE duplicateHandle;
+    PSYSTEM_HANDLE_INFORMATION_EX handles;
+    ULONG generation;
+    BOOLEAN haveObjects;
+    PPH_STRING name1;
+    PPH_STRING name2;
+    PPH_STRING name3;
+
+    eventHandle = CreateEvent(NULL, TRUE, FALSE, L"PhlibTestHandleNameCache");
+    assert(eventHandle);
+    status = NtDuplicateObject(NtCurrentProcess(), eventHandle, NtCurrentProcess(), &duplicateHandle, 0, 0, DUPLICATE_SAME_ACCESS);
+    assert(NT_SUCCESS(status));
+
+    status = PhEnumHandlesEx(&handles);
+    assert(NT_SUCCESS(status));
+    generation = PhUpdateHandleNameCache(handles, NULL);
+
+    // Object addresses aren't always available. The cache is bypassed in that case.
+    haveObjects = !!Test_FindHandle(handles, eventHandle)->Object;
+
+    // Both handles refer to the same object, so the name is only queried once.
+    name1 = Test_GetCachedName(handles, generation, eventHandle);
+    name2 = Test_GetCachedName(handles, generation, duplicateHandle);
+    assert(!haveObjects || name1 == name2);
+    PhFree(handles);
+
+    // Closing the handle the name was queried from invalidates the cached name.
+    NtClose(eventHandle);
+
+    status = PhEnumHandlesEx(&handles);
+    assert(NT_SUCCESS(status));
+    generation = PhUpdateHandleNameCache(handles, NULL);
+    name3 = Test_GetCachedName(handles, generation, duplicateHandle);
+    assert(!haveObjects || name3 != name1);
+    assert(PhEqualString(name3, name1, FALSE));
+    PhFree(handles);
+
+    PhDereferenceObject(name1);
+    PhDereferenceObject(name2);
+    PhDereferenceObject(name3);
+    NtClose(duplicateHandle);
+}
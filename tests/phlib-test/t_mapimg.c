@@ -0,0 +1,106 @@
+#include "tests.h"
+#include <mapimg.h>
+
+static USHORT ReferenceCheckSum(
+    _In_ ULONG Sum,
+    _In_reads_(Count) PUSHORT Buffer,
+    _In_ ULONG Count
+    )
+{
+    while (Count--)
+    {
+        Sum += *Buffer++;
+        Sum = (Sum >> 16) + (Sum & 0xffff);
+    }
+
+    Sum = (Sum >> 16) + Sum;
+
+    return (USHORT)Sum;
+}
+
+static VOID Test_checksum(
+    VOID
+    )
+{
+    static ULONG counts[] = { 0, 1, 2, 7, 15, 16, 17, 31, 32, 33, 255, 4096, 65537 };
+    PUSHORT buffer;
+    ULONG seed;
+    ULONG i;
+    ULONG j;
+    ULONG offset;
+
+    buffer = PhAllocate((65537 + 8) * sizeof(USHORT));
+    seed = 1;
+
+    // Random data, all zeros and all ones, at different alignments.
+
+    for (i = 0; i < 65537 + 8; i++)
+        buffer[i] = (USHORT)RtlRandomEx(&seed);
+
+    for (i = 0; i < RTL_NUMBER_OF(counts); i++)
+    {
+        for (offset = 0; offset < 8; offset++)
+        {
+            assert(PhCheckSum(0, buffer + offset, counts[i]) == ReferenceCheckSum(0, buffer + offset, counts[i]));
+            assert(PhCheckSum(0x1234, buffer + offset, counts[i]) == ReferenceCheckSum(0x1234, buffer + offset, counts[i]));
+            assert(PhCheckSum(0xfffffff0, buffer + offset, counts[i]) == ReferenceCheckSum(0xfffffff0, buffer + offset, counts[i]));
+        }
+    }
+
+    for (j = 0; j < 2; j++)
+    {
+        memset(buffer, j ? 0xff : 0, (65537 + 8) * sizeof(USHORT));
+
+        for (i = 0; i < RTL_NUMBER_OF(counts); i++)
+        {
+            assert(PhCheckSum(0, buffer + 1, counts[i]) == ReferenceCheckSum(0, buffer + 1, counts[i]));
+        }
+    }
+
+    PhFree(buffer);
+}
+
+static VOID Test_checksummappedimage(
+    VOID
+    )
+{
+    static SIZE_T sizes[] = { 0x1000, 0x1001, 0x12345, 0x100000 };
+    PH_MAPPED_IMAGE mappedImage;
+    PUCHAR buffer;
+    ULONG seed;
+    ULONG checkSum;
+    ULONG i;
+    ULONG j;
+
+    buffer = PhAllocate(0x100000 + 1);
+    seed = 2;
+
+    for (i = 0; i < 0x100000 + 1; i++)
+        buffer[i] = (UCHAR)RtlRandomEx(&seed);
+
+    for (i = 0; i < RTL_NUMBER_OF(sizes); i++)
+    {
+        memset(&mappedImage, 0, sizeof(PH_MAPPED_IMAGE));
+        mappedImage.ViewBase = buffer;
+        mappedImage.Size = sizes[i];
+        mappedImage.NtHeaders = (PIMAGE_NT_HEADERS)(buffer + 0x80);
+
+        // The odd byte at the end is read as part of a word, so it must be zero.
+        buffer[sizes[i]] = 0;
+
+        checkSum = PhCheckSumMappedImage(&mappedImage);
+
+        for (j = 0; j <= 17; j++)
+            assert(PhCheckSumMappedImageEx(&mappedImage, j) == checkSum);
+    }
+
+    PhFree(buffer);
+}
+
+VOID Test_mapimg(
+    VOID
+    )
+{
+    Test_checksum();
+    Test_checksummappedimage();
+}
@@ -0,0 +1,310 @@
+#include "tests.h"
+
+static PSYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX Test_CreateGroupInformation(
+    _In_ USHORT NumberOfGroups,
+    _In_reads_(NumberOfGroups) PKAFFINITY ActiveMasks,
+    _Out_ PULONG Length
+    )
+{
+    PSYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX entry;
+    ULONG size;
+    USHORT i;
+
+    size = FIELD_OFFSET(SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX, Group.GroupInfo) + sizeof(PROCESSOR_GROUP_INFO) * NumberOfGroups;
+    entry = PhAllocate(size);
+    memset(entry, 0, size);
+    entry->Relationship = RelationGroup;
+    entry->Size = size;
+    entry->Group.MaximumGroupCount = NumberOfGroups;
+    entry->Group.ActiveGroupCount = NumberOfGroups;
+
+    for (i = 0; i < NumberOfGroups; i++)
+    {
+        entry->Group.GroupInfo[i].ActiveProcessorMask = ActiveMasks[i];
+        entry->Group.GroupInfo[i].ActiveProcessorCount = (BYTE)PhCountBitsUlongPtr(ActiveMasks[i]);
+        entry->Group.GroupInfo[i].MaximumProcessorCount = entry->Group.GroupInfo[i].ActiveProcessorCount;
+    }
+
+    *Length = size;
+
+    return entry;
+}
+
+static PSYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX Test_CreateNodeInformation(
+    _In_ ULONG NumberOfNodes,
+    _In_reads_(NumberOfNodes) PGROUP_AFFINITY GroupMasks,
+    _Out_ PULONG Length
+    )
+{
+    PSYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX buffer;
+    PSYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX entry;
+    ULONG size;
+    ULONG i;
+
+    size = sizeof(SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX);
+    buffer = PhAllocate(size * NumberOfNodes);
+    memset(buffer, 0, size * NumberOfNodes);
+
+    for (i = 0; i < NumberOfNodes; i++)
+    {
+        entry = PTR_ADD_OFFSET(buffer, size * i);
+        entry->Relationship = RelationNumaNode;
+        entry->Size = size;
+        entry->NumaNode.NodeNumber = i;
+        entry->NumaNode.GroupMask = GroupMasks[i];
+    }
+
+    *Length = size * NumberOfNodes;
+
+    return buffer;
+}
+
+static VOID Test_topology_large(
+    VOID
+    )
+{
+    ULONG bitsPerGroup = sizeof(KAFFINITY) * 8;
+    ULONG numberOfGroups = 256 / bitsPerGroup;
+    KAFFINITY halfMask = ((KAFFINITY)1 << (bitsPerGroup / 2)) - 1;
+    KAFFINITY activeMasks[8];
+    GROUP_AFFINITY groupMasks[16];
+    PSYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX groupInformation;
+    PSYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX nodeInformation;
+    ULONG groupLength;
+    ULONG nodeLength;
+    PH_PROCESSOR_TOPOLOGY topology;
+    NTSTATUS status;
+    ULONG i;
+
+    // 256 processors in full groups, with two nodes in each group.
+
+    for (i = 0; i < numberOfGroups; i++)
+        activeMasks[i] = (KAFFINITY)-1;
+
+    for (i = 0; i < numberOfGroups * 2; i++)
+    {
+        memset(&groupMasks[i], 0, sizeof(GROUP_AFFINITY));
+        groupMasks[i].Group = (WORD)(i / 2);
+        groupMasks[i].Mask = (i % 2 == 0) ? halfMask : ~halfMask;
+    }
+
+    groupInformation = Test_CreateGroupInformation((USHORT)numberOfGroups, activeMasks, &groupLength);
+    nodeInformation = Test_CreateNodeInformation(numberOfGroups * 2, groupMasks, &nodeLength);
+
+    status = PhInitializeProcessorTopology(&topology, groupInformation, groupLength, nodeInformation, nodeLength);
+    assert(NT_SUCCESS(status));
+    assert(topology.NumberOfProcessors == 256);
+    assert(topology.NumberOfGroups == numberOfGroups);
+    assert(topology.NumberOfNodes == numberOfGroups * 2);
+    assert(topology.GroupFirstProcessor[1] == bitsPerGroup);
+    assert(topology.GroupFirstProcessor[numberOfGroups] == 256);
+
+    for (i = 0; i < 256; i++)
+    {
+        assert(topology.ProcessorGroup[i] == i / bitsPerGroup);
+        assert(topology.ProcessorNumber[i] == i % bitsPerGroup);
+        assert(topology.ProcessorNode[i] == i / (bitsPerGroup / 2));
+    }
+
+    PhDeleteProcessorTopology(&topology);
+    PhFree(nodeInformation);
+    PhFree(groupInformation);
+}
+
+static VOID Test_topology_sparse(
+    VOID
+    )
+{
+    KAFFINITY activeMasks[2] = { 0xf0f, 0x3 };
+    GROUP_AFFINITY groupMasks[3];
+    PSYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX groupInformation;
+    PSYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX nodeInformation;
+    ULONG groupLength;
+    ULONG nodeLength;
+    PH_PROCESSOR_TOPOLOGY topology;
+    NTSTATUS status;
+
+    memset(groupMasks, 0, sizeof(groupMasks));
+    groupMasks[0].Group = 0;
+    groupMasks[0].Mask = 0x0ff; // includes inactive processors
+    groupMasks[1].Group = 0;
+    groupMasks[1].Mask = 0xf00;
+    groupMasks[2].Group = 1;
+    groupMasks[2].Mask = 0x3;
+
+    groupInformation = Test_CreateGroupInformation(2, activeMasks, &groupLength);
+    nodeInformation = Test_CreateNodeInformation(3, groupMasks, &nodeLength);
+
+    status = PhInitializeProcessorTopology(&topology, groupInformation, groupLength, nodeInformation, nodeLength);
+    assert(NT_SUCCESS(status));
+    assert(topology.NumberOfProcessors == 10);
+    assert(topology.NumberOfNodes == 3);
+    assert(topology.GroupFirstProcessor[1] == 8);
+    assert(topology.ProcessorGroup[3] == 0 && topology.ProcessorNumber[3] == 3 && topology.ProcessorNode[3] == 0);
+    assert(topology.ProcessorGroup[4] == 0 && topology.ProcessorNumber[4] == 8 && topology.ProcessorNode[4] == 1);
+    assert(topology.ProcessorGroup[9] == 1 && topology.ProcessorNumber[9] == 1 && topology.ProcessorNode[9] == 2);
+    PhDeleteProcessorTopology(&topology);
+
+    // Without node information, everything is in node 0.
+    status = PhInitializeProcessorTopology(&topology, groupInformation, groupLength, NULL, 0);
+    assert(NT_SUCCESS(status));
+    assert(topology.NumberOfNodes == 1);
+    assert(topology.ProcessorNode[9] == 0);
+    PhDeleteProcessorTopology(&topology);
+
+    PhFree(nodeInformation);
+    PhFree(groupInformation);
+}
+
+static VOID Test_sum_performance(
+    VOID
+    )
+{
+    ULONG bitsPerGroup = sizeof(KAFFINITY) * 8;
+    ULONG numberOfGroups = 256 / bitsPerGroup;
+    ULONG numberOfNodes = numberOfGroups * 2;
+    KAFFINITY halfMask = ((KAFFINITY)1 << (bitsPerGroup / 2)) - 1;
+    KAFFINITY activeMasks[8];
+    GROUP_AFFINITY groupMasks[16];
+    PSYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX groupInformation;
+    PSYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX nodeInformation;
+    ULONG groupLength;
+    ULONG nodeLength;
+    PH_PROCESSOR_TOPOLOGY topology;
+    NTSTATUS status;
+    SYSTEM_PROCESSOR_PERFORMANCE_INFORMATION information[256];
+    SYSTEM_PROCESSOR_PERFORMANCE_INFORMATION totals[2];
+    PSYSTEM_PROCESSOR_PERFORMANCE_INFORMATION nodeTotals[2];
+    ULONG64 expectedIdle;
+    ULONG64 expectedKernel;
+    ULONG64 expectedUser;
+    ULONG sample;
+    ULONG i;
+    ULONG j;
+
+    // Two samples from 256 processors in full groups, with two nodes in each group.
+
+    for (i = 0; i < numberOfGroups; i++)
+        activeMasks[i] = (KAFFINITY)-1;
+
+    for (i = 0; i < numberOfNodes; i++)
+    {
+        memset(&groupMasks[i], 0, sizeof(GROUP_AFFINITY));
+        groupMasks[i].Group = (WORD)(i / 2);
+        groupMasks[i].Mask = (i % 2 == 0) ? halfMask : ~halfMask;
+    }
+
+    groupInformation = Test_CreateGroupInformation((USHORT)numberOfGroups, activeMasks, &groupLength);
+    nodeInformation = Test_CreateNodeInformation(numberOfNodes, groupMasks, &nodeLength);
+
+    status = PhInitializeProcessorTopology(&topology, groupInformation, groupLength, nodeInformation, nodeLength);
+    assert(NT_SUCCESS(status));
+
+    for (sample = 0; sample < 2; sample++)
+    {
+        nodeTotals[sample] = PhAllocate(sizeof(SYSTEM_PROCESSOR_PERFORMANCE_INFORMATION) * numberOfNodes);
+
+        for (i = 0; i < 256; i++)
+        {
+            memset(&information[i], 0, sizeof(SYSTEM_PROCESSOR_PERFORMANCE_INFORMATION));
+            information[i].IdleTime.QuadPart = (sample + 1) * 1000 + i;
+            information[i].KernelTime.QuadPart = information[i].IdleTime.QuadPart + (sample + 1) * 100 + i % 7; // includes idle time
+            information[i].UserTime.QuadPart = (sample + 1) * 10 * (i % 3);
+            information[i].DpcTime.QuadPart = i;
+            information[i].InterruptTime.QuadPart = 2 * i;
+            information[i].InterruptCount = 1;
+        }
+
+        PhSumProcessorPerformanceInformation(&topology, information, &totals[sample], nodeTotals[sample]);
+
+        assert(information[255].KernelTime.QuadPart == (sample + 1) * 100 + 255 % 7);
+        assert(totals[sample].InterruptCount == 256);
+        assert(totals[sample].DpcTime.QuadPart == 255 * 256 / 2);
+        assert(totals[sample].InterruptTime.QuadPart == 255 * 256);
+
+        expectedIdle = 0;
+        expectedKernel = 0;
+        expectedUser = 0;
+
+        for (i = 0; i < 256; i++)
+        {
+            expectedIdle += (sample + 1) * 1000 + i;
+            expectedKernel += (sample + 1) * 100 + i % 7;
+            expectedUser += (sample + 1) * 10 * (i % 3);
+        }
+
+        assert(totals[sample].IdleTime.QuadPart == expectedIdle);
+        assert(totals[sample].KernelTime.QuadPart == expectedKernel);
+        assert(totals[sample].UserTime.QuadPart == expectedUser);
+
+        // Each node contains half of a group, in order.
+        for (i = 0; i < numberOfNodes; i++)
+        {
+            expectedIdle = 0;
+            expectedKernel = 0;
+
+            for (j = i * (bitsPerGroup / 2); j < (i + 1) * (bitsPerGroup / 2); j++)
+            {
+                expectedIdle += (sample + 1) * 1000 + j;
+                expectedKernel += (sample + 1) * 100 + j % 7;
+            }
+
+            assert(nodeTotals[sample][i].InterruptCount == bitsPerGroup / 2);
+            assert(nodeTotals[sample][i].IdleTime.QuadPart == expectedIdle);
+            assert(nodeTotals[sample][i].KernelTime.QuadPart == expectedKernel);
+        }
+    }
+
+    // Replaying the second sample after the first gives the same delta for every node.
+    for (i = 0; i < numberOfNodes; i++)
+    {
+        assert(nodeTotals[1][i].IdleTime.QuadPart - nodeTotals[0][i].IdleTime.QuadPart == 1000 * (bitsPerGroup / 2));
+        assert(nodeTotals[1][i].KernelTime.QuadPart - nodeTotals[0][i].KernelTime.QuadPart == 100 * (bitsPerGroup / 2));
+    }
+
+    // Node totals are optional.
+    PhSumProcessorPerformanceInformation(&topology, information, &totals[0], NULL);
+    assert(totals[0].InterruptCount == 256);
+
+    PhFree(nodeTotals[1]);
+    PhFree(nodeTotals[0]);
+    PhDeleteProcessorTopology(&topology);
+    PhFree(nodeInformation);
+    PhFree(groupInformation);
+}
+
+static VOID Test_topology_system(
+    VOID
+    )
+{
+    PH_PROCESSOR_TOPOLOGY topology;
+    NTSTATUS status;
+    PSYSTEM_PROCESSOR_PERFORMANCE_INFORMATION performanceInformation;
+
+    status = PhQueryProcessorTopology(&topology);
+    assert(NT_SUCCESS(status));
+    assert(topology.NumberOfProcessors >= (ULONG)PhSystemBasicInformation.NumberOfProcessors);
+
+    performanceInformation = PhAllocate(sizeof(SYSTEM_PROCESSOR_PERFORMANCE_INFORMATION) * topology.NumberOfProcessors);
+    status = PhQueryProcessorInformation(
+        &topology,
+        SystemProcessorPerformanceInformation,
+        sizeof(SYSTEM_PROCESSOR_PERFORMANCE_INFORMATION),
+        performanceInformation
+        );
+    assert(NT_SUCCESS(status));
+    assert(performanceInformation[topology.NumberOfProcessors - 1].KernelTime.QuadPart != 0);
+    PhFree(performanceInformation);
+
+    PhDeleteProcessorTopology(&topology);
+}
+
+VOID Test_native(
+    VOID
+    )
+{
+    Test_topology_large();
+    Test_topology_sparse();
+    Test_sum_performance();
+    Test_topology_system();
+}
@@ -0,0 +1,108 @@
+#include "tests.h"
+#include <stkprof.h>
+
+static PPH_STRING NTAPI ResolveAddress(
+    _In_ ULONG64 Address,
+    _In_opt_ PVOID Context
+    )
+{
+    PULONG resolveCount = Context;
+
+    (*resolveCount)++;
+
+    if (Address == 0x3000)
+        return NULL;
+    if (Address == 0x6000)
+        return PhCreateString(L"f(a; b)\r\n");
+
+    return PhFormatString(L"f%I64x", Address >> 12);
+}
+
+static VOID Test_folded(
+    VOID
+    )
+{
+    // Recorded stacks, innermost frame first.
+    static ULONG64 stack1[] = { 0x4000, 0x2000, 0x1000 };
+    static ULONG64 stack2[] = { 0x5000, 0x2000, 0x1000 };
+    static ULONG64 stack3[] = { 0x2000, 0x1000 };
+    static ULONG64 stack4[] = { 0x3000, 0x6000 };
+    PH_STACK_PROFILE profile;
+    PPH_STRING folded;
+    ULONG resolveCount;
+    ULONG i;
+
+    PhInitializeStackProfile(&profile);
+
+    folded = PhFormatStackProfileFolded(&profile, NULL, NULL);
+    assert(folded->Length == 0);
+    PhDereferenceObject(folded);
+
+    for (i = 0; i < 3; i++)
+        PhAddStackProfileSample(&profile, stack1, RTL_NUMBER_OF(stack1));
+
+    PhAddStackProfileSample(&profile, stack2, RTL_NUMBER_OF(stack2));
+    PhAddStackProfileSample(&profile, stack3, RTL_NUMBER_OF(stack3));
+    PhAddStackProfileSample(&profile, stack4, RTL_NUMBER_OF(stack4));
+    PhAddStackProfileSample(&profile, stack2, RTL_NUMBER_OF(stack2));
+    PhAddStackProfileSample(&profile, stack1, 0);
+
+    assert(profile.NumberOfSamples == 7);
+    assert(profile.NumberOfNodes == 1 + 6);
+
+    resolveCount = 0;
+    folded = PhFormatStackProfileFolded(&profile, ResolveAddress, &resolveCount);
+    assert(resolveCount == 6);
+    assert(PhEqualString2(folded,
+        L"f1;f2 1\n"
+        L"f1;f2;f4 3\n"
+        L"f1;f2;f5 2\n"
+        L"f(a__b)__;0x3000 1\n",
+        FALSE));
+    PhDereferenceObject(folded);
+
+    PhDeleteStackProfile(&profile);
+}
+
+static VOID Test_deep(
+    VOID
+    )
+{
+    PH_STACK_PROFILE profile;
+    PULONG64 frames;
+    PPH_STRING folded;
+    ULONG i;
+
+    // Many samples that share a deep prefix.
+
+    frames = PhAllocate(1000 * sizeof(ULONG64));
+
+    for (i = 0; i < 1000; i++)
+        frames[i] = 0x10000 + i;
+
+    PhInitializeStackProfile(&profile);
+
+    for (i = 0; i < 1000; i++)
+    {
+        frames[0] = 0x1000 + i % 10;
+        PhAddStackProfileSample(&profile, frames, 1000);
+    }
+
+    assert(profile.NumberOfSamples == 1000);
+    assert(profile.NumberOfNodes == 1 + 999 + 10);
+
+    folded = PhFormatStackProfileFolded(&profile, NULL, NULL);
+    assert(PhEndsWithString2(folded, L";0x1009 100\n", FALSE));
+    PhDereferenceObject(folded);
+
+    PhDeleteStackProfile(&profile);
+    PhFree(frames);
+}
+
+VOID Test_stkprof(
+    VOID
+    )
+{
+    Test_folded();
+    Test_deep();
+}
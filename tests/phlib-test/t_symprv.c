@@ -0,0 +1,214 @@
+#include "tests.h"
+#include <symprv.h>
+
+#include <dbghelp.h>
+
+#include <symprvp.h>
+
+// A stub dbghelp which only counts module loads. Symbol lookups always fail, so resolved
+// addresses come back as module+offset.
+
+extern _SymInitialize SymInitialize_I;
+extern _SymFromAddrW SymFromAddrW_I;
+extern _SymLoadModuleExW SymLoadModuleExW_I;
+
+static ULONG LoadCount;
+static ULONG64 LastLoadBase;
+
+static BOOL WINAPI Test_SymInitialize(
+    _In_ HANDLE hProcess,
+    _In_opt_ PCSTR UserSearchPath,
+    _In_ BOOL fInvadeProcess
+    )
+{
+    return TRUE;
+}
+
+static BOOL WINAPI Test_SymFromAddrW(
+    _In_ HANDLE hProcess,
+    _In_ DWORD64 Address,
+    _Out_opt_ PDWORD64 Displacement,
+    _Inout_ PSYMBOL_INFOW Symbol
+    )
+{
+    if (Displacement)
+        *Displacement = 0;
+
+    return FALSE;
+}
+
+static DWORD64 WINAPI Test_SymLoadModuleExW(
+    _In_ HANDLE hProcess,
+    _In_ HANDLE hFile,
+    _In_ PCWSTR ImageName,
+    _In_ PCWSTR ModuleName,
+    _In_ DWORD64 BaseOfDll,
+    _In_ DWORD DllSize,
+    _In_ PMODLOAD_DATA Data,
+    _In_ DWORD Flags
+    )
+{
+    LoadCount++;
+    LastLoadBase = BaseOfDll;
+
+    return BaseOfDll;
+}
+
+static PPH_STRING Test_ResolveAddress(
+    _In_ PPH_SYMBOL_PROVIDER SymbolProvider,
+    _In_ ULONG64 Address,
+    _Out_ PPH_SYMBOL_RESOLVE_LEVEL ResolveLevel
+    )
+{
+    return PhGetSymbolFromAddress(SymbolProvider, Address, ResolveLevel, NULL, NULL, NULL);
+}
+
+static VOID Test_deferred(
+    VOID
+    )
+{
+    PPH_SYMBOL_PROVIDER symbolProvider;
+    WCHAR fileName[32];
+    ULONG64 moduleBase;
+    PPH_STRING moduleFileName;
+    BOOLEAN loaded;
+    PPH_STRING symbol;
+    PH_SYMBOL_RESOLVE_LEVEL resolveLevel;
+    ULONG i;
+
+    symbolProvider = PhCreateSymbolProvider(NULL);
+    LoadCount = 0;
+
+    for (i = 0; i < 300; i++)
+    {
+        _snwprintf(fileName, RTL_NUMBER_OF(fileName), L"C:\\mod%lu.dll", i);
+        PhAddModuleSymbolProvider(symbolProvider, fileName, 0x10000000 + i * 0x100000, 0x80000);
+    }
+
+    assert(LoadCount == 0);
+
+    // Finding the module doesn't need any symbols.
+    moduleBase = PhGetModuleFromAddress(symbolProvider, 0x10500010, &moduleFileName);
+    assert(moduleBase == 0x10500000);
+    assert(PhEndsWithString2(moduleFileName, L"\\mod5.dll", TRUE));
+    PhDereferenceObject(moduleFileName);
+    assert(LoadCount == 0);
+
+    symbol = Test_ResolveAddress(symbolProvider, 0x10500010, &resolveLevel);
+    assert(resolveLevel == PhsrlModule);
+    assert(PhEqualString2(symbol, L"mod5.dll+0x10", TRUE));
+    PhDereferenceObject(symbol);
+    assert(LoadCount == 1 && LastLoadBase == 0x10500000);
+
+    symbol = Test_ResolveAddress(symbolProvider, 0x1057ffff, &resolveLevel);
+    assert(resolveLevel == PhsrlModule);
+    PhDereferenceObject(symbol);
+    assert(LoadCount == 1);
+
+    // Addresses between modules don't load anything.
+    symbol = Test_ResolveAddress(symbolProvider, 0x10580000, &resolveLevel);
+    assert(resolveLevel == PhsrlAddress);
+    PhDereferenceObject(symbol);
+    symbol = Test_ResolveAddress(symbolProvider, 0x0fffffff, &resolveLevel);
+    assert(resolveLevel == PhsrlAddress);
+    PhDereferenceObject(symbol);
+    assert(LoadCount == 1);
+
+    // Explicit loads still work, and only load each module once.
+    loaded = PhLoadModuleSymbolProvider(symbolProvider, L"C:\\mod5.dll", 0x10500000, 0x80000);
+    assert(loaded);
+    assert(LoadCount == 1);
+    loaded = PhLoadModuleSymbolProvider(symbolProvider, L"C:\\mod6.dll", 0x10600000, 0x80000);
+    assert(loaded);
+    assert(LoadCount == 2 && LastLoadBase == 0x10600000);
+    loaded = PhLoadModuleSymbolProvider(symbolProvider, L"C:\\other.dll", 0x40000000, 0x1000);
+    assert(loaded);
+    assert(LoadCount == 3 && LastLoadBase == 0x40000000);
+
+    symbol = Test_ResolveAddress(symbolProvider, 0x10600000, &resolveLevel);
+    assert(PhEqualString2(symbol, L"mod6.dll+0x0", TRUE));
+    PhDereferenceObject(symbol);
+    symbol = Test_ResolveAddress(symbolProvider, 0x40000100, &resolveLevel);
+    assert(PhEqualString2(symbol, L"other.dll+0x100", TRUE));
+    PhDereferenceObject(symbol);
+    assert(LoadCount == 3);
+
+    PhDereferenceObject(symbolProvider);
+}
+
+static VOID Test_kernel(
+    VOID
+    )
+{
+    PPH_SYMBOL_PROVIDER kernelSymbolProvider;
+    PPH_SYMBOL_PROVIDER symbolProviders[2];
+    ULONG64 kernelBase;
+    PPH_STRING symbol;
+    PH_SYMBOL_RESOLVE_LEVEL resolveLevel;
+    ULONG i;
+
+    kernelBase = ((ULONG64)PhSystemBasicInformation.MaximumUserModeAddress + 0x10000) & ~0xffffULL;
+
+    kernelSymbolProvider = PhCreateSymbolProvider(NULL);
+    PhAddModuleSymbolProvider(kernelSymbolProvider, L"C:\\ntoskrnl.exe", kernelBase, 0x800000);
+    LoadCount = 0;
+
+    for (i = 0; i < 2; i++)
+    {
+        symbolProviders[i] = PhCreateSymbolProvider(NULL);
+        PhSetKernelSymbolProvider(symbolProviders[i], kernelSymbolProvider);
+        PhAddModuleSymbolProvider(symbolProviders[i], L"C:\\ntdll.dll", 0x10000000, 0x100000);
+    }
+
+    // Kernel symbols are loaded once for all providers.
+    for (i = 0; i < 2; i++)
+    {
+        assert(PhGetModuleFromAddress(symbolProviders[i], kernelBase + 0x20, NULL) == kernelBase);
+
+        symbol = Test_ResolveAddress(symbolProviders[i], kernelBase + 0x20, &resolveLevel);
+        assert(resolveLevel == PhsrlModule);
+        assert(PhEqualString2(symbol, L"ntoskrnl.exe+0x20", TRUE));
+        PhDereferenceObject(symbol);
+        assert(LoadCount == 1 && LastLoadBase == kernelBase);
+    }
+
+    // User symbols are still loaded per provider.
+    for (i = 0; i < 2; i++)
+    {
+        symbol = Test_ResolveAddress(symbolProviders[i], 0x10000020, &resolveLevel);
+        assert(PhEqualString2(symbol, L"ntdll.dll+0x20", TRUE));
+        PhDereferenceObject(symbol);
+        assert(LoadCount == 2 + i);
+    }
+
+    PhDereferenceObject(symbolProviders[0]);
+    PhDereferenceObject(symbolProviders[1]);
+
+    // The providers referenced the kernel provider, so it must still be usable.
+    symbol = Test_ResolveAddress(kernelSymbolProvider, kernelBase + 0x40, &resolveLevel);
+    assert(PhEqualString2(symbol, L"ntoskrnl.exe+0x40", TRUE));
+    PhDereferenceObject(symbol);
+    assert(LoadCount == 3);
+
+    PhDereferenceObject(kernelSymbolProvider);
+}
+
+VOID Test_symprv(
+    VOID
+    )
+{
+    _SymInitialize oldSymInitialize = SymInitialize_I;
+    _SymFromAddrW oldSymFromAddrW = SymFromAddrW_I;
+    _SymLoadModuleExW oldSymLoadModuleExW = SymLoadModuleExW_I;
+
+    SymInitialize_I = Test_SymInitialize;
+    SymFromAddrW_I = Test_SymFromAddrW;
+    SymLoadModuleExW_I = Test_SymLoadModuleExW;
+
+    Test_deferred();
+    Test_kernel();
+
+    SymInitialize_I = oldSymInitialize;
+    SymFromAddrW_I = oldSymFromAddrW;
+    SymLoadModuleExW_I = oldSymLoadModuleExW;
+}
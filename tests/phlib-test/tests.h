@@ -19,4 +19,32 @@ VOID Test_util(
     VOID
     );
 
+VOID Test_mapimg(
+    VOID
+    );
+
+VOID Test_stkprof(
+    VOID
+    );
+
+VOID Test_histfile(
+    VOID
+    );
+
+VOID Test_native(
+    VOID
+    );
+
+VOID Test_symprv(
+    VOID
+    );
+
+VOID Test_hndlinfo(
+    VOID
+    );
+
+VOID Test_circbuf(
+    VOID
+    );
+
 #endif
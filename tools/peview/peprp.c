@@ -183,7 +183,7 @@ static NTSTATUS CheckSumImageThreadStart(
     ULONG checkSum;
 
     windowHandle = Parameter;
-    checkSum = PhCheckSumMappedImage(&PvMappedImage);
+    checkSum = PhCheckSumMappedImageEx(&PvMappedImage, 0);
 
     PostMessage(
         windowHandle,